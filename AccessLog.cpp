@@ -0,0 +1,402 @@
+#include "AccessLog.hpp"
+#include "RingBuffer.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+#include "ws-util.h"
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+
+#include <Windows.h>
+
+#include "Debug.hpp"
+
+using namespace AccessLogFormat;
+
+//////////////////////////////////////////////////////////////////////////
+
+bool AccessLog::ENABLED = false;
+std::string AccessLog::PATH = "access.bin";
+unsigned long long AccessLog::MAX_FILE_SIZE = 64 * 1024 * 1024;
+int AccessLog::MAX_FILES = 8;
+unsigned long AccessLog::FLUSH_INTERVAL = 200;
+size_t AccessLog::BUFFER_SIZE = 256 * 1024;
+
+void AccessLog::Entry::Reset() {
+    memset(this, 0, sizeof(Entry));
+}
+
+namespace {
+
+// һ̵߳ļ¼
+struct ThreadBuffer {
+    ThreadBuffer(size_t capacity) : ring(capacity) {}
+
+    RingBuffer ring;
+    std::atomic<unsigned long long> dropped{0};
+
+    // ߳˳ſպ󼴿
+    std::atomic_bool orphaned{false};
+};
+
+// ʱ @a ts Ϊ @a base ΢
+uint32_t Offset(int64_t ts, int64_t base) {
+    if (ts == 0) {
+        return NO_TIME;
+    }
+
+    int64_t us = Clock::ToMicroseconds(ts - base);
+    if (us < 0) {
+        return 0;
+    }
+
+    return us < NO_TIME ? (uint32_t) us : NO_TIME - 1;
+}
+
+// ̨дļ߳
+class Writer {
+public:
+
+    static Writer &GetInstance() {
+        static Writer s_writer;
+        return s_writer;
+    }
+
+    bool Start() {
+        std::lock_guard<std::mutex> lock(m_stopMutex);
+
+        if (m_running) {
+            return true;
+        }
+
+        // ϴµļߣÿļԼֵ
+        if (GetFileAttributesA(AccessLog::PATH.c_str()) !=
+            INVALID_FILE_ATTRIBUTES) {
+            ShiftFiles();
+        }
+
+        if (!Open()) {
+            return false;
+        }
+
+        m_stopping = false;
+        m_running = true;
+        m_thread = std::thread(&Writer::Run, this);
+
+        return true;
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(m_stopMutex);
+
+        if (m_thread.joinable()) {
+            m_stopping = true;
+            SetEvent(m_wake);
+
+            m_thread.join();
+        }
+    }
+
+    bool IsRunning() const {
+        return m_running;
+    }
+
+    // Ϊǰ̷߳仺
+    ThreadBuffer *Register() {
+        ThreadBuffer *buf = new ThreadBuffer(AccessLog::BUFFER_SIZE);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.push_back(buf);
+
+        return buf;
+    }
+
+    unsigned long long GetRecordCount() const {
+        return m_numRecords;
+    }
+
+    unsigned long long GetDroppedCount() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        unsigned long long total = m_droppedExited;
+        for (auto buf : m_buffers) {
+            total += buf->dropped;
+        }
+
+        return total;
+    }
+
+private:
+
+    Writer() {
+        m_wake = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    }
+
+    ~Writer() {
+        Stop();
+        CloseHandle(m_wake);
+
+        for (auto buf : m_buffers) {
+            delete buf;
+        }
+    }
+
+    void Run() {
+        while (!m_stopping) {
+            WaitForSingleObject(m_wake, AccessLog::FLUSH_INTERVAL);
+            Drain();
+        }
+
+        m_running = false;
+        Drain();
+
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+
+    // ȡлеļ¼дļ
+    void Drain() {
+        std::vector<ThreadBuffer *> buffers;
+
+        m_mutex.lock();
+        buffers = m_buffers;
+        m_mutex.unlock();
+
+        for (auto buf : buffers) {
+            bool orphaned = buf->orphaned;
+
+            while (buf->ring.Read(m_scratch)) {
+                AccessLog::Entry entry;
+                memcpy(&entry, m_scratch.data(), sizeof(entry));
+
+                std::string host(m_scratch.data() + sizeof(entry),
+                                 m_scratch.size() - sizeof(entry));
+
+                Encode(entry, host);
+            }
+
+            if (orphaned) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_droppedExited += buf->dropped;
+                m_buffers.erase(std::find(m_buffers.begin(),
+                                          m_buffers.end(), buf));
+                delete buf;
+            }
+        }
+
+        WriteOut();
+    }
+
+    // һʼ¼Ҫʱдֵ
+    void Encode(const AccessLog::Entry &entry, const std::string &host) {
+        auto it = m_hosts.find(host);
+        if (it == m_hosts.end()) {
+            it = m_hosts.emplace(host, (uint32_t) m_hosts.size()).first;
+
+            HostRecord hr;
+            hr.id = it->second;
+
+            Put(RT_HOST, &hr, sizeof(hr), host.data(), host.size());
+        }
+
+        AccessRecord ar;
+        ar.accept = Clock::ToUnixMicroseconds(entry.accept);
+        ar.request = Offset(entry.request, entry.accept);
+        ar.dnsStart = Offset(entry.dnsStart, entry.accept);
+        ar.dnsEnd = Offset(entry.dnsEnd, entry.accept);
+        ar.connect = Offset(entry.connect, entry.accept);
+        ar.firstByte = Offset(entry.firstByte, entry.accept);
+        ar.close = Offset(entry.close, entry.accept);
+        ar.hostId = it->second;
+        ar.port = entry.port;
+        ar.status = entry.status;
+        ar.flags = entry.flags;
+        ar.inBytes = entry.inBytes;
+        ar.outBytes = entry.outBytes;
+
+        Put(RT_ACCESS, &ar, sizeof(ar), nullptr, 0);
+        m_numRecords++;
+    }
+
+    void Put(RecordType type, const void *a, size_t alen,
+             const void *b, size_t blen) {
+        RecordHeader rh;
+        rh.type = (uint8_t) type;
+        rh.reserved = 0;
+        rh.length = (uint16_t) (alen + blen);
+
+        auto p = (const char *) &rh;
+        m_out.insert(m_out.end(), p, p + sizeof(rh));
+
+        p = (const char *) a;
+        m_out.insert(m_out.end(), p, p + alen);
+
+        if (blen > 0) {
+            p = (const char *) b;
+            m_out.insert(m_out.end(), p, p + blen);
+        }
+    }
+
+    // д¼ļʱֻ
+    void WriteOut() {
+        if (m_out.empty()) {
+            return;
+        }
+
+        DWORD written = 0;
+        if (!WriteFile(m_file, m_out.data(), (DWORD) m_out.size(),
+                       &written, nullptr)) {
+            Logger::LogWindowsLastError(__FUNC__ "WriteFile() failed");
+        }
+
+        m_fileSize += written;
+        m_out.clear();
+
+        if (m_fileSize >= AccessLog::MAX_FILE_SIZE) {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+
+            ShiftFiles();
+            Open();
+        }
+    }
+
+    // ļдļͷ
+    bool Open() {
+        m_file = CreateFileA(AccessLog::PATH.c_str(), GENERIC_WRITE,
+                             FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (m_file == INVALID_HANDLE_VALUE) {
+            Logger::LogWindowsLastError(__FUNC__ "CreateFile() failed");
+            return false;
+        }
+
+        FileHeader fh;
+        memcpy(fh.magic, MAGIC, sizeof(fh.magic));
+        fh.version = VERSION;
+
+        DWORD written = 0;
+        WriteFile(m_file, &fh, sizeof(fh), &written, nullptr);
+
+        m_fileSize = written;
+        m_hosts.clear();
+
+        return true;
+    }
+
+    // PATH -> PATH.1 -> PATH.2  ɵļɾ
+    void ShiftFiles() {
+        auto name = [](int i) {
+            std::ostringstream oss;
+            oss << AccessLog::PATH;
+
+            if (i > 0) {
+                oss << '.' << i;
+            }
+
+            return oss.str();
+        };
+
+        DeleteFileA(name(AccessLog::MAX_FILES).c_str());
+
+        for (int i = AccessLog::MAX_FILES - 1; i >= 0; i--) {
+            MoveFileExA(name(i).c_str(), name(i + 1).c_str(),
+                        MOVEFILE_REPLACE_EXISTING);
+        }
+    }
+
+private:
+
+    std::mutex m_mutex; //  #m_buffers
+    std::vector<ThreadBuffer *> m_buffers;
+    unsigned long long m_droppedExited = 0;
+
+    std::mutex m_stopMutex;
+    std::thread m_thread;
+    HANDLE m_wake;
+    std::atomic_bool m_running{false};
+    std::atomic_bool m_stopping{false};
+
+    std::atomic<unsigned long long> m_numRecords{0};
+
+    // ֻɺ̷̨߳
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    unsigned long long m_fileSize = 0;
+    std::unordered_map<std::string, uint32_t> m_hosts;
+    std::vector<char> m_scratch;
+    std::vector<char> m_out;
+};
+
+// ߳˳ʱѻ̨̻߳
+struct BufferHolder {
+    ThreadBuffer *buf = nullptr;
+
+    ~BufferHolder() {
+        if (buf) {
+            buf->orphaned = true;
+        }
+    }
+};
+
+thread_local BufferHolder tls_holder;
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool AccessLog::Start() {
+    if (!ENABLED) {
+        return false;
+    }
+
+    return Writer::GetInstance().Start();
+}
+
+/*static*/
+void AccessLog::Stop() {
+    Writer::GetInstance().Stop();
+}
+
+/*static*/
+bool AccessLog::IsRunning() {
+    return Writer::GetInstance().IsRunning();
+}
+
+/*static*/
+void AccessLog::Submit(const Entry &entry, const std::string &host) {
+    Writer &writer = Writer::GetInstance();
+    if (!writer.IsRunning()) {
+        return;
+    }
+
+    ThreadBuffer *buf = tls_holder.buf;
+    if (!buf) {
+        buf = tls_holder.buf = writer.Register();
+    }
+
+    // ʹ¼
+    size_t hostLen = std::min<size_t>(host.length(), 255);
+
+    if (!buf->ring.TryWrite(&entry, sizeof(entry), host.data(), hostLen)) {
+        buf->dropped.store(buf->dropped.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    }
+}
+
+/*static*/
+unsigned long long AccessLog::GetRecordCount() {
+    return Writer::GetInstance().GetRecordCount();
+}
+
+/*static*/
+unsigned long long AccessLog::GetDroppedCount() {
+    return Writer::GetInstance().GetDroppedCount();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "AccessLogFormat.hpp"
+
+#include <string>
+#include <cstdint>
+
+/// Ʒ־
+///
+/// ÿʱ̰߳һ¼д뱾̵߳
+/// λ̨̻߳ʱ䡢滻Ϊźд
+/// ļļ #MAX_FILE_SIZE ֻ
+///
+/// ļʽ AccessLogFormat AccessLogDecoder תΪ CSV/JSON
+class AccessLog {
+public:
+
+    /// Ƿ
+    static bool ENABLED;
+
+    /// ǰ־ļ·ֻļμϺ׺ .1.2
+    static std::string PATH;
+
+    /// ļֽ
+    static unsigned long long MAX_FILE_SIZE;
+
+    /// ʷļĿ
+    static int MAX_FILES;
+
+    /// ̨߳дļʱ룩
+    static unsigned long FLUSH_INTERVAL;
+
+    /// ÿ̵߳ĻλСֽڣ
+    static size_t BUFFER_SIZE;
+
+    /// һķϢ
+    ///
+    /// ʱ̾Ϊ Clock::Now() ķֵ0 ʾý׶δ
+    struct Entry {
+        int64_t accept; ///< 
+        int64_t request; ///< յͷ
+        int64_t dnsStart; ///< ʼ
+        int64_t dnsEnd; ///< 
+        int64_t connect; ///< ӵ
+        int64_t firstByte; ///< յӦĵһֽ
+        int64_t close; ///< 
+
+        uint64_t inBytes; ///< ϴֽ
+        uint64_t outBytes; ///< ·ֽ
+
+        uint16_t port;
+        uint16_t status; ///< HTTP ״̬
+        uint32_t flags; ///< AccessLogFormat::Flags
+
+        /// ֶ
+        void Reset();
+    };
+
+    /// ־ļ̨߳
+    static bool Start();
+
+    /// дʣļ¼̨߳
+    static void Stop();
+
+    /// Ƿ
+    static bool IsRunning();
+
+    /// ύһ¼
+    ///
+    /// ʱ
+    static void Submit(const Entry &entry, const std::string &host);
+
+    /// ȡдļļ¼
+    static unsigned long long GetRecordCount();
+
+    /// ȡ򻺳ļ¼
+    static unsigned long long GetDroppedCount();
+};
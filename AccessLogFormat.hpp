@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+
+/// Ʒ־ļʽ
+///
+///  Windows빤 AccessLogDecoder áΪС
+///
+/// ļ #FileHeader ͷ֮һϵм¼ÿ¼
+/// #RecordHeader ͷֻÿļ״γʱ
+/// #RT_HOST ¼дһΣʼ¼ͨ
+/// ÿļԶ롣
+namespace AccessLogFormat {
+
+/// ļħ "MPAL"
+const char MAGIC[4] = { 'M', 'P', 'A', 'L' };
+
+/// ʽ汾
+const uint32_t VERSION = 1;
+
+/// ʾý׶δʱƫ
+const uint32_t NO_TIME = 0xFFFFFFFF;
+
+/// ¼
+enum RecordType {
+    RT_HOST = 1, ///< ֵ
+    RT_ACCESS = 2, ///< һ HTTP 󣨻һ
+};
+
+/// ʼ¼ı־λ
+enum Flags {
+    F_TUNNEL = 1 << 0, ///< CONNECT 
+    F_DNS_CACHE_HIT = 1 << 1, ///<  DNS 
+    F_DNS_FAILED = 1 << 2, ///< ʧܣ񶨻У
+    F_CONNECT_FAILED = 1 << 3, ///< ޷ӵ
+    F_REUSED = 1 << 4, ///< еķ
+    F_KEEP_ALIVE = 1 << 5, ///< ϵĵһ
+    F_BAD_RESPONSE = 1 << 6, ///< Ӧʽ
+};
+
+#pragma pack(push, 1)
+
+/// ļͷ
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+/// ¼ͷ
+struct RecordHeader {
+    uint8_t type; ///< #RecordType
+    uint8_t reserved;
+    uint16_t length; ///< ݵĳ
+};
+
+/// #RT_HOST ¼ 0 β
+struct HostRecord {
+    uint32_t id;
+};
+
+/// #RT_ACCESS ¼
+struct AccessRecord {
+    int64_t accept; ///< ӵʱ̣ 1970 ΢
+
+    /// Ϊ #accept ΢#NO_TIME ʾδ
+    uint32_t request; ///< յͷ
+    uint32_t dnsStart; ///< ʼ
+    uint32_t dnsEnd; ///< 
+    uint32_t connect; ///< ӵ
+    uint32_t firstByte; ///< յӦĵһֽ
+    uint32_t close; ///< 
+
+    uint32_t hostId; ///< #RT_HOST ¼еı
+    uint16_t port;
+    uint16_t status; ///< HTTP ״̬룬δ֪Ϊ 0
+    uint32_t flags; ///< #Flags
+
+    uint64_t inBytes; ///< ϴֽ
+    uint64_t outBytes; ///< ·ֽ
+};
+
+#pragma pack(pop)
+
+} // namespace AccessLogFormat
@@ -0,0 +1,673 @@
+#include "AdminServer.hpp"
+#include "Metrics.hpp"
+#include "TrafficTable.hpp"
+#include "Request.hpp"
+#include "DNSClient.hpp"
+#include "DNSCache.hpp"
+#include "Capture.hpp"
+#include "DispatchProfile.hpp"
+#include "TaskExecutor.hpp"
+#include "Topology.hpp"
+#include "Admission.hpp"
+#include "Logger.hpp"
+
+#include <mswsock.h> // for LPFN_ACCEPTEX
+
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cassert>
+using namespace std;
+
+#include "Debug.hpp"
+
+
+//////////////////////////////////////////////////////////////////////////
+
+extern LPFN_ACCEPTEX lpfnAcceptEx;
+
+bool AdminServer::ENABLED = false;
+string AdminServer::ADDRESS = "127.0.0.1";
+u_short AdminServer::PORT = 1991;
+
+/// һ
+///
+/// ξ ACCEPTRECVSEND ֲ
+struct AdminServer::Connection : public PerIoContext {
+    enum {
+        ADDR_LEN = sizeof(sockaddr_in) + 16,
+    };
+
+    Connection() : PerIoContext(INVALID_SOCKET, ACCEPT) {}
+
+    WSABUF bufSpec;
+    DWORD flags = 0;
+
+    // AcceptEx() ڿͷдַ֮ͷ
+    char buf[MAX_REQUEST_SIZE + 1];
+    DWORD rx = 0;
+
+    string out; // Ӧ
+    size_t tx = 0; // ѷ͵ֽ
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// ȡѯַ @a query в @a name ֵ URL 
+static string GetParam(const string &query, const char *name) {
+    size_t len = strlen(name);
+    size_t begin = 0;
+
+    while (begin < query.length()) {
+        size_t end = query.find('&', begin);
+        if (end == string::npos) {
+            end = query.length();
+        }
+
+        if (query.compare(begin, len, name) == 0 &&
+            begin + len < end && query[begin + len] == '=') {
+            return query.substr(begin + len + 1, end - begin - len - 1);
+        }
+
+        begin = end + 1;
+    }
+
+    return string();
+}
+
+/*static*/
+AdminServer &AdminServer::GetInstance() {
+    static AdminServer s_server;
+    return s_server;
+}
+
+// ߳ Request ڴصĺϼ
+static RequestPool::Usage GetRequestPoolUsage() {
+    RequestPool::Usage total = {};
+
+    for (int i = 0; i < Topology::GetGroupCount(); i++) {
+        auto usage = RequestPool::GetInstance(i).GetUsage();
+        total.capacity += usage.capacity;
+        total.used += usage.used;
+        total.staticUsed += usage.staticUsed;
+        total.numChunks += usage.numChunks;
+        total.numFree += usage.numFree;
+    }
+
+    return total;
+}
+
+AdminServer::AdminServer() {
+    m_running = false;
+
+    // еطŵֵץȡʱŶȡ
+    Metrics::RegisterCallback
+        ("myproxy_pool_used{pool=\"request\"}", "Pool nodes in use", [] {
+        return (double) GetRequestPoolUsage().used;
+    });
+    Metrics::RegisterCallback
+        ("myproxy_pool_used{pool=\"tx_context\"}", "Pool nodes in use", [] {
+        return (double) TxContextPool::GetInstance().GetUsage().used;
+    });
+    Metrics::RegisterCallback
+        ("myproxy_pool_capacity{pool=\"request\"}",
+         "Pool nodes allocated", [] {
+        return (double) GetRequestPoolUsage().capacity;
+    });
+    Metrics::RegisterCallback
+        ("myproxy_pool_capacity{pool=\"tx_context\"}",
+         "Pool nodes allocated", [] {
+        return (double) TxContextPool::GetInstance().GetUsage().capacity;
+    });
+    Metrics::RegisterCallback
+        ("myproxy_admission_load",
+         "Load seen by admission control, above 1 means overloaded", [] {
+        return Admission::GetStats().load;
+    });
+    Metrics::RegisterCallback
+        ("myproxy_admission_queue_delay_us",
+         "Completion port queueing delay in microseconds", [] {
+        return (double) Admission::GetStats().queueDelay;
+    });
+    Metrics::RegisterCallback
+        ("myproxy_admission_accept_target",
+         "Outstanding AcceptEx() calls allowed by admission control", [] {
+        return (double) Admission::GetAcceptTarget();
+    });
+    Metrics::RegisterCallback
+        ("myproxy_dns_cache_entries", "DNS cache entries", [] {
+        return (double) DNSCache::GetSize();
+    });
+    Metrics::RegisterCallback
+        ("myproxy_dns_pending_queries", "Outstanding DNS client queries", [] {
+        return (double) DNSClient::GetInstance().GetPendingCount();
+    });
+
+    Route("/metrics", "text/plain; version=0.0.4", "Metrics",
+          [](const string &, string &body) {
+        Metrics::ExportPrometheus(body);
+    });
+
+    Route("/latency", "text/plain", "Latency percentiles",
+          [](const string &, string &body) {
+        Metrics::ExportPercentiles(body);
+    });
+
+    Route("/pools", "text/plain", "Memory pools",
+          [](const string &, string &body) {
+        RenderPools(body);
+    });
+
+    Route("/connections", "text/plain", "Connections",
+          [this](const string &, string &body) {
+        RenderConnections(body);
+    });
+
+    // /dns?n=500
+    Route("/dns", "text/plain", "DNS cache and servers",
+          [](const string &query, string &body) {
+        int n = atoi(GetParam(query, "n").c_str());
+        RenderDNS(n > 0 ? n : 100, body);
+    });
+
+    // /hosts?by=bytes&n=50
+    Route("/hosts", "text/plain", "Top hosts",
+          [](const string &query, string &body) {
+        auto order = TrafficTable::BY_REQUESTS;
+        if (GetParam(query, "by") == "bytes") {
+            order = TrafficTable::BY_BYTES;
+        }
+
+        int n = atoi(GetParam(query, "n").c_str());
+        TrafficTable::Render(order, n > 0 ? n : 20, body);
+    });
+
+    Route("/topology", "text/plain", "Worker groups and NUMA nodes",
+          [](const string &, string &body) {
+        Topology::Render(body);
+    });
+
+    Route("/cpu", "text/plain", "CPU cycles per operation",
+          [](const string &, string &body) {
+        DispatchProfile::Render(body);
+    });
+
+    // ֻֻʱͨ Capture::ENABLED 
+    Route("/capture", "text/plain", "Traffic capture",
+          [](const string &, string &body) {
+        ostringstream oss;
+        oss << "capturing: " << (Capture::IsRunning() ? "yes" : "no")
+            << "\nfile: " << Capture::PATH
+            << "\nrecords: " << Capture::GetRecordCount()
+            << "\nbytes: " << Capture::GetFileSize() << "\n";
+        body += oss.str();
+    });
+}
+
+AdminServer::~AdminServer() {
+    Stop();
+}
+
+void AdminServer::Route(const char *path, const char *contentType,
+                        const char *title, Handler handler) {
+    assert(!m_running);
+
+    Page page;
+    page.path = path;
+    page.contentType = contentType;
+    page.title = title;
+    page.handler = move(handler);
+
+    m_pages.push_back(move(page));
+}
+
+bool AdminServer::Start(HANDLE cp) {
+    if (m_running) {
+        return true;
+    }
+
+    m_cp = cp;
+    if (!SetUpListener()) {
+        return false;
+    }
+
+    m_running = true;
+
+    for (int i = 0; i < NUM_ACCEPTORS; i++) {
+        if (!PostAccept()) {
+            Stop();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AdminServer::SetUpListener() {
+    m_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_listener == INVALID_SOCKET) {
+        Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "socket() failed"));
+        return false;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(ADDRESS.c_str());
+    addr.sin_port = htons(PORT);
+
+    if (::bind(m_listener, (sockaddr *) &addr, sizeof(addr)) != 0 ||
+        listen(m_listener, SOMAXCONN) != 0) {
+        ostringstream oss;
+        oss << __FUNC__ "Cannot listen on " << ADDRESS << ':' << PORT;
+        Logger::LogError(WSAGetLastErrorMessage(oss.str().c_str()));
+
+        closesocket(m_listener);
+        m_listener = INVALID_SOCKET;
+
+        return false;
+    }
+
+    if (CreateIoCompletionPort((HANDLE) m_listener, m_cp,
+                               SCK_ADMIN, 0) != m_cp) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateIoCompletionPort() failed");
+
+        closesocket(m_listener);
+        m_listener = INVALID_SOCKET;
+
+        return false;
+    }
+
+    return true;
+}
+
+void AdminServer::Stop() {
+    m_running = false;
+
+    if (m_listener != INVALID_SOCKET) {
+        closesocket(m_listener);
+        m_listener = INVALID_SOCKET;
+    }
+
+    // ߳Ѿ˳֪ͨ
+    lock_guard<mutex> lock(m_mutex);
+
+    for (auto conn : m_conns) {
+        if (conn->IsOk()) {
+            closesocket(conn->sd);
+        }
+
+        delete conn;
+    }
+
+    m_conns.clear();
+}
+
+bool AdminServer::PostAccept() {
+    Connection *conn = new Connection;
+
+    conn->sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (conn->sd == INVALID_SOCKET) {
+        Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "socket() failed"));
+
+        delete conn;
+        return false;
+    }
+
+    if (CreateIoCompletionPort((HANDLE) conn->sd, m_cp,
+                               SCK_ADMIN, 0) != m_cp) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateIoCompletionPort() failed");
+
+        closesocket(conn->sd);
+        delete conn;
+
+        return false;
+    }
+
+    m_mutex.lock();
+    m_conns.insert(conn);
+    m_mutex.unlock();
+
+    // ȴݣӽ
+    DWORD bytes = 0;
+    BOOL bResult = lpfnAcceptEx(m_listener,
+                                conn->sd,
+                                conn->buf,
+                                0,
+                                Connection::ADDR_LEN,
+                                Connection::ADDR_LEN,
+                                &bytes,
+                                &conn->ol);
+
+    if (!bResult) {
+        int ec = WSAGetLastError();
+        if (ec != ERROR_IO_PENDING) {
+            auto prefix = __FUNC__ "AcceptEx() failed";
+            Logger::LogError(WSAGetLastErrorMessage(prefix, ec));
+
+            Close(conn);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AdminServer::PostRecv(Connection *conn) {
+    memset(&conn->ol, 0, sizeof(conn->ol));
+    conn->action = PerIoContext::RECV;
+    conn->flags = 0;
+
+    conn->bufSpec.buf = conn->buf + conn->rx;
+    conn->bufSpec.len = MAX_REQUEST_SIZE - conn->rx;
+
+    int iResult = WSARecv(conn->sd, &conn->bufSpec, 1, nullptr,
+                          &conn->flags, &conn->ol, nullptr);
+
+    if (iResult == SOCKET_ERROR) {
+        int ec = WSAGetLastError();
+        if (ec != WSA_IO_PENDING) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AdminServer::PostSend(Connection *conn) {
+    memset(&conn->ol, 0, sizeof(conn->ol));
+    conn->action = PerIoContext::SEND;
+
+    conn->bufSpec.buf = &conn->out[conn->tx];
+    conn->bufSpec.len = (ULONG) (conn->out.size() - conn->tx);
+
+    int iResult = WSASend(conn->sd, &conn->bufSpec, 1, nullptr,
+                          0, &conn->ol, nullptr);
+
+    if (iResult == SOCKET_ERROR) {
+        int ec = WSAGetLastError();
+        if (ec != WSA_IO_PENDING) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void AdminServer::OnCompletion(PerIoContext *pic, DWORD transfered, bool ok) {
+    Connection *conn = (Connection *) pic;
+
+    switch (conn->action) {
+    case PerIoContext::ACCEPT:
+        // һȴе AcceptEx()
+        if (m_running) {
+            PostAccept();
+        }
+
+        if (!ok) {
+            Close(conn);
+            return;
+        }
+
+        setsockopt(conn->sd, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+                   (char *) &m_listener, sizeof(m_listener));
+
+        conn->rx = 0;
+        if (!PostRecv(conn)) {
+            Close(conn);
+        }
+
+        return;
+
+    case PerIoContext::RECV:
+        if (!ok || transfered == 0) {
+            Close(conn);
+            return;
+        }
+
+        conn->rx += transfered;
+        conn->buf[conn->rx] = 0;
+
+        if (strstr(conn->buf, "\r\n\r\n") || conn->rx == MAX_REQUEST_SIZE) {
+            Respond(conn);
+        }
+        else if (!PostRecv(conn)) {
+            Close(conn);
+        }
+
+        return;
+
+    case PerIoContext::SEND:
+        if (!ok) {
+            Close(conn);
+            return;
+        }
+
+        conn->tx += transfered;
+
+        if (conn->tx < conn->out.size()) {
+            if (!PostSend(conn)) {
+                Close(conn);
+            }
+        }
+        else {
+            Close(conn);
+        }
+
+        return;
+
+    default:
+        assert(false);
+        Close(conn);
+        return;
+    }
+}
+
+void AdminServer::Respond(Connection *conn) {
+    const char *status = "200 OK";
+    const char *contentType = "text/plain";
+    string body;
+
+    // УGET /path?query HTTP/1.1
+    const char *target = nullptr;
+    if (strncmp(conn->buf, "GET ", 4) == 0) {
+        target = conn->buf + 4;
+    }
+
+    if (!target || !strstr(conn->buf, "\r\n\r\n")) {
+        status = "400 Bad Request";
+        body = "Bad request\n";
+    }
+    else {
+        string uri(target, strcspn(target, " \r\n"));
+        string path(uri), query;
+
+        auto pos = uri.find('?');
+        if (pos != string::npos) {
+            path = uri.substr(0, pos);
+            query = uri.substr(pos + 1);
+        }
+
+        const Page *found = nullptr;
+        for (auto &page : m_pages) {
+            if (page.path == path) {
+                found = &page;
+                break;
+            }
+        }
+
+        if (found) {
+            contentType = found->contentType.c_str();
+            found->handler(query, body);
+        }
+        else if (path == "/") {
+            contentType = "text/html; charset=utf-8";
+            RenderIndex(body);
+        }
+        else {
+            status = "404 Not Found";
+            body = "Not found\n";
+        }
+    }
+
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Content-Length: %u\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Connection: close\r\n\r\n",
+                       status, contentType, (unsigned) body.size());
+
+    conn->out.reserve(len + body.size());
+    conn->out.assign(header, len);
+    conn->out += body;
+    conn->tx = 0;
+
+    if (!PostSend(conn)) {
+        Close(conn);
+    }
+}
+
+template <class Usage>
+static void RenderPool(const string &name, const Usage &usage,
+                       string &body) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%-12s %10u %10u %12u %8u %8u\n",
+             name.c_str(), (unsigned) usage.capacity, (unsigned) usage.used,
+             (unsigned) usage.staticUsed, (unsigned) usage.numChunks,
+             (unsigned) usage.numFree);
+
+    body += buf;
+}
+
+/*static*/
+void AdminServer::RenderPools(string &body) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%-12s %10s %10s %12s %8s %8s\n", "pool",
+             "capacity", "used", "static_used", "chunks", "free");
+    body += buf;
+
+    // ߳ʱֱг Request ڴ
+    int numGroups = Topology::GetGroupCount();
+    if (numGroups > 1) {
+        for (int i = 0; i < numGroups; i++) {
+            RenderPool("request/" + to_string(i),
+                       RequestPool::GetInstance(i).GetUsage(), body);
+        }
+    }
+
+    RenderPool("request", GetRequestPoolUsage(), body);
+    RenderPool("tx_context", TxContextPool::GetInstance().GetUsage(), body);
+}
+
+void AdminServer::RenderConnections(string &body) {
+    DNSClient &dnsClient = DNSClient::GetInstance();
+
+    size_t numAdmin;
+    m_mutex.lock();
+    numAdmin = m_conns.size();
+    m_mutex.unlock();
+
+    auto tasks = TaskExecutor::GetInstance().GetStats();
+    auto admission = Admission::GetStats();
+
+    ostringstream oss;
+    oss << "browser_connections " << Request::GetConnectionCount() << '\n'
+        << "requests_in_use "
+        << GetRequestPoolUsage().used << '\n'
+        << "dns_pending_queries "
+        << (dnsClient.IsRunning() ? dnsClient.GetPendingCount() : 0) << '\n'
+        << "admin_connections " << numAdmin << '\n'
+        << "executor_threads " << tasks.numThreads << '\n'
+        << "executor_tasks_queued " << tasks.queued << '\n'
+        << "executor_tasks_executed " << tasks.executed << '\n'
+        << "executor_tasks_stolen " << tasks.stolen << '\n'
+        << "executor_tasks_injected " << tasks.injected << '\n'
+        << "executor_tasks_inlined " << tasks.inlined << '\n'
+        << "admission_load " << admission.load << '\n'
+        << "admission_queue_delay_us " << admission.queueDelay << '\n'
+        << "admission_memory_mb " << admission.memoryMB << '\n'
+        << "admission_accept_target " << admission.acceptTarget << '\n'
+        << "admission_rejecting " << (admission.rejecting ? 1 : 0) << '\n'
+        << "admission_throttled " << admission.throttled << '\n'
+        << "admission_rejected " << admission.rejected << '\n';
+
+    body += oss.str();
+}
+
+/*static*/
+void AdminServer::RenderDNS(size_t max, string &body) {
+    ostringstream oss;
+    oss.setf(ios::fixed);
+    oss.precision(1);
+
+    DNSClient &dnsClient = DNSClient::GetInstance();
+    if (dnsClient.IsRunning()) {
+        oss << "# server srtt_ms rto_ms sent answered timeouts\n";
+
+        for (auto &stat : dnsClient.GetServerStats()) {
+            oss << stat.addr << ' ' << stat.srtt << ' ' << stat.rto << ' '
+                << stat.sent << ' ' << stat.answered << ' '
+                << stat.timeouts << '\n';
+        }
+
+        oss << '\n';
+    }
+
+    oss << "# cache entries: " << DNSCache::GetSize()
+        << ", prefetches: " << DNSCache::GetPrefetchCount() << '\n'
+        << "# name ttl remaining hits flags addresses\n";
+
+    for (auto &entry : DNSCache::GetEntries(max)) {
+        oss << entry.name << ' ' << entry.ttl << ' '
+            << entry.remaining << ' ' << entry.hits << ' ';
+
+        if (entry.negative) {
+            oss << 'N';
+        }
+        else if (entry.prefetching) {
+            oss << 'P';
+        }
+        else {
+            oss << '-';
+        }
+
+        for (auto &addr : entry.addrs) {
+            oss << ' ' << addr;
+        }
+
+        oss << '\n';
+    }
+
+    body += oss.str();
+}
+
+void AdminServer::RenderIndex(string &body) const {
+    body += "<!DOCTYPE html>\n<html><head><title>MyProxy2</title></head>"
+            "<body>\n<h1>MyProxy2</h1>\n<ul>\n";
+
+    for (auto &page : m_pages) {
+        body += "<li><a href=\"" + page.path + "\">" +
+                page.title + "</a></li>\n";
+    }
+
+    body += "</ul>\n</body></html>\n";
+}
+
+void AdminServer::Close(Connection *conn) {
+    {
+        lock_guard<mutex> lock(m_mutex);
+
+        if (m_conns.erase(conn) == 0) {
+            return; // ѱ Stop() 
+        }
+    }
+
+    if (conn->IsOk()) {
+        bool sent = !conn->out.empty() && conn->tx == conn->out.size();
+        ShutdownConnection(conn->sd, sent);
+    }
+
+    delete conn;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include "ws-util.h"
+#include "PerIoContext.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <functional>
+#include <atomic>
+#include <mutex>
+
+/// õĹҳ
+///
+/// ڵģĬֻԱŵģ˿ϼ׽Ĺ߳
+/// ͬһɶ˿ڣɹֱ߳ҳ档ÿֻһ
+/// GET 󣬻Ӧ󼴹رա
+///
+/// ҳͨ #Route() עᣬõҳУ
+///
+/// - `/metrics`Prometheus ıʽָ
+/// - `/latency`ֱͼķλ
+/// - `/pools`ڴصʹ
+/// - `/connections`ӵĿ
+/// - `/dns` DNS  DNS 
+/// - `/hosts`
+///
+/// ҳ涼ֻȡݳݣÿѯ
+class AdminServer {
+public:
+
+    /// Ƿ
+    ///
+    /// ҳû֤ĬϹرաúܾӵ
+    /// Ķ˵㡣
+    static bool ENABLED;
+
+    /// ַ
+    static std::string ADDRESS;
+
+    /// ˿
+    static u_short PORT;
+
+    enum {
+        /// ͬʱȴ AcceptEx() Ŀ
+        NUM_ACCEPTORS = 2,
+
+        /// ͷ󳤶
+        MAX_REQUEST_SIZE = 4096,
+    };
+
+    /// ҳɺ
+    ///
+    /// @param query URL  '?' ֮Ĳ
+    /// @param body Ӧ
+    typedef std::function<void(const std::string &query,
+                               std::string &body)> Handler;
+
+    /// ȡ
+    static AdminServer &GetInstance();
+
+    /// עһҳ
+    ///
+    ///  #Start() ֮ǰá
+    void Route(const char *path, const char *contentType,
+               const char *title, Handler handler);
+
+    /// ʼɶ˿ @a cp
+    bool Start(HANDLE cp);
+
+    /// رռ׽
+    ///
+    /// ڹ߳˳֮á
+    void Stop();
+
+    /// Ƿ
+    bool IsRunning() const {
+        return m_running;
+    }
+
+    /// ɶ˿ڱ֪ͨ
+    ///
+    /// @param ok 첽Ƿɹ
+    void OnCompletion(PerIoContext *pic, DWORD transfered, bool ok);
+
+private:
+
+    AdminServer();
+    ~AdminServer();
+
+    // ֹ
+    AdminServer(const AdminServer &) = delete;
+    AdminServer &operator=(const AdminServer &) = delete;
+
+private:
+
+    struct Connection;
+
+    // ҳ
+    struct Page {
+        std::string path;
+        std::string contentType;
+        std::string title;
+        Handler handler;
+    };
+
+    // ʼ׽
+    bool SetUpListener();
+
+    // ύһµ AcceptEx() 
+    bool PostAccept();
+
+    // ύ첽
+    bool PostRecv(Connection *conn);
+
+    // ύ첽󣬷 Connection::out µ
+    bool PostSend(Connection *conn);
+
+    // ͷɻӦ
+    void Respond(Connection *conn);
+
+    // ҳҳ
+    void RenderIndex(std::string &body) const;
+
+    // ڴصʹ
+    static void RenderPools(std::string &body);
+
+    // ӵĿ
+    void RenderConnections(std::string &body);
+
+    // DNS ͳǰ @a max Ŀ
+    static void RenderDNS(size_t max, std::string &body);
+
+    // رӲ
+    void Close(Connection *conn);
+
+private:
+
+    HANDLE m_cp = nullptr;
+    SOCKET m_listener = INVALID_SOCKET;
+    std::atomic_bool m_running;
+
+    std::vector<Page> m_pages;
+
+    std::unordered_set<Connection *> m_conns; // δرյ
+    std::mutex m_mutex; //  #m_conns
+};
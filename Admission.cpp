@@ -0,0 +1,276 @@
+#include "Admission.hpp"
+#include "PerIoContext.hpp"
+#include "Request.hpp"
+#include "Clock.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include "ws-util.h"
+
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <thread>
+using namespace std;
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+bool Admission::ENABLED = false;
+int Admission::MAX_QUEUE_DELAY = 20000;
+int Admission::MAX_CONNECTIONS = 0;
+int Admission::MAX_MEMORY_MB = 0;
+int Admission::MIN_ACCEPTS = 4;
+int Admission::MAX_ACCEPTS = 64;
+int Admission::ACCEPT_TIMEOUT = 5;
+double Admission::LOW_WATERMARK = 0.7;
+
+static Metrics::Counter gs_throttled
+    ("myproxy_admission_throttled_total",
+     "Times the outstanding AcceptEx() target was cut under overload");
+static Metrics::Counter gs_rejected
+    ("myproxy_admission_rejected_total",
+     "Browser connections rejected with 503 under overload");
+
+namespace {
+
+// ʱĻӦκԴ
+const char REJECT_RESPONSE[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "Retry-After: 1\r\n"
+    "\r\n";
+
+// ÿɶ˿һ̽룬˳ǰͷţֹͣʱŶ
+vector<unique_ptr<Admission::Probe>> gs_probes;
+vector<HANDLE> gs_ports;
+
+function<void()> gs_onTick;
+thread gs_thread;
+atomic_bool gs_running(false);
+atomic_bool gs_stopping(false);
+
+// ʼʱȷ
+int gs_minAccepts = 1;
+int gs_maxAccepts = 1;
+
+// һβĽ
+atomic_int gs_acceptTarget(0);
+atomic_bool gs_rejecting(false);
+atomic<int64_t> gs_queueDelay(0);
+atomic<int64_t> gs_memoryMB(0);
+atomic<int> gs_loadPermille(0);
+
+// ɶ˿Ŷӳ٣΢룩
+//
+// ȡ̽ȡֵŶӵİѾȴʱƣ
+// ߳ȫʱҲܲ
+int64_t SampleQueueDelay(int64_t now) {
+    int64_t worst = 0;
+
+    for (auto &probe : gs_probes) {
+        int64_t posted = probe->posted;
+        worst = max(worst, posted != 0 ? now - posted : probe->delay.load());
+    }
+
+    return Clock::ToMicroseconds(worst);
+}
+
+// ÿɶ˿Ͷһ̽룬һŶӵĳ
+void PostProbes(int64_t now) {
+    for (size_t i = 0; i < gs_probes.size(); i++) {
+        Admission::Probe &probe = *gs_probes[i];
+
+        int64_t expected = 0;
+        if (!probe.posted.compare_exchange_strong(expected, now)) {
+            continue;
+        }
+
+        memset(&probe.ol, 0, sizeof(probe.ol));
+
+        if (!PostQueuedCompletionStatus(gs_ports[i], 0, SCK_PROBE,
+                                        &probe.ol)) {
+            probe.posted = 0;
+            Logger::LogWindowsLastError
+                (__FUNC__ "PostQueuedCompletionStatus() failed");
+        }
+    }
+}
+
+// ύڴ棨MB
+int64_t SampleMemoryMB() {
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    pmc.cb = sizeof(pmc);
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return 0;
+    }
+
+    return (int64_t) (pmc.PagefileUsage / (1024 * 1024));
+}
+
+// һΣ AcceptEx() ĿǷܾ
+void Update() {
+    int64_t now = Clock::Now();
+
+    int64_t delay = SampleQueueDelay(now);
+    long long connections = Request::GetConnectionCount();
+    int64_t memoryMB = Admission::MAX_MEMORY_MB > 0 ? SampleMemoryMB() : 0;
+
+    PostProbes(now);
+
+    double load = 0;
+    if (Admission::MAX_QUEUE_DELAY > 0) {
+        load = max(load, (double) delay / Admission::MAX_QUEUE_DELAY);
+    }
+    if (Admission::MAX_CONNECTIONS > 0) {
+        load = max(load, (double) connections / Admission::MAX_CONNECTIONS);
+    }
+    if (Admission::MAX_MEMORY_MB > 0) {
+        load = max(load, (double) memoryMB / Admission::MAX_MEMORY_MB);
+    }
+
+    gs_queueDelay = delay;
+    gs_memoryMB = memoryMB;
+    gs_loadPermille = (int) min(load * 1000, 1e9);
+
+    // ʱɱָʱ
+    int target = gs_acceptTarget;
+    bool rejecting = false;
+
+    if (load > 1) {
+        if (target > gs_minAccepts) {
+            target = max(target / 2, gs_minAccepts);
+            gs_throttled.Inc();
+        }
+        else {
+            rejecting = true;
+        }
+    }
+    else if (load < Admission::LOW_WATERMARK && target < gs_maxAccepts) {
+        target++;
+    }
+
+    gs_acceptTarget = target;
+
+    if (gs_rejecting.exchange(rejecting) != rejecting) {
+        ostringstream oss;
+        oss << __FUNC__ << (rejecting ? "Overloaded, rejecting" :
+                                        "Load recovered, accepting")
+            << " new connections (load " << load << ", queue delay "
+            << delay << "us, " << connections << " connections, "
+            << memoryMB << "MB)";
+
+        Logger::LogInfo(oss.str());
+    }
+}
+
+// ߳
+void Run() {
+    while (!gs_stopping) {
+        Sleep(Admission::TICK_INTERVAL);
+        Update();
+
+        if (gs_onTick) {
+            gs_onTick();
+        }
+    }
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool Admission::Start(const vector<HANDLE> &ports, function<void()> onTick) {
+    if (gs_running) {
+        return true;
+    }
+
+    gs_minAccepts = max(MIN_ACCEPTS, 1);
+    gs_maxAccepts = GetMaxAccepts();
+
+    gs_ports = ports;
+    gs_onTick = onTick;
+    gs_acceptTarget = gs_maxAccepts;
+
+    while (gs_probes.size() < gs_ports.size()) {
+        gs_probes.emplace_back(new Probe);
+    }
+
+    gs_stopping = false;
+    gs_running = true;
+    gs_thread = thread(Run);
+
+    return true;
+}
+
+/*static*/
+void Admission::Stop() {
+    if (!gs_running) {
+        return;
+    }
+
+    gs_stopping = true;
+    gs_thread.join();
+
+    gs_running = false;
+    gs_rejecting = false;
+}
+
+/*static*/
+void Admission::OnProbe(Probe *probe) {
+    probe->delay = Clock::Now() - probe->posted;
+    probe->posted = 0;
+}
+
+/*static*/
+int Admission::GetAcceptTarget() {
+    return gs_running ? gs_acceptTarget.load() : GetMaxAccepts();
+}
+
+/*static*/
+int Admission::GetMaxAccepts() {
+    return max(MAX_ACCEPTS, max(MIN_ACCEPTS, 1));
+}
+
+/*static*/
+bool Admission::ShouldReject() {
+    return gs_rejecting;
+}
+
+/*static*/
+bool Admission::Reject(SOCKET sd) {
+    gs_rejected.Inc();
+
+    // ʱù߳κһͻ
+    u_long nonBlocking = 1;
+    if (ioctlsocket(sd, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+        auto fmt = __FUNC__ "ioctlsocket() failed";
+        Logger::LogError(WSAGetLastErrorMessage(fmt));
+
+        return false;
+    }
+
+    const int len = sizeof(REJECT_RESPONSE) - 1;
+    return send(sd, REJECT_RESPONSE, len, 0) == len;
+}
+
+/*static*/
+Admission::Stats Admission::GetStats() {
+    Stats stats;
+    stats.load = gs_loadPermille / 1000.0;
+    stats.queueDelay = gs_queueDelay;
+    stats.connections = Request::GetConnectionCount();
+    stats.memoryMB = gs_memoryMB;
+    stats.acceptTarget = GetAcceptTarget();
+    stats.rejecting = gs_rejecting;
+    stats.throttled = gs_throttled.GetValue();
+    stats.rejected = gs_rejected.GetValue();
+
+    return stats;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "ws-util.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// ر
+///
+/// ڹ۲źţɶ˿ڵŶӳ٣Ͷһ̽룬
+/// ߳ȡǰȴʱ䣩 #MAX_CONNECTIONS ռʡ
+/// ύڴ #MAX_MEMORY_MB ııֵΪ
+/// أ 1 ʾء
+///
+/// ʱս
+///
+/// 1. δɵ AcceptEx() Ŀÿμ룬 #MIN_ACCEPTS
+///    ں˵ĵȴУݲȡǵͷѽܵ
+///    ػָ
+/// 2. Ѽ #MIN_ACCEPTS Ȼʱֱӻظ 503 رգ
+///     RequestҲ
+///
+/// ѽܵʼճ
+class Admission {
+public:
+
+    /// Ƿ
+    static bool ENABLED;
+
+    /// ɶ˿Ŷӳٵޣ΢룩
+    static int MAX_QUEUE_DELAY;
+
+    /// ޣ0 ʾ
+    static int MAX_CONNECTIONS;
+
+    /// ύڴޣMB0 ʾ
+    static int MAX_MEMORY_MB;
+
+    /// δɵ AcceptEx() Ŀ
+    static int MIN_ACCEPTS;
+    static int MAX_ACCEPTS;
+
+    ///  AcceptEx() ڼ䣬ӽ󳬹ʱ䣨룩δ
+    /// ᱻã⼸˵Ŀͻռסʣ޼ AcceptEx()
+    static int ACCEPT_TIMEOUT;
+
+    enum {
+        TICK_INTERVAL = 100, ///< 룩
+    };
+
+    /// صڴֵʱʼָ
+    static double LOW_WATERMARK;
+
+    /// Ŷӳٵ̽
+    struct Probe {
+        OVERLAPPED ol; ///< ǵһԱ
+
+        /// Ͷݵʱ̣Clock 0 ʾѱȡ
+        std::atomic<int64_t> posted{0};
+
+        /// һβõŶӳ٣Clock 
+        std::atomic<int64_t> delay{0};
+    };
+
+    /// ʼ
+    ///
+    /// @param ports ߳ɶ˿
+    /// @param onTick ÿβڲ߳ϵãɾݴ˲ AcceptEx()
+    static bool Start(const std::vector<HANDLE> &ports,
+                      std::function<void()> onTick);
+
+    /// ֹͣ
+    static void Stop();
+
+    /// ߳ȡ SCK_PROBE ֪ͨʱ
+    static void OnProbe(Probe *probe);
+
+    /// Ӧֵδ AcceptEx() Ŀ
+    static int GetAcceptTarget();
+
+    /// δɵ AcceptEx() ĿޣӦ acceptor Ŀ
+    static int GetMaxAccepts();
+
+    /// ǷӦܾ
+    static bool ShouldReject();
+
+    /// սܵ @a sd ظ 503ر
+    ///
+    /// ׽ֱΪͻŲʱ
+    ///
+    /// @return ӦǷ
+    static bool Reject(SOCKET sd);
+
+    /// ͳ
+    struct Stats {
+        double load = 0; ///< һβĸ
+        int64_t queueDelay = 0; ///< ɶ˿Ŷӳ٣΢룩
+        long long connections = 0; ///< 
+        int64_t memoryMB = 0; ///< ύڴ棨MB
+        int acceptTarget = 0; ///< Ӧֵδ AcceptEx() Ŀ
+        bool rejecting = false; ///< Ƿھܾ
+        unsigned long long throttled = 0; ///<  AcceptEx() Ĵ
+        unsigned long long rejected = 0; ///<  503 ܾ
+    };
+
+    /// ȡͳ
+    static Stats GetStats();
+};
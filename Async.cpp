@@ -1,13 +1,37 @@
 
 #include "Async.hpp"
+#include "DNSCache.hpp"
+#include "DNSClient.hpp"
 #include "Logger.hpp"
 
+#include <windns.h> // for DnsQuery_W()
+#pragma comment(lib, "dnsapi.lib")
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
 #include <cassert>
 
+#ifdef MYPROXY_SIMULATION
+#include "SimNet.hpp" // ģ DNS 
+#endif
+
 #include "Debug.hpp"
 
 //////////////////////////////////////////////////////////////////////////
 
+// ڽеĲѯΪ host:portֵΪȴͬһѯ
+typedef std::unordered_map<std::string, std::vector<AsyncResolver::QueryContext *>>
+    PendingQueries;
+
+static PendingQueries gs_pending;
+static std::mutex gs_pendingMutex;
+
+static std::atomic_ulong gs_seq(0);
+static std::atomic_ulong gs_numCoalesced(0);
+
+//////////////////////////////////////////////////////////////////////////
+
 AsyncResolver::QueryContext::QueryContext
 (AsyncResolver *resolver, const Request &request) {
     memset(this, 0, sizeof(QueryContext));
@@ -29,22 +53,41 @@ AsyncResolver::QueryContext::QueryContext
 
     ts = time(nullptr);
 
+    // 0 Ϊûеȴ
+    do {
+        seq = ++gs_seq;
+    } while (seq == 0);
+
+    auto hostLen = strlen(request.host);
+    key = new char[hostLen + 1 + 5 + 1];
+    for (size_t i = 0; i < hostLen; i++) {
+        key[i] = (char) tolower(request.host[i]);
+    }
+
+    sprintf(key + hostLen, ":%u", port);
+
     this->resolver = resolver;
     userData = request.userData;
 }
 
 AsyncResolver::QueryContext::~QueryContext() {
     delete [] host;
+    delete [] key;
 
     if (results) {
-        FreeAddrInfoEx(results);
+        if (copied) {
+            DNSCache::DestroyAddrInfo(results);
+        }
+        else {
+            FreeAddrInfoEx(results);
+        }
     }
 }
 
 //////////////////////////////////////////////////////////////////////////
 
 AsyncResolver::AsyncResolver(Callback *callback)
-    : m_callback(callback) {
+    : m_callback(callback), m_seq(0) {
 
 }
 
@@ -53,13 +96,58 @@ AsyncResolver::~AsyncResolver() {
 }
 
 void AsyncResolver::Cancel() {
-    m_ts = 0;
+    m_seq = 0;
+}
+
+/*static*/
+unsigned long AsyncResolver::GetCoalescedCount() {
+    return gs_numCoalesced;
+}
+
+/*static*/
+bool AsyncResolver::AttachToPending(QueryContext *context) {
+    std::lock_guard<std::mutex> lock(gs_pendingMutex);
+
+    auto it(gs_pending.find(context->key));
+    if (it != gs_pending.end()) {
+        it->second.push_back(context);
+        gs_numCoalesced++;
+
+        return true;
+    }
+
+    gs_pending[context->key];
+    return false;
 }
 
 bool AsyncResolver::PostResolve(const Request &request) {
     QueryContext *context = new QueryContext(this, request);
-    m_ts = context->ts;
+    m_seq = context->seq;
+
+    if (AttachToPending(context)) {
+        return true;
+    }
 
+#ifndef MYPROXY_SIMULATION
+    // ʹõ DNS ͻˣֱڹ֪߳ͨ
+    DNSClient &client = DNSClient::GetInstance();
+    if (client.IsRunning() && DNSClient::CanResolve(request.host)) {
+        client.Resolve(context);
+        return true;
+    }
+#endif
+
+    // ʧܵĽͬɻص֪ͨߣǷ true
+    // ظ
+    ResolveWithSystem(context);
+    return true;
+}
+
+/*static*/
+void AsyncResolver::ResolveWithSystem(QueryContext *context) {
+#ifdef MYPROXY_SIMULATION
+    SimNet::GetInstance().Resolve(context);
+#else
     int error = GetAddrInfoExW(context->host,
                                context->service,
                                NS_DNS,
@@ -80,26 +168,97 @@ bool AsyncResolver::PostResolve(const Request &request) {
     // Ϊ IP ַʱֱӳɹ
     if (error != WSA_IO_PENDING) {
         OnDnsResolved(error, 0, &context->ol);
-        return error == ERROR_SUCCESS;
     }
-
-    return true;
+#endif
 }
 
 /*static*/
 void CALLBACK AsyncResolver::OnDnsResolved
 (DWORD error, DWORD, LPWSAOVERLAPPED ol) {
     QueryContext *context = (QueryContext *) ol;
+    context->error = error;
+
+    if (error != ERROR_SUCCESS) {
+        Logger::LogError(__FUNC__ "GetAddrInfoExW() failed");
+    }
+    else {
+        context->ttl = QueryCachedTTL(context->host);
+    }
+
+    Complete(context);
+}
+
+/*static*/
+void AsyncResolver::Complete(QueryContext *context) {
+    std::vector<QueryContext *> waiters;
+
+    gs_pendingMutex.lock();
+
+    auto it(gs_pending.find(context->key));
+    if (it != gs_pending.end()) {
+        waiters.swap(it->second);
+        gs_pending.erase(it);
+    }
+
+    gs_pendingMutex.unlock();
+
+    // ʹȡȴȻҪ
+    for (auto waiter : waiters) {
+        waiter->error = context->error;
+        waiter->ttl = context->ttl;
+        waiter->onWorker = context->onWorker;
+
+        if (context->results) {
+            waiter->results = DNSCache::CopyAddrInfo(context->results);
+            waiter->copied = true;
+        }
+
+        Deliver(waiter);
+    }
+
+    Deliver(context);
+}
+
+/*static*/
+void AsyncResolver::Deliver(QueryContext *context) {
+    AsyncResolver *resolver = context->resolver;
 
     // ûȡ
-    if (context->ts != context->resolver->m_ts) {
+    //
+    // صܻ resolver ύµȸλš
+    unsigned long seq = context->seq;
+    if (!resolver->m_seq.compare_exchange_strong(seq, 0)) {
+        delete context;
         return;
     }
 
-    if (error != ERROR_SUCCESS) {
-        Logger::LogError(__FUNC__ "GetAddrInfoExW() failed");
+    resolver->m_callback->OnQueryCompleted(context);
+}
+
+/*static*/
+unsigned long AsyncResolver::QueryCachedTTL(const wchar_t *host) {
+    PDNS_RECORD records = nullptr;
+    DNS_STATUS status = DnsQuery_W(host,
+                                   DNS_TYPE_A,
+                                   DNS_QUERY_NO_WIRE_QUERY,
+                                   nullptr,
+                                   &records,
+                                   nullptr);
+
+    if (status != ERROR_SUCCESS || !records) {
+        return 0;
+    }
+
+    // CNAME κһ¼ڶʹʧЧȡСֵ
+    unsigned long ttl = 0;
+    for (PDNS_RECORD r = records; r; r = r->pNext) {
+        if (r->wType == DNS_TYPE_A || r->wType == DNS_TYPE_CNAME) {
+            if (ttl == 0 || r->dwTtl < ttl) {
+                ttl = r->dwTtl;
+            }
+        }
     }
 
-    context->resolver->m_callback->OnQueryCompleted(context);
-    context->resolver->m_ts = 0;
+    DnsRecordListFree(records, DnsFreeRecordList);
+    return ttl;
 }
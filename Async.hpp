@@ -3,6 +3,7 @@
 #include "ws-util.h"
 #include <ws2tcpip.h>
 #include <ctime>
+#include <atomic>
 
 /// 첽 DNS
 class AsyncResolver {
@@ -24,6 +25,9 @@ public:
     };
 
     /// ύ
+    ///
+    /// ͬ host:port вѯڽУ򲻻ظͣ
+    /// ǵȴòѯɺһõ֪ͨ
     bool PostResolve(const Request &request);
 
     /// ȡ
@@ -43,6 +47,14 @@ public:
         wchar_t service[6];
 
         time_t ts; // ύʱʱ
+        unsigned long seq; // ύţʶѱȡ
+
+        char *key; // ڽвѯеļhost:port
+        bool copied; // #results Ƿ DNSCache::DestroyAddrInfo() 
+        bool onWorker; // ǷڴĹ߳
+
+        int error; ///< Ĵ
+        unsigned long ttl; ///< ¼ TTL룩Ϊ 0 ʾδ֪
 
         AsyncResolver *resolver;
         void *userData;
@@ -67,12 +79,40 @@ public:
         m_callback = cb;
     }
 
+    /// ȡϲδʵʷ͵ĲѯĿ
+    static unsigned long GetCoalescedCount();
+
+    /// ѯɣ֪ͨԼеȴͬһĲѯ
+    ///
+    /// ǰú @a context  #QueryContext::error 
+    /// #QueryContext::results ֶΡ DNSClient ʹá
+    static void Complete(QueryContext *context);
+
+    /// ϵͳ GetAddrInfoExW()  @a context
+    ///
+    ///  #Complete() ֪ͨ DNSClient Լַʱʹá
+    static void ResolveWithSystem(QueryContext *context);
+
 private:
 
     static void CALLBACK OnDnsResolved(DWORD, DWORD, LPWSAOVERLAPPED);
 
+    // Ļصѱȡʱֱ
+    static void Deliver(QueryContext *context);
+
+    // Թҵڽеͬѯ
+    //
+    // @return Ƿɹϣʧʱ @a context Ϊü׸ѯ
+    static bool AttachToPending(QueryContext *context);
+
+    // ϵͳ DNS ͻ˻жȡ @a host С TTL
+    //
+    // GetAddrInfoExW()  TTLɺ¼ѽϵͳ棬
+    // ֻѯػ棬
+    static unsigned long QueryCachedTTL(const wchar_t *host);
+
 private:
 
     Callback *m_callback = nullptr;
-    time_t m_ts = 0;
+    std::atomic_ulong m_seq; // ǰȴţ0 ʾû
 };
@@ -0,0 +1,360 @@
+#include "Capture.hpp"
+#include "Clock.hpp"
+#include "Logger.hpp"
+#include "TaskExecutor.hpp"
+#include "ws-util.h"
+
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "Debug.hpp"
+
+using namespace CaptureFormat;
+
+//////////////////////////////////////////////////////////////////////////
+
+bool Capture::ENABLED = false;
+std::string Capture::PATH = "capture.bin";
+unsigned long long Capture::MAX_FILE_SIZE = 256 * 1024 * 1024;
+
+namespace {
+
+enum {
+    // 峬˴Сʱдļ
+    FLUSH_SIZE = 64 * 1024,
+
+    // ײĳޣ֤¼Ȳ uint16_t
+    MAX_META_SIZE = 60 * 1024,
+
+    // еĳ
+    MAX_FIRST_LINE = 8 * 1024,
+
+    // ײֵĳޣֻ¼
+    MAX_KEPT_VALUE = 255,
+};
+
+// ˳ gs_fileMutex gs_mutex
+std::mutex gs_fileMutex; //  gs_file
+std::mutex gs_mutex; // 
+
+FILE *gs_file;
+std::string gs_buffer;
+std::deque<std::string> gs_pending; // ȴдĻȺ
+int64_t gs_start; // FileHeader::start
+
+std::atomic_bool gs_running(false);
+std::atomic<uint64_t> gs_nextConn(1);
+std::atomic<unsigned long long> gs_numRecords(0);
+std::atomic<unsigned long long> gs_fileSize(0);
+
+template <typename T>
+void Append(std::string &out, const T &value) {
+    out.append((const char *) &value, sizeof(T));
+}
+
+//  @a base ΢
+uint32_t Offset(int64_t ts, int64_t base) {
+    if (ts == 0 || ts < base) {
+        return 0;
+    }
+
+    int64_t us = Clock::ToMicroseconds(ts - base);
+    return us < 0xFFFFFFFF ? (uint32_t) us : 0xFFFFFFFF;
+}
+
+bool IsKept(const std::string &name) {
+    for (auto kept : KEPT_HEADERS) {
+        if (name.size() == strlen(kept) &&
+            std::equal(name.begin(), name.end(), kept, [](char a, char b) {
+                return tolower((unsigned char) a) ==
+                       tolower((unsigned char) b);
+            })) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// УЭ汾Լ URL е֣
+// ·ѯָֻ
+std::string SanitizeFirstLine(const std::string &line) {
+    std::string ret(line, 0, std::min<size_t>(line.size(), MAX_FIRST_LINE));
+
+    size_t begin = ret.find(' ');
+    if (begin == std::string::npos) {
+        return ret;
+    }
+
+    begin++;
+    size_t end = ret.rfind(' ');
+    if (end <= begin) {
+        end = ret.size();
+    }
+
+    // CONNECT Ŀֻ˿
+    if (ret.compare(0, 8, "CONNECT ") == 0) {
+        return ret;
+    }
+
+    size_t scheme = ret.find("://", begin);
+    if (scheme != std::string::npos && scheme < end) {
+        begin = ret.find('/', scheme + 3);
+        if (begin == std::string::npos || begin > end) {
+            return ret;
+        }
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        if (!strchr("/?&=", ret[i])) {
+            ret[i] = 'x';
+        }
+    }
+
+    return ret;
+}
+
+// ѵǰдУ gs_mutex
+void Seal() {
+    if (!gs_buffer.empty()) {
+        gs_pending.emplace_back();
+        gs_pending.back().swap(gs_buffer);
+    }
+}
+
+// ȺдŶӵĻ gs_fileMutex
+void WritePending() {
+    while (true) {
+        std::string buf;
+        {
+            std::lock_guard<std::mutex> lock(gs_mutex);
+            if (gs_pending.empty()) {
+                break;
+            }
+
+            buf.swap(gs_pending.front());
+            gs_pending.pop_front();
+        }
+
+        if (gs_file) {
+            fwrite(buf.data(), 1, buf.size(), gs_file);
+        }
+    }
+
+    if (gs_file) {
+        fflush(gs_file);
+    }
+}
+
+// дʣݲرļ gs_fileMutex
+void CloseFile() {
+    WritePending();
+
+    if (gs_file) {
+        fclose(gs_file);
+        gs_file = nullptr;
+    }
+}
+
+// ִ߳дļռ I/O ߳
+class FlushTask : public TaskExecutor::Task {
+public:
+
+    virtual void Run() override {
+        std::lock_guard<std::mutex> lock(gs_fileMutex);
+
+        // ڼļֹͣһرļ
+        if (gs_running) {
+            WritePending();
+        }
+        else {
+            CloseFile();
+        }
+    }
+};
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool Capture::Start() {
+    // gs_running ֻڳ gs_fileMutex ʱλ
+    std::lock_guard<std::mutex> fileLock(gs_fileMutex);
+
+    if (gs_running) {
+        return true;
+    }
+
+    // ļֹͣһβ
+    CloseFile();
+
+    std::lock_guard<std::mutex> lock(gs_mutex);
+
+    gs_file = fopen(PATH.c_str(), "wb");
+    if (!gs_file) {
+        Logger::LogError(__FUNC__ "Cannot open the capture file " + PATH);
+        return false;
+    }
+
+    gs_start = Clock::ToUnixMicroseconds(Clock::Now());
+
+    FileHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.start = gs_start;
+
+    gs_buffer.clear();
+    Append(gs_buffer, header);
+
+    gs_numRecords = 0;
+    gs_fileSize = sizeof(header);
+    gs_running = true;
+
+    return true;
+}
+
+/*static*/
+void Capture::Stop() {
+    std::lock_guard<std::mutex> fileLock(gs_fileMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(gs_mutex);
+
+        gs_running = false;
+        Seal();
+    }
+
+    CloseFile();
+}
+
+/*static*/
+bool Capture::IsRunning() {
+    return gs_running;
+}
+
+/*static*/
+uint64_t Capture::NewConnection() {
+    return gs_nextConn++;
+}
+
+/*static*/
+void Capture::Describe(const std::string &firstLine,
+                       const std::unordered_map<std::string,
+                                                std::string> &headers,
+                       Entry &entry) {
+    entry.meta.clear();
+    entry.numHeaders = 0;
+    entry.flags = 0;
+
+    std::string line(SanitizeFirstLine(firstLine));
+    Append(entry.meta, (uint16_t) line.size());
+    entry.meta += line;
+
+    for (auto &header : headers) {
+        auto &name = header.first;
+        auto &value = header.second;
+
+        HeaderEntry he;
+        he.nameLength = (uint8_t) std::min<size_t>(name.size(), 255);
+        he.valueLength = (uint16_t) std::min<size_t>(value.size(), 0xFFFF);
+        he.kept = IsKept(name) && value.size() <= MAX_KEPT_VALUE;
+
+        size_t size = sizeof(he) + he.nameLength +
+                      (he.kept ? he.valueLength : 0);
+
+        if (entry.meta.size() + size > MAX_META_SIZE) {
+            entry.flags |= F_TRUNCATED;
+            break;
+        }
+
+        Append(entry.meta, he);
+        entry.meta.append(name, 0, he.nameLength);
+
+        if (he.kept) {
+            entry.meta += value;
+        }
+
+        entry.numHeaders++;
+    }
+}
+
+/*static*/
+void Capture::Submit(const Entry &entry) {
+    if (!gs_running) {
+        return;
+    }
+
+    RequestRecord rec;
+    rec.conn = entry.conn;
+    rec.request = Offset(entry.request, entry.accept);
+    rec.firstByte = Offset(entry.firstByte, entry.accept);
+    rec.close = Offset(entry.close, entry.accept);
+    rec.inBytes = entry.inBytes;
+    rec.outBytes = entry.outBytes;
+    rec.requestHeader = entry.requestHeader;
+    rec.responseHeader = entry.responseHeader;
+    rec.port = entry.port;
+    rec.status = entry.status;
+    rec.flags = entry.flags;
+    rec.numHeaders = entry.numHeaders;
+
+    RecordHeader rh;
+    rh.type = RT_REQUEST;
+    rh.reserved = 0;
+    rh.length = (uint16_t) (sizeof(rec) + entry.meta.size());
+
+    int64_t accept = Clock::ToUnixMicroseconds(entry.accept);
+    bool full = false, flush = false;
+
+    {
+        std::lock_guard<std::mutex> lock(gs_mutex);
+
+        if (!gs_running) {
+            return;
+        }
+
+        // ʼ֮ǰܵӣʱ̼Ϊ 0
+        rec.accept = accept > gs_start ? (uint64_t) (accept - gs_start) : 0;
+
+        Append(gs_buffer, rh);
+        Append(gs_buffer, rec);
+        gs_buffer += entry.meta;
+
+        gs_numRecords++;
+        gs_fileSize += sizeof(rh) + rh.length;
+
+        if (gs_fileSize >= MAX_FILE_SIZE) {
+            gs_running = false;
+            full = true;
+        }
+
+        if (full || gs_buffer.size() >= FLUSH_SIZE) {
+            Seal();
+            flush = true;
+        }
+    }
+
+    if (full) {
+        Logger::LogInfo(__FUNC__ "The capture file is full, stopped");
+    }
+
+    // ļʱͬһرļ
+    if (flush) {
+        TaskExecutor::GetInstance().Submit(new FlushTask);
+    }
+}
+
+/*static*/
+unsigned long long Capture::GetRecordCount() {
+    return gs_numRecords;
+}
+
+/*static*/
+unsigned long long Capture::GetFileSize() {
+    return gs_fileSize;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "CaptureFormat.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+/// 
+///
+/// ¼ԪʱСײϡĳȡ
+/// ͬһϸļ Replay ڱطų
+/// ״ͬĸءļʽ CaptureFormat
+///
+/// ĬϹرգֻʱ򿪣ҳ /capture ʾ״̬
+/// δʱ Request 䲶ÿ¼׷ӵڴ滺壬
+/// ۵һСдļļﵽ #MAX_FILE_SIZE Զֹͣ
+class Capture {
+public:
+
+    /// Ƿʱʼ
+    static bool ENABLED;
+
+    /// ļ·ÿοʼʱ
+    static std::string PATH;
+
+    /// ļֽ
+    static unsigned long long MAX_FILE_SIZE;
+
+    /// һĲϢ
+    ///
+    /// ʱ̾Ϊ Clock::Now() ķֵ
+    struct Entry {
+        uint64_t conn = 0; ///< ӱţ #NewConnection() 
+        int64_t accept = 0;
+        int64_t request = 0; ///< 0 ʾǰûڲ
+        int64_t firstByte = 0;
+        int64_t close = 0;
+
+        uint64_t inBytes = 0;
+        uint64_t outBytes = 0;
+        uint32_t requestHeader = 0;
+        uint32_t responseHeader = 0;
+
+        uint16_t port = 0;
+        uint16_t status = 0;
+        uint16_t flags = 0; ///< CaptureFormat::Flags
+
+        ///  #Describe() ײ
+        std::string meta;
+        uint16_t numHeaders = 0;
+    };
+
+    /// ǣļʼ
+    static bool Start();
+
+    /// дݲֹͣ
+    static void Stop();
+
+    /// Ƿڲ
+    static bool IsRunning();
+
+    /// һӱ
+    static uint64_t NewConnection();
+
+    /// ײд @a entry
+    ///
+    /// @param firstLine У "\r\n"
+    static void Describe(const std::string &firstLine,
+                         const std::unordered_map<std::string,
+                                                  std::string> &headers,
+                         Entry &entry);
+
+    /// ύһ¼δڲʱֱӺ
+    static void Submit(const Entry &entry);
+
+    /// ȡβѼ¼
+    static unsigned long long GetRecordCount();
+
+    /// ȡβд壩ֽ
+    static unsigned long long GetFileSize();
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+
+/// ļĸʽ
+///
+///  WindowsطŹ Replay áΪС
+///
+/// ļ #FileHeader ͷ֮һϵм¼ÿ¼
+/// #RecordHeader ͷÿ󣨻ʱдһ #RT_REQUEST
+/// ¼ͬһϵӱţʼȺС
+///
+/// Ѿ·ѯַָⶼ
+/// 滻Ϊ 'x'ֻṹײֵֻĳȣ
+///  #KEPT_HEADERS гײֵ
+namespace CaptureFormat {
+
+/// ļħ "MPCP"
+const char MAGIC[4] = { 'M', 'P', 'C', 'P' };
+
+/// ʽ汾
+const uint32_t VERSION = 1;
+
+/// ֵײִСд
+const char *const KEPT_HEADERS[] = {
+    "Host", "Connection", "Proxy-Connection", "Content-Length",
+    "Transfer-Encoding", "Expect", "Upgrade",
+};
+
+/// ¼
+enum RecordType {
+    RT_REQUEST = 1, ///< һ HTTP 󣨻һ
+};
+
+/// ¼ı־λ
+enum Flags {
+    F_TUNNEL = 1 << 0, ///< CONNECT 
+    F_TRUNCATED = 1 << 1, ///< ײֻ࣬¼һ
+};
+
+#pragma pack(push, 1)
+
+/// ļͷ
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t start; ///< ʼʱ̣ 1970 ΢
+};
+
+/// ¼ͷ
+struct RecordHeader {
+    uint8_t type; ///< #RecordType
+    uint8_t reserved;
+    uint16_t length; ///< ݵĳ
+};
+
+/// #RT_REQUEST ¼
+///
+/// ΪУuint16_t  + ݣ
+/// Ȼ #numHeaders ײÿΪ #HeaderEntry +  + ֵ
+/// ֵֻ #HeaderEntry::kept  0 ʱڣ
+struct RequestRecord {
+    uint64_t conn; ///< ӵı
+
+    /// ӵʱ̣ FileHeader::start ΢
+    uint64_t accept;
+
+    /// Ϊ #accept ΢
+    uint32_t request; ///< յͷ
+    uint32_t firstByte; ///< յӦĵһֽڣδΪ 0
+    uint32_t close; ///< 
+
+    uint64_t inBytes; ///< ϴֽͷ
+    uint64_t outBytes; ///< ·ֽӦͷ
+    uint32_t requestHeader; ///< ͷĳ
+    uint32_t responseHeader; ///< Ӧͷĳȣδ֪Ϊ 0
+
+    uint16_t port;
+    uint16_t status; ///< HTTP ״̬룬δ֪Ϊ 0
+    uint16_t flags; ///< #Flags
+    uint16_t numHeaders;
+};
+
+/// һײ
+struct HeaderEntry {
+    uint8_t nameLength;
+    uint8_t kept; ///< Ƿֵ
+    uint16_t valueLength; ///< ԭʼֵĳ
+};
+
+#pragma pack(pop)
+
+} // namespace CaptureFormat
@@ -0,0 +1,98 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+
+/// ߾ȵʱ
+///
+///  QueryPerformanceCounter()ȡһֻʮ룬
+/// ʺ·ϴʱΪʱ䵥λĹȡ
+///
+/// ģ⹹MYPROXY_SIMULATIONиΪȡ SimNet ƽʱӣ
+/// λΪ롣
+class Clock {
+public:
+
+    /// ǰʱ̣δ
+    static int64_t Now() {
+#ifdef MYPROXY_SIMULATION
+        return Virtual();
+#else
+        LARGE_INTEGER li;
+        QueryPerformanceCounter(&li);
+        return li.QuadPart;
+#endif
+    }
+
+#ifdef MYPROXY_SIMULATION
+    /// ʱӵĵǰʱ̣룩д
+    static int64_t &Virtual() {
+        static int64_t s_now = 0;
+        return s_now;
+    }
+#endif
+
+    /// Ƶʣδ/룩
+    static int64_t Frequency() {
+#ifdef MYPROXY_SIMULATION
+        return 1000000000;
+#endif
+        static const int64_t s_freq = [] {
+            LARGE_INTEGER li;
+            QueryPerformanceFrequency(&li);
+            return li.QuadPart;
+        }();
+
+        return s_freq;
+    }
+
+    /// δΪ
+    static int64_t ToNanoseconds(int64_t ticks) {
+        int64_t freq = Frequency();
+        return ticks / freq * 1000000000 + ticks % freq * 1000000000 / freq;
+    }
+
+    /// δΪ΢
+    static int64_t ToMicroseconds(int64_t ticks) {
+        int64_t freq = Frequency();
+        return ticks / freq * 1000000 + ticks % freq * 1000000 / freq;
+    }
+
+    /// δΪ
+    static double ToSeconds(int64_t ticks) {
+        return (double) ticks / Frequency();
+    }
+
+    /// ʱ @a ticks Ϊ 1970-01-01 UTC ΢
+    static int64_t ToUnixMicroseconds(int64_t ticks) {
+        const Epoch &epoch = GetEpoch();
+        return epoch.unixMicros + ToMicroseconds(ticks - epoch.ticks);
+    }
+
+private:
+
+    // ״ʹʱ¼ʱӻ׼
+    struct Epoch {
+        int64_t ticks;
+        int64_t unixMicros;
+    };
+
+    static const Epoch &GetEpoch() {
+        static const Epoch s_epoch = [] {
+            FILETIME ft;
+            GetSystemTimeAsFileTime(&ft);
+
+            ULARGE_INTEGER ul;
+            ul.LowPart = ft.dwLowDateTime;
+            ul.HighPart = ft.dwHighDateTime;
+
+            // FILETIME  1601-01-01 Ϊ㣬λΪ 100 
+            Epoch epoch;
+            epoch.ticks = Now();
+            epoch.unixMicros = (int64_t) (ul.QuadPart / 10) - 11644473600000000LL;
+
+            return epoch;
+        }();
+
+        return s_epoch;
+    }
+};
@@ -1,44 +1,206 @@
-
 #include "DNSCache.hpp"
+#include "Async.hpp"
 #include "Logger.hpp"
 
 #include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
 using namespace std;
 
+#ifdef MYPROXY_SIMULATION
+#include "SimNet.hpp" // ʹʱ
+#endif
+
 #include "Debug.hpp"
 
 //////////////////////////////////////////////////////////////////////////
 
-double DNSCache::EXPIRATION = 60 * 60 * 1;
+double DNSCache::DEFAULT_TTL = 60 * 5;
+double DNSCache::MIN_TTL = 30;
+double DNSCache::MAX_TTL = 60 * 60 * 1;
+double DNSCache::NEGATIVE_TTL = 15;
+double DNSCache::PREFETCH_MIN_RATE = 6;
+double DNSCache::PREFETCH_AHEAD = 0.1;
+string DNSCache::SNAPSHOT_PATH = "dnscache.dat";
+double DNSCache::SNAPSHOT_INTERVAL = 60;
 DNSCache::Cache DNSCache::ms_cache;
 static mutex gs_loggerMutex;
+static atomic_ulong gs_numPrefetches(0);
 
+//////////////////////////////////////////////////////////////////////////
 
-DNSCache::AI *DNSCache::Resolve(const string &dname) {
-    lock_guard<mutex> lock(gs_loggerMutex);
+// ļʽС򣩣
+//
+// ļͷħ "MPDC"汾(u32)Ŀ(u32)ʱ(i64)
+// Ŀֳ(u16)֡TTL(u32)ʣЧ(u32)ַ(u16)
+//       Լÿַ family(u16)socktype(u16)protocol(u16)
+//       ַ(u16)sockaddr
+namespace {
+
+const char SNAPSHOT_MAGIC[4] = { 'M', 'P', 'D', 'C' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_HEADER_SIZE = 4 + 4 + 4 + 8;
+
+template <typename T>
+inline void Put(vector<char> &out, T v) {
+    const char *p = (const char *) &v;
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+// ӳļ˳ȡԽʱ false
+struct Reader {
+    const char *p;
+    const char *end;
+
+    template <typename T>
+    bool Get(T &v) {
+        if ((size_t) (end - p) < sizeof(T)) {
+            return false;
+        }
+
+        memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+
+        return true;
+    }
+
+    bool Skip(size_t n, const char *&begin) {
+        if ((size_t) (end - p) < n) {
+            return false;
+        }
+
+        begin = p;
+        p += n;
+
+        return true;
+    }
+};
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+class DNSCache::Prefetcher : public AsyncResolver::Callback {
+public:
+
+    Prefetcher(const string &dname)
+        : m_dname(dname), m_resolver(this) {}
+
+    bool Start() {
+        auto pos = m_dname.rfind(':');
+        if (pos == string::npos) {
+            return false;
+        }
+
+        string host(m_dname, 0, pos);
+        u_short port = (u_short) atoi(m_dname.c_str() + pos + 1);
+
+        AsyncResolver::Request req{host.c_str(), port, nullptr};
+        return m_resolver.PostResolve(req);
+    }
+
+private:
+
+    typedef AsyncResolver::QueryContext QueryContext;
+
+    // ϵͳ DNS ִ߳
+    virtual void OnQueryCompleted(QueryContext *context) override {
+        if (context->results) {
+            DNSCache::Add(m_dname, *context->results, context->ttl);
+        }
+        else {
+            DNSCache::OnPrefetchFailed(m_dname);
+        }
+
+        delete context;
+        delete this;
+    }
+
+private:
+
+    string m_dname;
+    AsyncResolver m_resolver;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+
+DNSCache::AI *DNSCache::Resolve(const string &dname, bool *failed) {
+    AI *ret = nullptr;
+    bool prefetch = false;
+
+    gs_loggerMutex.lock();
 
     auto it(ms_cache.find(dname));
     if (it != ms_cache.end()) {
+        Entry &entry = it->second;
         auto curr = time(nullptr);
-        if (difftime(curr, it->second.ts) > EXPIRATION) {
+
+        if (entry.IsExpired(curr)) {
             ms_cache.erase(it);
+        }
+        else if (!entry.IsOk()) {
+            if (failed) {
+                *failed = true;
+            }
+        }
+        else {
+            entry.hits++;
+
+            // ӳЧڣĿ TTL ںʧЧ
+            // ȵĿڹ֮ǰɺ̨ˢ
+            if (!entry.prefetching && entry.NeedsPrefetch(curr)) {
+                entry.prefetching = true;
+                prefetch = true;
+            }
 
-            return nullptr;
+            ret = entry.CopyAddrInfo();
         }
+    }
 
-        // ӳЧڣΪǰʱ
-        it->second.ts = curr;
+    gs_loggerMutex.unlock();
 
-        return it->second.CopyAddrInfo();
+    if (prefetch) {
+        Prefetch(dname);
     }
 
-    return nullptr;
+    return ret;
 }
 
-void DNSCache::Add(const std::string &dname, const AI &ai) {
-    gs_loggerMutex.lock();
-    ms_cache.emplace(dname, &ai);
-    gs_loggerMutex.unlock();
+void DNSCache::Add(const std::string &dname, const AI &ai, unsigned long ttl) {
+    lock_guard<mutex> lock(gs_loggerMutex);
+
+    // ǾĿѹڵĻ߷񶨻Ŀ
+    ms_cache.erase(dname);
+    ms_cache.emplace(piecewise_construct,
+                     forward_as_tuple(dname),
+                     forward_as_tuple(&ai, ClampTTL(ttl)));
+}
+
+void DNSCache::AddNegative(const std::string &dname) {
+    lock_guard<mutex> lock(gs_loggerMutex);
+
+    ms_cache.erase(dname);
+    ms_cache.emplace(piecewise_construct,
+                     forward_as_tuple(dname),
+                     forward_as_tuple(nullptr, NEGATIVE_TTL));
+}
+
+/*static*/
+bool DNSCache::IsNegativeCacheable(int error) {
+    switch (error) {
+    case WSAHOST_NOT_FOUND: // NXDOMAIN
+    case WSANO_DATA: // ûжӦ͵ļ¼
+    case WSATRY_AGAIN: // SERVFAIL ߷Ӧ
+    case WSANO_RECOVERY: // REFUSEDFORMERR 
+        return true;
+
+    default:
+        return false;
+    }
 }
 
 bool DNSCache::Remove(const std::string &dname) {
@@ -53,42 +215,389 @@ bool DNSCache::Remove(const std::string &dname) {
     return false;
 }
 
+/*static*/
+unsigned long DNSCache::GetPrefetchCount() {
+    return gs_numPrefetches;
+}
+
+/*static*/
+size_t DNSCache::GetSize() {
+    lock_guard<mutex> lock(gs_loggerMutex);
+    return ms_cache.size();
+}
+
+/*static*/
+vector<DNSCache::EntryInfo> DNSCache::GetEntries(size_t max) {
+    vector<EntryInfo> entries;
+    auto curr = time(nullptr);
+
+    lock_guard<mutex> lock(gs_loggerMutex);
+    entries.reserve(min(max, ms_cache.size()));
+
+    for (auto &item : ms_cache) {
+        if (entries.size() == max) {
+            break;
+        }
+
+        const Entry &entry = item.second;
+
+        EntryInfo info;
+        info.name = item.first;
+        info.negative = !entry.IsOk();
+        info.ttl = entry.ttl;
+        info.remaining = entry.ttl - difftime(curr, entry.ts);
+        info.hits = entry.hits;
+        info.prefetching = entry.prefetching;
+
+        for (auto ai = entry.ai; ai; ai = ai->ai_next) {
+            char buf[INET6_ADDRSTRLEN] = "?";
+
+            if (ai->ai_family == AF_INET) {
+                inet_ntop(AF_INET, &((sockaddr_in *) ai->ai_addr)->sin_addr,
+                          buf, sizeof(buf));
+            }
+            else if (ai->ai_family == AF_INET6) {
+                inet_ntop(AF_INET6,
+                          &((sockaddr_in6 *) ai->ai_addr)->sin6_addr,
+                          buf, sizeof(buf));
+            }
+
+            info.addrs.push_back(buf);
+        }
+
+        entries.push_back(move(info));
+    }
+
+    return entries;
+}
+
+/*static*/
+bool DNSCache::SaveSnapshot() {
+    if (SNAPSHOT_PATH.empty()) {
+        return false;
+    }
+
+    vector<char> buf(SNAPSHOT_HEADER_SIZE);
+    uint32_t count = 0;
+    auto curr = time(nullptr);
+
+    gs_loggerMutex.lock();
+
+    for (auto &item : ms_cache) {
+        const Entry &entry = item.second;
+        if (!entry.IsOk() || entry.IsExpired(curr)) {
+            continue;
+        }
+
+        uint16_t numAddrs = 0;
+        for (auto ai = entry.ai; ai; ai = ai->ai_next) {
+            numAddrs++;
+        }
+
+        Put(buf, (uint16_t) item.first.length());
+        buf.insert(buf.end(), item.first.begin(), item.first.end());
+        Put(buf, (uint32_t) entry.ttl);
+        Put(buf, (uint32_t) (entry.ttl - difftime(curr, entry.ts)));
+        Put(buf, numAddrs);
+
+        for (auto ai = entry.ai; ai; ai = ai->ai_next) {
+            Put(buf, (uint16_t) ai->ai_family);
+            Put(buf, (uint16_t) ai->ai_socktype);
+            Put(buf, (uint16_t) ai->ai_protocol);
+            Put(buf, (uint16_t) ai->ai_addrlen);
+
+            auto addr = (const char *) ai->ai_addr;
+            buf.insert(buf.end(), addr, addr + ai->ai_addrlen);
+        }
+
+        count++;
+    }
+
+    gs_loggerMutex.unlock();
+
+    char *p = buf.data();
+    memcpy(p, SNAPSHOT_MAGIC, 4);
+    memcpy(p + 4, &SNAPSHOT_VERSION, 4);
+    memcpy(p + 8, &count, 4);
+
+    int64_t savedAt = curr;
+    memcpy(p + 12, &savedAt, 8);
+
+    string tmpPath(SNAPSHOT_PATH + ".tmp");
+    HANDLE file = CreateFileA(tmpPath.c_str(), GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateFile() failed");
+        return false;
+    }
+
+    DWORD written = 0;
+    BOOL ok = WriteFile(file, buf.data(), (DWORD) buf.size(), &written,
+                        nullptr) && written == buf.size();
+
+    CloseHandle(file);
+
+    // ԭӵ滻ɿ
+    if (!ok || !MoveFileExA(tmpPath.c_str(), SNAPSHOT_PATH.c_str(),
+                            MOVEFILE_REPLACE_EXISTING |
+                            MOVEFILE_WRITE_THROUGH)) {
+        Logger::LogWindowsLastError(__FUNC__ "Failed to write the snapshot");
+        DeleteFileA(tmpPath.c_str());
+
+        return false;
+    }
+
+    return true;
+}
+
+/*static*/
+size_t DNSCache::LoadSnapshot() {
+    if (SNAPSHOT_PATH.empty()) {
+        return 0;
+    }
+
+    HANDLE file = CreateFileA(SNAPSHOT_PATH.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    // ״ʱûп
+    if (file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) ||
+        size.QuadPart < (LONGLONG) SNAPSHOT_HEADER_SIZE) {
+        CloseHandle(file);
+        return 0;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+    if (!mapping) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateFileMapping() failed");
+
+        CloseHandle(file);
+        return 0;
+    }
+
+    auto view = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        Logger::LogWindowsLastError(__FUNC__ "MapViewOfFile() failed");
+
+        CloseHandle(mapping);
+        CloseHandle(file);
+
+        return 0;
+    }
+
+    Reader reader{ view, view + (size_t) size.QuadPart };
+
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    int64_t savedAt = 0;
+
+    reader.Get(magic);
+    reader.Get(version);
+    reader.Get(count);
+    reader.Get(savedAt);
+
+    size_t loaded = 0;
+    auto curr = time(nullptr);
+    double elapsed = difftime(curr, (time_t) savedAt);
+
+    if (memcmp(magic, SNAPSHOT_MAGIC, 4) != 0 ||
+        version != SNAPSHOT_VERSION) {
+        Logger::LogError(__FUNC__ "Unknown snapshot format: " + SNAPSHOT_PATH);
+        count = 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t nameLen, numAddrs;
+        uint32_t ttl, remaining;
+        const char *name;
+
+        if (!reader.Get(nameLen) || !reader.Skip(nameLen, name) ||
+            !reader.Get(ttl) || !reader.Get(remaining) ||
+            !reader.Get(numAddrs)) {
+            break;
+        }
+
+        AI *head = nullptr, **tail = &head;
+        bool ok = true;
+
+        for (uint16_t j = 0; j < numAddrs && ok; j++) {
+            uint16_t family, socktype, protocol, addrlen;
+            const char *addr;
+
+            ok = reader.Get(family) && reader.Get(socktype) &&
+                 reader.Get(protocol) && reader.Get(addrlen) &&
+                 addrlen <= sizeof(sockaddr_storage) &&
+                 reader.Skip(addrlen, addr);
+
+            if (ok) {
+                AI *ai = new AI;
+                memset(ai, 0, sizeof(AI));
+
+                ai->ai_family = family;
+                ai->ai_socktype = socktype;
+                ai->ai_protocol = protocol;
+                ai->ai_addrlen = addrlen;
+                ai->ai_addr = (sockaddr *) new sockaddr_storage;
+                memcpy(ai->ai_addr, addr, addrlen);
+
+                *tail = ai;
+                tail = &ai->ai_next;
+            }
+        }
+
+        // տ𻵻Բͬãǰ [MIN_TTL, MAX_TTL]
+        // ƣʣЧڲƺ TTLͣڼҲڼʱ
+        double clamped = ClampTTL(ttl);
+        double left = min((double) remaining - elapsed, clamped);
+
+        if (ok && head && left > 0) {
+            lock_guard<mutex> lock(gs_loggerMutex);
+
+            string dname(name, nameLen);
+            ms_cache.erase(dname);
+
+            auto it = ms_cache.emplace(piecewise_construct,
+                                       forward_as_tuple(dname),
+                                       forward_as_tuple(head, clamped)).first;
+
+            // ԭеĵʱ
+            it->second.ts = curr - (time_t) (clamped - left);
+            loaded++;
+        }
+
+        DestroyAddrInfo(head);
+
+        if (!ok) {
+            break;
+        }
+    }
+
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    CloseHandle(file);
+
+    return loaded;
+}
+
+/*static*/
+void DNSCache::Prefetch(const std::string &dname) {
+    gs_numPrefetches++;
+
+    // ύɹɻص
+    Prefetcher *prefetcher = new Prefetcher(dname);
+    if (!prefetcher->Start()) {
+        delete prefetcher;
+        OnPrefetchFailed(dname);
+    }
+}
+
+/*static*/
+void DNSCache::OnPrefetchFailed(const std::string &dname) {
+    lock_guard<mutex> lock(gs_loggerMutex);
+
+    // ĿֱڣγʧʱÿжԤȡ
+    auto it(ms_cache.find(dname));
+    if (it != ms_cache.end()) {
+        Entry &entry = it->second;
+        entry.prefetching = false;
+        entry.nextPrefetch = time(nullptr) +
+                             (time_t) max(NEGATIVE_TTL, 1.0);
+    }
+}
+
+/*static*/
+double DNSCache::ClampTTL(unsigned long ttl) {
+    if (ttl == 0) {
+        return DEFAULT_TTL;
+    }
+
+    double ret = (double) ttl;
+    if (ret < MIN_TTL) {
+        ret = MIN_TTL;
+    }
+    else if (ret > MAX_TTL) {
+        ret = MAX_TTL;
+    }
+
+    return ret;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
-DNSCache::Entry::Entry(const AI *ai_other) {
-    if (ai_other) {
-        ai = *ai_other;
-        ai.ai_addr = new sockaddr(*(ai_other->ai_addr));
+/*static*/
+DNSCache::AI *DNSCache::CopyAddrInfo(const AI *src) {
+    AI *head = nullptr, **tail = &head;
+
+    for (; src; src = src->ai_next) {
+        AI *ai = new AI(*src);
+        ai->ai_addr = (sockaddr *) new sockaddr_storage;
+        memcpy(ai->ai_addr, src->ai_addr, src->ai_addrlen);
 
         // ûʹֵ
-        ai.ai_canonname = nullptr;
-        ai.ai_next = nullptr;
+        ai->ai_canonname = nullptr;
+        ai->ai_next = nullptr;
 
-        ts = time(nullptr);
+        *tail = ai;
+        tail = &ai->ai_next;
     }
-    else {
-        memset(&ai, 0, sizeof(AI));
+
+    return head;
+}
+
+DNSCache::Entry::Entry(const AI *ai_other, double ttl)
+    : ts(time(nullptr)), ttl(ttl) {
+    if (ai_other) {
+        ai = DNSCache::CopyAddrInfo(ai_other);
     }
 }
 
 DNSCache::Entry::~Entry() {
     if (IsOk()) {
-        delete ai.ai_addr;
+        DestroyAddrInfo(ai);
     }
 }
 
 DNSCache::AI *DNSCache::Entry::CopyAddrInfo() const {
-    AI *ret = new AI(ai);
-    ret->ai_addr = new sockaddr(*(ai.ai_addr));
-
-    return ret;
+    return DNSCache::CopyAddrInfo(ai);
 }
 
 void DNSCache::DestroyAddrInfo(AI *ai) {
-    delete ai->ai_addr;
-    delete ai;
+    while (ai) {
+        AI *next = ai->ai_next;
+
+        delete (sockaddr_storage *) ai->ai_addr;
+        delete ai;
+
+        ai = next;
+    }
 }
 
 bool DNSCache::Entry::IsOk() const {
-    return ai.ai_addr != nullptr;
+    return ai != nullptr;
+}
+
+bool DNSCache::Entry::IsExpired(time_t curr) const {
+    return difftime(curr, ts) > ttl;
+}
+
+bool DNSCache::Entry::NeedsPrefetch(time_t curr) const {
+    if (PREFETCH_MIN_RATE <= 0 || curr < nextPrefetch) {
+        return false;
+    }
+
+    double age = difftime(curr, ts);
+    if (ttl - age > ttl * PREFETCH_AHEAD) {
+        return false;
+    }
+
+    // ռ뻺ĿΪ 0
+    double minutes = (age < 1 ? 1 : age) / 60;
+    return hits / minutes >= PREFETCH_MIN_RATE;
 }
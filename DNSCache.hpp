@@ -1,44 +1,125 @@
-
 #pragma once
 #include "ws-util.h"
 #include <ws2tcpip.h> // for ADDRINFOEX
 
 #include <string>
+#include <vector>
 #include <map>
 
 /// DNS 
 class DNSCache {
 public:
 
-    /// ĿʧЧʱ
-    /// 
-    /// ĬΪһСʱ֮ûκηĿʧЧ
-    /// ÿηʶʱ
-    static double EXPIRATION;
+    /// ޷֪¼ TTL ʱʹõĬЧڣ룩
+    static double DEFAULT_TTL;
+
+    /// ĿЧޣ룩
+    ///
+    /// ¼ TTL СʱԴΪ׼Ƶ½
+    static double MIN_TTL;
+
+    /// ĿЧޣ룩
+    ///
+    /// ʹ¼ TTL ܳĿҲڴʱ֮ʧЧ
+    /// ĿӳЧڡ
+    static double MAX_TTL;
+
+    /// 񶨻Чڣ룩
+    ///
+    /// ʧܣNXDOMAINSERVFAIL ȣڴʱ
+    /// ٴ DNS ѯ
+    static double NEGATIVE_TTL;
+
+    /// ȵĿͷƵʣ/ӣ
+    ///
+    /// ƵʲڴֵĿڼʱ̨Ԥȡˢ¡
+    /// Ϊ 0 Ԥȡ
+    static double PREFETCH_MIN_RATE;
+
+    /// ԤȡʱʣЧڲ TTL һʱʼˢ
+    static double PREFETCH_AHEAD;
+
+    /// ļ·ΪȲҲ
+    static std::string SNAPSHOT_PATH;
+
+    /// ڱյʱ룩
+    static double SNAPSHOT_INTERVAL;
 
     /// WinSock Ķ
     typedef ADDRINFOEX AI;
 
     /// 
-    /// 
+    ///
     /// Ҫӹܷصָ룬ɾͨ #DestroyAddrInfo() 
-    static AI *Resolve(const std::string &dname);
+    ///
+    /// @param failed ǿգз񶨻ʱΪ true
+    static AI *Resolve(const std::string &dname, bool *failed = nullptr);
 
-    /// һ #Resolve() ص AI 
+    /// һ #Resolve()  #CopyAddrInfo() ص AI 
     static void DestroyAddrInfo(AI *ai);
 
-    /// Ӧ IP ַ뻺
-    static void Add(const std::string &dname, const AI &ai);
+    ///  addrinfo 
+    ///
+    /// صͨ #DestroyAddrInfo() ١
+    static AI *CopyAddrInfo(const AI *ai);
+
+    /// Ӧ IP ַб뻺
+    ///
+    /// @param ttl ¼ TTL룩Ϊ 0 ʾδ֪
+    static void Add(const std::string &dname, const AI &ai, unsigned long ttl);
+
+    /// ʧܵ񶨻
+    static void AddNegative(const std::string &dname);
+
+    ///  @a error ǷӦñ񶨻
+    ///
+    /// ֻȨʧܽڡûм¼ʧܣŻᱻ棬
+    /// شڴ治㡢ȡᡣ
+    static bool IsNegativeCacheable(int error);
 
     /// ɾʧЧĿ
     static bool Remove(const std::string &dname);
 
+    /// ȡύԤȡĿ
+    static unsigned long GetPrefetchCount();
+
+    /// ĿĸҪϢ
+    struct EntryInfo {
+        std::string name; ///<  host:port
+        bool negative; ///< ǷΪ񶨻Ŀ
+        std::vector<std::string> addrs; ///< ַıʽ
+        double ttl; ///< Чڣ룩
+        double remaining; ///< ʣЧڣ룩ʾѹ
+        unsigned long hits; ///< д
+        bool prefetching; ///< ǷԤȡ
+    };
+
+    /// ȡĿĿѹڶδɾģ
+    static size_t GetSize();
+
+    /// ȡǰ @a max Ŀ
+    static std::vector<EntryInfo> GetEntries(size_t max);
+
+    /// ЧĿдļ #SNAPSHOT_PATH
+    ///
+    /// дʱļ滻;˳𻵵Ŀա
+    static bool SaveSnapshot();
+
+    /// ӿļ #SNAPSHOT_PATH ĿѹڵĿ
+    ///
+    /// Ӧڴʼ֮ǰãʹҲл档
+    ///
+    /// @return صĿĿ
+    static size_t LoadSnapshot();
+
 private:
 
     /// һĿ
     struct Entry {
         /// 캯
-        Entry(const AI *ai_other);
+        ///
+        /// @param ai_other Ϊʱһ񶨻Ŀ
+        Entry(const AI *ai_other, double ttl);
 
         /// øƹ캯
         Entry(const Entry &other) = delete;
@@ -46,16 +127,39 @@ private:
         /// 
         ~Entry();
 
-        /// ĿǷЧ
+        /// ĿǷЧ񶨻ĿЧ
         bool IsOk() const;
 
+        /// ĿǷѹ
+        bool IsExpired(time_t curr) const;
+
         ///  #ai ṹ
         AI *CopyAddrInfo() const;
 
-        AI ai;
+        /// ǷΪڵȵĿ
+        bool NeedsPrefetch(time_t curr) const;
+
+        AI *ai = nullptr; ///< ַб񶨻ĿΪ
         time_t ts = 0; ///< 뻺ʱ
+        double ttl = 0; ///< Чڣ룩
+
+        unsigned long hits = 0; ///< 뻺д
+        bool prefetching = false; ///< ǷύԤȡ
+        time_t nextPrefetch = 0; ///< Ԥȡʧܺ󣬴ʱ֮ǰԤȡ
     };
 
+    /// ں̨½ @a dname host:port
+    static void Prefetch(const std::string &dname);
+
+    /// Ԥȡʧܣ #NEGATIVE_TTL 
+    static void OnPrefetchFailed(const std::string &dname);
+
+    /// Ԥȡɺ
+    class Prefetcher;
+
+    ///  TTL  [#MIN_TTL, #MAX_TTL] ֮
+    static double ClampTTL(unsigned long ttl);
+
 private:
 
     typedef std::map<std::string, Entry> Cache;
@@ -0,0 +1,930 @@
+#include "DNSClient.hpp"
+#include "DNSCache.hpp"
+#include "Logger.hpp"
+
+#include <mswsock.h> // for LPFN_CONNECTEX
+#include <mstcpip.h> // for SIO_UDP_CONNRESET
+#include <iphlpapi.h> // for GetNetworkParams()
+#pragma comment(lib, "iphlpapi.lib")
+#include <bcrypt.h> // for BCryptGenRandom()
+#pragma comment(lib, "bcrypt.lib")
+
+#include <sstream>
+#include <cmath>
+#include <cassert>
+using namespace std;
+
+#include "Debug.hpp"
+
+
+//////////////////////////////////////////////////////////////////////////
+
+//  Proxy.cpp еͬԱԳ򵥶ӱģ
+static bool AssociateWithCompletionPort(SOCKET sd, HANDLE cp) {
+    if (CreateIoCompletionPort((HANDLE) sd, cp, SCK_DNS_CLIENT, 0) != cp) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateIoCompletionPort() failed");
+        return false;
+    }
+
+    return true;
+}
+
+static LPFN_CONNECTEX gs_lpfnConnectEx;
+
+// ȡ ConnectEx() ĺָ
+static bool LoadConnectEx(SOCKET sd) {
+    if (gs_lpfnConnectEx) {
+        return true;
+    }
+
+    GUID GuidConnectEx = WSAID_CONNECTEX;
+    DWORD dwBytes;
+
+    int iResult = WSAIoctl(sd, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                           &GuidConnectEx, sizeof(GuidConnectEx),
+                           &gs_lpfnConnectEx, sizeof(gs_lpfnConnectEx),
+                           &dwBytes, NULL, NULL);
+
+    if (iResult == SOCKET_ERROR) {
+        auto fmt = __FUNC__ "WSAIoctl(WSAID_CONNECTEX) failed";
+        Logger::LogError(WSAGetLastErrorMessage(fmt));
+
+        return false;
+    }
+
+    return true;
+}
+
+// ϵͳѧ @a buf
+static bool Random(void *buf, ULONG len) {
+    NTSTATUS status = BCryptGenRandom(nullptr, (PUCHAR) buf, len,
+                                      BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+
+    if (!BCRYPT_SUCCESS(status)) {
+        ostringstream oss;
+        oss << __FUNC__ "BCryptGenRandom() failed with status 0x"
+            << hex << (unsigned long) status;
+
+        Logger::LogError(oss.str());
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+bool DNSClient::ENABLED = false;
+int DNSClient::MAX_ATTEMPTS = 3;
+DWORD DNSClient::MIN_RTO = 100;
+DWORD DNSClient::MAX_RTO = 3000;
+DWORD DNSClient::INITIAL_RTO = 1000;
+
+/// TCP ѯ
+struct DNSClient::TcpContext : public Channel {
+    TcpContext(uint16_t id) : Channel(id, true, CONNECT) {
+        bufSpec.buf = buf;
+        bufSpec.len = sizeof(buf);
+    }
+
+    vector<char> out; // ֽڳǰ׺Ĳѯ
+    vector<char> in; // յӦ
+
+    WSABUF bufSpec;
+    char buf[1024];
+
+    DWORD tx = 0;
+
+    // ӦǷ
+    bool IsComplete() const {
+        if (in.size() < 2) {
+            return false;
+        }
+
+        size_t len = ((unsigned char) in[0] << 8) | (unsigned char) in[1];
+        return in.size() >= len + 2;
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+//  DNSCache::DestroyAddrInfo() ܹٵĵַб
+static ADDRINFOEX *MakeAddrInfo(const vector<uint32_t> &addrs, u_short port) {
+    ADDRINFOEX *head = nullptr, **tail = &head;
+
+    for (auto addr : addrs) {
+        ADDRINFOEX *ai = new ADDRINFOEX;
+        memset(ai, 0, sizeof(ADDRINFOEX));
+
+        ai->ai_family = AF_INET;
+        ai->ai_socktype = SOCK_STREAM;
+        ai->ai_protocol = IPPROTO_TCP;
+        ai->ai_addrlen = sizeof(sockaddr_in);
+
+        auto ss = new sockaddr_storage;
+        memset(ss, 0, sizeof(sockaddr_storage));
+
+        auto sin = (sockaddr_in *) ss;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        sin->sin_addr.s_addr = addr;
+
+        ai->ai_addr = (sockaddr *) ss;
+
+        *tail = ai;
+        tail = &ai->ai_next;
+    }
+
+    return head;
+}
+
+// ӦתΪ GetAddrInfoExW() Ĵ
+static int RCodeToError(int rcode) {
+    switch (rcode) {
+    case DNSMessage::RCODE_NOERROR:
+        return WSANO_DATA;
+
+    case DNSMessage::RCODE_NXDOMAIN:
+        return WSAHOST_NOT_FOUND;
+
+    case DNSMessage::RCODE_SERVFAIL:
+        return WSATRY_AGAIN;
+
+    default:
+        return WSANO_RECOVERY;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+DNSClient::DNSClient()
+    : m_running(false), m_nextPoll(0) {
+
+}
+
+DNSClient::~DNSClient() {
+    Stop();
+}
+
+/*static*/
+DNSClient &DNSClient::GetInstance() {
+    static DNSClient s_client;
+    return s_client;
+}
+
+bool DNSClient::AddServer(const char *addr) {
+    string host(addr);
+    u_short port = DEFAULT_PORT;
+
+    auto pos = host.find(':');
+    if (pos != string::npos) {
+        port = (u_short) atoi(host.c_str() + pos + 1);
+        host.resize(pos);
+    }
+
+    u_long ip = inet_addr(host.c_str());
+    if (ip == INADDR_NONE || port == 0) {
+        Logger::LogError(__FUNC__ "Invalid DNS server: " + string(addr));
+        return false;
+    }
+
+    Server server;
+    memset(&server.addr, 0, sizeof(server.addr));
+    server.addr.sin_family = AF_INET;
+    server.addr.sin_addr.s_addr = ip;
+    server.addr.sin_port = htons(port);
+    server.rto = INITIAL_RTO;
+
+    m_servers.push_back(server);
+    return true;
+}
+
+bool DNSClient::AddSystemServers() {
+    ULONG len = 0;
+    if (GetNetworkParams(nullptr, &len) != ERROR_BUFFER_OVERFLOW) {
+        return false;
+    }
+
+    vector<char> buf(len);
+    auto info = (FIXED_INFO *) buf.data();
+
+    if (GetNetworkParams(info, &len) != ERROR_SUCCESS) {
+        return false;
+    }
+
+    for (auto p = &info->DnsServerList; p; p = p->Next) {
+        if (p->IpAddress.String[0]) {
+            AddServer(p->IpAddress.String);
+        }
+    }
+
+    return !m_servers.empty();
+}
+
+bool DNSClient::Start(HANDLE cp) {
+    if (!ENABLED || m_running) {
+        return m_running;
+    }
+
+    if (m_servers.empty() && !AddSystemServers()) {
+        Logger::LogError(__FUNC__ "No DNS server available");
+        return false;
+    }
+
+    m_cp = cp;
+    m_running = true;
+
+    return true;
+}
+
+DNSClient::UdpContext *DNSClient::OpenUdp(uint16_t id) {
+    SOCKET sd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sd == INVALID_SOCKET) {
+        Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "socket() failed"));
+        return nullptr;
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+
+    // Ķ˿ڿѱռãԼκ󽻸ϵͳ
+    enum { MAX_BIND_ATTEMPTS = 8 };
+
+    for (int i = 0; ; i++) {
+        u_short port = 0;
+        if (i < MAX_BIND_ATTEMPTS && Random(&port, sizeof(port))) {
+            port = 1024 + port % (65536 - 1024);
+        }
+
+        local.sin_port = htons(port);
+
+        if (::bind(sd, (sockaddr *) &local, sizeof(local)) == 0) {
+            break;
+        }
+
+        if (port == 0) {
+            Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "bind() failed"));
+            closesocket(sd);
+
+            return nullptr;
+        }
+    }
+
+    // ҪΪ ICMP ˿ڲɴʹղʧ
+    BOOL reportReset = FALSE;
+    DWORD dwBytes;
+    WSAIoctl(sd, SIO_UDP_CONNRESET,
+             &reportReset, sizeof(reportReset),
+             nullptr, 0, &dwBytes, nullptr, nullptr);
+
+    if (!AssociateWithCompletionPort(sd, m_cp)) {
+        closesocket(sd);
+        return nullptr;
+    }
+
+    UdpContext *udp = new UdpContext(id);
+    udp->sd = sd;
+
+    if (!PostRecv(*udp)) {
+        closesocket(sd);
+        delete udp;
+
+        return nullptr;
+    }
+
+    return udp;
+}
+
+void DNSClient::CancelAll() {
+    vector<AsyncResolver::QueryContext *> aborted;
+
+    m_mutex.lock();
+    m_running = false;
+
+    while (!m_queries.empty()) {
+        aborted.push_back(Finish(m_queries.begin(), WSAECANCELLED,
+                                 nullptr, 0));
+    }
+
+    m_mutex.unlock();
+
+    // ϲͬһѯϵĵȴ߶ҪõʧܵĽ
+    // ԶȲص
+    for (auto context : aborted) {
+        Notify(context, false);
+    }
+}
+
+void DNSClient::Stop() {
+    lock_guard<mutex> lock(m_mutex);
+    m_running = false;
+
+    // ߳Ѿ˳CancelAll() ֮ҲвѯһУ
+    // ֻر׽֣֪ͨ
+    for (auto &kv : m_queries) {
+        Query &query = kv.second;
+
+        if (query.udp) {
+            Abandon(query.udp);
+        }
+
+        if (query.tcp) {
+            Abandon(query.tcp);
+        }
+    }
+
+    if (!m_queries.empty()) {
+        ostringstream oss;
+        oss << __FUNC__ "Dropped " << m_queries.size()
+            << " query(s) left after CancelAll()";
+
+        Logger::LogError(oss.str());
+        m_queries.clear();
+    }
+}
+
+/*static*/
+bool DNSClient::CanResolve(const char *host) {
+    auto dot = strrchr(host, '.');
+    if (!dot) {
+        return false;
+    }
+
+    // mDNS 
+    return _stricmp(dot, ".local") != 0;
+}
+
+void DNSClient::Resolve(AsyncResolver::QueryContext *context) {
+    string name(context->key, strrchr(context->key, ':'));
+    if (!name.empty() && name.back() == '.') {
+        name.pop_back(); // Ӧеֲĩβĵ
+    }
+
+    //  IP ַ
+    u_long ip = inet_addr(name.c_str());
+    if (ip != INADDR_NONE) {
+        vector<uint32_t> addrs(1, ip);
+        context->results = MakeAddrInfo(addrs, context->port);
+        context->copied = true;
+        context->error = ERROR_SUCCESS;
+
+        Notify(context, false);
+        return;
+    }
+
+    AsyncResolver::QueryContext *failed = nullptr;
+    auto now = GetTickCount64();
+    uint16_t id;
+
+    m_mutex.lock();
+
+    // CancelAll() ֮ٽܲѯ
+    if (!m_running) {
+        context->error = WSAECANCELLED;
+        failed = context;
+    }
+    else if (!NewId(id)) {
+        context->error = WSANO_RECOVERY;
+        failed = context;
+    }
+    else {
+        auto it = m_queries.emplace(id, Query()).first;
+
+        Query &query = it->second;
+        query.context = context;
+        query.name = name;
+        query.port = context->port;
+
+        if (!Send(id, query, now)) {
+            failed = Finish(it, WSAENETDOWN, nullptr, 0);
+        }
+    }
+
+    m_mutex.unlock();
+
+    //  I/O ֪ͨУ߿ԼĴ
+    if (failed) {
+        Notify(failed, false);
+    }
+}
+
+bool DNSClient::NewId(uint16_t &id) {
+    do {
+        if (!Random(&id, sizeof(id))) {
+            return false;
+        }
+    } while (id == 0 || m_queries.find(id) != m_queries.end());
+
+    return true;
+}
+
+int DNSClient::PickServer(int exclude) const {
+    int best = -1;
+
+    for (int i = 0; i < (int) m_servers.size(); i++) {
+        if (i == exclude && m_servers.size() > 1) {
+            continue;
+        }
+
+        if (best == -1 || m_servers[i].rto < m_servers[best].rto) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+bool DNSClient::Send(uint16_t id, Query &query, ULONGLONG now) {
+    int idx = PickServer(query.attempts > 0 ? query.server : -1);
+    if (idx == -1) {
+        return false;
+    }
+
+    vector<char> msg;
+    if (!DNSMessage::BuildQuery(id, query.name, DNSMessage::TYPE_A, msg)) {
+        return false;
+    }
+
+    // شͬһ׽
+    if (!query.udp) {
+        query.udp = OpenUdp(id);
+        if (!query.udp) {
+            return false;
+        }
+    }
+
+    Server &server = m_servers[idx];
+
+    // UDP ͼص
+    int ret = sendto(query.udp->sd, msg.data(), (int) msg.size(), 0,
+                     (const sockaddr *) &server.addr, sizeof(server.addr));
+
+    if (ret == SOCKET_ERROR) {
+        Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "sendto() failed"));
+        return false;
+    }
+
+    query.server = idx;
+    query.attempts++;
+    query.sentAt = now;
+    query.deadline = now + server.rto;
+
+    server.sent++;
+    return true;
+}
+
+bool DNSClient::SendTcp(uint16_t id, Query &query) {
+    vector<char> msg;
+    if (!DNSMessage::BuildQuery(id, query.name, DNSMessage::TYPE_A, msg)) {
+        return false;
+    }
+
+    SOCKET sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sd == INVALID_SOCKET) {
+        Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "socket() failed"));
+        return false;
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = 0;
+
+    // ConnectEx() Ҫ׽Ѱ
+    if (::bind(sd, (sockaddr *) &local, sizeof(local)) != 0 ||
+        !LoadConnectEx(sd) ||
+        !AssociateWithCompletionPort(sd, m_cp)) {
+        closesocket(sd);
+        return false;
+    }
+
+    TcpContext *tcp = new TcpContext(id);
+    tcp->sd = sd;
+    tcp->out.push_back((char) (msg.size() >> 8));
+    tcp->out.push_back((char) (msg.size() & 0xFF));
+    tcp->out.insert(tcp->out.end(), msg.begin(), msg.end());
+
+    const Server &server = m_servers[query.server];
+
+    // ӵͬʱѯ
+    BOOL bResult = gs_lpfnConnectEx(sd,
+                                 (const sockaddr *) &server.addr,
+                                 sizeof(server.addr),
+                                 tcp->out.data(),
+                                 (DWORD) tcp->out.size(),
+                                 &tcp->tx,
+                                 &tcp->ol);
+
+    if (!bResult) {
+        int ec = WSAGetLastError();
+        if (ec != WSA_IO_PENDING) {
+            Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "ConnectEx() failed", ec));
+
+            closesocket(sd);
+            delete tcp;
+
+            return false;
+        }
+    }
+
+    query.tcp = tcp;
+    query.sentAt = GetTickCount64();
+    query.deadline = query.sentAt + server.rto * 2;
+
+    return true;
+}
+
+bool DNSClient::PostRecv(UdpContext &udp) {
+    memset(&udp.ol, 0, sizeof(udp.ol));
+    udp.fromLen = sizeof(udp.from);
+    udp.flags = 0;
+
+    int iResult = WSARecvFrom(udp.sd,
+                              &udp.bufSpec, 1,
+                              nullptr,
+                              &udp.flags,
+                              (sockaddr *) &udp.from,
+                              &udp.fromLen,
+                              &udp.ol,
+                              nullptr);
+
+    if (iResult != 0) {
+        int ec = WSAGetLastError();
+        if (ec != WSA_IO_PENDING) {
+            auto prefix = __FUNC__ "WSARecvFrom() failed";
+            Logger::LogError(WSAGetLastErrorMessage(prefix, ec));
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void DNSClient::OnCompletion(PerIoContext *pic, DWORD transfered, bool ok) {
+    AsyncResolver::QueryContext *done = nullptr;
+    Channel *channel = (Channel *) pic;
+
+    m_mutex.lock();
+
+    if (channel->abandoned) {
+        Destroy(channel);
+    }
+    else if (channel->tcp) {
+        done = OnTcpCompletion((TcpContext *) channel, transfered, ok);
+    }
+    else {
+        done = OnUdpCompletion((UdpContext *) channel, transfered, ok);
+    }
+
+    m_mutex.unlock();
+
+    if (done) {
+        Notify(done, true);
+    }
+}
+
+AsyncResolver::QueryContext *DNSClient::OnUdpCompletion
+(UdpContext *udp, DWORD transfered, bool ok) {
+    AsyncResolver::QueryContext *done = nullptr;
+
+    if (ok && transfered > 0) {
+        done = OnResponse(udp->buf, transfered, &udp->from, udp,
+                          GetTickCount64());
+    }
+
+    // ѯѽ׽ѹرգ֪ͨ
+    if (udp->abandoned) {
+        delete udp;
+        return done;
+    }
+
+    if (!PostRecv(*udp)) {
+        //  Poll()ʱµ׽ط
+        auto it = m_queries.find(udp->id);
+        assert(it != m_queries.end() && it->second.udp == udp);
+        it->second.udp = nullptr;
+
+        closesocket(udp->sd);
+        delete udp;
+    }
+
+    return done;
+}
+
+AsyncResolver::QueryContext *DNSClient::OnTcpCompletion
+(TcpContext *tcp, DWORD transfered, bool ok) {
+    auto it = m_queries.find(tcp->id);
+    assert(it != m_queries.end() && it->second.tcp == tcp);
+
+    if (ok) {
+        if (tcp->action == PerIoContext::CONNECT) {
+            setsockopt(tcp->sd, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT,
+                       nullptr, 0);
+
+            ok = tcp->tx == tcp->out.size();
+            tcp->action = PerIoContext::RECV;
+        }
+        else if (transfered > 0) {
+            tcp->in.insert(tcp->in.end(), tcp->buf, tcp->buf + transfered);
+
+            if (tcp->IsComplete()) {
+                it->second.tcp = nullptr;
+                auto done = OnResponse(tcp->in.data() + 2, tcp->in.size() - 2,
+                                       nullptr, nullptr, GetTickCount64());
+
+                closesocket(tcp->sd);
+                delete tcp;
+
+                return done;
+            }
+        }
+        // ڷӦ֮ǰر
+        else {
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        memset(&tcp->ol, 0, sizeof(tcp->ol));
+        DWORD flags = 0;
+
+        int iResult = WSARecv(tcp->sd, &tcp->bufSpec, 1, nullptr, &flags,
+                              &tcp->ol, nullptr);
+
+        if (iResult == 0 || WSAGetLastError() == WSA_IO_PENDING) {
+            return nullptr;
+        }
+    }
+
+    //  Poll() ԻǷ
+    it->second.tcp = nullptr;
+    it->second.deadline = 0;
+
+    closesocket(tcp->sd);
+    delete tcp;
+
+    return nullptr;
+}
+
+AsyncResolver::QueryContext *DNSClient::OnResponse
+(const char *buf, size_t len, const sockaddr_in *from,
+ UdpContext *udp, ULONGLONG now) {
+    DNSMessage::Response resp;
+    if (!DNSMessage::ParseResponse(buf, len, resp)) {
+        return nullptr;
+    }
+
+    auto it = m_queries.find(resp.id);
+    if (it == m_queries.end()) {
+        return nullptr; // ٵӦ
+    }
+
+    Query &query = it->second;
+
+    // Ӧ뵽ﱾѯ׽
+    if (udp && query.udp != udp) {
+        return nullptr;
+    }
+
+    // ⲻӦα
+    if (resp.question.name != query.name ||
+        resp.question.type != DNSMessage::TYPE_A) {
+        return nullptr;
+    }
+
+    if (from) {
+        int idx = FindServer(*from);
+        if (idx == -1) {
+            return nullptr;
+        }
+
+        Server &server = m_servers[idx];
+        server.answered++;
+
+        // ֻδشĲѯKarn 㷨
+        if (idx == query.server && query.attempts == 1) {
+            server.AddSample((double) (now - query.sentAt));
+        }
+
+        // Ѹ TCPԳٵ UDP Ӧ
+        if (query.tcp) {
+            return nullptr;
+        }
+
+        if (resp.truncated) {
+            if (!SendTcp(resp.id, query)) {
+                return Finish(it, WSANO_RECOVERY, nullptr, 0);
+            }
+
+            return nullptr;
+        }
+    }
+    else {
+        m_servers[query.server].answered++;
+    }
+
+    // ʱһ
+    if ((resp.rcode == DNSMessage::RCODE_SERVFAIL ||
+         resp.rcode == DNSMessage::RCODE_REFUSED) &&
+        query.attempts < MAX_ATTEMPTS && m_servers.size() > 1) {
+        if (Send(resp.id, query, now)) {
+            return nullptr;
+        }
+    }
+
+    int error = ERROR_SUCCESS;
+    if (resp.rcode != DNSMessage::RCODE_NOERROR || resp.addrs.empty()) {
+        error = RCodeToError(resp.rcode);
+    }
+
+    return Finish(it, error, &resp.addrs, resp.ttl);
+}
+
+void DNSClient::Poll() {
+    if (!m_running) {
+        return;
+    }
+
+    auto now = GetTickCount64();
+    auto next = m_nextPoll.load();
+
+    // ͬһʱֻһ̼߳
+    if (now < next ||
+        !m_nextPoll.compare_exchange_strong(next, now + TICK_INTERVAL)) {
+        return;
+    }
+
+    vector<AsyncResolver::QueryContext *> done;
+
+    m_mutex.lock();
+
+    for (auto it = m_queries.begin(); it != m_queries.end();) {
+        auto curr = it++;
+        Query &query = curr->second;
+
+        if (now < query.deadline) {
+            continue;
+        }
+
+        // deadline Ϊ 0 ʾ TCP ʧܣǳʱ
+        if (query.deadline != 0) {
+            Server &server = m_servers[query.server];
+            server.timeouts++;
+            server.rto = min(server.rto * 2, MAX_RTO);
+        }
+
+        if (query.attempts < MAX_ATTEMPTS) {
+            bool tcp = query.tcp != nullptr || query.deadline == 0;
+
+            if (query.tcp) {
+                Abandon(query.tcp);
+                query.tcp = nullptr;
+            }
+
+            if (tcp) {
+                query.attempts++;
+                query.server = PickServer(query.server);
+
+                if (SendTcp(curr->first, query)) {
+                    continue;
+                }
+            }
+            else if (Send(curr->first, query, now)) {
+                continue;
+            }
+        }
+
+        done.push_back(Finish(curr, WSAETIMEDOUT, nullptr, 0));
+    }
+
+    m_mutex.unlock();
+
+    for (auto context : done) {
+        Notify(context, true);
+    }
+}
+
+AsyncResolver::QueryContext *DNSClient::Finish
+(QueryMap::iterator it, int error, const vector<uint32_t> *addrs,
+ unsigned long ttl) {
+    Query &query = it->second;
+    AsyncResolver::QueryContext *context = query.context;
+
+    if (query.udp) {
+        Abandon(query.udp);
+    }
+
+    if (query.tcp) {
+        Abandon(query.tcp);
+    }
+
+    context->error = error;
+    context->ttl = ttl;
+
+    if (error == ERROR_SUCCESS && addrs && !addrs->empty()) {
+        context->results = MakeAddrInfo(*addrs, query.port);
+        context->copied = true;
+    }
+
+    m_queries.erase(it);
+    return context;
+}
+
+/*static*/
+void DNSClient::Abandon(Channel *channel) {
+    channel->abandoned = true;
+    closesocket(channel->sd);
+}
+
+/*static*/
+void DNSClient::Destroy(Channel *channel) {
+    if (channel->tcp) {
+        delete (TcpContext *) channel;
+    }
+    else {
+        delete (UdpContext *) channel;
+    }
+}
+
+/*static*/
+void DNSClient::Notify(AsyncResolver::QueryContext *context, bool onWorker) {
+    // ֻѯ A ¼NODATA ˵ûеַϵͳ
+    // ͬʱѯ AAAA ¼Ҳܾݴд񶨻
+    if (context->error == WSANO_DATA) {
+        context->error = ERROR_SUCCESS;
+        context->ttl = 0;
+        context->onWorker = false;
+        context->hints.ai_family = AF_UNSPEC;
+
+        AsyncResolver::ResolveWithSystem(context);
+        return;
+    }
+
+    context->onWorker = onWorker;
+    AsyncResolver::Complete(context);
+}
+
+int DNSClient::FindServer(const sockaddr_in &addr) const {
+    for (int i = 0; i < (int) m_servers.size(); i++) {
+        const sockaddr_in &sin = m_servers[i].addr;
+
+        if (sin.sin_addr.s_addr == addr.sin_addr.s_addr &&
+            sin.sin_port == addr.sin_port) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+vector<DNSClient::ServerStat> DNSClient::GetServerStats() const {
+    lock_guard<mutex> lock(m_mutex);
+    vector<ServerStat> stats;
+
+    for (auto &server : m_servers) {
+        ostringstream oss;
+        oss << inet_ntoa(server.addr.sin_addr) << ':'
+            << ntohs(server.addr.sin_port);
+
+        ServerStat stat;
+        stat.addr = oss.str();
+        stat.srtt = server.srtt;
+        stat.rto = server.rto;
+        stat.sent = server.sent;
+        stat.answered = server.answered;
+        stat.timeouts = server.timeouts;
+
+        stats.push_back(stat);
+    }
+
+    return stats;
+}
+
+size_t DNSClient::GetPendingCount() const {
+    lock_guard<mutex> lock(m_mutex);
+    return m_queries.size();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void DNSClient::Server::AddSample(double rtt) {
+    if (srtt == 0) {
+        srtt = rtt;
+        rttvar = rtt / 2;
+    }
+    else {
+        rttvar = 0.75 * rttvar + 0.25 * fabs(srtt - rtt);
+        srtt = 0.875 * srtt + 0.125 * rtt;
+    }
+
+    // ʱ鱾 TICK_INTERVAL 
+    double r = srtt + max(4 * rttvar, (double) TICK_INTERVAL);
+    r = max(r, (double) MIN_RTO);
+    r = min(r, (double) MAX_RTO);
+
+    rto = (DWORD) r;
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include "ws-util.h"
+#include "PerIoContext.hpp"
+#include "Async.hpp"
+#include "DNSMessage.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+/// õ첽 DNS ͻˣstub resolver
+///
+/// ֱݹ DNS  UDP ѯضʱ TCP
+/// ׽Ĺ̹߳ͬһɶ˿ڣڹ߳
+/// ֱӽߣؾϵͳ DNS ߳ת
+///
+/// ÿѯʹԼ UDP ׽֣󶨵ıض˿ڣ ID Ҳ
+/// ȡ BCryptGenRandom()һӴαӦѶȡÿά
+/// ƽ RTT Ծʱʱ䣬ʱһԡ
+///
+/// ֻѯ A ¼ֶû A ¼ʱNODATAתϵͳ
+/// ͬʱѯ AAAA ¼
+class DNSClient {
+public:
+
+    /// Ƿãʹϵͳ GetAddrInfoExW()
+    ///
+    /// ÿͻ˲ο hosts ļҲѭ NRPT ϵͳֽ
+    /// ԣĬϹرգָ DNS ʱá
+    static bool ENABLED;
+
+    /// ÿѯೢԵĴһΣ
+    static int MAX_ATTEMPTS;
+
+    /// شʱޣ룩
+    static DWORD MIN_RTO, MAX_RTO;
+
+    ///  RTT ʱشʱ룩
+    static DWORD INITIAL_RTO;
+
+    enum {
+        /// ʱʱ룩
+        ///
+        /// ̵߳ȴ֪ͨĳʱʱҲȡֵ
+        TICK_INTERVAL = 50,
+
+        /// Ĭϵ DNS ˿
+        DEFAULT_PORT = 53,
+    };
+
+    /// ȡ
+    static DNSClient &GetInstance();
+
+    /// һη
+    ///
+    /// @param addr  "8.8.8.8"  "127.0.0.1:5353"
+    bool AddServer(const char *addr);
+
+    /// ʼ񣬸ѯ׽ֶɶ˿ @a cp
+    ///
+    /// ûеù #AddServer() ʱʹϵͳõ DNS 
+    bool Start(HANDLE cp);
+
+    /// ٽµĲѯδɵĲѯ WSAECANCELLED ʧ
+    ///
+    /// ڹ߳˳֮ǰãʧܵĽɶ˿ڽ̣߳
+    /// ڵߵ߳ϽĴ̡
+    void CancelAll();
+
+    /// ر׽
+    ///
+    /// ڹ߳˳֮ãǰӦѵ #CancelAll()
+    void Stop();
+
+    /// Ƿ
+    bool IsRunning() const {
+        return m_running;
+    }
+
+    /// ǷӦɱͻ˽ @a host
+    ///
+    /// ֣ localhost hosts ļ
+    /// LLMNR ȱػƣԽϵͳּʹд hosts
+    /// ļҲֱӲѯη
+    static bool CanResolve(const char *host);
+
+    /// ύһѯ
+    ///
+    /// ͨ AsyncResolver::Complete() ֪ͨʧҲ⡣
+    void Resolve(AsyncResolver::QueryContext *context);
+
+    /// ɶ˿ڱͻ˵֪ͨ
+    ///
+    /// @param ok 첽Ƿɹ
+    void OnCompletion(PerIoContext *pic, DWORD transfered, bool ok);
+
+    /// 鳬ʱĲѯ
+    ///
+    ///  0 飨 TopologyĹ߳ÿѭã
+    /// ڲʵʼƵʡ
+    void Poll();
+
+public:
+
+    /// ηͳϢ
+    struct ServerStat {
+        std::string addr; ///< ַ
+        double srtt; ///< ƽ RTT룩
+        DWORD rto; ///< ǰشʱ룩
+        unsigned long sent; ///< ѷ͵Ĳѯ
+        unsigned long answered; ///< յӦ
+        unsigned long timeouts; ///< ʱ
+    };
+
+    /// ȡηͳϢ
+    std::vector<ServerStat> GetServerStats() const;
+
+    /// ȡǰδɵĲѯĿ
+    size_t GetPendingCount() const;
+
+private:
+
+    DNSClient();
+    ~DNSClient();
+
+    // ֹ
+    DNSClient(const DNSClient &) = delete;
+    DNSClient &operator=(const DNSClient &) = delete;
+
+private:
+
+    // η
+    struct Server {
+        sockaddr_in addr;
+
+        double srtt = 0; // ƽ RTT룩0 ʾ
+        double rttvar = 0; // RTT ƽƫ
+        DWORD rto; // شʱ
+
+        unsigned long sent = 0;
+        unsigned long answered = 0;
+        unsigned long timeouts = 0;
+
+        // һ RTT RFC 6298
+        void AddSample(double rtt);
+    };
+
+    // һѯռ׽
+    struct Channel : public PerIoContext {
+        Channel(uint16_t id, bool tcp, Action action)
+            : PerIoContext(INVALID_SOCKET, action), id(id), tcp(tcp) {}
+
+        uint16_t id; // ѯ ID
+        bool tcp; // ǷΪ TcpContext
+
+        // ѯѲҪ׽֣׽ѹرգ֪ͨ
+        bool abandoned = false;
+    };
+
+    // UDP ׽ּջ
+    struct UdpContext : public Channel {
+        UdpContext(uint16_t id) : Channel(id, false, RECV) {
+            bufSpec.buf = buf;
+            bufSpec.len = sizeof(buf);
+        }
+
+        WSABUF bufSpec;
+        char buf[DNSMessage::MAX_UDP_SIZE];
+
+        sockaddr_in from;
+        int fromLen;
+        DWORD flags;
+    };
+
+    struct TcpContext;
+
+    // һеĲѯ
+    struct Query {
+        AsyncResolver::QueryContext *context = nullptr;
+
+        std::string name;
+        u_short port = 0; // еĶ˿ں
+
+        int server = -1; // һη͵ķ
+        int attempts = 0;
+
+        ULONGLONG sentAt = 0; // һη͵ʱ
+        ULONGLONG deadline = 0; // ʱʱ
+
+        UdpContext *udp = nullptr; // ѯ UDP ׽
+        TcpContext *tcp = nullptr; //  TCP ʱ
+    };
+
+    typedef std::unordered_map<uint16_t, Query> QueryMap;
+
+    // һδʹõ ID
+    //
+    // @return ϵͳ޷ṩʱ false
+    bool NewId(uint16_t &id);
+
+    // Ϊ @a id һ󶨵˿ڵ UDP ׽ֲʼ
+    UdpContext *OpenUdp(uint16_t id);
+
+    // ѡ RTO Сķܿ @a exclude
+    int PickServer(int exclude) const;
+
+    // £Ͳѯ
+    bool Send(uint16_t id, Query &query, ULONGLONG now);
+
+    //  TCP ²ѯ
+    bool SendTcp(uint16_t id, Query &query);
+
+    // ύ UDP ղ
+    bool PostRecv(UdpContext &udp);
+
+    // һӦ
+    //
+    // ʱ #m_mutex
+    //
+    // @param from UDP ӦԴַTCP ӦΪ
+    // @param udp յ UDP Ӧ׽֣TCP ӦΪ
+    // @return ѽĲѯҪͷ֪֮ͨ
+    AsyncResolver::QueryContext *OnResponse(const char *buf, size_t len,
+                                            const sockaddr_in *from,
+                                            UdpContext *udp,
+                                            ULONGLONG now);
+
+    //  UDP ׽ϵ֪ͨ
+    //
+    // ʱ #m_mutex
+    AsyncResolver::QueryContext *OnUdpCompletion(UdpContext *udp,
+                                                 DWORD transfered,
+                                                 bool ok);
+
+    //  TCP ϵ֪ͨ
+    //
+    // ʱ #m_mutex
+    AsyncResolver::QueryContext *OnTcpCompletion(TcpContext *tcp,
+                                                 DWORD transfered,
+                                                 bool ok);
+
+    // һ׽
+    //
+    // ر׽֣δɵĲġ
+    static void Abandon(Channel *channel);
+
+    // ׽ֵ
+    static void Destroy(Channel *channel);
+
+    // ѯѽĵȴ֪ͨ
+    //
+    // ʱ #m_mutex
+    AsyncResolver::QueryContext *Finish(QueryMap::iterator it, int error,
+                                        const std::vector<uint32_t> *addrs,
+                                        unsigned long ttl);
+
+    // ֪ͨߣܳ #m_mutex
+    //
+    // NODATA Ĳѯתϵͳ
+    static void Notify(AsyncResolver::QueryContext *context, bool onWorker);
+
+    // ȡϵͳõ DNS 
+    bool AddSystemServers();
+
+    // ҵַΪ @a addr ķ
+    int FindServer(const sockaddr_in &addr) const;
+
+private:
+
+    HANDLE m_cp = nullptr;
+    std::atomic_bool m_running;
+
+    std::vector<Server> m_servers;
+
+    QueryMap m_queries;
+    mutable std::mutex m_mutex;
+
+    std::atomic<ULONGLONG> m_nextPoll;
+};
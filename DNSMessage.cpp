@@ -0,0 +1,387 @@
+#include "DNSMessage.hpp"
+
+#include <cctype>
+#include <cstring>
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+enum {
+    FLAG_QR = 0x8000, // Ӧ
+    FLAG_TC = 0x0200, // ض
+    FLAG_RD = 0x0100, // ݹ
+    FLAG_RA = 0x0080, // ֵ֧ݹ
+    RCODE_MASK = 0x000F,
+
+    MAX_POINTERS = 16, // ֹѹָ빹ɻ
+    MAX_CNAME_CHAIN = 8, // CNAME 󳤶
+};
+
+// Ӧеһ A  CNAME ¼
+struct AnswerRecord {
+    std::string owner;
+    uint16_t type;
+    uint32_t ttl;
+    uint32_t addr; // A ¼ĵַֽ
+    std::string target; // CNAME ¼ָ
+};
+
+inline uint16_t ReadU16(const unsigned char *p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+inline uint32_t ReadU32(const unsigned char *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+           ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+inline void WriteU16(std::vector<char> &out, uint16_t v) {
+    out.push_back((char) (v >> 8));
+    out.push_back((char) (v & 0xFF));
+}
+
+inline void WriteU32(std::vector<char> &out, uint32_t v) {
+    WriteU16(out, (uint16_t) (v >> 16));
+    WriteU16(out, (uint16_t) (v & 0xFFFF));
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool DNSMessage::EncodeName(const std::string &name, std::vector<char> &out) {
+    if (name.empty() || name.length() > MAX_NAME_LENGTH) {
+        return false;
+    }
+
+    size_t begin = 0;
+    while (begin < name.length()) {
+        size_t end = name.find('.', begin);
+        if (end == std::string::npos) {
+            end = name.length();
+        }
+
+        size_t labelLen = end - begin;
+        if (labelLen == 0 || labelLen > 63) {
+            return false;
+        }
+
+        out.push_back((char) labelLen);
+        for (size_t i = begin; i < end; i++) {
+            out.push_back((char) tolower((unsigned char) name[i]));
+        }
+
+        begin = end + 1;
+    }
+
+    out.push_back(0);
+    return true;
+}
+
+/*static*/
+bool DNSMessage::DecodeName(const unsigned char *buf, size_t len,
+                            size_t &pos, std::string &name) {
+    name.clear();
+
+    size_t p = pos;
+    size_t next = 0; // һѹָ֮λ
+    int pointers = 0;
+
+    while (true) {
+        if (p >= len) {
+            return false;
+        }
+
+        unsigned labelLen = buf[p];
+
+        // ѹָ
+        if ((labelLen & 0xC0) == 0xC0) {
+            if (p + 1 >= len || ++pointers > MAX_POINTERS) {
+                return false;
+            }
+
+            if (next == 0) {
+                next = p + 2;
+            }
+
+            p = ((labelLen & 0x3F) << 8) | buf[p + 1];
+            continue;
+        }
+        else if (labelLen & 0xC0) {
+            return false;
+        }
+
+        p++;
+
+        if (labelLen == 0) {
+            break;
+        }
+
+        if (p + labelLen > len) {
+            return false;
+        }
+
+        if (!name.empty()) {
+            name.push_back('.');
+        }
+
+        for (unsigned i = 0; i < labelLen; i++) {
+            name.push_back((char) tolower(buf[p + i]));
+        }
+
+        if (name.length() > MAX_NAME_LENGTH) {
+            return false;
+        }
+
+        p += labelLen;
+    }
+
+    pos = next ? next : p;
+    return true;
+}
+
+/*static*/
+bool DNSMessage::ParseHeader(const unsigned char *buf, size_t len,
+                             uint16_t &id, uint16_t &flags,
+                             uint16_t &qdcount, uint16_t &ancount,
+                             Question &question, size_t &pos) {
+    if (len < HEADER_SIZE) {
+        return false;
+    }
+
+    id = ReadU16(buf);
+    flags = ReadU16(buf + 2);
+    qdcount = ReadU16(buf + 4);
+    ancount = ReadU16(buf + 6);
+
+    pos = HEADER_SIZE;
+
+    // ֵֻ֧⣬ҲгΪ
+    if (qdcount != 1) {
+        return false;
+    }
+
+    if (!DecodeName(buf, len, pos, question.name) || pos + 4 > len) {
+        return false;
+    }
+
+    question.type = ReadU16(buf + pos);
+    question.cls = ReadU16(buf + pos + 2);
+    pos += 4;
+
+    return true;
+}
+
+/*static*/
+bool DNSMessage::BuildQuery(uint16_t id, const std::string &name,
+                            uint16_t type, std::vector<char> &out) {
+    out.clear();
+    out.reserve(HEADER_SIZE + name.length() + 2 + 4);
+
+    WriteU16(out, id);
+    WriteU16(out, FLAG_RD);
+    WriteU16(out, 1); // QDCOUNT
+    WriteU16(out, 0); // ANCOUNT
+    WriteU16(out, 0); // NSCOUNT
+    WriteU16(out, 0); // ARCOUNT
+
+    // ȥȫ޶ĩβĵ
+    std::string qname(name);
+    if (!qname.empty() && qname.back() == '.') {
+        qname.pop_back();
+    }
+
+    if (!EncodeName(qname, out)) {
+        return false;
+    }
+
+    WriteU16(out, type);
+    WriteU16(out, CLASS_IN);
+
+    return true;
+}
+
+/*static*/
+bool DNSMessage::ParseResponse(const char *data, size_t len, Response &resp) {
+    auto buf = (const unsigned char *) data;
+
+    uint16_t flags, qdcount, ancount;
+    size_t pos;
+
+    if (!ParseHeader(buf, len, resp.id, flags, qdcount, ancount,
+                     resp.question, pos)) {
+        return false;
+    }
+
+    if (!(flags & FLAG_QR)) {
+        return false;
+    }
+
+    resp.rcode = flags & RCODE_MASK;
+    resp.truncated = (flags & FLAG_TC) != 0;
+    resp.addrs.clear();
+    resp.ttl = 0;
+
+    // ضϵıĲţӦ TCP
+    if (resp.truncated) {
+        return true;
+    }
+
+    std::vector<AnswerRecord> records;
+    std::string owner;
+
+    for (unsigned i = 0; i < ancount; i++) {
+        if (!DecodeName(buf, len, pos, owner) || pos + 10 > len) {
+            return false;
+        }
+
+        uint16_t type = ReadU16(buf + pos);
+        uint16_t cls = ReadU16(buf + pos + 2);
+        uint32_t ttl = ReadU32(buf + pos + 4);
+        uint16_t rdlen = ReadU16(buf + pos + 8);
+        pos += 10;
+
+        if (pos + rdlen > len) {
+            return false;
+        }
+
+        if (cls == CLASS_IN && (type == TYPE_A || type == TYPE_CNAME)) {
+            AnswerRecord record;
+            record.owner = owner;
+            record.type = type;
+            record.addr = 0;
+
+            // TTL λΪ 1 ʱ 0 RFC 2181
+            record.ttl = (ttl & 0x80000000) ? 0 : ttl;
+
+            if (type == TYPE_A) {
+                if (rdlen == 4) {
+                    memcpy(&record.addr, buf + pos, 4);
+                    records.push_back(record);
+                }
+            }
+            else {
+                size_t p = pos;
+                if (!DecodeName(buf, len, p, record.target) ||
+                    p > pos + rdlen) {
+                    return false;
+                }
+
+                records.push_back(record);
+            }
+        }
+
+        pos += rdlen;
+    }
+
+    // еֳ CNAME ңֻϵֵ A ¼
+    // ޹صļ¼ڱѯ֮
+    bool hasTTL = false;
+    auto updateTTL = [&](uint32_t ttl) {
+        if (!hasTTL || ttl < resp.ttl) {
+            resp.ttl = ttl;
+            hasTTL = true;
+        }
+    };
+
+    std::string name(resp.question.name);
+
+    for (int hop = 0; hop <= MAX_CNAME_CHAIN; hop++) {
+        const AnswerRecord *cname = nullptr;
+
+        for (auto &record : records) {
+            if (record.owner != name) {
+                continue;
+            }
+
+            if (record.type == TYPE_A) {
+                resp.addrs.push_back(record.addr);
+                updateTTL(record.ttl);
+            }
+            else if (!cname) {
+                cname = &record;
+            }
+        }
+
+        if (!resp.addrs.empty() || !cname) {
+            break;
+        }
+
+        updateTTL(cname->ttl);
+        name = cname->target;
+    }
+
+    // Ͽʱʹϵ TTL
+    if (resp.addrs.empty()) {
+        resp.ttl = 0;
+    }
+
+    return true;
+}
+
+/*static*/
+bool DNSMessage::ParseQuery(const char *data, size_t len,
+                            uint16_t &id, Question &question) {
+    auto buf = (const unsigned char *) data;
+
+    uint16_t flags, qdcount, ancount;
+    size_t pos;
+
+    if (!ParseHeader(buf, len, id, flags, qdcount, ancount,
+                     question, pos)) {
+        return false;
+    }
+
+    return !(flags & FLAG_QR);
+}
+
+/*static*/
+void DNSMessage::BuildResponse(uint16_t id, const Question &question,
+                               int rcode,
+                               const std::vector<uint32_t> &addrs,
+                               uint32_t ttl,
+                               bool truncated,
+                               std::vector<char> &out) {
+    out.clear();
+
+    uint16_t flags = FLAG_QR | FLAG_RD | FLAG_RA | (rcode & RCODE_MASK);
+    if (truncated) {
+        flags |= FLAG_TC;
+    }
+
+    uint16_t ancount = 0;
+    if (!truncated && rcode == RCODE_NOERROR && question.type == TYPE_A) {
+        ancount = (uint16_t) addrs.size();
+    }
+
+    WriteU16(out, id);
+    WriteU16(out, flags);
+    WriteU16(out, 1);
+    WriteU16(out, ancount);
+    WriteU16(out, 0);
+    WriteU16(out, 0);
+
+    if (!EncodeName(question.name, out)) {
+        out.push_back(0);
+    }
+
+    WriteU16(out, question.type);
+    WriteU16(out, question.cls);
+
+    for (uint16_t i = 0; i < ancount; i++) {
+        // ָе
+        WriteU16(out, 0xC000 | HEADER_SIZE);
+        WriteU16(out, TYPE_A);
+        WriteU16(out, CLASS_IN);
+        WriteU32(out, ttl);
+        WriteU16(out, 4);
+
+        const char *p = (const char *) &addrs[i];
+        out.insert(out.end(), p, p + 4);
+    }
+}
+
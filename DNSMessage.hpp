@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/// DNS ĵı
+///
+/// ִֻ֧ҪӼIN  A ¼ѯӦ
+///  WinSockԹߣ DNSStubֱʹá
+class DNSMessage {
+public:
+
+    enum {
+        HEADER_SIZE = 12, ///< ͷ
+        MAX_UDP_SIZE = 512, ///< ʹ EDNS ʱ UDP ĵ󳤶
+        MAX_NAME_LENGTH = 255, ///< 󳤶
+    };
+
+    /// Դ¼
+    enum Type {
+        TYPE_A = 1,
+        TYPE_CNAME = 5,
+        TYPE_AAAA = 28,
+    };
+
+    /// Դ¼
+    enum Class {
+        CLASS_IN = 1,
+    };
+
+    /// Ӧ
+    enum RCode {
+        RCODE_NOERROR = 0,
+        RCODE_FORMERR = 1,
+        RCODE_SERVFAIL = 2,
+        RCODE_NXDOMAIN = 3,
+        RCODE_NOTIMP = 4,
+        RCODE_REFUSED = 5,
+    };
+
+    /// 
+    struct Question {
+        std::string name; ///< Сдĩβĵ
+        uint16_t type = 0;
+        uint16_t cls = 0;
+    };
+
+    /// Ӧ
+    struct Response {
+        uint16_t id = 0;
+        int rcode = RCODE_NOERROR;
+        bool truncated = false; ///< TC ־Ҫ TCP ²ѯ
+
+        Question question;
+
+        /// A ¼ַбֽ
+        std::vector<uint32_t> addrs;
+
+        /// еֵ A ¼ CNAME ϸ¼С TTL룩
+        /// ûеַʱΪ 0
+        uint32_t ttl = 0;
+    };
+
+    /// һݹѯ
+    ///
+    /// @return Ϸʱ false
+    static bool BuildQuery(uint16_t id, const std::string &name,
+                           uint16_t type, std::vector<char> &out);
+
+    /// Ӧ
+    ///
+    /// ֻռ A ¼еֳӦе CNAME ң
+    /// ֻϵ A ¼űܣ֮޹صļ¼һɺԡ
+    static bool ParseResponse(const char *buf, size_t len, Response &resp);
+
+    /// ѯģõ DNS ʹã
+    static bool ParseQuery(const char *buf, size_t len,
+                           uint16_t &id, Question &question);
+
+    /// Ӧģõ DNS ʹã
+    ///
+    /// @param truncated Ϊʱֻ TC ־Ӧ¼
+    static void BuildResponse(uint16_t id, const Question &question,
+                              int rcode,
+                              const std::vector<uint32_t> &addrs,
+                              uint32_t ttl,
+                              bool truncated,
+                              std::vector<char> &out);
+
+private:
+
+    // һ
+    static bool EncodeName(const std::string &name, std::vector<char> &out);
+
+    // һܱѹģ
+    //
+    // @param pos ΪʼλãΪ֮λ
+    static bool DecodeName(const unsigned char *buf, size_t len,
+                           size_t &pos, std::string &name);
+
+    // ͷ
+    static bool ParseHeader(const unsigned char *buf, size_t len,
+                            uint16_t &id, uint16_t &flags,
+                            uint16_t &qdcount, uint16_t &ancount,
+                            Question &question, size_t &pos);
+};
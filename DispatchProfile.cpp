@@ -0,0 +1,126 @@
+#include "DispatchProfile.hpp"
+#include "Metrics.hpp"
+#include "Clock.hpp"
+
+#include <Windows.h>
+
+#include <cstdio>
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+bool DispatchProfile::ENABLED = false;
+
+namespace {
+
+const char *OP_NAMES[] = {
+    "accept", "connect", "recv", "send", "name_resolve",
+};
+
+static_assert(sizeof(OP_NAMES) / sizeof(OP_NAMES[0]) ==
+              DispatchProfile::NUM_OPS, "OP_NAMES out of sync");
+
+#define DISPATCH_COUNTERS(op) \
+    { Metrics::Counter("myproxy_dispatch_total{op=\"" op "\"}", \
+                       "Completions dispatched by worker threads"), \
+      Metrics::Counter("myproxy_dispatch_cycles_total{op=\"" op "\"}", \
+                       "CPU cycles spent handling completions"), \
+      Metrics::Counter("myproxy_dispatch_nanoseconds_total{op=\"" op "\"}", \
+                       "Wall time spent handling completions") }
+
+// һֲļ
+struct OpCounters {
+    Metrics::Counter count;
+    Metrics::Counter cycles;
+    Metrics::Counter nanoseconds;
+};
+
+OpCounters gs_counters[] = {
+    DISPATCH_COUNTERS("accept"),
+    DISPATCH_COUNTERS("connect"),
+    DISPATCH_COUNTERS("recv"),
+    DISPATCH_COUNTERS("send"),
+    DISPATCH_COUNTERS("name_resolve"),
+};
+
+#undef DISPATCH_COUNTERS
+
+static_assert(sizeof(gs_counters) / sizeof(gs_counters[0]) ==
+              DispatchProfile::NUM_OPS, "gs_counters out of sync");
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+DispatchProfile::Op DispatchProfile::OpOf(PerIoContext::Action action) {
+    switch (action) {
+    case PerIoContext::ACCEPT:
+        return OP_ACCEPT;
+
+    case PerIoContext::CONNECT:
+        return OP_CONNECT;
+
+    case PerIoContext::RECV:
+        return OP_RECV;
+
+    case PerIoContext::SEND:
+        return OP_SEND;
+
+    default:
+        return NUM_OPS;
+    }
+}
+
+/*static*/
+void DispatchProfile::Sample(uint64_t &cycles, int64_t &ts) {
+    ULONG64 c = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &c);
+
+    cycles = c;
+    ts = Clock::Now();
+}
+
+/*static*/
+void DispatchProfile::Record(Op op, uint64_t cycles, int64_t ts) {
+    uint64_t cyclesNow;
+    int64_t now;
+    Sample(cyclesNow, now);
+
+    OpCounters &counters = gs_counters[op];
+    counters.count.Inc();
+    counters.cycles.Add(cyclesNow - cycles);
+    counters.nanoseconds.Add((uint64_t) Clock::ToNanoseconds(now - ts));
+}
+
+/*static*/
+void DispatchProfile::Render(std::string &out) {
+    if (!ENABLED) {
+        out += "# disabled, set DispatchProfile::ENABLED to collect\n";
+    }
+
+    uint64_t totalCycles = 0;
+    for (auto &counters : gs_counters) {
+        totalCycles += counters.cycles.GetValue();
+    }
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%-14s %12s %14s %12s %10s\n", "op",
+             "count", "cycles/op", "us/op", "cycles%");
+    out += buf;
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        uint64_t count = gs_counters[op].count.GetValue();
+        uint64_t cycles = gs_counters[op].cycles.GetValue();
+        uint64_t ns = gs_counters[op].nanoseconds.GetValue();
+
+        double n = count > 0 ? (double) count : 1;
+
+        snprintf(buf, sizeof(buf), "%-14s %12llu %14.0f %12.2f %9.1f%%\n",
+                 OP_NAMES[op], (unsigned long long) count, cycles / n,
+                 ns / n / 1000,
+                 totalCycles > 0 ? cycles * 100.0 / totalCycles : 0.0);
+        out += buf;
+    }
+}
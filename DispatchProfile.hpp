@@ -0,0 +1,73 @@
+#pragma once
+#include "PerIoContext.hpp"
+
+#include <string>
+#include <cstdint>
+
+/// ֪ͨͳƹ̵߳ CPU 
+///
+/// ÿηַ֪ͨʱȡ̵߳ CPU QueryThreadCycleTime()
+/// 뵥ʱӣѲֵڶӦĲϡֻƱ߳ʵ
+/// CPU еĲ֣ǽʱȿԿǷռ
+/// ϡ
+///
+/// ֵд밴̷߳Ƭ Metrics  /metrics 
+/// ҳ /cpu Ϊÿβδʱÿηַֻһ
+/// жϡ
+class DispatchProfile {
+public:
+
+    /// Ƿ
+    static bool ENABLED;
+
+    /// 
+    enum Op {
+        OP_ACCEPT,
+        OP_CONNECT,
+        OP_RECV,
+        OP_SEND,
+        OP_NAME_RESOLVE, ///< SCK_NAME_RESOLVE
+
+        NUM_OPS
+    };
+
+    /// ֪ͨ @a action ӦĲͣ޶Ӧʱ #NUM_OPS
+    static Op OpOf(PerIoContext::Action action);
+
+    /// ͳһηַ
+    class Scope {
+    public:
+
+        explicit Scope(Op op) : m_op(op) {
+            if (ENABLED && op != NUM_OPS) {
+                Sample(m_cycles, m_ts);
+            }
+        }
+
+        ~Scope() {
+            if (m_ts != 0) {
+                Record(m_op, m_cycles, m_ts);
+            }
+        }
+
+    private:
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        Op m_op;
+        uint64_t m_cycles = 0;
+        int64_t m_ts = 0;
+    };
+
+    /// ıĴÿεʱ
+    static void Render(std::string &out);
+
+private:
+
+    // ȡ̵߳ CPU 뵱ǰʱ
+    static void Sample(uint64_t &cycles, int64_t &ts);
+
+    // ¼ Sample() һβ
+    static void Record(Op op, uint64_t cycles, int64_t ts);
+};
@@ -1,7 +1,16 @@
-
 #include "Logger.hpp"
+#include "RingBuffer.hpp"
+#include "Clock.hpp"
+
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
 #include <sstream>
+#include <streambuf>
+#include <algorithm>
+#include <ctime>
 
 #include <Windows.h>
 
@@ -11,19 +20,395 @@
 
 bool Logger::CONSOLE = false;
 Logger::OutputLevel Logger::LEVEL = Logger::OL_ERROR;
+size_t Logger::BUFFER_SIZE = 256 * 1024;
+unsigned long Logger::FLUSH_INTERVAL = 10;
+
+namespace {
+
+// λÿ¼ͷ־
+struct RecordHeader {
+    int64_t ts; // Clock::Now()
+    DWORD tid;
+    Logger::OutputLevel level;
+};
+
+// һ̵߳־
+struct ThreadBuffer {
+    ThreadBuffer(size_t capacity)
+        : ring(capacity), tid(GetCurrentThreadId()) {}
+
+    RingBuffer ring;
+    DWORD tid;
+
+    std::atomic<unsigned long long> dropped{0};
+
+    // ߳˳ſպ󼴿
+    std::atomic_bool orphaned{false};
+};
+
+// һ־
+struct Record {
+    int64_t ts;
+    DWORD tid;
+    Logger::OutputLevel level;
+    std::string text;
+
+    bool operator<(const Record &other) const {
+        return ts < other.ts;
+    }
+};
+
+// һ־ʽ׷ӵ @a out
+void Format(const Record &record, std::string &out) {
+    int64_t us = Clock::ToUnixMicroseconds(record.ts);
+    time_t secs = (time_t) (us / 1000000);
+
+    tm local;
+    localtime_s(&local, &secs);
+
+    char head[64];
+    int len = sprintf_s(head, sizeof(head),
+                        "[%lu] %02d:%02d:%02d.%06d ",
+                        (unsigned long) record.tid,
+                        local.tm_hour, local.tm_min, local.tm_sec,
+                        (int) (us % 1000000));
+
+    out.append(head, len);
+    out.append("------------------------\n");
+    out.append(record.text);
+    out.append("\n\n");
+}
+
+// һѸʽ־
+//
+// ̨ģʽмдͬһֿдźõʱ˳
+void Output(const std::string &text) {
+    if (text.empty()) {
+        return;
+    }
+
+    if (Logger::CONSOLE) {
+        fwrite(text.data(), 1, text.size(), stderr);
+        fflush(stderr);
+    }
+    else {
+        OutputDebugStringA(text.c_str());
+    }
+}
+
+// ̨߳
+class Writer {
+public:
+
+    static Writer &GetInstance() {
+        static Writer s_writer;
+        return s_writer;
+    }
+
+    bool IsRunning() const {
+        return m_running;
+    }
+
+    // Ϊǰ̷߳仺
+    ThreadBuffer *Register() {
+        ThreadBuffer *buf = new ThreadBuffer(Logger::BUFFER_SIZE);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.push_back(buf);
+
+        return buf;
+    }
+
+    void Wake() {
+        SetEvent(m_wake);
+    }
+
+    void Flush() {
+        if (!m_running) {
+            return;
+        }
+
+        unsigned long req = ++m_flushRequested;
+        Wake();
+
+        while (m_running && m_flushed < req) {
+            Sleep(1);
+        }
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(m_stopMutex);
+
+        if (m_thread.joinable()) {
+            m_stopping = true;
+            Wake();
+
+            m_thread.join();
+        }
+    }
+
+    unsigned long long GetDroppedCount() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        unsigned long long total = m_droppedExited;
+        for (auto buf : m_buffers) {
+            total += buf->dropped;
+        }
+
+        return total;
+    }
+
+    // ֱ̨߳̽
+    void WriteDirectly(const Record &record) {
+        std::string text;
+        Format(record, text);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Output(text);
+    }
+
+    // ̨߳̽߷Լļ¼δȡʱ
+    void DrainLate() {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        Drain();
+    }
+
+private:
+
+    Writer() {
+        m_wake = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        m_running = true;
+        m_thread = std::thread(&Writer::Run, this);
+    }
+
+    ~Writer() {
+        Stop();
+        CloseHandle(m_wake);
+
+        for (auto buf : m_buffers) {
+            delete buf;
+        }
+    }
+
+    void Run() {
+        while (!m_stopping) {
+            WaitForSingleObject(m_wake, Logger::FLUSH_INTERVAL);
+
+            unsigned long req = m_flushRequested;
+            {
+                std::lock_guard<std::mutex> lock(m_drainMutex);
+                Drain();
+            }
+            m_flushed = req;
+        }
+
+        // ˺־Ϊֱ
+        //
+        //  Logger::Write() еդԣҪô m_running Ϊ
+        // false ſգҪôļ¼ Drain() бȡߡ
+        m_running = false;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        Drain();
+    }
+
+    // ȡле־ʱ
+    //
+    //  #m_drainMutex
+    void Drain() {
+        std::vector<ThreadBuffer *> buffers;
+
+        m_mutex.lock();
+        buffers = m_buffers;
+        m_mutex.unlock();
+
+        for (auto buf : buffers) {
+            // ȶ־֮ſջȷ¼¼
+            bool orphaned = buf->orphaned;
+
+            while (buf->ring.Read(m_scratch)) {
+                RecordHeader header;
+                memcpy(&header, m_scratch.data(), sizeof(header));
+
+                Record record;
+                record.ts = header.ts;
+                record.tid = header.tid;
+                record.level = header.level;
+
+                const char *text = m_scratch.data() + sizeof(header);
+                record.text.assign(text, m_scratch.size() - sizeof(header));
+
+                m_records.push_back(std::move(record));
+            }
+
+            if (orphaned) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_droppedExited += buf->dropped;
+                m_buffers.erase(std::find(m_buffers.begin(),
+                                          m_buffers.end(), buf));
+                delete buf;
+            }
+        }
 
-static std::mutex gs_loggerMutex;
-const static char *gs_format = "[%d]------------------------\n%s\n\n";
+        // ͬһԲ̵ͬ߳ļ¼ʱȺ
+        std::stable_sort(m_records.begin(), m_records.end());
 
-std::string Format(const char *msg) {
-    static std::ostringstream ss;
-    ss.str(std::string());
+        std::string batch;
+        for (auto &record : m_records) {
+            if (Logger::CONSOLE) {
+                Format(record, batch);
+            }
+            // OutputDebugString() ضϹַ
+            else {
+                std::string text;
+                Format(record, text);
+                Output(text);
+            }
+        }
 
-    ss << '[' << GetCurrentThreadId() << ']'
-       << "------------------------\n"
-       << msg << "\n\n";
+        Output(batch);
 
-    return ss.str();
+        m_records.clear();
+
+        unsigned long long dropped = GetDroppedCount();
+        if (dropped > m_droppedReported) {
+            std::ostringstream oss;
+            oss << "Logger: " << dropped - m_droppedReported
+                << " record(s) dropped (buffer full)\n\n";
+
+            Output(oss.str());
+            m_droppedReported = dropped;
+        }
+    }
+
+private:
+
+    std::mutex m_mutex; //  #m_buffers
+    std::vector<ThreadBuffer *> m_buffers;
+    unsigned long long m_droppedExited = 0; // ٵĻļ¼
+
+    std::mutex m_drainMutex; // ֤ͬһʱֻһ
+    std::mutex m_stopMutex;
+    std::thread m_thread;
+    HANDLE m_wake;
+    std::atomic_bool m_running{false};
+    std::atomic_bool m_stopping{false};
+
+    std::atomic_ulong m_flushRequested{0};
+    std::atomic_ulong m_flushed{0};
+
+    // ֻڳ #m_drainMutex ʱ
+    std::vector<char> m_scratch;
+    std::vector<Record> m_records;
+    unsigned long long m_droppedReported = 0;
+};
+
+// ־ʹõĶдݱ
+class FixedStreamBuf : public std::streambuf {
+public:
+
+    FixedStreamBuf() {
+        Reset();
+    }
+
+    void Reset() {
+        setp(m_buf, m_buf + sizeof(m_buf));
+    }
+
+    const char *Data() const {
+        return pbase();
+    }
+
+    size_t Size() const {
+        return pptr() - pbase();
+    }
+
+protected:
+
+    virtual int_type overflow(int_type) override {
+        return traits_type::eof();
+    }
+
+private:
+
+    char m_buf[Logger::MAX_MESSAGE_LENGTH];
+};
+
+struct LazyStream {
+    LazyStream() : os(&buf) {}
+
+    FixedStreamBuf buf;
+    std::ostream os;
+};
+
+thread_local LazyStream tls_stream;
+
+// ߳˳ʱѻ̨̻߳
+struct BufferHolder {
+    ThreadBuffer *buf = nullptr;
+
+    ~BufferHolder();
+};
+
+thread_local BufferHolder tls_holder;
+
+// ̵߳ tls_holder ˺־ֱ
+//
+// ƽ͵ thread_local ̵߳ڶЧ
+thread_local bool tls_exiting = false;
+
+BufferHolder::~BufferHolder() {
+    tls_exiting = true;
+
+    if (buf) {
+        buf->orphaned = true;
+        buf = nullptr; // ʱ̨ܱ߳
+    }
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+void Logger::Write(const char *msg, size_t len, OutputLevel level) {
+    Writer &writer = Writer::GetInstance();
+
+    if (len > MAX_MESSAGE_LENGTH) {
+        len = MAX_MESSAGE_LENGTH;
+    }
+
+    if (!writer.IsRunning() || tls_exiting) {
+        Record record{ Clock::Now(), GetCurrentThreadId(), level,
+                       std::string(msg, len) };
+        writer.WriteDirectly(record);
+
+        return;
+    }
+
+    ThreadBuffer *buf = tls_holder.buf;
+    if (!buf) {
+        buf = tls_holder.buf = writer.Register();
+    }
+
+    RecordHeader header{ Clock::Now(), buf->tid, level };
+
+    if (!buf->ring.TryWrite(&header, sizeof(header), msg, len)) {
+        buf->dropped.store(buf->dropped.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    }
+
+    // ̨߳ǡдǰʱһſտûȡ¼
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!writer.IsRunning()) {
+        writer.DrainLate();
+        return;
+    }
+
+    if (level == OL_ERROR) {
+        writer.Wake();
+    }
 }
 
 void Logger::Log(const char *msg, OutputLevel level) {
@@ -40,35 +425,54 @@ void Logger::LogInfo(const char *msg) {
         return;
     }
 
-    gs_loggerMutex.lock();
-    
-    if (CONSOLE) {
-        printf(gs_format, GetCurrentThreadId(), msg);
-    }
-    else {
-        OutputDebugStringA(Format(msg).c_str());
-    }
-
-    gs_loggerMutex.unlock();
+    Write(msg, strlen(msg), OL_INFO);
 }
 
 void Logger::LogError(const char *msg) {
-    gs_loggerMutex.lock();
+    Write(msg, strlen(msg), OL_ERROR);
+}
 
-    if (CONSOLE) {
-        fprintf(stderr, gs_format, GetCurrentThreadId(), msg);
-    }
-    else {
-        OutputDebugStringA(Format(msg).c_str());
+void Logger::LogWindowsLastError(const char *msg) {
+    DWORD ec = GetLastError();
+
+    char *text = nullptr;
+    FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER |
+                   FORMAT_MESSAGE_FROM_SYSTEM |
+                   FORMAT_MESSAGE_IGNORE_INSERTS,
+                   nullptr, ec, 0, (LPSTR) &text, 0, nullptr);
+
+    std::ostringstream oss;
+    oss << msg << ": " << (text ? text : "unknown error")
+        << " (" << ec << ")";
+
+    if (text) {
+        LocalFree(text);
     }
 
-    gs_loggerMutex.unlock();
+    LogError(oss.str());
 }
 
-void Logger::LogWindowsLastError(const char *msg) {
-    gs_loggerMutex.lock();
-    
+/*static*/
+std::ostream &Logger::AcquireStream() {
+    tls_stream.buf.Reset();
+    tls_stream.os.clear();
 
+    return tls_stream.os;
+}
+
+/*static*/
+void Logger::CommitStream(OutputLevel level) {
+    Write(tls_stream.buf.Data(), tls_stream.buf.Size(), level);
+}
+
+void Logger::Flush() {
+    Writer::GetInstance().Flush();
+}
+
+void Logger::Stop() {
+    Writer::GetInstance().Stop();
+}
 
-    gs_loggerMutex.unlock();
+unsigned long long Logger::GetDroppedCount() {
+    return Writer::GetInstance().GetDroppedCount();
 }
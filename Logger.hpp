@@ -1,12 +1,38 @@
-
 #pragma once
 #include <string>
+#include <ostream>
+
+/// ڵ־Logger::OutputLevel ֵ
+///
+/// ڴ˼ #LOG_INFO ȶ־ֵͬһ𱻱
+/// 綨Ϊ 1 ȥͨϢ
+#ifndef LOGGER_COMPILED_LEVEL
+#define LOGGER_COMPILED_LEVEL 0
+#endif
+
+/// ͨϢ
+///
+/// ΪһʽֻиüʱŻֵʽ
+///
+///     LOG_INFO("Accepted connection from " << addr << ':' << port);
+#define LOG_INFO(args) \
+    Logger::LogLazy<Logger::OL_INFO>([&](std::ostream &os_) { os_ << args; })
+
+/// Ϣ
+#define LOG_ERROR(args) \
+    Logger::LogLazy<Logger::OL_ERROR>([&](std::ostream &os_) { os_ << args; })
 
 /// ־
+///
+/// ÿ̰߳־¼дԼλɺ̨߳ͳһ
+/// ʽ߼ȲȫҲȴ̨
+/// ʱ¼̡߳
 class Logger {
 public:
 
-    /// Ƿ̨ʹ OutputDebugString WinAPI
+    /// Ƿ̨stderrʹ OutputDebugString WinAPI
+    ///
+    /// ־дͬһʱ˳
     static bool CONSOLE;
 
     enum OutputLevel {
@@ -16,8 +42,23 @@ public:
 
     static OutputLevel LEVEL;
 
+    /// ÿ̵߳ĻλСֽڣ
+    ///
+    /// ֻӰ˺״־̡߳
+    static size_t BUFFER_SIZE;
+
+    /// ̨߳־ʱ룩
+    ///
+    /// ϢѺ̨̡߳
+    static unsigned long FLUSH_INTERVAL;
+
+    enum {
+        /// ־󳤶ȣֱض
+        MAX_MESSAGE_LENGTH = 4096,
+    };
+
     /// ־
-    /// 
+    ///
     /// ɲ @a level ṩ
     static void Log(const char *msg, OutputLevel level);
     static void Log(const std::string &msg, OutputLevel level) {
@@ -38,4 +79,62 @@ public:
 
     ///  Windows LogLastError() Ϣ
     static void LogWindowsLastError(const char *msg);
+
+    ///  @a level ־ǰǷᱻ
+    static bool IsEnabled(OutputLevel level) {
+        return level >= LOGGER_COMPILED_LEVEL && level >= LEVEL;
+    }
+
+    /// ־
+    ///
+    /// ֻм @a L ڱʱʱŵ @a fmt 
+    ///  std::ostream дϢڱʱΪա
+    /// Ϣд뱾̸߳õĶڴ档
+    template <OutputLevel L, typename Fmt>
+    static void LogLazy(Fmt &&fmt) {
+        Lazy<L, (L >= LOGGER_COMPILED_LEVEL)>::Log(fmt);
+    }
+
+    /// ȴǰύ־ȫ
+    static void Flush();
+
+    /// ʣ־̨߳
+    ///
+    /// ˺־ֱͬ˳ǰӦá
+    static void Stop();
+
+    /// ȡ򻺳־Ŀ
+    static unsigned long long GetDroppedCount();
+
+private:
+
+    // һ־д뵱ǰ̵߳Ļ
+    static void Write(const char *msg, size_t len, OutputLevel level);
+
+    // ȡ߳յĸʽ
+    //
+    // ʽڲ־
+    static std::ostream &AcquireStream();
+
+    // ʽе
+    static void CommitStream(OutputLevel level);
+
+    // ڱõļ
+    template <OutputLevel L, bool Compiled>
+    struct Lazy {
+        template <typename Fmt>
+        static void Log(Fmt &fmt) {
+            if (L >= LEVEL) {
+                fmt(AcquireStream());
+                CommitStream(L);
+            }
+        }
+    };
+
+    // ڱõļ
+    template <OutputLevel L>
+    struct Lazy<L, false> {
+        template <typename Fmt>
+        static void Log(Fmt &) {}
+    };
 };
@@ -88,6 +88,37 @@ public:
         Init();
     }
 
+    /// ʹ
+    struct Usage {
+        size_type capacity; ///< ѷռĽ̬ + ̬
+        size_type used; ///< ʹõĽĿ
+        size_type staticUsed; ///< Ѷùľ̬Ŀ
+        size_type numChunks; ///< ̬ڴĿ
+        size_type numFree; ///< беĽĿвõģ
+    };
+
+    /// ȡʹ
+    Usage GetUsage() {
+        Usage usage;
+        m_sync.lock();
+
+        // ÿڴεĵһͷ
+        size_type dynamicLeft = m_end - m_nextAvailable;
+        size_type handedOut = m_numStaticUsed +
+                              m_numChunks * Node::DYNAMIC_POOL_SIZE -
+                              dynamicLeft;
+
+        usage.capacity = Node::STATIC_POOL_SIZE +
+                         m_numChunks * Node::DYNAMIC_POOL_SIZE;
+        usage.numFree = m_free.size();
+        usage.used = handedOut - usage.numFree;
+        usage.staticUsed = m_numStaticUsed;
+        usage.numChunks = m_numChunks;
+
+        m_sync.unlock();
+        return usage;
+    }
+
 #ifdef _DEBUG
     /// ȡѷĽĿ
     ///
@@ -102,6 +133,7 @@ private:
     // ʼΪӾ̬ռз
     void Init() {
         m_numStaticUsed = 0;
+        m_numChunks = 0;
 
         m_header = (BlockHeader *) m_static;
         m_nextAvailable = nullptr;
@@ -132,6 +164,7 @@ private:
 
         m_nextAvailable = raw + 1;
         m_end = raw + Node::DYNAMIC_POOL_SIZE + 1;
+        m_numChunks++;
 
 #ifdef _DEBUG
         m_totalAllocated += Node::DYNAMIC_POOL_SIZE + 1;
@@ -151,6 +184,9 @@ private:
     // ѷľ̬ԪĿ
     size_type m_numStaticUsed;
 
+    // ̬ڴĿ
+    size_type m_numChunks;
+
     // Start of raw memory making up current pool
     BlockHeader *m_header;
     // First free byte in current pool
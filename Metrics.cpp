@@ -0,0 +1,467 @@
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include "ws-util.h"
+
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// עָ֮Ĵ洢Ԫעʧָܵд룬ᱻ
+const unsigned SCRATCH_CELLS = Metrics::Histogram::NUM_BUCKETS + 1;
+
+// һ̵߳ķƬ
+//
+// ǰһУ̵֤߳ݹûС
+struct Shard {
+    Shard() {
+        for (auto &cell : cells) {
+            cell.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    char paddingBefore[64];
+    std::atomic<uint64_t> cells[Metrics::MAX_CELLS + SCRATCH_CELLS];
+    char paddingAfter[64];
+};
+
+// ָ
+struct Descriptor {
+    std::string name; // ǩ
+    std::string family; // ǩ
+    std::string help;
+    Metrics::Type type;
+
+    unsigned cell;
+    double scale;
+
+    std::function<double()> callback; // ʱֵ
+};
+
+class Registry {
+public:
+
+    static Registry &GetInstance() {
+        static Registry s_registry;
+        return s_registry;
+    }
+
+    unsigned Register(const char *name, const char *help,
+                      Metrics::Type type, unsigned numCells, double scale) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_nextCell + numCells > Metrics::MAX_CELLS) {
+            std::string msg(__FUNC__ "Too many metrics, dropped ");
+            Logger::LogError(msg + name);
+
+            return Metrics::MAX_CELLS;
+        }
+
+        Descriptor desc;
+        desc.name = name;
+        desc.family = desc.name.substr(0, desc.name.find('{'));
+        desc.help = help;
+        desc.type = type;
+        desc.cell = m_nextCell;
+        desc.scale = scale;
+
+        m_descs.push_back(std::move(desc));
+        m_nextCell += numCells;
+
+        return m_descs.back().cell;
+    }
+
+    void RegisterCallback(const char *name, const char *help,
+                          std::function<double()> fn) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Descriptor desc;
+        desc.name = name;
+        desc.family = desc.name.substr(0, desc.name.find('{'));
+        desc.help = help;
+        desc.type = Metrics::GAUGE;
+        desc.cell = Metrics::MAX_CELLS;
+        desc.scale = 1;
+        desc.callback = std::move(fn);
+
+        m_descs.push_back(std::move(desc));
+    }
+
+    Shard *Attach() {
+        Shard *shard = new Shard;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shards.push_back(shard);
+
+        return shard;
+    }
+
+    // ߳˳ֵ #m_retired Ƭ
+    void Detach(Shard *shard) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (unsigned i = 0; i < m_nextCell; i++) {
+            auto &cell = m_retired.cells[i];
+            cell.store(cell.load(std::memory_order_relaxed) +
+                       shard->cells[i].load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+        }
+
+        for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+            if (*it == shard) {
+                m_shards.erase(it);
+                break;
+            }
+        }
+
+        delete shard;
+    }
+
+    // ߳˳Ҫָʱʹãֵ
+    Shard *GetSink() {
+        return &m_sink;
+    }
+
+    // 洢Ԫ [@a first, @a first + @a count) зƬеܺ
+    void Sum(unsigned first, unsigned count, uint64_t *out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        DoSum(first, count, out);
+    }
+
+    void Export(std::string &out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<uint64_t> totals(m_nextCell);
+        if (m_nextCell > 0) {
+            DoSum(0, m_nextCell, totals.data());
+        }
+
+        // ָͬ
+        std::vector<bool> done(m_descs.size());
+        for (size_t i = 0; i < m_descs.size(); i++) {
+            if (done[i]) {
+                continue;
+            }
+
+            const Descriptor &head = m_descs[i];
+            WriteHeader(out, head);
+
+            for (size_t j = i; j < m_descs.size(); j++) {
+                if (!done[j] && m_descs[j].family == head.family) {
+                    WriteValue(out, m_descs[j], totals);
+                    done[j] = true;
+                }
+            }
+        }
+    }
+
+    void ExportPercentiles(std::string &out) {
+        typedef Metrics::Histogram Histogram;
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        out += "# name count mean p50 p90 p99 p99.9 max\n";
+
+        Histogram::Snapshot snapshot;
+        snapshot.buckets.resize(Histogram::NUM_BUCKETS);
+
+        for (auto &desc : m_descs) {
+            if (desc.type != Metrics::HISTOGRAM || desc.callback) {
+                continue;
+            }
+
+            uint64_t cells[Histogram::NUM_BUCKETS + 1];
+            DoSum(desc.cell, Histogram::NUM_BUCKETS + 1, cells);
+            snapshot.count = 0;
+
+            for (unsigned i = 0; i < Histogram::NUM_BUCKETS; i++) {
+                snapshot.buckets[i] = cells[i];
+                snapshot.count += cells[i];
+            }
+
+            snapshot.sum = cells[Histogram::NUM_BUCKETS];
+
+            char buf[256];
+            snprintf(buf, sizeof(buf),
+                     " %llu %.6g %.6g %.6g %.6g %.6g %.6g\n",
+                     (unsigned long long) snapshot.count,
+                     snapshot.Mean() * desc.scale,
+                     snapshot.ValueAt(0.5) * desc.scale,
+                     snapshot.ValueAt(0.9) * desc.scale,
+                     snapshot.ValueAt(0.99) * desc.scale,
+                     snapshot.ValueAt(0.999) * desc.scale,
+                     snapshot.Max() * desc.scale);
+
+            out += desc.name;
+            out += buf;
+        }
+    }
+
+private:
+
+    Registry() {}
+
+    // ʱ #m_mutex
+    void DoSum(unsigned first, unsigned count, uint64_t *out) {
+        for (unsigned i = 0; i < count; i++) {
+            out[i] = m_retired.cells[first + i].load
+                (std::memory_order_relaxed);
+        }
+
+        for (auto shard : m_shards) {
+            for (unsigned i = 0; i < count; i++) {
+                out[i] += shard->cells[first + i].load
+                    (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void WriteHeader(std::string &out, const Descriptor &desc) {
+        static const char *s_types[] = { "counter", "gauge", "histogram" };
+
+        out += "# HELP ";
+        out += desc.family;
+        out += ' ';
+        out += desc.help;
+        out += "\n# TYPE ";
+        out += desc.family;
+        out += ' ';
+        out += s_types[desc.type];
+        out += '\n';
+    }
+
+    static void WriteValue(std::string &out, const Descriptor &desc,
+                           const std::vector<uint64_t> &totals) {
+        char buf[64];
+
+        if (desc.callback) {
+            snprintf(buf, sizeof(buf), " %.17g\n", desc.callback());
+        }
+        else if (desc.type == Metrics::COUNTER) {
+            snprintf(buf, sizeof(buf), " %llu\n",
+                     (unsigned long long) totals[desc.cell]);
+        }
+        else if (desc.type == Metrics::GAUGE) {
+            snprintf(buf, sizeof(buf), " %lld\n",
+                     (long long) totals[desc.cell]);
+        }
+        else {
+            WriteHistogram(out, desc, totals);
+            return;
+        }
+
+        out += desc.name;
+        out += buf;
+    }
+
+    // ֻÿ 2 ı߽ۼͰ
+    static void WriteHistogram(std::string &out, const Descriptor &desc,
+                               const std::vector<uint64_t> &totals) {
+        typedef Metrics::Histogram Histogram;
+
+        const uint64_t *buckets = totals.data() + desc.cell;
+        uint64_t count = 0;
+
+        for (unsigned i = 0; i < Histogram::NUM_BUCKETS; i++) {
+            count += buckets[i];
+        }
+
+        char buf[128];
+        uint64_t cumulative = 0;
+
+        for (unsigned i = 0; i < Histogram::NUM_BUCKETS; i++) {
+            cumulative += buckets[i];
+
+            uint64_t upper = Histogram::UpperBoundOf(i);
+            if ((upper & (upper + 1)) != 0) {
+                continue; //  2 ݼһ
+            }
+
+            snprintf(buf, sizeof(buf), "_bucket{le=\"%.9g\"} %llu\n",
+                     upper * desc.scale, (unsigned long long) cumulative);
+
+            out += desc.name;
+            out += buf;
+
+            if (cumulative == count) {
+                break;
+            }
+        }
+
+        snprintf(buf, sizeof(buf), "_bucket{le=\"+Inf\"} %llu\n",
+                 (unsigned long long) count);
+        out += desc.name;
+        out += buf;
+
+        snprintf(buf, sizeof(buf), "_sum %.9g\n",
+                 buckets[Histogram::NUM_BUCKETS] * desc.scale);
+        out += desc.name;
+        out += buf;
+
+        snprintf(buf, sizeof(buf), "_count %llu\n",
+                 (unsigned long long) count);
+        out += desc.name;
+        out += buf;
+    }
+
+private:
+
+    std::mutex m_mutex;
+    std::vector<Descriptor> m_descs;
+    unsigned m_nextCell = 0;
+
+    std::vector<Shard *> m_shards;
+    Shard m_retired; // ˳̵ֵ߳
+    Shard m_sink;
+};
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+struct Metrics::ShardHolder {
+    Shard *shard = nullptr;
+
+    ~ShardHolder() {
+        if (shard) {
+            Registry::GetInstance().Detach(shard);
+            ms_cells = Registry::GetInstance().GetSink()->cells;
+        }
+    }
+};
+
+thread_local Metrics::Cell *Metrics::ms_cells = nullptr;
+
+/*static*/
+Metrics::Cell *Metrics::Attach() {
+    static thread_local ShardHolder s_holder;
+
+    Shard *shard = Registry::GetInstance().Attach();
+    s_holder.shard = shard;
+
+    return ms_cells = shard->cells;
+}
+
+/*static*/
+unsigned Metrics::Register(const char *name, const char *help,
+                           Type type, unsigned numCells, double scale) {
+    return Registry::GetInstance().Register(name, help, type,
+                                            numCells, scale);
+}
+
+/*static*/
+uint64_t Metrics::Sum(unsigned cell) {
+    if (cell >= MAX_CELLS) {
+        return 0;
+    }
+
+    uint64_t total;
+    Registry::GetInstance().Sum(cell, 1, &total);
+
+    return total;
+}
+
+/*static*/
+void Metrics::RegisterCallback(const char *name, const char *help,
+                               std::function<double()> fn) {
+    Registry::GetInstance().RegisterCallback(name, help, std::move(fn));
+}
+
+/*static*/
+void Metrics::ExportPrometheus(std::string &out) {
+    Registry::GetInstance().Export(out);
+}
+
+/*static*/
+void Metrics::ExportPercentiles(std::string &out) {
+    Registry::GetInstance().ExportPercentiles(out);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+Metrics::Counter::Counter(const char *name, const char *help) {
+    m_cell = Register(name, help, COUNTER, 1, 1);
+}
+
+uint64_t Metrics::Counter::GetValue() const {
+    return Sum(m_cell);
+}
+
+Metrics::Gauge::Gauge(const char *name, const char *help) {
+    m_cell = Register(name, help, GAUGE, 1, 1);
+}
+
+int64_t Metrics::Gauge::GetValue() const {
+    return (int64_t) Sum(m_cell);
+}
+
+Metrics::Histogram::Histogram(const char *name, const char *help,
+                              double scale) {
+    m_cell = Register(name, help, HISTOGRAM, NUM_BUCKETS + 1, scale);
+}
+
+/*static*/
+uint64_t Metrics::Histogram::UpperBoundOf(unsigned bucket) {
+    if (bucket < LINEAR_BUCKETS) {
+        return bucket;
+    }
+
+    unsigned octave = (bucket - LINEAR_BUCKETS) >> SUB_BITS;
+    unsigned sub = (bucket - LINEAR_BUCKETS) & ((1 << SUB_BITS) - 1);
+
+    // λΪ (octave + 4) λ
+    int shift = (int) octave + 4 - SUB_BITS;
+    uint64_t lower = (uint64_t) ((1 << SUB_BITS) + sub) << shift;
+
+    return lower + (((uint64_t) 1 << shift) - 1);
+}
+
+Metrics::Histogram::Snapshot Metrics::Histogram::GetSnapshot() const {
+    Snapshot snapshot;
+    snapshot.buckets.resize(NUM_BUCKETS);
+
+    if (m_cell >= MAX_CELLS) {
+        return snapshot;
+    }
+
+    std::vector<uint64_t> cells(NUM_BUCKETS + 1);
+    Registry::GetInstance().Sum(m_cell, NUM_BUCKETS + 1, cells.data());
+
+    for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+        snapshot.buckets[i] = cells[i];
+        snapshot.count += cells[i];
+    }
+
+    snapshot.sum = cells[NUM_BUCKETS];
+    return snapshot;
+}
+
+uint64_t Metrics::Histogram::Snapshot::ValueAt(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    //  rank  1 ʼڵͰ
+    uint64_t rank = (uint64_t) (quantile * count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    else if (rank > count) {
+        rank = count;
+    }
+
+    uint64_t cumulative = 0;
+    for (unsigned i = 0; i < buckets.size(); i++) {
+        cumulative += buckets[i];
+
+        if (cumulative >= rank) {
+            return UpperBoundOf(i);
+        }
+    }
+
+    return UpperBoundOf(NUM_BUCKETS - 1);
+}
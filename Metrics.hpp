@@ -0,0 +1,240 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// ָע
+///
+/// ֱͼ̷߳Ƭÿ̵߳һθָʱ
+/// һռġжĴ洢ֻһͨĶд
+/// ûԭӵĶ--дҲûп˵Ļáֻеʱű
+/// ̵߳ķƬͣ߳˳ʱֵһķƬ
+///
+/// ָӦΪ̬ڹ߳ǰ죺
+///
+///     static Metrics::Counter gs_accepted("myproxy_accepted_total",
+///                                         "Accepted browser connections");
+///     gs_accepted.Inc();
+///
+/// ֿԴ Prometheus ǩ `x_total{peer="browser"}`
+/// ͬǩ֮ǰĲָ֣깲һ HELP/TYPE ˵
+class Metrics {
+public:
+
+    enum {
+        /// ÿ̷߳ƬеĴ洢ԪĿ
+        MAX_CELLS = 8192,
+    };
+
+    /// ָ
+    enum Type {
+        COUNTER, ///< ֻ
+        GAUGE, ///< ɼĵǰֵ
+        HISTOGRAM, ///< ֲֵ
+    };
+
+    /// 
+    class Counter {
+    public:
+
+        /// עһ
+        Counter(const char *name, const char *help);
+
+        /// һ
+        void Inc() {
+            Add(1);
+        }
+
+        ///  @a n
+        void Add(uint64_t n) {
+            Metrics::Add(m_cell, n);
+        }
+
+        /// ̵߳ܺ
+        uint64_t GetValue() const;
+
+    private:
+
+        unsigned m_cell;
+    };
+
+    /// 
+    ///
+    /// ̷ֱ߳ۼͼΪǰֵٿ
+    /// ڲ̡ͬ߳
+    class Gauge {
+    public:
+
+        /// עһ
+        Gauge(const char *name, const char *help);
+
+        void Inc() {
+            Add(1);
+        }
+
+        void Dec() {
+            Add(-1);
+        }
+
+        ///  @a delta Ϊ
+        void Add(int64_t delta) {
+            Metrics::Add(m_cell, (uint64_t) delta);
+        }
+
+        /// ǰֵ
+        int64_t GetValue() const;
+
+    private:
+
+        unsigned m_cell;
+    };
+
+    /// ֱͼ
+    ///
+    /// -ԷͰ HdrHistogramС 16 ֵռһͰ
+    /// ÿ 2 ٵȷΪ 8 Ͱ 12.5%
+    ///  64 λΧԤ趨ޡ
+    class Histogram {
+    public:
+
+        enum {
+            /// Ͱ
+            LINEAR_BUCKETS = 16,
+
+            /// ÿ 2 ϸֵͰ2  SUB_BITS ݣ
+            SUB_BITS = 3,
+
+            /// Ͱ
+            NUM_BUCKETS = LINEAR_BUCKETS + (64 - 4) * (1 << SUB_BITS),
+        };
+
+        /// עһֱͼ
+        ///
+        /// @param scale ʱֵԵϵ΢¼
+        ///              뵼ʱȡ 1e-6
+        Histogram(const char *name, const char *help, double scale = 1);
+
+        /// ¼һֵ
+        void Record(uint64_t value) {
+            Metrics::Add(m_cell + BucketOf(value), 1);
+            Metrics::Add(m_cell + NUM_BUCKETS, value);
+        }
+
+        /// ֵ @a value ڵͰ
+        static unsigned BucketOf(uint64_t value) {
+            if (value < LINEAR_BUCKETS) {
+                return (unsigned) value;
+            }
+
+            int msb = HighestBit(value); // >= 4
+            unsigned sub = (unsigned) (value >> (msb - SUB_BITS)) &
+                           ((1 << SUB_BITS) - 1);
+
+            return LINEAR_BUCKETS + ((msb - 4) << SUB_BITS) + sub;
+        }
+
+        /// Ͱ @a bucket еֵ
+        static uint64_t UpperBoundOf(unsigned bucket);
+
+        /// ϲ̵߳
+        struct Snapshot {
+            std::vector<uint64_t> buckets;
+            uint64_t count = 0;
+            uint64_t sum = 0;
+
+            /// λ @a quantile 0 ~ 1ֵ
+            ///
+            /// Ͱֵƫ󲻳 12.5%ûʱ 0
+            uint64_t ValueAt(double quantile) const;
+
+            /// ֵͰֵ
+            uint64_t Max() const {
+                return ValueAt(1);
+            }
+
+            /// ƽֵ
+            double Mean() const {
+                return count > 0 ? (double) sum / count : 0;
+            }
+        };
+
+        /// ϲ̵߳
+        Snapshot GetSnapshot() const;
+
+    private:
+
+        // ߵķλ
+        static int HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+            unsigned long index;
+            if (_BitScanReverse(&index, (unsigned long) (value >> 32))) {
+                return (int) index + 32;
+            }
+
+            _BitScanReverse(&index, (unsigned long) value);
+            return (int) index;
+#else
+            return 63 - __builtin_clzll(value);
+#endif
+        }
+
+    private:
+
+        unsigned m_cell; // ΪͰܺ
+    };
+
+    /// עһڵʱֵ
+    ///
+    /// ʺڴռáгȵȱеطŵֵ
+    static void RegisterCallback(const char *name, const char *help,
+                                 std::function<double()> fn);
+
+    ///  Prometheus ıʽ0.0.4 棩ָ
+    static void ExportPrometheus(std::string &out);
+
+    /// ֱͼƽֵλ
+    ///
+    /// ÿֱͼһУֵѳעʱϵ
+    ///
+    ///       ƽֵ p50 p90 p99 p99.9 ֵ
+    static void ExportPercentiles(std::string &out);
+
+private:
+
+    // 洢Ԫ
+    typedef std::atomic<uint64_t> Cell;
+
+    // ߳˳ʱƬ
+    struct ShardHolder;
+
+    // ǰ̵߳ķƬ
+    static thread_local Cell *ms_cells;
+
+    // Ϊǰ̷߳Ƭ
+    static Cell *Attach();
+
+    // ֻб߳дԼķƬԭӵĶ--д
+    static void Add(unsigned cell, uint64_t n) {
+        Cell *cells = ms_cells;
+        if (!cells) {
+            cells = Attach();
+        }
+
+        Cell &c = cells[cell];
+        c.store(c.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+
+    // עһָ꣬һ洢Ԫ
+    static unsigned Register(const char *name, const char *help,
+                             Type type, unsigned numCells, double scale);
+
+    // зƬд洢Ԫ @a cell ܺ
+    static uint64_t Sum(unsigned cell);
+};
@@ -10,6 +10,10 @@
 enum SpecialCompKeys {
     SCK_EXIT = 1, ///< ˳
     SCK_NAME_RESOLVE, ///< 첽 DNS Ͳ
+    SCK_DNS_CLIENT, ///<  DNS ͻ˵׽
+    SCK_ADMIN, ///< ҳ׽
+    SCK_TASK, ///< TaskExecutor ִ
+    SCK_PROBE, ///< ɶ˿Ŷӳٵ̽루 Admission
 };
 
 /// IOCP 첽
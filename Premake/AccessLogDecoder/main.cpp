@@ -0,0 +1,236 @@
+
+// ѶƷ־תΪ CSV  JSON
+//
+// ÷AccessLogDecoder [-j] ļ...
+//
+//   -j  ÿ¼һ JSONĬͷ CSV
+//
+// ʱ ISO 8601UTC׶ΪԽʱ̵ĺ
+// δĽ׶գCSVΪ nullJSON Windows  Linux
+// ϱ롣
+
+#include "../../AccessLogFormat.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace AccessLogFormat;
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool gs_json = false;
+
+static const char *PHASES[] = {
+    "request", "dns_start", "dns_end", "connect", "first_byte", "close",
+};
+
+//  1970 ΢ʽΪ ISO 8601
+static std::string FormatTime(int64_t us) {
+    time_t secs = (time_t) (us / 1000000);
+
+    tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &secs);
+#else
+    gmtime_r(&secs, &utc);
+#endif
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ",
+             utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+             utc.tm_hour, utc.tm_min, utc.tm_sec, (int) (us % 1000000));
+
+    return buf;
+}
+
+// ת JSON ַеַ
+static std::string Escape(const std::string &s) {
+    std::string ret;
+
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            ret.push_back('\\');
+            ret.push_back(c);
+        }
+        else if ((unsigned char) c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            ret += buf;
+        }
+        else {
+            ret.push_back(c);
+        }
+    }
+
+    return ret;
+}
+
+static std::string FormatFlags(uint32_t flags) {
+    static const struct {
+        uint32_t flag;
+        const char *name;
+    } s_names[] = {
+        { F_TUNNEL, "tunnel" },
+        { F_DNS_CACHE_HIT, "dns_cache_hit" },
+        { F_DNS_FAILED, "dns_failed" },
+        { F_CONNECT_FAILED, "connect_failed" },
+        { F_REUSED, "reused" },
+        { F_KEEP_ALIVE, "keep_alive" },
+        { F_BAD_RESPONSE, "bad_response" },
+    };
+
+    std::string ret;
+    for (auto &item : s_names) {
+        if (flags & item.flag) {
+            if (!ret.empty()) {
+                ret.push_back('|');
+            }
+
+            ret += item.name;
+        }
+    }
+
+    return ret;
+}
+
+static void PrintRecord(const AccessRecord &ar, const std::string &host) {
+    const uint32_t phases[] = {
+        ar.request, ar.dnsStart, ar.dnsEnd,
+        ar.connect, ar.firstByte, ar.close,
+    };
+
+    std::string accept = FormatTime(ar.accept);
+    std::string flags = FormatFlags(ar.flags);
+
+    if (gs_json) {
+        printf("{\"accept\":\"%s\",\"host\":\"%s\",\"port\":%u",
+               accept.c_str(), Escape(host).c_str(), ar.port);
+
+        for (int i = 0; i < 6; i++) {
+            if (phases[i] == NO_TIME) {
+                printf(",\"%s_ms\":null", PHASES[i]);
+            }
+            else {
+                printf(",\"%s_ms\":%.3f", PHASES[i], phases[i] / 1000.0);
+            }
+        }
+
+        printf(",\"status\":%u,\"in_bytes\":%llu,\"out_bytes\":%llu,"
+               "\"flags\":\"%s\"}\n",
+               ar.status,
+               (unsigned long long) ar.inBytes,
+               (unsigned long long) ar.outBytes,
+               flags.c_str());
+    }
+    else {
+        printf("%s,%s,%u", accept.c_str(), host.c_str(), ar.port);
+
+        for (int i = 0; i < 6; i++) {
+            if (phases[i] == NO_TIME) {
+                printf(",");
+            }
+            else {
+                printf(",%.3f", phases[i] / 1000.0);
+            }
+        }
+
+        printf(",%u,%llu,%llu,%s\n",
+               ar.status,
+               (unsigned long long) ar.inBytes,
+               (unsigned long long) ar.outBytes,
+               flags.c_str());
+    }
+}
+
+// һļؼ¼ʽʱ -1
+static long Decode(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+
+    FileHeader fh;
+    if (fread(&fh, sizeof(fh), 1, fp) != 1 ||
+        memcmp(fh.magic, MAGIC, sizeof(fh.magic)) != 0 ||
+        fh.version != VERSION) {
+        fprintf(stderr, "%s: not an access log (version %u)\n",
+                path, VERSION);
+        fclose(fp);
+
+        return -1;
+    }
+
+    // ֵֻڵļЧ
+    std::unordered_map<uint32_t, std::string> hosts;
+    std::vector<char> payload;
+    long count = 0;
+
+    RecordHeader rh;
+    while (fread(&rh, sizeof(rh), 1, fp) == 1) {
+        payload.resize(rh.length);
+        if (rh.length > 0 && fread(payload.data(), rh.length, 1, fp) != 1) {
+            fprintf(stderr, "%s: truncated record\n", path);
+            break;
+        }
+
+        if (rh.type == RT_HOST && rh.length >= sizeof(HostRecord)) {
+            HostRecord hr;
+            memcpy(&hr, payload.data(), sizeof(hr));
+
+            hosts[hr.id].assign(payload.data() + sizeof(hr),
+                                payload.size() - sizeof(hr));
+        }
+        else if (rh.type == RT_ACCESS && rh.length >= sizeof(AccessRecord)) {
+            AccessRecord ar;
+            memcpy(&ar, payload.data(), sizeof(ar));
+
+            PrintRecord(ar, hosts[ar.hostId]);
+            count++;
+        }
+        // δ֪͵ļ¼Ժչʽ
+    }
+
+    fclose(fp);
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0) {
+            gs_json = true;
+        }
+        else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty()) {
+        fprintf(stderr, "Usage: %s [-j] file...\n", argv[0]);
+        return 1;
+    }
+
+    if (!gs_json) {
+        printf("accept,host,port");
+        for (auto phase : PHASES) {
+            printf(",%s_ms", phase);
+        }
+
+        printf(",status,in_bytes,out_bytes,flags\n");
+    }
+
+    int ret = 0;
+    for (auto path : files) {
+        if (Decode(path) < 0) {
+            ret = 2;
+        }
+    }
+
+    return ret;
+}
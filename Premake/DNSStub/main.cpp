@@ -0,0 +1,346 @@
+
+// ڲ DNS ͻ˵ļ DNS 
+//
+// ÷DNSStub [-p port] [-d delay_ms] [-l loss_percent] [-t] [-T ttl] [-v]
+//               name=ip[,ip...] ...
+//
+//   -p   UDP/TCP ˿ڣĬ 5353
+//   -d  ÿӦӳ٣룩ڹ۲쳬ʱ RTT 
+//   -l   UDP ѯİٷֱȣڹ۲ش
+//   -t  UDP Ӧһ TC ־ʹͻ˸ TCP
+//   -T  Ӧ¼ TTL룬Ĭ 60
+//   -v  ӡÿѯ
+//
+// Ϊ "*" ļ¼ƥ֣δַ֪ NXDOMAIN
+//
+// ̣߳ʹ select() Windows  Linux ϱ롣
+
+#include "../../DNSMessage.hpp"
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+typedef int socklen_t;
+#  define CLOSE_SOCKET closesocket
+#else
+#  include <sys/socket.h>
+#  include <sys/select.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#  include <unistd.h>
+typedef int SOCKET;
+#  define INVALID_SOCKET (-1)
+#  define CLOSE_SOCKET close
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////
+
+static int gs_delay = 0;
+static int gs_loss = 0;
+static bool gs_truncate = false;
+static uint32_t gs_ttl = 60;
+static bool gs_verbose = false;
+
+static map<string, vector<uint32_t>> gs_records;
+
+typedef chrono::steady_clock Clock;
+
+// һȴ͵ UDP Ӧ
+struct Delayed {
+    Clock::time_point due;
+    sockaddr_in to;
+    vector<char> msg;
+};
+
+// һ TCP 
+struct TcpConn {
+    SOCKET sd;
+    vector<char> in;
+    vector<char> out;
+    Clock::time_point due; // ʼӦʱ
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool ParseRecord(const char *arg) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || eq == arg) {
+        return false;
+    }
+
+    string name(arg, eq);
+    for (auto &c : name) {
+        c = (char) tolower((unsigned char) c);
+    }
+
+    vector<uint32_t> &addrs = gs_records[name];
+
+    string list(eq + 1);
+    size_t begin = 0;
+
+    while (begin < list.length()) {
+        size_t end = list.find(',', begin);
+        if (end == string::npos) {
+            end = list.length();
+        }
+
+        in_addr addr;
+        if (inet_pton(AF_INET, list.substr(begin, end - begin).c_str(),
+                      &addr) != 1) {
+            return false;
+        }
+
+        addrs.push_back(addr.s_addr);
+        begin = end + 1;
+    }
+
+    return true;
+}
+
+// ɶ @a query Ӧ𣬲ѯ޷ʱ false
+static bool Answer(const char *query, size_t len, bool udp,
+                   vector<char> &out) {
+    uint16_t id;
+    DNSMessage::Question q;
+
+    if (!DNSMessage::ParseQuery(query, len, id, q)) {
+        return false;
+    }
+
+    int rcode = DNSMessage::RCODE_NXDOMAIN;
+    const vector<uint32_t> *addrs = nullptr;
+
+    auto it = gs_records.find(q.name);
+    if (it == gs_records.end()) {
+        it = gs_records.find("*");
+    }
+
+    static const vector<uint32_t> s_empty;
+    if (it != gs_records.end()) {
+        rcode = DNSMessage::RCODE_NOERROR;
+        addrs = &it->second;
+    }
+
+    if (gs_verbose) {
+        printf("%s %s type=%u -> %s\n", udp ? "UDP" : "TCP",
+               q.name.c_str(), q.type,
+               rcode == DNSMessage::RCODE_NOERROR ? "NOERROR" : "NXDOMAIN");
+        fflush(stdout);
+    }
+
+    DNSMessage::BuildResponse(id, q, rcode, addrs ? *addrs : s_empty,
+                              gs_ttl, udp && gs_truncate, out);
+    return true;
+}
+
+static void Usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-d delay_ms] [-l loss_percent] [-t] "
+            "[-T ttl] [-v] name=ip[,ip...] ...\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int port = 5353;
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-p" && hasValue) {
+            port = atoi(argv[++i]);
+        }
+        else if (arg == "-d" && hasValue) {
+            gs_delay = atoi(argv[++i]);
+        }
+        else if (arg == "-l" && hasValue) {
+            gs_loss = atoi(argv[++i]);
+        }
+        else if (arg == "-T" && hasValue) {
+            gs_ttl = (uint32_t) atoi(argv[++i]);
+        }
+        else if (arg == "-t") {
+            gs_truncate = true;
+        }
+        else if (arg == "-v") {
+            gs_verbose = true;
+        }
+        else if (!ParseRecord(argv[i])) {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((unsigned short) port);
+
+    SOCKET udp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *) &on,
+               sizeof(on));
+
+    if (udp == INVALID_SOCKET || listener == INVALID_SOCKET ||
+        ::bind(udp, (sockaddr *) &local, sizeof(local)) != 0 ||
+        ::bind(listener, (sockaddr *) &local, sizeof(local)) != 0 ||
+        listen(listener, 16) != 0) {
+        fprintf(stderr, "Failed to listen on port %d\n", port);
+        return 2;
+    }
+
+    printf("DNSStub listening on port %d (UDP/TCP), %u record(s)\n",
+           port, (unsigned) gs_records.size());
+
+    mt19937 rng(random_device{}());
+    uniform_int_distribution<int> percent(0, 99);
+
+    deque<Delayed> delayed;
+    vector<TcpConn> conns;
+    char buf[65536];
+
+    while (true) {
+        auto now = Clock::now();
+
+        // ѵڵ UDP Ӧӳͬаʱ
+        while (!delayed.empty() && delayed.front().due <= now) {
+            Delayed &d = delayed.front();
+            sendto(udp, d.msg.data(), (int) d.msg.size(), 0,
+                   (const sockaddr *) &d.to, sizeof(d.to));
+            delayed.pop_front();
+        }
+
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(udp, &rfds);
+        FD_SET(listener, &rfds);
+
+        SOCKET maxfd = udp > listener ? udp : listener;
+        for (auto &c : conns) {
+            if (c.out.empty()) {
+                FD_SET(c.sd, &rfds);
+            }
+            else if (c.due <= now) {
+                FD_SET(c.sd, &wfds);
+            }
+
+            maxfd = c.sd > maxfd ? c.sd : maxfd;
+        }
+
+        timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 5000;
+
+        if (select((int) maxfd + 1, &rfds, &wfds, nullptr, &tv) < 0) {
+            perror("select");
+            return 3;
+        }
+
+        now = Clock::now();
+        auto due = now + chrono::milliseconds(gs_delay);
+
+        if (FD_ISSET(udp, &rfds)) {
+            sockaddr_in from;
+            socklen_t fromLen = sizeof(from);
+
+            int n = (int) recvfrom(udp, buf, sizeof(buf), 0,
+                                   (sockaddr *) &from, &fromLen);
+
+            if (n > 0 && percent(rng) >= gs_loss) {
+                Delayed d;
+                if (Answer(buf, (size_t) n, true, d.msg)) {
+                    d.due = due;
+                    d.to = from;
+                    delayed.push_back(d);
+                }
+            }
+            else if (n > 0 && gs_verbose) {
+                printf("UDP query dropped\n");
+            }
+        }
+
+        if (FD_ISSET(listener, &rfds)) {
+            SOCKET sd = accept(listener, nullptr, nullptr);
+            if (sd != INVALID_SOCKET) {
+                TcpConn c;
+                c.sd = sd;
+                conns.push_back(c);
+            }
+        }
+
+        for (size_t i = 0; i < conns.size();) {
+            TcpConn &c = conns[i];
+            bool closed = false;
+
+            if (FD_ISSET(c.sd, &rfds)) {
+                int n = (int) recv(c.sd, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    closed = true;
+                }
+                else {
+                    c.in.insert(c.in.end(), buf, buf + n);
+
+                    if (c.in.size() >= 2) {
+                        size_t len = ((unsigned char) c.in[0] << 8) |
+                                     (unsigned char) c.in[1];
+
+                        if (c.in.size() >= len + 2) {
+                            vector<char> msg;
+                            if (!Answer(c.in.data() + 2, len, false, msg)) {
+                                closed = true;
+                            }
+                            else {
+                                c.out.push_back((char) (msg.size() >> 8));
+                                c.out.push_back((char) (msg.size() & 0xFF));
+                                c.out.insert(c.out.end(),
+                                             msg.begin(), msg.end());
+                                c.in.erase(c.in.begin(),
+                                           c.in.begin() + len + 2);
+                                c.due = due;
+                            }
+                        }
+                    }
+                }
+            }
+            else if (FD_ISSET(c.sd, &wfds)) {
+                int n = (int) send(c.sd, c.out.data(), (int) c.out.size(), 0);
+                if (n <= 0) {
+                    closed = true;
+                }
+                else {
+                    c.out.erase(c.out.begin(), c.out.begin() + n);
+                }
+            }
+
+            if (closed) {
+                CLOSE_SOCKET(c.sd);
+                conns.erase(conns.begin() + i);
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    return 0;
+}
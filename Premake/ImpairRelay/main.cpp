@@ -0,0 +1,539 @@
+
+// ģ TCP м
+//
+// ÷ImpairRelay [-p port] -u upstream [-d delay_ms] [-j jitter_ms]
+//                   [-b down_KBps] [-B up_KBps] [-s stall_percent]
+//                   [-S stall_ms] [-w window] [-v]
+//
+//   -p  ˿ڣĬ 2990ֻ 127.0.0.1
+//   -u  εַ ip:portÿӶת˴
+//   -d  ӳ٣룩ʩӣRTT Ϊ
+//   -j  룩ÿݶӳ [0, jitter) еֵ
+//       
+//   -b  УεͻˣÿӵĴKB/s0 Ϊ
+//   -B  Уͻ˵ΣÿӵĴKB/s0 Ϊ
+//   -s  ÿݱӳ -S İٷֱȣƶشʱ
+//   -S  ӳ٣룬Ĭ 200
+//   -w  ÿ;ݵޣֽڣĬ 65536ƽմڣ
+//       ﵽʱֹͣȡʹͷܵѹ
+//   -v  ӡÿӵͳ
+//
+//  LoadGen ֮ģٵ
+//
+//   ImpairRelay -u 127.0.0.1:1990 -d 50 -b 64
+//   LoadGen -x 127.0.0.1:2990 ...
+//
+// ڴ OriginServer ֮ģңԶԴվ
+//
+//   ImpairRelay -u 127.0.0.1:8000 -d 100 -j 20 -s 1
+//   LoadGen -t 127.0.0.1:2990 ...
+//
+// ȫû̬ɣҪ root Ȩ޻ neteṃ߳ʹ poll()
+//  Windows  Linux ϱ롣
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#  define CLOSE_SOCKET closesocket
+#  define poll WSAPoll
+#  define ERR_WOULDBLOCK WSAEWOULDBLOCK
+#  define ERR_INPROGRESS WSAEWOULDBLOCK
+#  define SEND_FLAGS 0
+#  define SHUT_WR SD_SEND
+typedef int socklen_t;
+#else
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <arpa/inet.h>
+#  include <poll.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+typedef int SOCKET;
+#  define INVALID_SOCKET (-1)
+#  define CLOSE_SOCKET close
+#  define ERR_WOULDBLOCK EWOULDBLOCK
+#  define ERR_INPROGRESS EINPROGRESS
+#  define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef chrono::steady_clock Clock;
+
+static sockaddr_in gs_upstream;
+static int gs_delay = 0;
+static int gs_jitter = 0;
+static double gs_downRate = 0; // ֽ/
+static double gs_upRate = 0; // ֽ/
+static int gs_stallPercent = 0;
+static int gs_stall = 200;
+static size_t gs_window = 65536;
+static bool gs_verbose = false;
+
+static mt19937 gs_rng(1);
+
+static int LastError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+static bool SetNonBlocking(SOCKET sd) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(sd, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(sd, F_GETFL, 0);
+    return flags >= 0 && fcntl(sd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static bool ParseAddress(const string &s, sockaddr_in &addr) {
+    size_t colon = s.rfind(':');
+    if (colon == string::npos) {
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short) atoi(s.c_str() + colon + 1));
+
+    return inet_pton(AF_INET, s.substr(0, colon).c_str(),
+                     &addr.sin_addr) == 1 && addr.sin_port != 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// һεȴת
+struct Segment {
+    Clock::time_point due; // תʱ
+    string data;
+    size_t pos;
+};
+
+// һ
+struct Flow {
+    deque<Segment> queue;
+    size_t queued = 0; // ;ֽ
+    double rate = 0; // ֽ/룩0 Ϊ
+
+    Clock::time_point lastDue; // һݵĵʱ̣ڱ
+    Clock::time_point nextSend; // ´η͵ʱ
+
+    bool eof = false; // Դѹر
+    bool shut = false; // Ŀĵתر
+    uint64_t total = 0; // ۼתֽ
+
+    // ǷԼȡԴ
+    bool CanRead() const {
+        return !eof && queued < gs_window;
+    }
+
+    // ׵Ƿѿɷͣ @a wake
+    bool Ready(Clock::time_point now, Clock::time_point &wake) const {
+        if (queue.empty()) {
+            return false;
+        }
+
+        auto when = max(queue.front().due, nextSend);
+        if (when <= now) {
+            return true;
+        }
+
+        wake = min(wake, when);
+        return false;
+    }
+
+    // յŶ
+    void Push(const char *buf, size_t len, Clock::time_point now) {
+        int extra = gs_delay;
+        if (gs_jitter > 0) {
+            extra += uniform_int_distribution<int>(0, gs_jitter - 1)(gs_rng);
+        }
+        if (gs_stallPercent > 0 &&
+            uniform_int_distribution<int>(0, 99)(gs_rng) < gs_stallPercent) {
+            extra += gs_stall;
+        }
+
+        // TCP 򣺶ֻƳ٣úݳǰ
+        auto due = max(now + chrono::milliseconds(extra), lastDue);
+        lastDue = due;
+
+        queue.push_back(Segment{due, string(buf, len), 0});
+        queued += len;
+    }
+};
+
+// һм̵
+struct Conn {
+    SOCKET client = INVALID_SOCKET;
+    SOCKET server = INVALID_SOCKET;
+    bool connected = false;
+
+    Flow up; // ͻ˵
+    Flow down; // εͻ
+
+    Clock::time_point opened;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+//  @a from ݵ @a flow false ʾӳ
+static bool ReadInto(SOCKET from, Flow &flow, Clock::time_point now) {
+    char buf[65536];
+    size_t room = min(sizeof(buf), gs_window - flow.queued);
+
+    int n = (int) recv(from, buf, (int) room, 0);
+    if (n > 0) {
+        flow.Push(buf, (size_t) n, now);
+    }
+    else if (n == 0) {
+        flow.eof = true;
+    }
+    else if (LastError() != ERR_WOULDBLOCK) {
+        return false;
+    }
+
+    return true;
+}
+
+//  @a flow ׵д @a to false ʾӳ
+static bool WriteFrom(SOCKET to, Flow &flow, Clock::time_point now) {
+    if (!flow.queue.empty()) {
+        Segment &seg = flow.queue.front();
+        size_t len = seg.data.size() - seg.pos;
+
+        // ʱÿֻԼ 10 ʹƽ
+        if (flow.rate > 0) {
+            len = min(len, max<size_t>(1460, (size_t) (flow.rate / 100)));
+        }
+
+        int n = (int) send(to, seg.data.data() + seg.pos, (int) len,
+                           SEND_FLAGS);
+        if (n < 0) {
+            return LastError() == ERR_WOULDBLOCK;
+        }
+
+        seg.pos += n;
+        flow.queued -= n;
+        flow.total += n;
+
+        if (flow.rate > 0) {
+            flow.nextSend = max(flow.nextSend, now) +
+                chrono::duration_cast<Clock::duration>(
+                    chrono::duration<double>(n / flow.rate));
+        }
+
+        if (seg.pos == seg.data.size()) {
+            flow.queue.pop_front();
+        }
+    }
+
+    if (flow.queue.empty() && flow.eof && !flow.shut) {
+        shutdown(to, SHUT_WR);
+        flow.shut = true;
+    }
+
+    return true;
+}
+
+static void Close(Conn &conn, const char *reason) {
+    if (gs_verbose) {
+        double secs = chrono::duration<double>(
+            Clock::now() - conn.opened).count();
+
+        printf("closed (%s) after %.3f s: up %llu bytes, down %llu bytes\n",
+               reason, secs, (unsigned long long) conn.up.total,
+               (unsigned long long) conn.down.total);
+        fflush(stdout);
+    }
+
+    if (conn.client != INVALID_SOCKET) {
+        CLOSE_SOCKET(conn.client);
+        conn.client = INVALID_SOCKET;
+    }
+
+    if (conn.server != INVALID_SOCKET) {
+        CLOSE_SOCKET(conn.server);
+        conn.server = INVALID_SOCKET;
+    }
+}
+
+static void Accept(SOCKET listener, list<Conn> &conns) {
+    while (true) {
+        SOCKET client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            return;
+        }
+
+        SOCKET server = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (server == INVALID_SOCKET || !SetNonBlocking(client) ||
+            !SetNonBlocking(server)) {
+            CLOSE_SOCKET(client);
+            if (server != INVALID_SOCKET) {
+                CLOSE_SOCKET(server);
+            }
+
+            continue;
+        }
+
+        int on = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char *) &on,
+                   sizeof(on));
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, (const char *) &on,
+                   sizeof(on));
+
+        if (connect(server, (const sockaddr *) &gs_upstream,
+                    sizeof(gs_upstream)) != 0 &&
+            LastError() != ERR_INPROGRESS) {
+            CLOSE_SOCKET(client);
+            CLOSE_SOCKET(server);
+            continue;
+        }
+
+        conns.emplace_back();
+        Conn &conn = conns.back();
+        conn.client = client;
+        conn.server = server;
+        conn.opened = Clock::now();
+        conn.up.rate = gs_upRate;
+        conn.down.rate = gs_downRate;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static void Usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] -u upstream [-d delay_ms] [-j jitter_ms] "
+            "[-b down_KBps] [-B up_KBps] [-s stall_percent] [-S stall_ms] "
+            "[-w window] [-v]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int port = 2990;
+    bool hasUpstream = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-p" && hasValue) {
+            port = atoi(argv[++i]);
+        }
+        else if (arg == "-u" && hasValue) {
+            hasUpstream = ParseAddress(argv[++i], gs_upstream);
+        }
+        else if (arg == "-d" && hasValue) {
+            gs_delay = atoi(argv[++i]);
+        }
+        else if (arg == "-j" && hasValue) {
+            gs_jitter = atoi(argv[++i]);
+        }
+        else if (arg == "-b" && hasValue) {
+            gs_downRate = atof(argv[++i]) * 1024;
+        }
+        else if (arg == "-B" && hasValue) {
+            gs_upRate = atof(argv[++i]) * 1024;
+        }
+        else if (arg == "-s" && hasValue) {
+            gs_stallPercent = atoi(argv[++i]);
+        }
+        else if (arg == "-S" && hasValue) {
+            gs_stall = atoi(argv[++i]);
+        }
+        else if (arg == "-w" && hasValue) {
+            gs_window = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "-v") {
+            gs_verbose = true;
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!hasUpstream || gs_delay < 0 || gs_jitter < 0 || gs_window == 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    local.sin_port = htons((unsigned short) port);
+
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *) &on,
+               sizeof(on));
+
+    if (listener == INVALID_SOCKET ||
+        ::bind(listener, (sockaddr *) &local, sizeof(local)) != 0 ||
+        listen(listener, SOMAXCONN) != 0 || !SetNonBlocking(listener)) {
+        fprintf(stderr, "Failed to listen on port %d\n", port);
+        return 2;
+    }
+
+    printf("ImpairRelay listening on 127.0.0.1:%d, delay %d ms, "
+           "jitter %d ms, down %.0f KB/s, up %.0f KB/s, stall %d%%\n",
+           port, gs_delay, gs_jitter, gs_downRate / 1024, gs_upRate / 1024,
+           gs_stallPercent);
+    fflush(stdout);
+
+    list<Conn> conns;
+    vector<pollfd> fds;
+    vector<Conn *> polled;
+
+    while (true) {
+        auto now = Clock::now();
+        auto wake = now + chrono::milliseconds(100);
+
+        fds.clear();
+        polled.clear();
+
+        pollfd lfd;
+        lfd.fd = listener;
+        lfd.events = POLLIN;
+        lfd.revents = 0;
+        fds.push_back(lfd);
+        polled.push_back(nullptr);
+
+        // ÿռͻǰں
+        for (auto &conn : conns) {
+            pollfd cfd, sfd;
+            cfd.fd = conn.client;
+            sfd.fd = conn.server;
+            cfd.events = sfd.events = 0;
+            cfd.revents = sfd.revents = 0;
+
+            if (conn.up.CanRead()) {
+                cfd.events |= POLLIN;
+            }
+            if (!conn.down.shut && conn.down.Ready(now, wake)) {
+                cfd.events |= POLLOUT;
+            }
+
+            if (!conn.connected) {
+                sfd.events |= POLLOUT;
+            }
+            else {
+                if (conn.down.CanRead()) {
+                    sfd.events |= POLLIN;
+                }
+                if (!conn.up.shut && conn.up.Ready(now, wake)) {
+                    sfd.events |= POLLOUT;
+                }
+            }
+
+            fds.push_back(cfd);
+            fds.push_back(sfd);
+            polled.push_back(&conn);
+        }
+
+        auto ms = chrono::duration_cast<chrono::milliseconds>(
+            wake - now).count();
+
+        if (poll(fds.data(), (unsigned) fds.size(),
+                 (int) max<decltype(ms)>(ms, 0)) < 0) {
+            perror("poll");
+            return 3;
+        }
+
+        now = Clock::now();
+
+        if (fds[0].revents & POLLIN) {
+            Accept(listener, conns);
+        }
+
+        for (size_t i = 1; i < polled.size(); i++) {
+            Conn &conn = *polled[i];
+            short crev = fds[i * 2 - 1].revents;
+            short srev = fds[i * 2].revents;
+            bool ok = true;
+
+            if (!conn.connected && srev) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.server, SOL_SOCKET, SO_ERROR, (char *) &err,
+                           &len);
+
+                if (err != 0 || (srev & POLLOUT) == 0) {
+                    Close(conn, "upstream unreachable");
+                    continue;
+                }
+
+                conn.connected = true;
+                srev = 0;
+            }
+
+            if ((crev | srev) & POLLERR) {
+                Close(conn, "reset");
+                continue;
+            }
+
+            if (crev & (POLLIN | POLLHUP)) {
+                ok = ok && (!conn.up.CanRead() ||
+                            ReadInto(conn.client, conn.up, now));
+            }
+            if (ok && (crev & POLLOUT)) {
+                ok = WriteFrom(conn.client, conn.down, now);
+            }
+            if (ok && (srev & (POLLIN | POLLHUP))) {
+                ok = !conn.down.CanRead() ||
+                     ReadInto(conn.server, conn.down, now);
+            }
+            if (ok && (srev & POLLOUT)) {
+                ok = WriteFrom(conn.server, conn.up, now);
+            }
+
+            // Զѹرſգתر
+            if (ok && conn.connected) {
+                if (conn.up.eof && conn.up.queue.empty()) {
+                    ok = WriteFrom(conn.server, conn.up, now);
+                }
+                if (conn.down.eof && conn.down.queue.empty()) {
+                    ok = ok && WriteFrom(conn.client, conn.down, now);
+                }
+            }
+
+            if (!ok) {
+                Close(conn, "reset");
+            }
+            else if (conn.up.shut && conn.down.shut) {
+                Close(conn, "done");
+            }
+        }
+
+        conns.remove_if([](const Conn &conn) {
+            return conn.client == INVALID_SOCKET;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,1010 @@
+
+// ͨѹ HTTP 
+//
+// ÷LoadGen [-x proxy] [-t target] [-m http|connect|tunnel] [-c conns]
+//               [-T threads] [-d seconds] [-r rate] [-b body_bytes]
+//               [-p path] [-K] [-o timeout_ms]
+//
+//   -x  ĵַĬ 127.0.0.1:1990
+//   -t  ԴվĵַĬ 127.0.0.1:8000ɴ
+//   -m  httpͨĴconnectȽ CONNECT 
+//       tunnelȽ CONNECT ٷ TLS ¼Ĳ͸
+//       ݣȴԴվԭԣ OriginServer ʹãĬ http
+//   -c  Ĭ 64ƽָ߳
+//   -T  ߳Ĭ 4
+//   -d  ʱ䣨룬Ĭ 10
+//   -r  ʣ/룩0 ΪջÿյӦһ
+//       Ĭ 0
+//   -b  ĵĳȣ 0 ʱʹ POSTĬ 0tunnel ģʽΪÿ
+//       ͵Ĳ͸ݵĳȣĬ 1024
+//   -p  ·Ĭ /
+//   -K  ʹ keep-aliveÿ½ӣģʽΪ½
+//   -o  ĳʱ룬Ĭ 5000
+//
+// ģʽ󰴹̶̵߳ĶУʱӴӼƻʱ
+// ʱڶеȴʱͬʱӣӶ
+// coordinated omissionԽʱڶе󱨸Ϊ backlog
+//
+// Դվֻǻػַÿ߳ poll() Լķӣ
+//  Windows  Linux ϱ롣
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#  define CLOSE_SOCKET closesocket
+#  define poll WSAPoll
+#  define ERR_WOULDBLOCK WSAEWOULDBLOCK
+#  define ERR_INPROGRESS WSAEWOULDBLOCK
+#  define SEND_FLAGS 0
+typedef int socklen_t;
+#else
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <arpa/inet.h>
+#  include <poll.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+typedef int SOCKET;
+#  define INVALID_SOCKET (-1)
+#  define CLOSE_SOCKET close
+#  define ERR_WOULDBLOCK EWOULDBLOCK
+#  define ERR_INPROGRESS EINPROGRESS
+#  define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef chrono::steady_clock Clock;
+
+static sockaddr_in gs_proxy;
+static string gs_target = "127.0.0.1:8000";
+static bool gs_tunnel = false; //  CONNECT 
+static bool gs_opaque = false; // зͲ͸
+static int gs_numConns = 64;
+static int gs_numThreads = 4;
+static int gs_duration = 10;
+static double gs_rate = 0;
+static size_t gs_bodySize = 0;
+static string gs_path = "/";
+static bool gs_keepAlive = true;
+static int gs_timeout = 5000;
+
+static int LastError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+static bool SetNonBlocking(SOCKET sd) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(sd, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(sd, F_GETFL, 0);
+    return flags >= 0 && fcntl(sd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+//  "ip:port"ֻܻػַ
+static bool ParseLoopback(const string &s, sockaddr_in &addr) {
+    size_t colon = s.rfind(':');
+    if (colon == string::npos) {
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short) atoi(s.c_str() + colon + 1));
+
+    if (inet_pton(AF_INET, s.substr(0, colon).c_str(),
+                  &addr.sin_addr) != 1) {
+        return false;
+    }
+
+    return (ntohl(addr.sin_addr.s_addr) >> 24) == 127 && addr.sin_port != 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// ʽ HTTP Ӧ
+//
+// ֻϢ߽磬ֱӶ
+class ResponseParser {
+public:
+
+    enum Result {
+        R_NEED_MORE,
+        R_DONE,
+        R_ERROR,
+    };
+
+    // @param connectReply ǷΪ CONNECT ĻӦ2xx ʱûģ
+    void Reset(bool connectReply) {
+        m_state = S_HEADER;
+        m_connectReply = connectReply;
+        m_status = 0;
+        m_keepAlive = false;
+        m_remaining = 0;
+    }
+
+    // ȴ @a size ֽڵĲ͸ݣΪһɹĻӦ
+    void ResetOpaque(uint64_t size) {
+        m_state = S_BODY;
+        m_connectReply = false;
+        m_status = 200;
+        m_keepAlive = true;
+        m_remaining = size;
+    }
+
+    //  @a in еݲƳĵĲ
+    Result Parse(string &in) {
+        size_t pos = 0;
+        Result ret = R_NEED_MORE;
+
+        while (ret == R_NEED_MORE && pos < in.size()) {
+            ret = Step(in, pos);
+            if (ret == R_NEED_MORE && !m_progress) {
+                break;
+            }
+        }
+
+        in.erase(0, pos);
+        return ret;
+    }
+
+    // Զ˹رӣػӦǷʹ˽
+    bool OnEof() const {
+        return m_state == S_UNTIL_CLOSE;
+    }
+
+    int GetStatus() const {
+        return m_status;
+    }
+
+    bool IsKeepAlive() const {
+        return m_keepAlive;
+    }
+
+private:
+
+    enum State {
+        S_HEADER,
+        S_BODY,
+        S_CHUNK_SIZE,
+        S_CHUNK_DATA,
+        S_CHUNK_CRLF,
+        S_TRAILER,
+        S_UNTIL_CLOSE,
+    };
+
+    enum {
+        MAX_HEADER_SIZE = 64 * 1024,
+    };
+
+    // һm_progress ʾǷݻı״̬
+    Result Step(const string &in, size_t &pos) {
+        m_progress = false;
+
+        switch (m_state) {
+        case S_HEADER: {
+            size_t end = in.find("\r\n\r\n", pos);
+            if (end == string::npos) {
+                return in.size() - pos > MAX_HEADER_SIZE ? R_ERROR
+                                                         : R_NEED_MORE;
+            }
+
+            Result ret = ParseHeader(in.substr(pos, end + 2 - pos));
+            pos = end + 4;
+            m_progress = true;
+
+            return ret;
+        }
+
+        case S_BODY:
+        case S_CHUNK_DATA: {
+            size_t n = min<size_t>(m_remaining, in.size() - pos);
+            pos += n;
+            m_remaining -= n;
+            m_progress = n > 0;
+
+            if (m_remaining == 0) {
+                if (m_state == S_BODY) {
+                    return R_DONE;
+                }
+
+                m_state = S_CHUNK_CRLF;
+                m_progress = true;
+            }
+
+            return R_NEED_MORE;
+        }
+
+        case S_CHUNK_CRLF:
+            if (in.size() - pos < 2) {
+                return R_NEED_MORE;
+            }
+
+            if (in.compare(pos, 2, "\r\n") != 0) {
+                return R_ERROR;
+            }
+
+            pos += 2;
+            m_state = S_CHUNK_SIZE;
+            m_progress = true;
+
+            return R_NEED_MORE;
+
+        case S_CHUNK_SIZE: {
+            size_t end = in.find("\r\n", pos);
+            if (end == string::npos) {
+                return R_NEED_MORE;
+            }
+
+            char *stop;
+            m_remaining = strtoull(in.c_str() + pos, &stop, 16);
+            if (stop == in.c_str() + pos) {
+                return R_ERROR;
+            }
+
+            pos = end + 2;
+            m_state = m_remaining == 0 ? S_TRAILER : S_CHUNK_DATA;
+            m_progress = true;
+
+            return R_NEED_MORE;
+        }
+
+        case S_TRAILER: {
+            size_t end = in.find("\r\n", pos);
+            if (end == string::npos) {
+                return R_NEED_MORE;
+            }
+
+            bool last = end == pos;
+            pos = end + 2;
+            m_progress = true;
+
+            return last ? R_DONE : R_NEED_MORE;
+        }
+
+        case S_UNTIL_CLOSE:
+            m_progress = pos < in.size();
+            pos = in.size();
+            return R_NEED_MORE;
+        }
+
+        return R_ERROR;
+    }
+
+    // ״̬ײ@a header  "\r\n" β
+    Result ParseHeader(const string &header) {
+        int minor;
+        if (sscanf(header.c_str(), "HTTP/1.%d %d", &minor, &m_status) != 2) {
+            return R_ERROR;
+        }
+
+        m_keepAlive = minor >= 1;
+
+        bool chunked = false;
+        long long length = -1;
+
+        size_t begin = header.find("\r\n") + 2;
+        while (begin < header.size()) {
+            size_t end = header.find("\r\n", begin);
+            string line = header.substr(begin, end - begin);
+            begin = end + 2;
+
+            size_t colon = line.find(':');
+            if (colon == string::npos) {
+                continue;
+            }
+
+            string name = line.substr(0, colon);
+            string value = line.substr(colon + 1);
+            for (auto &c : name) {
+                c = (char) tolower((unsigned char) c);
+            }
+            for (auto &c : value) {
+                c = (char) tolower((unsigned char) c);
+            }
+
+            if (name == "content-length") {
+                length = atoll(value.c_str());
+            }
+            else if (name == "transfer-encoding") {
+                chunked = value.find("chunked") != string::npos;
+            }
+            else if (name == "connection" || name == "proxy-connection") {
+                if (value.find("close") != string::npos) {
+                    m_keepAlive = false;
+                }
+                else if (value.find("keep-alive") != string::npos) {
+                    m_keepAlive = true;
+                }
+            }
+        }
+
+        // 1xx ʱӦ֮ʽĻӦ
+        if (m_status >= 100 && m_status < 200) {
+            return R_NEED_MORE;
+        }
+
+        if ((m_connectReply && m_status / 100 == 2) ||
+            m_status == 204 || m_status == 304) {
+            return R_DONE;
+        }
+
+        if (chunked) {
+            m_state = S_CHUNK_SIZE;
+        }
+        else if (length >= 0) {
+            m_state = S_BODY;
+            m_remaining = (uint64_t) length;
+
+            return length == 0 ? R_DONE : R_NEED_MORE;
+        }
+        else {
+            m_state = S_UNTIL_CLOSE;
+            m_keepAlive = false;
+        }
+
+        return R_NEED_MORE;
+    }
+
+private:
+
+    State m_state = S_HEADER;
+    bool m_connectReply = false;
+    bool m_progress = false;
+    int m_status = 0;
+    bool m_keepAlive = false;
+    uint64_t m_remaining = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// һ̵߳ͳ
+struct Stats {
+    vector<uint32_t> latencies; // ΢
+    uint64_t requests = 0;
+    uint64_t non2xx = 0;
+    uint64_t errors = 0;
+    uint64_t timeouts = 0;
+    uint64_t connects = 0;
+    uint64_t rxBytes = 0;
+    uint64_t txBytes = 0;
+    uint64_t backlog = 0;
+};
+
+// һ
+struct Conn {
+    enum Phase {
+        P_CLOSED,
+        P_CONNECTING,
+        P_HANDSHAKE, // ȴ CONNECT ĻӦ
+        P_RESPONSE, // ȴĻӦ
+        P_IDLE,
+    };
+
+    SOCKET sd = INVALID_SOCKET;
+    Phase phase = P_CLOSED;
+
+    string out;
+    size_t outPos = 0;
+    string in;
+    ResponseParser parser;
+
+    bool busy = false; // Ƿ
+    bool reused = false; // ǰǷڸõϷ
+    bool gotBytes = false; // ǰǷյӦ
+    Clock::time_point start; // ʱӵ
+    Clock::time_point deadline; // ʱʱ
+};
+
+// һ̣߳Լһ
+class Worker {
+public:
+
+    Worker(int numConns, double rate, Stats &stats)
+        : m_conns(numConns), m_rate(rate), m_stats(stats) {
+        string host = gs_target;
+        string body(gs_bodySize, 'x');
+        const char *method = gs_bodySize ? "POST " : "GET ";
+
+        // ͨʹþ URLеֱӷԴվ
+        m_request = method;
+        if (!gs_tunnel) {
+            m_request += "http://" + host;
+        }
+
+        m_request += gs_path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+        m_request += gs_keepAlive ? "Connection: keep-alive\r\n"
+                                  : "Connection: close\r\n";
+
+        if (gs_bodySize) {
+            m_request += "Content-Length: " + to_string(gs_bodySize) + "\r\n";
+        }
+
+        m_request += "\r\n" + body;
+
+        if (gs_opaque) {
+            MakeRecords();
+        }
+
+        m_connect = "CONNECT " + host + " HTTP/1.1\r\nHost: " + host +
+                    "\r\n\r\n";
+    }
+
+    void Run(Clock::time_point begin, Clock::time_point end) {
+        Clock::duration interval(0);
+        Clock::time_point next = begin;
+
+        if (m_rate > 0) {
+            interval = chrono::duration_cast<Clock::duration>(
+                chrono::duration<double>(1 / m_rate));
+        }
+
+        vector<pollfd> fds;
+        vector<Conn *> polled;
+
+        while (true) {
+            auto now = Clock::now();
+            if (now >= end) {
+                break;
+            }
+
+            // ѵڵУջһ
+            if (m_rate > 0) {
+                while (next <= now) {
+                    m_pending.push_back(next);
+                    next += interval;
+                }
+            }
+
+            for (auto &conn : m_conns) {
+                if (conn.busy) {
+                    continue;
+                }
+
+                if (m_rate > 0) {
+                    if (m_pending.empty()) {
+                        break;
+                    }
+
+                    Dispatch(conn, m_pending.front(), now);
+                    m_pending.pop_front();
+                }
+                else {
+                    Dispatch(conn, now, now);
+                }
+            }
+
+            // ȴһڡĳʱԽ
+            auto wake = end;
+            if (m_rate > 0 && next < wake) {
+                wake = next;
+            }
+
+            fds.clear();
+            polled.clear();
+
+            for (auto &conn : m_conns) {
+                if (conn.sd == INVALID_SOCKET) {
+                    continue;
+                }
+
+                pollfd pfd;
+                pfd.fd = conn.sd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+
+                if (conn.phase == Conn::P_CONNECTING ||
+                    conn.outPos < conn.out.size()) {
+                    pfd.events |= POLLOUT;
+                }
+
+                fds.push_back(pfd);
+                polled.push_back(&conn);
+
+                if (conn.busy && conn.deadline < wake) {
+                    wake = conn.deadline;
+                }
+            }
+
+            auto ms = chrono::duration_cast<chrono::milliseconds>(
+                wake - now).count() + 1;
+            ms = min<decltype(ms)>(ms, 100);
+
+            if (fds.empty()) {
+                this_thread::sleep_for(chrono::milliseconds(ms));
+                continue;
+            }
+
+            if (poll(fds.data(), (unsigned) fds.size(), (int) ms) < 0) {
+                perror("poll");
+                break;
+            }
+
+            now = Clock::now();
+
+            for (size_t i = 0; i < fds.size(); i++) {
+                if (fds[i].revents) {
+                    OnEvents(*polled[i], fds[i].revents, now);
+                }
+            }
+
+            for (auto &conn : m_conns) {
+                if (conn.busy && conn.deadline <= now) {
+                    m_stats.timeouts++;
+                    Close(conn);
+                }
+            }
+        }
+
+        m_stats.backlog += m_pending.size();
+
+        for (auto &conn : m_conns) {
+            Close(conn);
+        }
+    }
+
+private:
+
+    // ܳΪ gs_bodySize Ӧݼ¼TLS ¼ĸʽ
+    // ÿ¼ĸز 16 KB
+    void MakeRecords() {
+        m_request.clear();
+
+        for (size_t left = gs_bodySize; left > 0;) {
+            size_t n = min<size_t>(left, 16384);
+            left -= n;
+
+            m_request += (char) 0x17;
+            m_request += (char) 0x03;
+            m_request += (char) 0x03;
+            m_request += (char) (n >> 8);
+            m_request += (char) (n & 0xFF);
+            m_request.append(n, 'x');
+        }
+    }
+
+    //  @a conn ϷһʱӴ @a start 
+    void Dispatch(Conn &conn, Clock::time_point start,
+                  Clock::time_point now) {
+        conn.busy = true;
+        conn.start = start;
+        conn.deadline = now + chrono::milliseconds(gs_timeout);
+        conn.gotBytes = false;
+
+        if (conn.phase == Conn::P_IDLE) {
+            conn.reused = true;
+            SendRequest(conn);
+        }
+        else {
+            conn.reused = false;
+            Open(conn);
+        }
+    }
+
+    void Open(Conn &conn) {
+        conn.sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (conn.sd == INVALID_SOCKET || !SetNonBlocking(conn.sd)) {
+            Fail(conn);
+            return;
+        }
+
+        int on = 1;
+        setsockopt(conn.sd, IPPROTO_TCP, TCP_NODELAY, (const char *) &on,
+                   sizeof(on));
+
+        if (connect(conn.sd, (const sockaddr *) &gs_proxy,
+                    sizeof(gs_proxy)) != 0 &&
+            LastError() != ERR_INPROGRESS) {
+            Fail(conn);
+            return;
+        }
+
+        conn.phase = Conn::P_CONNECTING;
+        conn.in.clear();
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+
+    void SendRequest(Conn &conn) {
+        conn.phase = Conn::P_RESPONSE;
+        conn.out = m_request;
+        conn.outPos = 0;
+
+        if (gs_opaque) {
+            conn.parser.ResetOpaque(m_request.size());
+        }
+        else {
+            conn.parser.Reset(false);
+        }
+
+        m_stats.txBytes += m_request.size();
+    }
+
+    void OnEvents(Conn &conn, short revents, Clock::time_point now) {
+        if (conn.phase == Conn::P_CONNECTING) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(conn.sd, SOL_SOCKET, SO_ERROR, (char *) &err, &len);
+
+            if (err != 0 || (revents & POLLOUT) == 0) {
+                Fail(conn);
+                return;
+            }
+
+            m_stats.connects++;
+
+            if (gs_tunnel) {
+                conn.phase = Conn::P_HANDSHAKE;
+                conn.out = m_connect;
+                conn.outPos = 0;
+                conn.parser.Reset(true);
+            }
+            else {
+                SendRequest(conn);
+            }
+
+            revents = POLLOUT;
+        }
+
+        if ((revents & POLLOUT) && conn.outPos < conn.out.size()) {
+            int n = (int) send(conn.sd, conn.out.data() + conn.outPos,
+                               (int) (conn.out.size() - conn.outPos),
+                               SEND_FLAGS);
+
+            if (n > 0) {
+                conn.outPos += n;
+            }
+            else if (LastError() != ERR_WOULDBLOCK) {
+                OnBroken(conn);
+                return;
+            }
+        }
+
+        if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            OnReadable(conn, now);
+        }
+    }
+
+    void OnReadable(Conn &conn, Clock::time_point now) {
+        char buf[65536];
+        bool eof = false;
+
+        while (true) {
+            int n = (int) recv(conn.sd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                conn.in.append(buf, n);
+                conn.gotBytes = true;
+                m_stats.rxBytes += n;
+            }
+            else if (n == 0 || LastError() != ERR_WOULDBLOCK) {
+                eof = true;
+                break;
+            }
+            else {
+                break;
+            }
+        }
+
+        // е keep-alive ӱԶ˹ر
+        if (conn.phase == Conn::P_IDLE) {
+            if (eof || !conn.in.empty()) {
+                Close(conn);
+            }
+
+            return;
+        }
+
+        switch (conn.parser.Parse(conn.in)) {
+        case ResponseParser::R_DONE:
+            if (conn.phase == Conn::P_HANDSHAKE) {
+                if (conn.parser.GetStatus() != 200) {
+                    Fail(conn);
+                    return;
+                }
+
+                SendRequest(conn);
+                OnEvents(conn, POLLOUT, now);
+            }
+            else {
+                Complete(conn, now);
+            }
+
+            return;
+
+        case ResponseParser::R_ERROR:
+            Fail(conn);
+            return;
+
+        case ResponseParser::R_NEED_MORE:
+            break;
+        }
+
+        if (eof) {
+            if (conn.phase == Conn::P_RESPONSE && conn.parser.OnEof()) {
+                Complete(conn, now);
+                Close(conn);
+            }
+            else {
+                OnBroken(conn);
+            }
+        }
+    }
+
+    void Complete(Conn &conn, Clock::time_point now) {
+        auto us = chrono::duration_cast<chrono::microseconds>(
+            now - conn.start).count();
+
+        m_stats.latencies.push_back((uint32_t) us);
+        m_stats.requests++;
+
+        if (conn.parser.GetStatus() / 100 != 2) {
+            m_stats.non2xx++;
+        }
+
+        conn.busy = false;
+        conn.in.clear();
+
+        if (gs_keepAlive && conn.parser.IsKeepAlive()) {
+            conn.phase = Conn::P_IDLE;
+        }
+        else {
+            Close(conn);
+        }
+    }
+
+    // ӳ򱻹ر
+    //
+    // õӿǡڷʱԶ˹رգʱһΡ
+    void OnBroken(Conn &conn) {
+        if (conn.reused && !conn.gotBytes && conn.phase == Conn::P_RESPONSE) {
+            auto start = conn.start;
+            auto deadline = conn.deadline;
+
+            Close(conn);
+
+            conn.busy = true;
+            conn.start = start;
+            conn.deadline = deadline;
+            conn.reused = false;
+            Open(conn);
+
+            return;
+        }
+
+        Fail(conn);
+    }
+
+    void Fail(Conn &conn) {
+        m_stats.errors++;
+        Close(conn);
+    }
+
+    void Close(Conn &conn) {
+        if (conn.sd != INVALID_SOCKET) {
+            CLOSE_SOCKET(conn.sd);
+            conn.sd = INVALID_SOCKET;
+        }
+
+        conn.phase = Conn::P_CLOSED;
+        conn.busy = false;
+        conn.in.clear();
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+
+private:
+
+    vector<Conn> m_conns;
+    double m_rate;
+    Stats &m_stats;
+
+    string m_request;
+    string m_connect;
+
+    deque<Clock::time_point> m_pending; // ѵڡδ
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+static void Report(vector<Stats> &all, double seconds) {
+    Stats total;
+    for (auto &s : all) {
+        total.latencies.insert(total.latencies.end(),
+                               s.latencies.begin(), s.latencies.end());
+        total.requests += s.requests;
+        total.non2xx += s.non2xx;
+        total.errors += s.errors;
+        total.timeouts += s.timeouts;
+        total.connects += s.connects;
+        total.rxBytes += s.rxBytes;
+        total.txBytes += s.txBytes;
+        total.backlog += s.backlog;
+    }
+
+    printf("requests: %llu, non-2xx: %llu, errors: %llu, timeouts: %llu\n",
+           (unsigned long long) total.requests,
+           (unsigned long long) total.non2xx,
+           (unsigned long long) total.errors,
+           (unsigned long long) total.timeouts);
+    printf("connects: %llu", (unsigned long long) total.connects);
+    if (gs_rate > 0) {
+        printf(", backlog: %llu", (unsigned long long) total.backlog);
+    }
+    printf("\n");
+
+    printf("rps: %.1f\n", total.requests / seconds);
+    printf("throughput: rx %.2f MB/s, tx %.2f MB/s\n",
+           total.rxBytes / seconds / 1e6, total.txBytes / seconds / 1e6);
+
+    auto &lat = total.latencies;
+    if (lat.empty()) {
+        return;
+    }
+
+    sort(lat.begin(), lat.end());
+
+    double sum = 0;
+    for (auto us : lat) {
+        sum += us;
+    }
+
+    auto at = [&](double q) {
+        size_t index = (size_t) (q * (lat.size() - 1) + 0.5);
+        return lat[index] / 1000.0;
+    };
+
+    printf("latency (ms): mean %.3f, min %.3f, p50 %.3f, p90 %.3f, "
+           "p99 %.3f, p99.9 %.3f, max %.3f\n",
+           sum / lat.size() / 1000, lat.front() / 1000.0,
+           at(0.5), at(0.9), at(0.99), at(0.999), lat.back() / 1000.0);
+}
+
+static void Usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-x proxy] [-t target] [-m http|connect|tunnel] "
+            "[-c conns] [-T threads] [-d seconds] [-r rate] [-b body_bytes] "
+            "[-p path] [-K] [-o timeout_ms]\n"
+            "proxy and target must be loopback addresses (ip:port).\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    string proxy = "127.0.0.1:1990";
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-x" && hasValue) {
+            proxy = argv[++i];
+        }
+        else if (arg == "-t" && hasValue) {
+            gs_target = argv[++i];
+        }
+        else if (arg == "-m" && hasValue) {
+            string mode = argv[++i];
+            if (mode != "http" && mode != "connect" && mode != "tunnel") {
+                Usage(argv[0]);
+                return 1;
+            }
+
+            gs_tunnel = mode != "http";
+            gs_opaque = mode == "tunnel";
+        }
+        else if (arg == "-c" && hasValue) {
+            gs_numConns = atoi(argv[++i]);
+        }
+        else if (arg == "-T" && hasValue) {
+            gs_numThreads = atoi(argv[++i]);
+        }
+        else if (arg == "-d" && hasValue) {
+            gs_duration = atoi(argv[++i]);
+        }
+        else if (arg == "-r" && hasValue) {
+            gs_rate = atof(argv[++i]);
+        }
+        else if (arg == "-b" && hasValue) {
+            gs_bodySize = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "-p" && hasValue) {
+            gs_path = argv[++i];
+        }
+        else if (arg == "-K") {
+            gs_keepAlive = false;
+        }
+        else if (arg == "-o" && hasValue) {
+            gs_timeout = atoi(argv[++i]);
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    sockaddr_in target;
+    if (!ParseLoopback(proxy, gs_proxy) ||
+        !ParseLoopback(gs_target, target)) {
+        fprintf(stderr, "Only loopback addresses are allowed.\n");
+        Usage(argv[0]);
+        return 1;
+    }
+
+    if (gs_numConns < 1 || gs_numThreads < 1 || gs_duration < 1 ||
+        gs_rate < 0 || gs_timeout < 1) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    gs_numThreads = min(gs_numThreads, gs_numConns);
+
+    if (gs_opaque && gs_bodySize == 0) {
+        gs_bodySize = 1024;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    printf("%s %s via %s, %d connection(s), %d thread(s), %s, %d s\n",
+           gs_opaque ? "TUNNEL" : gs_tunnel ? "CONNECT" : "HTTP",
+           gs_target.c_str(), proxy.c_str(),
+           gs_numConns, gs_numThreads,
+           gs_rate > 0 ? (to_string((long long) gs_rate) + " req/s").c_str()
+                       : "closed loop",
+           gs_duration);
+    fflush(stdout);
+
+    vector<Stats> stats(gs_numThreads);
+    vector<thread> threads;
+
+    auto begin = Clock::now();
+    auto end = begin + chrono::seconds(gs_duration);
+
+    for (int i = 0; i < gs_numThreads; i++) {
+        int numConns = gs_numConns / gs_numThreads +
+                       (i < gs_numConns % gs_numThreads ? 1 : 0);
+
+        // ̵߳㣬ʹϲ
+        auto offset = chrono::duration_cast<Clock::duration>(
+            chrono::duration<double>(gs_rate > 0 ? i / gs_rate : 0));
+
+        threads.emplace_back([&, i, numConns, offset] {
+            Worker worker(numConns, gs_rate / gs_numThreads, stats[i]);
+            worker.Run(begin + offset, end);
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    double seconds = chrono::duration<double>(Clock::now() - begin).count();
+    Report(stats, seconds);
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+
+//  Logger һ˵Ŀ
+//
+// ÷LoggerBench [߳] [ÿ̼߳¼] [Ϣ]
+//
+// ÿ߳־ͳƽÿ¼ڵ߳ϻѵ
+// Լ򻺳ļ¼־
+
+#include "../../Logger.hpp"
+#include "../../Clock.hpp"
+
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+    int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+    int numRecords = argc > 2 ? atoi(argv[2]) : 100000;
+    int msgLen = argc > 3 ? atoi(argv[3]) : 64;
+
+    Logger::CONSOLE = false;
+    Logger::LEVEL = Logger::OL_INFO;
+
+    std::string msg(msgLen, 'x');
+    std::vector<int64_t> elapsed(numThreads);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i] {
+            // һ¼䱾̵߳Ļ
+            Logger::LogInfo("warm up");
+
+            int64_t begin = Clock::Now();
+            for (int j = 0; j < numRecords; j++) {
+                Logger::LogInfo(msg);
+            }
+
+            elapsed[i] = Clock::Now() - begin;
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    int64_t total = 0;
+    for (auto e : elapsed) {
+        total += e;
+    }
+
+    double records = (double) numThreads * numRecords;
+    int64_t flushBegin = Clock::Now();
+    Logger::Flush();
+    double flushMs = Clock::ToSeconds(Clock::Now() - flushBegin) * 1000;
+
+    printf("threads: %d, records/thread: %d, message: %d bytes\n",
+           numThreads, numRecords, msgLen);
+    printf("producer: %.1f ns/record\n",
+           Clock::ToNanoseconds(total) / records);
+    printf("dropped: %llu (%.2f%%)\n", Logger::GetDroppedCount(),
+           Logger::GetDroppedCount() * 100 / records);
+    printf("final flush: %.1f ms\n", flushMs);
+
+    Logger::Stop();
+    return 0;
+}
@@ -0,0 +1,379 @@
+
+// ȵ·΢׼
+//
+// ÷MicroBench [-t max_threads] [-s seconds] [-f filter]
+//
+//   -t  ߳Ŀ߳ĬΪ CPU  1 ʼ
+//   -s  ÿ̲ʱ䣨룬Ĭ 0.5
+//   -f  ְֻӴĿ
+//
+//  Request::Headers::Parse()Request::FilterBrowserHeaders()
+// MemoryPool ķաTxContext::Init() Լ DNSCache 
+// Resolve()  Add()
+//
+// ÿһ JSON ׼ڱȽϲͬĹ
+//
+//   {"bench":"headers_parse","param":"browser","threads":1,
+//    "ops":5000000,"ns_per_op":85.3,"mops":11.72}
+//
+// ns_per_op ǵ߳ÿβƽʱmops ̺߳ϼƵ
+// /룩
+
+#include "../../Request.hpp"
+#include "../../PerIoContext.hpp"
+#include "../../DNSCache.hpp"
+#include "../../Clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+
+static int gs_maxThreads = 0;
+static double gs_minSeconds = 0.5;
+static std::string gs_filter;
+
+// ֹ뱻Ż
+static std::atomic<size_t> gs_sink(0);
+
+// ͵󣨾ɴ˴о URL  Proxy-Connection
+static const char BROWSER_REQUEST[] =
+    "GET http://www.example.com/static/js/app.min.js?v=20180301 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Proxy-Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/64.0.3282.186 "
+    "Safari/537.36\r\n"
+    "Accept: */*\r\n"
+    "Referer: http://www.example.com/\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: sid=4f9a0c3e2b1d; _ga=GA1.2.123456789.1519862400; "
+    "theme=dark\r\n"
+    "If-None-Match: \"5a97c0b1-1f3a\"\r\n"
+    "\r\n";
+
+// ͵ķӦ
+static const char SERVER_RESPONSE[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Server: nginx/1.12.2\r\n"
+    "Date: Thu, 01 Mar 2018 08:00:00 GMT\r\n"
+    "Content-Type: application/javascript; charset=utf-8\r\n"
+    "Content-Length: 7994\r\n"
+    "Last-Modified: Thu, 01 Mar 2018 07:59:13 GMT\r\n"
+    "Connection: keep-alive\r\n"
+    "ETag: \"5a97c0b1-1f3a\"\r\n"
+    "Cache-Control: max-age=31536000\r\n"
+    "Accept-Ranges: bytes\r\n"
+    "\r\n";
+
+//////////////////////////////////////////////////////////////////////////
+
+///  Request ˽гԱ
+class RequestBench {
+public:
+
+    RequestBench() : m_req(new Request) {}
+
+    ~RequestBench() {
+        delete m_req;
+    }
+
+    ///  0 βͷֶĿ
+    size_t Parse(const char *buf, bool browser) {
+        m_req->m_headers.Parse(buf, browser);
+        return m_req->m_headers.m.size();
+    }
+
+    /// д󣬷ظдĳ
+    ///
+    /// д޸ͷ뻺ÿζҪ½
+    size_t ParseAndFilter(const char *buf, size_t len) {
+        m_req->m_vbuf.assign(buf, buf + len + 1); // β 0
+        m_req->m_headers.Parse(m_req->m_vbuf.data(), true);
+        m_req->FilterBrowserHeaders();
+
+        return m_req->m_vbuf.size();
+    }
+
+private:
+
+    RequestBench(const RequestBench &) = delete;
+    RequestBench &operator=(const RequestBench &) = delete;
+
+    Request *m_req;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// һִ߳ @a n β
+typedef std::function<void(int thread, int64_t n)> Body;
+
+// ߳ͬʱʼִ @a body̵߳ĺʱ룩
+static double RunThreads(int numThreads, int64_t n, const Body &body,
+                         double &threadSeconds) {
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<int64_t> elapsed(numThreads);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i] {
+            ready++;
+            while (!go) {
+                std::this_thread::yield();
+            }
+
+            int64_t begin = Clock::Now();
+            body(i, n);
+            elapsed[i] = Clock::Now() - begin;
+        });
+    }
+
+    while (ready < numThreads) {
+        std::this_thread::yield();
+    }
+
+    int64_t begin = Clock::Now();
+    go = true;
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    double wall = Clock::ToSeconds(Clock::Now() - begin);
+
+    threadSeconds = 0;
+    for (auto e : elapsed) {
+        threadSeconds += Clock::ToSeconds(e);
+    }
+
+    return wall;
+}
+
+// һԲ
+//
+// ԵĴУʱԼΪ #gs_minSeconds Ĵʽ
+static void Bench(const char *name, const std::string &param, int numThreads,
+                  const Body &body) {
+    std::string fullName = std::string(name) + "/" + param;
+    if (!gs_filter.empty() && fullName.find(gs_filter) == std::string::npos) {
+        return;
+    }
+
+    double threadSeconds;
+    int64_t n = 64;
+
+    while (true) {
+        double wall = RunThreads(numThreads, n, body, threadSeconds);
+        if (wall >= gs_minSeconds / 10) {
+            n = (int64_t) (n * gs_minSeconds / wall) + 1;
+            break;
+        }
+
+        n *= 4;
+    }
+
+    double wall = RunThreads(numThreads, n, body, threadSeconds);
+    int64_t ops = n * numThreads;
+
+    printf("{\"bench\":\"%s\",\"param\":\"%s\",\"threads\":%d,"
+           "\"ops\":%lld,\"ns_per_op\":%.2f,\"mops\":%.3f}\n",
+           name, param.c_str(), numThreads, (long long) ops,
+           threadSeconds * 1e9 / ops, ops / wall / 1e6);
+    fflush(stdout);
+}
+
+//  1, 2, 4, ... #gs_maxThreads ̷ֱ߳
+static void BenchThreads(const char *name, const std::string &param,
+                         const Body &body) {
+    for (int t = 1; ; t *= 2) {
+        t = std::min(t, gs_maxThreads);
+        Bench(name, param, t, body);
+
+        if (t == gs_maxThreads) {
+            break;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static void BenchHeaders() {
+    for (int browser = 1; browser >= 0; browser--) {
+        const char *buf = browser ? BROWSER_REQUEST : SERVER_RESPONSE;
+
+        Bench("headers_parse", browser ? "browser" : "server", 1,
+              [=](int, int64_t n) {
+            RequestBench rb;
+            size_t sink = 0;
+
+            for (int64_t i = 0; i < n; i++) {
+                sink += rb.Parse(buf, browser != 0);
+            }
+
+            gs_sink += sink;
+        });
+    }
+
+    Bench("filter_browser_headers", "with_parse", 1, [](int, int64_t n) {
+        RequestBench rb;
+        size_t sink = 0;
+
+        for (int64_t i = 0; i < n; i++) {
+            sink += rb.ParseAndFilter(BROWSER_REQUEST,
+                                      sizeof(BROWSER_REQUEST) - 1);
+        }
+
+        gs_sink += sink;
+    });
+}
+
+static void BenchMemoryPool() {
+    // ÿȡһȫ黹ģͬʱ;Ķ
+    const int BATCH = 16;
+
+    BenchThreads("memory_pool", "tx_context_x16", [](int, int64_t n) {
+        auto &pool = TxContextPool::GetInstance();
+        TxContext *nodes[BATCH];
+
+        for (int64_t i = 0; i < n; i++) {
+            for (int j = 0; j < BATCH; j++) {
+                nodes[j] = pool.Allocate();
+            }
+
+            for (int j = 0; j < BATCH; j++) {
+                pool.DeAllocate(nodes[j]);
+            }
+        }
+    });
+}
+
+// صķ
+static void BenchTxContext() {
+    static const int LENGTHS[] = {
+        64, 1460, kBufferSize, kBufferSize + 1, kBufferSize * 4, 65536,
+    };
+
+    static std::vector<char> data(65536, 'x');
+
+    for (int len : LENGTHS) {
+        BenchThreads("tx_context_init", std::to_string(len),
+                     [=](int, int64_t n) {
+            TxContext tc;
+
+            for (int64_t i = 0; i < n; i++) {
+                tc.Init(INVALID_SOCKET, data.data(), len);
+                tc.Reset();
+            }
+        });
+    }
+}
+
+static void BenchDNSCache() {
+    const int NUM_NAMES = 1024;
+
+    std::vector<std::string> names;
+    for (int i = 0; i < NUM_NAMES; i++) {
+        names.push_back("host" + std::to_string(i) + ".example.com:80");
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(80);
+    addr.sin_addr.s_addr = htonl(0x0A000001);
+
+    DNSCache::AI ai;
+    memset(&ai, 0, sizeof(ai));
+    ai.ai_family = AF_INET;
+    ai.ai_socktype = SOCK_STREAM;
+    ai.ai_protocol = IPPROTO_TCP;
+    ai.ai_addrlen = sizeof(addr);
+    ai.ai_addr = (sockaddr *) &addr;
+
+    for (auto &name : names) {
+        DNSCache::Add(name, ai, 3600);
+    }
+
+    // ÿ @a addEvery βһ Add()Ϊе Resolve()
+    auto body = [&](int addEvery) -> Body {
+        return [&, addEvery](int thread, int64_t n) {
+            size_t sink = 0;
+            unsigned index = (unsigned) thread * 7919;
+
+            for (int64_t i = 0; i < n; i++) {
+                index = index * 1103515245 + 12345;
+                const std::string &name = names[(index >> 8) % NUM_NAMES];
+
+                if (addEvery > 0 && i % addEvery == 0) {
+                    DNSCache::Add(name, ai, 3600);
+                }
+                else {
+                    DNSCache::AI *result = DNSCache::Resolve(name);
+                    sink += result != nullptr;
+                    DNSCache::DestroyAddrInfo(result);
+                }
+            }
+
+            gs_sink += sink;
+        };
+    };
+
+    BenchThreads("dns_cache", "resolve", body(0));
+    BenchThreads("dns_cache", "resolve_add_10pct", body(10));
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+    gs_maxThreads = (int) std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-t" && hasValue) {
+            gs_maxThreads = atoi(argv[++i]);
+        }
+        else if (arg == "-s" && hasValue) {
+            gs_minSeconds = atof(argv[++i]);
+        }
+        else if (arg == "-f" && hasValue) {
+            gs_filter = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [-t max_threads] [-s seconds] "
+                    "[-f filter]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (gs_maxThreads < 1) {
+        gs_maxThreads = 1;
+    }
+
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+
+    Logger::CONSOLE = false;
+
+    BenchHeaders();
+    BenchMemoryPool();
+    BenchTxContext();
+    BenchDNSCache();
+
+    fprintf(stderr, "sink: %llu\n", (unsigned long long) gs_sink.load());
+
+    Logger::Stop();
+    WSACleanup();
+
+    return 0;
+}
@@ -0,0 +1,600 @@
+
+// ׼ʹõıԴվ
+//
+// ÷OriginServer [-p port] [-T threads] [-s size|min-max] [-C] [-k chunk]
+//                    [-c] [-d delay_ms] [-S seed] [-v]
+//
+//   -p  ˿ڣĬ 8000ֻ 127.0.0.1
+//   -T  ߳Ĭ 2
+//   -s  ӦĵĳȣĬ 1024min-max ʾھ
+//   -C   chunked 뷢ģʹ Content-Length
+//   -k  chunked ʱÿĳȣĬ 16384
+//   -c  ÿӦ֮رӣѭ keep-alive 
+//   -d  յ֮󡢷Ӧײ֮ǰӳ٣룩ģ TTFB
+//   -S  ȵӣĬ 1ͬÿ̲߳ͬ
+//   -v  ӡÿ
+//
+//  URL ã /?size=65536&chunked=1&delay=20
+// Ϊ sizechunkedclosedelayֻ֧ Content-Length
+//
+// ϵĵһֽĸΪ CONNECT еĲ͸
+//  TLS ¼˺ԭյݣһλͬ -d ӳ١
+//
+// ÿ߳ poll() Լܵӣ Windows  Linux ϱ롣
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#  define CLOSE_SOCKET closesocket
+#  define poll WSAPoll
+#  define ERR_WOULDBLOCK WSAEWOULDBLOCK
+#  define SEND_FLAGS 0
+#else
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <arpa/inet.h>
+#  include <poll.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+typedef int SOCKET;
+#  define INVALID_SOCKET (-1)
+#  define CLOSE_SOCKET close
+#  define ERR_WOULDBLOCK EWOULDBLOCK
+#  define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef chrono::steady_clock Clock;
+
+// Ӧãɱ URL 
+struct Settings {
+    size_t minSize = 1024;
+    size_t maxSize = 1024;
+    bool chunked = false;
+    bool close = false;
+    int delay = 0;
+};
+
+static Settings gs_defaults;
+static size_t gs_chunkSize = 16384;
+static unsigned gs_seed = 1;
+static bool gs_verbose = false;
+
+static SOCKET gs_listener = INVALID_SOCKET;
+
+// õ
+static const string gs_filler(65536, 'x');
+
+static int LastError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+static bool SetNonBlocking(SOCKET sd) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(sd, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(sd, F_GETFL, 0);
+    return flags >= 0 && fcntl(sd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+//  URL Ĳѯȡʱ false
+static bool GetParam(const string &target, const char *name, string &value) {
+    size_t q = target.find('?');
+    if (q == string::npos) {
+        return false;
+    }
+
+    size_t len = strlen(name);
+    size_t begin = q + 1;
+
+    while (begin < target.size()) {
+        size_t end = target.find('&', begin);
+        if (end == string::npos) {
+            end = target.size();
+        }
+
+        if (target.compare(begin, len, name) == 0 &&
+            begin + len < end && target[begin + len] == '=') {
+            value = target.substr(begin + len + 1, end - begin - len - 1);
+            return true;
+        }
+
+        begin = end + 1;
+    }
+
+    return false;
+}
+
+//  "n"  "min-max"
+static bool ParseSize(const string &s, size_t &minSize, size_t &maxSize) {
+    char *end;
+    minSize = maxSize = strtoull(s.c_str(), &end, 10);
+
+    if (*end == '-') {
+        maxSize = strtoull(end + 1, &end, 10);
+    }
+
+    return *end == 0 && minSize <= maxSize;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// һ
+struct Conn {
+    SOCKET sd = INVALID_SOCKET;
+
+    string in;
+    string out; // ͵ݣİ
+    size_t outPos = 0;
+
+    bool started = false; // Ƿյ
+    bool opaque = false; // ͸ԭ
+    bool echoed = false; // ͸ǷѻԹ
+
+    bool responding = false; // ڷͻӦ
+    Clock::time_point due; // ʼ͵ʱ
+
+    uint64_t bodyLeft = 0; // δɵĳ
+    bool chunked = false;
+    bool closeAfter = false; // Ӧر
+    size_t skip = 0; // δյ趪
+};
+
+// һ߳
+class Worker {
+public:
+
+    explicit Worker(int index) : m_rng(gs_seed + index) {}
+
+    void Run() {
+        vector<pollfd> fds;
+        vector<Conn *> polled;
+
+        while (true) {
+            auto now = Clock::now();
+            auto wake = now + chrono::milliseconds(100);
+
+            fds.clear();
+            polled.clear();
+
+            pollfd lfd;
+            lfd.fd = gs_listener;
+            lfd.events = POLLIN;
+            lfd.revents = 0;
+            fds.push_back(lfd);
+            polled.push_back(nullptr);
+
+            for (auto &conn : m_conns) {
+                pollfd pfd;
+                pfd.fd = conn.sd;
+                pfd.events = 0;
+                pfd.revents = 0;
+
+                if (!conn.responding) {
+                    pfd.events |= POLLIN;
+                }
+                else if (conn.due <= now) {
+                    pfd.events |= POLLOUT;
+                }
+                else if (conn.due < wake) {
+                    wake = conn.due;
+                }
+
+                fds.push_back(pfd);
+                polled.push_back(&conn);
+            }
+
+            auto ms = chrono::duration_cast<chrono::milliseconds>(
+                wake - now).count();
+
+            if (poll(fds.data(), (unsigned) fds.size(),
+                     (int) max<decltype(ms)>(ms, 0)) < 0) {
+                perror("poll");
+                return;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                Accept();
+            }
+
+            for (size_t i = 1; i < fds.size(); i++) {
+                Conn &conn = *polled[i];
+                bool ok = true;
+
+                if (fds[i].revents & POLLOUT) {
+                    ok = OnWritable(conn);
+                }
+                else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    ok = OnReadable(conn);
+                }
+
+                if (!ok) {
+                    CLOSE_SOCKET(conn.sd);
+                    conn.sd = INVALID_SOCKET;
+                }
+            }
+
+            m_conns.remove_if([](const Conn &conn) {
+                return conn.sd == INVALID_SOCKET;
+            });
+        }
+    }
+
+private:
+
+    void Accept() {
+        while (true) {
+            SOCKET sd = accept(gs_listener, nullptr, nullptr);
+            if (sd == INVALID_SOCKET) {
+                return;
+            }
+
+            int on = 1;
+            setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, (const char *) &on,
+                       sizeof(on));
+
+            if (!SetNonBlocking(sd)) {
+                CLOSE_SOCKET(sd);
+                continue;
+            }
+
+            m_conns.emplace_back();
+            m_conns.back().sd = sd;
+        }
+    }
+
+    //  false ʾӦر
+    bool OnReadable(Conn &conn) {
+        char buf[65536];
+
+        int n = (int) recv(conn.sd, buf, sizeof(buf), 0);
+        if (n == 0 || (n < 0 && LastError() != ERR_WOULDBLOCK)) {
+            return false;
+        }
+
+        if (n < 0) {
+            return true;
+        }
+
+        if (conn.skip > 0) {
+            size_t skipped = min<size_t>(conn.skip, n);
+            conn.skip -= skipped;
+            conn.in.append(buf + skipped, n - skipped);
+        }
+        else {
+            conn.in.append(buf, n);
+        }
+
+        if (conn.in.empty()) {
+            return true;
+        }
+
+        if (!conn.started) {
+            conn.started = true;
+            conn.opaque = !isalpha((unsigned char) conn.in[0]);
+        }
+
+        if (conn.opaque) {
+            conn.out.swap(conn.in);
+            conn.in.clear();
+            conn.outPos = 0;
+            conn.responding = true;
+            conn.due = Clock::now();
+
+            if (!conn.echoed) {
+                conn.echoed = true;
+                conn.due += chrono::milliseconds(gs_defaults.delay);
+            }
+
+            return true;
+        }
+
+        return TryRequest(conn);
+    }
+
+    // ͷʱ׼Ӧ
+    bool TryRequest(Conn &conn) {
+        size_t end = conn.in.find("\r\n\r\n");
+        if (end == string::npos) {
+            return conn.in.size() < 65536;
+        }
+
+        string header = conn.in.substr(0, end + 2);
+
+        char method[16], target[4096];
+        int minor;
+        if (sscanf(header.c_str(), "%15s %4095s HTTP/1.%d",
+                   method, target, &minor) != 3) {
+            return false;
+        }
+
+        bool keepAlive = minor >= 1;
+        uint64_t length = 0;
+
+        size_t begin = header.find("\r\n") + 2;
+        while (begin < header.size()) {
+            size_t lineEnd = header.find("\r\n", begin);
+            string line = header.substr(begin, lineEnd - begin);
+            begin = lineEnd + 2;
+
+            for (auto &c : line) {
+                c = (char) tolower((unsigned char) c);
+            }
+
+            if (line.compare(0, 15, "content-length:") == 0) {
+                length = strtoull(line.c_str() + 15, nullptr, 10);
+            }
+            else if (line.compare(0, 11, "connection:") == 0 ||
+                     line.compare(0, 17, "proxy-connection:") == 0) {
+                if (line.find("close") != string::npos) {
+                    keepAlive = false;
+                }
+                else if (line.find("keep-alive") != string::npos) {
+                    keepAlive = true;
+                }
+            }
+        }
+
+        // 
+        conn.in.erase(0, end + 4);
+        size_t consumed = min<size_t>(length, conn.in.size());
+        conn.in.erase(0, consumed);
+        conn.skip = (size_t) (length - consumed);
+
+        Settings s = gs_defaults;
+        string value;
+
+        if (GetParam(target, "size", value) &&
+            !ParseSize(value, s.minSize, s.maxSize)) {
+            return false;
+        }
+        if (GetParam(target, "chunked", value)) {
+            s.chunked = value != "0";
+        }
+        if (GetParam(target, "close", value)) {
+            s.close = value != "0";
+        }
+        if (GetParam(target, "delay", value)) {
+            s.delay = atoi(value.c_str());
+        }
+
+        uint64_t size = s.minSize;
+        if (s.maxSize > s.minSize) {
+            size = uniform_int_distribution<uint64_t>(s.minSize,
+                                                      s.maxSize)(m_rng);
+        }
+
+        if (strcmp(method, "HEAD") == 0) {
+            size = 0;
+        }
+
+        conn.closeAfter = s.close || !keepAlive;
+        conn.chunked = s.chunked;
+        conn.bodyLeft = size;
+
+        conn.out = "HTTP/1.1 200 OK\r\n"
+                   "Content-Type: application/octet-stream\r\n";
+        conn.out += s.chunked ? string("Transfer-Encoding: chunked\r\n")
+                              : "Content-Length: " + to_string(size) + "\r\n";
+        conn.out += conn.closeAfter ? "Connection: close\r\n\r\n"
+                                    : "Connection: keep-alive\r\n\r\n";
+
+        if (s.chunked && size == 0) {
+            conn.out += "0\r\n\r\n";
+        }
+
+        conn.outPos = 0;
+        conn.responding = true;
+        conn.due = Clock::now() + chrono::milliseconds(s.delay);
+
+        if (gs_verbose) {
+            printf("%s %s -> %llu bytes%s%s\n", method, target,
+                   (unsigned long long) size, s.chunked ? ", chunked" : "",
+                   conn.closeAfter ? ", close" : "");
+            fflush(stdout);
+        }
+
+        return true;
+    }
+
+    // ͵ݲʱɺ
+    void Fill(Conn &conn) {
+        if (conn.outPos > 0 && conn.outPos == conn.out.size()) {
+            conn.out.clear();
+            conn.outPos = 0;
+        }
+
+        while (conn.bodyLeft > 0 && conn.out.size() - conn.outPos < 65536) {
+            size_t n;
+
+            if (conn.chunked) {
+                n = (size_t) min<uint64_t>(conn.bodyLeft, gs_chunkSize);
+
+                char size[32];
+                snprintf(size, sizeof(size), "%zx\r\n", n);
+                conn.out += size;
+
+                for (size_t left = n; left > 0;) {
+                    size_t piece = min(left, gs_filler.size());
+                    conn.out.append(gs_filler, 0, piece);
+                    left -= piece;
+                }
+
+                conn.out += "\r\n";
+            }
+            else {
+                n = (size_t) min<uint64_t>(conn.bodyLeft, gs_filler.size());
+                conn.out.append(gs_filler, 0, n);
+            }
+
+            conn.bodyLeft -= n;
+
+            if (conn.chunked && conn.bodyLeft == 0) {
+                conn.out += "0\r\n\r\n";
+            }
+        }
+    }
+
+    //  false ʾӦر
+    bool OnWritable(Conn &conn) {
+        Fill(conn);
+
+        int n = (int) send(conn.sd, conn.out.data() + conn.outPos,
+                           (int) (conn.out.size() - conn.outPos), SEND_FLAGS);
+
+        if (n < 0) {
+            return LastError() == ERR_WOULDBLOCK;
+        }
+
+        conn.outPos += n;
+        if (conn.outPos < conn.out.size() || conn.bodyLeft > 0) {
+            return true;
+        }
+
+        // Ӧѷ
+        conn.out.clear();
+        conn.outPos = 0;
+        conn.responding = false;
+
+        if (conn.opaque) {
+            return true;
+        }
+
+        if (conn.closeAfter) {
+            return false;
+        }
+
+        // ѻһˮߣ
+        return conn.in.empty() || TryRequest(conn);
+    }
+
+private:
+
+    list<Conn> m_conns;
+    mt19937_64 m_rng;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+static void Usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-T threads] [-s size|min-max] [-C] "
+            "[-k chunk] [-c] [-d delay_ms] [-S seed] [-v]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int port = 8000;
+    int numThreads = 2;
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-p" && hasValue) {
+            port = atoi(argv[++i]);
+        }
+        else if (arg == "-T" && hasValue) {
+            numThreads = atoi(argv[++i]);
+        }
+        else if (arg == "-s" && hasValue) {
+            if (!ParseSize(argv[++i], gs_defaults.minSize,
+                           gs_defaults.maxSize)) {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-C") {
+            gs_defaults.chunked = true;
+        }
+        else if (arg == "-k" && hasValue) {
+            gs_chunkSize = (size_t) atoi(argv[++i]);
+        }
+        else if (arg == "-c") {
+            gs_defaults.close = true;
+        }
+        else if (arg == "-d" && hasValue) {
+            gs_defaults.delay = atoi(argv[++i]);
+        }
+        else if (arg == "-S" && hasValue) {
+            gs_seed = (unsigned) atoi(argv[++i]);
+        }
+        else if (arg == "-v") {
+            gs_verbose = true;
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (numThreads < 1 || gs_chunkSize < 1) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    local.sin_port = htons((unsigned short) port);
+
+    gs_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    int on = 1;
+    setsockopt(gs_listener, SOL_SOCKET, SO_REUSEADDR, (const char *) &on,
+               sizeof(on));
+
+    if (gs_listener == INVALID_SOCKET ||
+        ::bind(gs_listener, (sockaddr *) &local, sizeof(local)) != 0 ||
+        listen(gs_listener, SOMAXCONN) != 0 ||
+        !SetNonBlocking(gs_listener)) {
+        fprintf(stderr, "Failed to listen on port %d\n", port);
+        return 2;
+    }
+
+    printf("OriginServer listening on 127.0.0.1:%d, %d thread(s), "
+           "body %zu-%zu bytes%s, delay %d ms\n", port, numThreads,
+           gs_defaults.minSize, gs_defaults.maxSize,
+           gs_defaults.chunked ? " chunked" : "", gs_defaults.delay);
+    fflush(stdout);
+
+    vector<thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([i] {
+            Worker(i).Run();
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    return 0;
+}
@@ -0,0 +1,1242 @@
+
+// ͨطŲ
+//
+// ÷Replay [-x proxy] [-t target] [-s speed] [-T threads] [-D]
+//              [-o timeout_ms] [-n max_conns] [-v] capture.bin
+//
+//   -x  ĵַĬ 127.0.0.1:1990
+//   -t  ԴվĵַĬ 127.0.0.1:8000ӦΪ OriginServer
+//   -s  ٶȱĬ 1ԭʼʱ򣩣2 ʾмһ
+//   -T  ߳Ĭ 4Ӱŷָ߳
+//   -D  Բ񵽵ֽʱӣٶȱΪԴվ delay 
+//   -o  ĳʱ룬Ĭ 10000
+//   -n  ֻطɸӣĬȫ
+//   -v  ӡÿ
+//
+// ļɴ Capture ɣ CaptureFormat.hppÿ
+// ӰԭʼĽʱ̽ϵĵһԭʼʱ̷
+// ֮һӦȴԭʼļٷӱԴվرպ
+// µʹµӡ
+//
+// ײĽṹؽ·״URL  Host
+// ָԴվδֵײԵȳ 'x' 䣬ԭʼͬ
+// һʹ Content-LengthԴվ URL  size ԭʼĻӦ
+// ĳȡȽ CONNECTٷԭʼϴȳĲ͸ݣ
+// ȴԴվԭԣֵԭʼĽʱ̡
+//
+//  LoadGen ͬʱͳƣԼƻʱ̵Ƴ٣lag
+// Ƴٽϴ˵طŶ˻ԭʼĽࡣ
+//
+// Դվֻǻػַ Windows  Linux ϱ롣
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#  define CLOSE_SOCKET closesocket
+#  define poll WSAPoll
+#  define ERR_WOULDBLOCK WSAEWOULDBLOCK
+#  define ERR_INPROGRESS WSAEWOULDBLOCK
+#  define SEND_FLAGS 0
+typedef int socklen_t;
+#else
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <arpa/inet.h>
+#  include <poll.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+typedef int SOCKET;
+#  define INVALID_SOCKET (-1)
+#  define CLOSE_SOCKET close
+#  define ERR_WOULDBLOCK EWOULDBLOCK
+#  define ERR_INPROGRESS EINPROGRESS
+#  define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#include "../../CaptureFormat.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace CaptureFormat;
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef chrono::steady_clock Clock;
+
+static sockaddr_in gs_proxy;
+static string gs_target = "127.0.0.1:8000";
+static double gs_speed = 1;
+static int gs_numThreads = 4;
+static bool gs_delay = false;
+static int gs_timeout = 10000;
+static size_t gs_maxConns = 0;
+static bool gs_verbose = false;
+
+static int LastError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+static bool SetNonBlocking(SOCKET sd) {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(sd, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(sd, F_GETFL, 0);
+    return flags >= 0 && fcntl(sd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+//  "ip:port"ֻܻػַ
+static bool ParseLoopback(const string &s, sockaddr_in &addr) {
+    size_t colon = s.rfind(':');
+    if (colon == string::npos) {
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short) atoi(s.c_str() + colon + 1));
+
+    if (inet_pton(AF_INET, s.substr(0, colon).c_str(),
+                  &addr.sin_addr) != 1) {
+        return false;
+    }
+
+    return (ntohl(addr.sin_addr.s_addr) >> 24) == 127 && addr.sin_port != 0;
+}
+
+// Ѳеʱ΢룩ٶȱΪطŵʱ
+static Clock::duration Scale(int64_t us) {
+    return chrono::duration_cast<Clock::duration>(
+        chrono::duration<double, micro>(max<int64_t>(us, 0) / gs_speed));
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// һ
+struct Captured {
+    RequestRecord rec;
+    string firstLine;
+    vector<pair<string, string>> headers; // δֵΪ
+
+    // δֵԭʼȣ headers һһӦ
+    vector<uint16_t> valueLengths;
+    vector<bool> kept;
+};
+
+// һӣ󰴿ʼȺ
+struct CapturedConn {
+    uint64_t id = 0;
+    uint64_t accept = 0; // Բʼ΢
+    vector<Captured> requests;
+};
+
+static bool Read(const char *path, vector<CapturedConn> &conns) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+
+    string data;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(fp);
+
+    FileHeader fh;
+    if (data.size() < sizeof(fh)) {
+        fprintf(stderr, "%s: truncated file header\n", path);
+        return false;
+    }
+
+    memcpy(&fh, data.data(), sizeof(fh));
+    if (memcmp(fh.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        fh.version != VERSION) {
+        fprintf(stderr, "%s: not a capture file (version %u)\n", path,
+                VERSION);
+        return false;
+    }
+
+    map<uint64_t, CapturedConn> byId;
+    size_t pos = sizeof(fh);
+
+    while (pos + sizeof(RecordHeader) <= data.size()) {
+        RecordHeader rh;
+        memcpy(&rh, data.data() + pos, sizeof(rh));
+        pos += sizeof(rh);
+
+        if (pos + rh.length > data.size()) {
+            fprintf(stderr, "%s: truncated record at %zu, ignored\n",
+                    path, pos);
+            break;
+        }
+
+        const char *p = data.data() + pos, *end = p + rh.length;
+        pos += rh.length;
+
+        if (rh.type != RT_REQUEST || rh.length < sizeof(RequestRecord)) {
+            continue;
+        }
+
+        Captured req;
+        memcpy(&req.rec, p, sizeof(req.rec));
+        p += sizeof(req.rec);
+
+        uint16_t len;
+        if (end - p < (ptrdiff_t) sizeof(len)) {
+            continue;
+        }
+
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        if (end - p < len) {
+            continue;
+        }
+
+        req.firstLine.assign(p, len);
+        p += len;
+
+        bool ok = true;
+        for (unsigned i = 0; i < req.rec.numHeaders && ok; i++) {
+            HeaderEntry he;
+            if (end - p < (ptrdiff_t) sizeof(he)) {
+                ok = false;
+                break;
+            }
+
+            memcpy(&he, p, sizeof(he));
+            p += sizeof(he);
+
+            size_t valueLen = he.kept ? he.valueLength : 0;
+            if ((size_t) (end - p) < he.nameLength + valueLen) {
+                ok = false;
+                break;
+            }
+
+            string name(p, he.nameLength);
+            p += he.nameLength;
+            string value(p, valueLen);
+            p += valueLen;
+
+            req.headers.emplace_back(name, value);
+            req.valueLengths.push_back(he.valueLength);
+            req.kept.push_back(he.kept != 0);
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s: malformed record, ignored\n", path);
+            continue;
+        }
+
+        CapturedConn &conn = byId[req.rec.conn];
+        conn.id = req.rec.conn;
+        conn.accept = req.rec.accept;
+        conn.requests.push_back(move(req));
+    }
+
+    for (auto &it : byId) {
+        auto &reqs = it.second.requests;
+        stable_sort(reqs.begin(), reqs.end(),
+                    [](const Captured &a, const Captured &b) {
+            return a.rec.request < b.rec.request;
+        });
+
+        conns.push_back(move(it.second));
+    }
+
+    sort(conns.begin(), conns.end(),
+         [](const CapturedConn &a, const CapturedConn &b) {
+        return a.accept != b.accept ? a.accept < b.accept : a.id < b.id;
+    });
+
+    return true;
+}
+
+static bool EqualsNoCase(const string &a, const char *b) {
+    return a.size() == strlen(b) &&
+           equal(a.begin(), a.end(), b, [](char x, char y) {
+        return tolower((unsigned char) x) == tolower((unsigned char) y);
+    });
+}
+
+// ؽΪ CONNECT 
+static string BuildRequest(const Captured &req) {
+    const RequestRecord &rec = req.rec;
+    bool tunnel = (rec.flags & F_TUNNEL) != 0;
+
+    string out;
+    if (tunnel) {
+        out = "CONNECT " + gs_target + " HTTP/1.1\r\n";
+    }
+    else {
+        //  URL 汾 URL ֻԴվ
+        const string &line = req.firstLine;
+        size_t sp1 = line.find(' ');
+        size_t sp2 = line.rfind(' ');
+        if (sp1 == string::npos || sp2 <= sp1) {
+            sp1 = line.size();
+            sp2 = string::npos;
+        }
+
+        string method = line.substr(0, sp1);
+        string url = sp2 != string::npos ? line.substr(sp1 + 1,
+                                                       sp2 - sp1 - 1) : "/";
+        string version = sp2 != string::npos ? line.substr(sp2 + 1)
+                                             : "HTTP/1.1";
+
+        size_t scheme = url.find("://");
+        if (scheme != string::npos) {
+            size_t slash = url.find('/', scheme + 3);
+            url = slash != string::npos ? url.substr(slash) : "/";
+        }
+
+        if (url.empty() || url[0] != '/') {
+            url = "/" + url;
+        }
+
+        uint64_t body = rec.outBytes;
+        if (rec.responseHeader > 0) {
+            body -= min<uint64_t>(body, rec.responseHeader);
+        }
+
+        url += url.find('?') == string::npos ? "?" : "&";
+        url += "size=" + to_string(body);
+
+        if (gs_delay && rec.firstByte > rec.request) {
+            url += "&delay=" +
+                   to_string((int) ((rec.firstByte - rec.request) / 1000 /
+                                    gs_speed));
+        }
+
+        out = method + " http://" + gs_target + url + " " + version + "\r\n";
+    }
+
+    out += "Host: " + gs_target + "\r\n";
+
+    for (size_t i = 0; i < req.headers.size(); i++) {
+        const string &name = req.headers[i].first;
+
+        if (EqualsNoCase(name, "Host") ||
+            EqualsNoCase(name, "Content-Length") ||
+            EqualsNoCase(name, "Transfer-Encoding") ||
+            EqualsNoCase(name, "Expect") ||
+            EqualsNoCase(name, "Upgrade")) {
+            continue;
+        }
+
+        out += name + ": ";
+        out += req.kept[i] ? req.headers[i].second
+                           : string(req.valueLengths[i], 'x');
+        out += "\r\n";
+    }
+
+    uint64_t upload = rec.inBytes - min<uint64_t>(rec.inBytes,
+                                                  rec.requestHeader);
+    if (!tunnel && upload > 0) {
+        out += "Content-Length: " + to_string(upload) + "\r\n";
+    }
+
+    out += "\r\n";
+
+    if (!tunnel) {
+        out.append((size_t) upload, 'x');
+    }
+
+    return out;
+}
+
+// з͵Ĳ͸ݣܳΪ @a size Ӧݼ¼
+// TLS ¼ĸʽÿ¼ĸز 16 KB
+static string BuildRecords(uint64_t size) {
+    string out;
+
+    for (uint64_t left = size; left > 0;) {
+        size_t n = (size_t) min<uint64_t>(left, 16384);
+        left -= n;
+
+        out += (char) 0x17;
+        out += (char) 0x03;
+        out += (char) 0x03;
+        out += (char) (n >> 8);
+        out += (char) (n & 0xFF);
+        out.append(n, 'x');
+    }
+
+    return out;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// ʽ HTTP Ӧ
+//
+// ֻϢ߽磬ֱӶ
+class ResponseParser {
+public:
+
+    enum Result {
+        R_NEED_MORE,
+        R_DONE,
+        R_ERROR,
+    };
+
+    // @param connectReply ǷΪ CONNECT ĻӦ2xx ʱûģ
+    void Reset(bool connectReply) {
+        m_state = S_HEADER;
+        m_connectReply = connectReply;
+        m_status = 0;
+        m_keepAlive = false;
+        m_remaining = 0;
+    }
+
+    // ȴ @a size ֽڵĲ͸ݣΪһɹĻӦ
+    void ResetOpaque(uint64_t size) {
+        m_state = S_BODY;
+        m_connectReply = false;
+        m_status = 200;
+        m_keepAlive = true;
+        m_remaining = size;
+    }
+
+    //  @a in еݲƳĵĲ
+    Result Parse(string &in) {
+        size_t pos = 0;
+        Result ret = R_NEED_MORE;
+
+        while (ret == R_NEED_MORE && pos < in.size()) {
+            ret = Step(in, pos);
+            if (ret == R_NEED_MORE && !m_progress) {
+                break;
+            }
+        }
+
+        in.erase(0, pos);
+        return ret;
+    }
+
+    // Զ˹رӣػӦǷʹ˽
+    bool OnEof() const {
+        return m_state == S_UNTIL_CLOSE;
+    }
+
+    int GetStatus() const {
+        return m_status;
+    }
+
+    bool IsKeepAlive() const {
+        return m_keepAlive;
+    }
+
+private:
+
+    enum State {
+        S_HEADER,
+        S_BODY,
+        S_CHUNK_SIZE,
+        S_CHUNK_DATA,
+        S_CHUNK_CRLF,
+        S_TRAILER,
+        S_UNTIL_CLOSE,
+    };
+
+    enum {
+        MAX_HEADER_SIZE = 64 * 1024,
+    };
+
+    // һm_progress ʾǷݻı״̬
+    Result Step(const string &in, size_t &pos) {
+        m_progress = false;
+
+        switch (m_state) {
+        case S_HEADER: {
+            size_t end = in.find("\r\n\r\n", pos);
+            if (end == string::npos) {
+                return in.size() - pos > MAX_HEADER_SIZE ? R_ERROR
+                                                         : R_NEED_MORE;
+            }
+
+            Result ret = ParseHeader(in.substr(pos, end + 2 - pos));
+            pos = end + 4;
+            m_progress = true;
+
+            return ret;
+        }
+
+        case S_BODY:
+        case S_CHUNK_DATA: {
+            size_t n = (size_t) min<uint64_t>(m_remaining, in.size() - pos);
+            pos += n;
+            m_remaining -= n;
+            m_progress = n > 0;
+
+            if (m_remaining == 0) {
+                if (m_state == S_BODY) {
+                    return R_DONE;
+                }
+
+                m_state = S_CHUNK_CRLF;
+                m_progress = true;
+            }
+
+            return R_NEED_MORE;
+        }
+
+        case S_CHUNK_CRLF:
+            if (in.size() - pos < 2) {
+                return R_NEED_MORE;
+            }
+
+            if (in.compare(pos, 2, "\r\n") != 0) {
+                return R_ERROR;
+            }
+
+            pos += 2;
+            m_state = S_CHUNK_SIZE;
+            m_progress = true;
+
+            return R_NEED_MORE;
+
+        case S_CHUNK_SIZE: {
+            size_t end = in.find("\r\n", pos);
+            if (end == string::npos) {
+                return R_NEED_MORE;
+            }
+
+            char *stop;
+            m_remaining = strtoull(in.c_str() + pos, &stop, 16);
+            if (stop == in.c_str() + pos) {
+                return R_ERROR;
+            }
+
+            pos = end + 2;
+            m_state = m_remaining == 0 ? S_TRAILER : S_CHUNK_DATA;
+            m_progress = true;
+
+            return R_NEED_MORE;
+        }
+
+        case S_TRAILER: {
+            size_t end = in.find("\r\n", pos);
+            if (end == string::npos) {
+                return R_NEED_MORE;
+            }
+
+            bool last = end == pos;
+            pos = end + 2;
+            m_progress = true;
+
+            return last ? R_DONE : R_NEED_MORE;
+        }
+
+        case S_UNTIL_CLOSE:
+            m_progress = pos < in.size();
+            pos = in.size();
+            return R_NEED_MORE;
+        }
+
+        return R_ERROR;
+    }
+
+    // ״̬ײ@a header  "\r\n" β
+    Result ParseHeader(const string &header) {
+        int minor;
+        if (sscanf(header.c_str(), "HTTP/1.%d %d", &minor, &m_status) != 2) {
+            return R_ERROR;
+        }
+
+        m_keepAlive = minor >= 1;
+
+        bool chunked = false;
+        long long length = -1;
+
+        size_t begin = header.find("\r\n") + 2;
+        while (begin < header.size()) {
+            size_t end = header.find("\r\n", begin);
+            string line = header.substr(begin, end - begin);
+            begin = end + 2;
+
+            size_t colon = line.find(':');
+            if (colon == string::npos) {
+                continue;
+            }
+
+            string name = line.substr(0, colon);
+            string value = line.substr(colon + 1);
+            for (auto &c : value) {
+                c = (char) tolower((unsigned char) c);
+            }
+
+            if (EqualsNoCase(name, "content-length")) {
+                length = atoll(value.c_str());
+            }
+            else if (EqualsNoCase(name, "transfer-encoding")) {
+                chunked = value.find("chunked") != string::npos;
+            }
+            else if (EqualsNoCase(name, "connection") ||
+                     EqualsNoCase(name, "proxy-connection")) {
+                if (value.find("close") != string::npos) {
+                    m_keepAlive = false;
+                }
+                else if (value.find("keep-alive") != string::npos) {
+                    m_keepAlive = true;
+                }
+            }
+        }
+
+        // 1xx ʱӦ֮ʽĻӦ
+        if (m_status >= 100 && m_status < 200) {
+            return R_NEED_MORE;
+        }
+
+        if ((m_connectReply && m_status / 100 == 2) ||
+            m_status == 204 || m_status == 304) {
+            return R_DONE;
+        }
+
+        if (chunked) {
+            m_state = S_CHUNK_SIZE;
+        }
+        else if (length >= 0) {
+            m_state = S_BODY;
+            m_remaining = (uint64_t) length;
+
+            return length == 0 ? R_DONE : R_NEED_MORE;
+        }
+        else {
+            m_state = S_UNTIL_CLOSE;
+            m_keepAlive = false;
+        }
+
+        return R_NEED_MORE;
+    }
+
+private:
+
+    State m_state = S_HEADER;
+    bool m_connectReply = false;
+    bool m_progress = false;
+    int m_status = 0;
+    bool m_keepAlive = false;
+    uint64_t m_remaining = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// һ̵߳ͳ
+struct Stats {
+    vector<uint32_t> latencies; // ΢
+    vector<uint32_t> lags; // Լƻʱ̵Ƴ٣΢룩
+    uint64_t requests = 0;
+    uint64_t tunnels = 0;
+    uint64_t non2xx = 0;
+    uint64_t errors = 0;
+    uint64_t timeouts = 0;
+    uint64_t connects = 0;
+    uint64_t rxBytes = 0;
+    uint64_t txBytes = 0;
+};
+
+// һطе
+struct Conn {
+    enum Phase {
+        P_WAITING, // ȴһ
+        P_CONNECTING,
+        P_HANDSHAKE, // ȴ CONNECT ĻӦ
+        P_RESPONSE, // ȴĻӦ
+        P_HOLDING, // ѻԣֵԭʼĽʱ
+        P_DONE,
+    };
+
+    const CapturedConn *captured = nullptr;
+    size_t next = 0; // һ±
+
+    SOCKET sd = INVALID_SOCKET;
+    Phase phase = P_WAITING;
+    bool open = false; // ѽԸ
+
+    string out;
+    size_t outPos = 0;
+    string in;
+    ResponseParser parser;
+
+    Clock::time_point due; // һʱ
+    Clock::time_point start; // ǰʵʷʱ
+    Clock::time_point deadline; // ʱʱ
+};
+
+// һ̣߳ʱָ
+class Worker {
+public:
+
+    Worker(const vector<const CapturedConn *> &conns, Stats &stats)
+        : m_conns(conns.size()), m_stats(stats) {
+        for (size_t i = 0; i < conns.size(); i++) {
+            m_conns[i].captured = conns[i];
+        }
+    }
+
+    void Run(Clock::time_point begin) {
+        m_begin = begin;
+
+        for (auto &conn : m_conns) {
+            const Captured &first = conn.captured->requests.front();
+            conn.due = begin + Scale((int64_t) (conn.captured->accept +
+                                                first.rec.request));
+        }
+
+        vector<pollfd> fds;
+        vector<Conn *> polled;
+
+        while (true) {
+            auto now = Clock::now();
+            auto wake = now + chrono::milliseconds(100);
+            bool active = false;
+
+            for (auto &conn : m_conns) {
+                if (conn.phase == Conn::P_DONE) {
+                    continue;
+                }
+
+                active = true;
+
+                if ((conn.phase == Conn::P_WAITING ||
+                     conn.phase == Conn::P_HOLDING) && conn.due <= now) {
+                    Next(conn, now);
+                }
+
+                if (conn.phase == Conn::P_WAITING ||
+                    conn.phase == Conn::P_HOLDING) {
+                    wake = min(wake, conn.due);
+                }
+                else if (conn.phase != Conn::P_DONE) {
+                    wake = min(wake, conn.deadline);
+                }
+            }
+
+            if (!active) {
+                break;
+            }
+
+            fds.clear();
+            polled.clear();
+
+            for (auto &conn : m_conns) {
+                if (conn.sd == INVALID_SOCKET) {
+                    continue;
+                }
+
+                pollfd pfd;
+                pfd.fd = conn.sd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+
+                if (conn.phase == Conn::P_CONNECTING ||
+                    conn.outPos < conn.out.size()) {
+                    pfd.events |= POLLOUT;
+                }
+
+                fds.push_back(pfd);
+                polled.push_back(&conn);
+            }
+
+            auto ms = chrono::duration_cast<chrono::milliseconds>(
+                wake - now).count() + 1;
+            ms = max<decltype(ms)>(min<decltype(ms)>(ms, 100), 0);
+
+            if (fds.empty()) {
+                this_thread::sleep_for(chrono::milliseconds(ms));
+                continue;
+            }
+
+            if (poll(fds.data(), (unsigned) fds.size(), (int) ms) < 0) {
+                perror("poll");
+                break;
+            }
+
+            now = Clock::now();
+
+            for (size_t i = 0; i < fds.size(); i++) {
+                if (fds[i].revents) {
+                    OnEvents(*polled[i], fds[i].revents, now);
+                }
+            }
+
+            for (auto &conn : m_conns) {
+                if ((conn.phase == Conn::P_CONNECTING ||
+                     conn.phase == Conn::P_HANDSHAKE ||
+                     conn.phase == Conn::P_RESPONSE) &&
+                    conn.deadline <= now) {
+                    m_stats.timeouts++;
+                    Abandon(conn, now);
+                }
+            }
+        }
+    }
+
+private:
+
+    const Captured &Current(const Conn &conn) const {
+        return conn.captured->requests[conn.next];
+    }
+
+    bool IsTunnel(const Conn &conn) const {
+        return (Current(conn).rec.flags & F_TUNNEL) != 0;
+    }
+
+    // ˼ƻʱ̣һ󣬻е
+    void Next(Conn &conn, Clock::time_point now) {
+        if (conn.phase == Conn::P_HOLDING) {
+            Close(conn);
+            Advance(conn, now);
+            return;
+        }
+
+        m_stats.lags.push_back((uint32_t) chrono::duration_cast<
+            chrono::microseconds>(now - conn.due).count());
+
+        conn.start = now;
+        conn.deadline = now + chrono::milliseconds(gs_timeout);
+
+        if (conn.open && !IsTunnel(conn)) {
+            SendRequest(conn);
+            OnEvents(conn, POLLOUT, now);
+        }
+        else {
+            Close(conn);
+            Open(conn);
+        }
+    }
+
+    void Open(Conn &conn) {
+        conn.sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (conn.sd == INVALID_SOCKET || !SetNonBlocking(conn.sd)) {
+            Fail(conn, Clock::now());
+            return;
+        }
+
+        int on = 1;
+        setsockopt(conn.sd, IPPROTO_TCP, TCP_NODELAY, (const char *) &on,
+                   sizeof(on));
+
+        if (connect(conn.sd, (const sockaddr *) &gs_proxy,
+                    sizeof(gs_proxy)) != 0 &&
+            LastError() != ERR_INPROGRESS) {
+            Fail(conn, Clock::now());
+            return;
+        }
+
+        conn.phase = Conn::P_CONNECTING;
+        conn.in.clear();
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+
+    void SendRequest(Conn &conn) {
+        conn.phase = IsTunnel(conn) ? Conn::P_HANDSHAKE : Conn::P_RESPONSE;
+        conn.out = BuildRequest(Current(conn));
+        conn.outPos = 0;
+        conn.parser.Reset(IsTunnel(conn));
+
+        m_stats.txBytes += conn.out.size();
+
+        if (gs_verbose) {
+            printf("conn %llu #%zu: %s\n",
+                   (unsigned long long) conn.captured->id, conn.next,
+                   conn.out.substr(0, conn.out.find('\r')).c_str());
+        }
+    }
+
+    void OnEvents(Conn &conn, short revents, Clock::time_point now) {
+        if (conn.phase == Conn::P_CONNECTING) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(conn.sd, SOL_SOCKET, SO_ERROR, (char *) &err, &len);
+
+            if (err != 0 || (revents & POLLOUT) == 0) {
+                Fail(conn, now);
+                return;
+            }
+
+            m_stats.connects++;
+            conn.open = true;
+            SendRequest(conn);
+
+            revents = POLLOUT;
+        }
+
+        if ((revents & POLLOUT) && conn.outPos < conn.out.size()) {
+            int n = (int) send(conn.sd, conn.out.data() + conn.outPos,
+                               (int) (conn.out.size() - conn.outPos),
+                               SEND_FLAGS);
+
+            if (n > 0) {
+                conn.outPos += n;
+            }
+            else if (LastError() != ERR_WOULDBLOCK) {
+                Fail(conn, now);
+                return;
+            }
+        }
+
+        if (revents & (POLLIN | POLLHUP | POLLERR)) {
+            OnReadable(conn, now);
+        }
+    }
+
+    void OnReadable(Conn &conn, Clock::time_point now) {
+        char buf[65536];
+        bool eof = false;
+
+        while (true) {
+            int n = (int) recv(conn.sd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                conn.in.append(buf, n);
+                m_stats.rxBytes += n;
+            }
+            else if (n == 0 || LastError() != ERR_WOULDBLOCK) {
+                eof = true;
+                break;
+            }
+            else {
+                break;
+            }
+        }
+
+        // е keep-alive ӱԶ˹رգһʹ
+        if (conn.phase == Conn::P_WAITING || conn.phase == Conn::P_HOLDING) {
+            if (eof || !conn.in.empty()) {
+                bool holding = conn.phase == Conn::P_HOLDING;
+                Close(conn);
+
+                if (holding) {
+                    Advance(conn, now);
+                }
+            }
+
+            return;
+        }
+
+        switch (conn.parser.Parse(conn.in)) {
+        case ResponseParser::R_DONE:
+            if (conn.phase == Conn::P_HANDSHAKE) {
+                if (conn.parser.GetStatus() != 200) {
+                    Fail(conn, now);
+                    return;
+                }
+
+                // еϴݣԴվԭ
+                const RequestRecord &rec = Current(conn).rec;
+                uint64_t upload = rec.inBytes - min<uint64_t>(
+                    rec.inBytes, rec.requestHeader);
+
+                conn.phase = Conn::P_RESPONSE;
+                conn.out = BuildRecords(upload);
+                conn.outPos = 0;
+                conn.parser.ResetOpaque(conn.out.size());
+                m_stats.txBytes += conn.out.size();
+
+                if (conn.out.empty()) {
+                    Complete(conn, now);
+                }
+                else {
+                    OnEvents(conn, POLLOUT, now);
+                }
+            }
+            else {
+                Complete(conn, now);
+            }
+
+            return;
+
+        case ResponseParser::R_ERROR:
+            Fail(conn, now);
+            return;
+
+        case ResponseParser::R_NEED_MORE:
+            break;
+        }
+
+        if (eof) {
+            if (conn.phase == Conn::P_RESPONSE && conn.parser.OnEof()) {
+                conn.open = false;
+                Complete(conn, now);
+            }
+            else {
+                Fail(conn, now);
+            }
+        }
+    }
+
+    void Complete(Conn &conn, Clock::time_point now) {
+        auto us = chrono::duration_cast<chrono::microseconds>(
+            now - conn.start).count();
+
+        m_stats.latencies.push_back((uint32_t) us);
+
+        if (IsTunnel(conn)) {
+            m_stats.tunnels++;
+
+            // ֵԭʼĽʱ
+            const RequestRecord &rec = Current(conn).rec;
+            conn.phase = Conn::P_HOLDING;
+            conn.due = conn.start + Scale((int64_t) rec.close -
+                                          (int64_t) rec.request);
+            conn.in.clear();
+
+            return;
+        }
+
+        m_stats.requests++;
+        if (conn.parser.GetStatus() / 100 != 2) {
+            m_stats.non2xx++;
+        }
+
+        conn.in.clear();
+
+        if (!conn.parser.IsKeepAlive()) {
+            Close(conn);
+        }
+
+        Advance(conn, now);
+    }
+
+    // תϵһ󣬵ȴԭʼļ
+    void Advance(Conn &conn, Clock::time_point now) {
+        const RequestRecord &prev = Current(conn).rec;
+
+        if (++conn.next == conn.captured->requests.size()) {
+            Close(conn);
+            conn.phase = Conn::P_DONE;
+            return;
+        }
+
+        const RequestRecord &rec = Current(conn).rec;
+        conn.phase = Conn::P_WAITING;
+        conn.due = now + Scale((int64_t) rec.request - (int64_t) prev.close);
+    }
+
+    // ǰ󣬼ϵһ
+    void Abandon(Conn &conn, Clock::time_point now) {
+        Close(conn);
+        Advance(conn, now);
+    }
+
+    void Fail(Conn &conn, Clock::time_point now) {
+        m_stats.errors++;
+        Abandon(conn, now);
+    }
+
+    void Close(Conn &conn) {
+        if (conn.sd != INVALID_SOCKET) {
+            CLOSE_SOCKET(conn.sd);
+            conn.sd = INVALID_SOCKET;
+        }
+
+        conn.open = false;
+        conn.in.clear();
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+
+private:
+
+    vector<Conn> m_conns;
+    Stats &m_stats;
+
+    Clock::time_point m_begin;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintPercentiles(const char *name, vector<uint32_t> &v) {
+    if (v.empty()) {
+        return;
+    }
+
+    sort(v.begin(), v.end());
+
+    double sum = 0;
+    for (auto us : v) {
+        sum += us;
+    }
+
+    auto at = [&](double q) {
+        size_t index = (size_t) (q * (v.size() - 1) + 0.5);
+        return v[index] / 1000.0;
+    };
+
+    printf("%s (ms): mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, "
+           "p99.9 %.3f, max %.3f\n", name, sum / v.size() / 1000,
+           at(0.5), at(0.9), at(0.99), at(0.999), v.back() / 1000.0);
+}
+
+static void Report(vector<Stats> &all, double seconds) {
+    Stats total;
+    for (auto &s : all) {
+        total.latencies.insert(total.latencies.end(),
+                               s.latencies.begin(), s.latencies.end());
+        total.lags.insert(total.lags.end(), s.lags.begin(), s.lags.end());
+        total.requests += s.requests;
+        total.tunnels += s.tunnels;
+        total.non2xx += s.non2xx;
+        total.errors += s.errors;
+        total.timeouts += s.timeouts;
+        total.connects += s.connects;
+        total.rxBytes += s.rxBytes;
+        total.txBytes += s.txBytes;
+    }
+
+    printf("requests: %llu, tunnels: %llu, non-2xx: %llu, errors: %llu, "
+           "timeouts: %llu\n",
+           (unsigned long long) total.requests,
+           (unsigned long long) total.tunnels,
+           (unsigned long long) total.non2xx,
+           (unsigned long long) total.errors,
+           (unsigned long long) total.timeouts);
+    printf("connects: %llu\n", (unsigned long long) total.connects);
+    printf("elapsed: %.1f s, rps: %.1f\n", seconds,
+           (total.requests + total.tunnels) / seconds);
+    printf("throughput: rx %.2f MB/s, tx %.2f MB/s\n",
+           total.rxBytes / seconds / 1e6, total.txBytes / seconds / 1e6);
+
+    PrintPercentiles("latency", total.latencies);
+    PrintPercentiles("lag", total.lags);
+}
+
+static void Usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-x proxy] [-t target] [-s speed] [-T threads] [-D] "
+            "[-o timeout_ms] [-n max_conns] [-v] capture.bin\n"
+            "proxy and target must be loopback addresses (ip:port).\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    string proxy = "127.0.0.1:1990";
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-x" && hasValue) {
+            proxy = argv[++i];
+        }
+        else if (arg == "-t" && hasValue) {
+            gs_target = argv[++i];
+        }
+        else if (arg == "-s" && hasValue) {
+            gs_speed = atof(argv[++i]);
+        }
+        else if (arg == "-T" && hasValue) {
+            gs_numThreads = atoi(argv[++i]);
+        }
+        else if (arg == "-D") {
+            gs_delay = true;
+        }
+        else if (arg == "-o" && hasValue) {
+            gs_timeout = atoi(argv[++i]);
+        }
+        else if (arg == "-n" && hasValue) {
+            gs_maxConns = (size_t) atoll(argv[++i]);
+        }
+        else if (arg == "-v") {
+            gs_verbose = true;
+        }
+        else if (arg[0] != '-' && !path) {
+            path = argv[i];
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    sockaddr_in target;
+    if (!path || gs_speed <= 0 || gs_numThreads < 1 ||
+        !ParseLoopback(proxy, gs_proxy) ||
+        !ParseLoopback(gs_target, target)) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    vector<CapturedConn> conns;
+    if (!Read(path, conns)) {
+        return 2;
+    }
+
+    if (gs_maxConns > 0 && conns.size() > gs_maxConns) {
+        conns.resize(gs_maxConns);
+    }
+
+    size_t numRequests = 0;
+    for (auto &conn : conns) {
+        numRequests += conn.requests.size();
+    }
+
+    if (conns.empty()) {
+        fprintf(stderr, "%s: no requests\n", path);
+        return 2;
+    }
+
+    double span = (conns.back().accept +
+                   conns.back().requests.front().rec.request) / 1e6;
+    printf("Replaying %zu connection(s), %zu request(s) spanning %.1f s "
+           "at %gx via %s to %s\n", conns.size(), numRequests, span,
+           gs_speed, proxy.c_str(), gs_target.c_str());
+    fflush(stdout);
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    // Ӱ˳ָ̣߳ʹ̵߳ĸʱϾ
+    vector<vector<const CapturedConn *>> shares(gs_numThreads);
+    for (size_t i = 0; i < conns.size(); i++) {
+        shares[i % gs_numThreads].push_back(&conns[i]);
+    }
+
+    vector<Stats> stats(gs_numThreads);
+    vector<thread> threads;
+
+    auto begin = Clock::now() + chrono::milliseconds(100);
+
+    for (int i = 0; i < gs_numThreads; i++) {
+        threads.emplace_back([&, i] {
+            if (!shares[i].empty()) {
+                Worker(shares[i], stats[i]).Run(begin);
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    double seconds = chrono::duration<double>(Clock::now() - begin).count();
+    Report(stats, seconds > 0 ? seconds : 1);
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    return 0;
+}
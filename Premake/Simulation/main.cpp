@@ -0,0 +1,1168 @@
+
+// ȷģ⣺ڴʱ Request ״̬
+//
+// ÷Simulation [-s seed] [-n connections] [-w waves] [-o index]
+//                  [-L max_ms] [-v]
+//
+//   -s  ӣĬ 1ͬһӵȫͬ
+//   -n  ÿһֵĬ 500
+//   -w  Ĭ 4֮ 21 ʱ䣬
+//       ʹ RequestPool бͷŵĽ
+//   -o  ֻбΪ index ӣſڵ۲
+//   -L  ޹ʱ룬Ĭ 500
+//   -v  ־
+//
+// ÿӵľ籾ӱžɸӵ GET/POST 
+// Content-Length  chunked Ӧ;ɷرӣ
+// һ CONNECT һעϣڡ
+// ʱ;ӡǰ
+//
+// Уյÿһֽڡÿһֽ飺
+//
+//   - ޹ϵȫɹҺʱ -L
+//   - йϵձرգû
+//   - RequestPool  TxContextPool Ľȫ黹׽ȫر
+//   - RequestPool һֵ
+//   - ûΥ Winsock ʹԼ SimNet
+//
+// κһʧʱԷ 0 ֵ˳ӡӡ
+
+#include "../../SimNet.hpp"
+#include "../../Request.hpp"
+#include "../../PerIoContext.hpp"
+#include "../../Logger.hpp"
+#include "../../Clock.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////
+
+static const int64_t MS = 1000000;
+static const int64_t SECOND = 1000 * MS;
+
+// ûκνչʱӵʱ
+static const int64_t IDLE_TIMEOUT = 30 * SECOND;
+
+// һӵĿʼʱ̷ֲڴ
+static const int64_t WAVE_SPREAD = 2 * SECOND;
+
+// õĿ
+static const int NUM_HOSTS = 8;
+
+static uint64_t gs_seed = 1;
+static int gs_connections = 500;
+static int gs_waves = 4;
+static int gs_only = -1;
+static int64_t gs_maxLatency = 500 * MS;
+static bool gs_verbose = false;
+
+//////////////////////////////////////////////////////////////////////////
+
+// ĵĵ @a i ֽ
+static char Pattern(uint64_t salt, uint64_t i) {
+    return (char) ('a' + (salt * 7 + i) % 26);
+}
+
+static string MakeBody(uint64_t salt, size_t len) {
+    string body(len, 0);
+    for (size_t i = 0; i < len; i++) {
+        body[i] = Pattern(salt, i);
+    }
+
+    return body;
+}
+
+// һӦ
+struct Exchange {
+    int host = 0;
+    bool post = false;
+    size_t upload = 0; // ĳ
+    size_t size = 0; // Ӧĳ
+    bool chunked = false;
+    int thinkMs = 0; // Ĵʱ
+    bool close = false; // ڻӦر
+    bool serverReset = false; // һĺ
+};
+
+// һӵľ籾
+struct Scenario {
+    enum Fault {
+        F_NONE,
+        F_NXDOMAIN, ///< 
+        F_DOWN, ///< ӳʱ
+        F_BROWSER_RESET, ///< յһĺ
+        F_SERVER_RESET, ///< һĺ
+        F_GIVE_UP, ///< ܿ
+    };
+
+    int index = 0;
+    int64_t start = 0;
+    bool tunnel = false;
+    Fault fault = F_NONE;
+
+    vector<Exchange> exchanges; // HTTP
+    vector<size_t> rounds; // ÿһַͲȴԵֽ
+};
+
+static const char *FAULT_NAMES[] = {
+    "none", "nxdomain", "down", "browser-reset", "server-reset", "give-up",
+};
+
+// ӱɾ籾
+static Scenario MakeScenario(int index) {
+    mt19937_64 rng(gs_seed * 1000003 + (uint64_t) index);
+    auto uniform = [&](uint64_t n) {
+        return (int) (rng() % n);
+    };
+
+    Scenario sc;
+    sc.index = index;
+    sc.start = (int64_t) (rng() % (uint64_t) WAVE_SPREAD);
+    sc.tunnel = uniform(100) < 15;
+
+    int f = uniform(100);
+    if (f < 5) {
+        sc.fault = Scenario::F_NXDOMAIN;
+    }
+    else if (f < 9) {
+        sc.fault = Scenario::F_DOWN;
+    }
+    else if (f < 13 && !sc.tunnel) {
+        sc.fault = Scenario::F_BROWSER_RESET;
+    }
+    else if (f < 17 && !sc.tunnel) {
+        sc.fault = Scenario::F_SERVER_RESET;
+    }
+    else if (f < 21) {
+        sc.fault = Scenario::F_GIVE_UP;
+    }
+
+    int host = uniform(NUM_HOSTS);
+
+    if (sc.tunnel) {
+        int n = 1 + uniform(4);
+        for (int i = 0; i < n; i++) {
+            sc.rounds.push_back(1 + uniform(20000));
+        }
+
+        sc.exchanges.resize(1);
+        sc.exchanges[0].host = host;
+
+        return sc;
+    }
+
+    int n = 1 + uniform(4);
+    for (int i = 0; i < n; i++) {
+        Exchange ex;
+
+        if (i > 0 && uniform(4) == 0) {
+            host = uniform(NUM_HOSTS);
+        }
+
+        ex.host = host;
+        ex.post = uniform(5) == 0;
+        ex.upload = ex.post ? 1 + uniform(30000) : 0;
+
+        // ӦСܴ
+        int r = uniform(10);
+        ex.size = r < 6 ? uniform(2000) : r < 9 ? uniform(20000)
+                                                : uniform(200000);
+
+        ex.chunked = uniform(3) == 0;
+        ex.thinkMs = uniform(20);
+        ex.close = uniform(6) == 0;
+
+        sc.exchanges.push_back(ex);
+    }
+
+    // ֻע뵽һϣ˺󲻻ᷢ
+    if (sc.fault == Scenario::F_BROWSER_RESET ||
+        sc.fault == Scenario::F_SERVER_RESET) {
+        int i = uniform(n);
+        sc.exchanges.resize(i + 1);
+
+        Exchange &ex = sc.exchanges.back();
+        ex.size = max<size_t>(ex.size, 1000);
+        ex.serverReset = sc.fault == Scenario::F_SERVER_RESET;
+    }
+    else if (sc.fault != Scenario::F_NONE) {
+        sc.exchanges.resize(1);
+    }
+
+    return sc;
+}
+
+static string HostName(const Scenario &sc, int host) {
+    char buf[32];
+
+    switch (sc.fault) {
+    case Scenario::F_NXDOMAIN:
+        sprintf(buf, "nx%d.sim", host);
+        break;
+
+    case Scenario::F_DOWN:
+        sprintf(buf, "down%d.sim", host);
+        break;
+
+    default:
+        sprintf(buf, "h%d.sim", host);
+        break;
+    }
+
+    return buf;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// һģĽ
+struct Stats {
+    int ok = 0; ///< ȫɹ
+    int expected = 0; ///< 籾ʧܵ
+    vector<int64_t> latencies; ///< ޹ĺʱ
+    vector<string> failures;
+
+    void Fail(const Scenario &sc, const string &what) {
+        char buf[128];
+        sprintf(buf, "connection %d (%s, fault=%s): ", sc.index,
+                sc.tunnel ? "tunnel" : "http", FAULT_NAMES[sc.fault]);
+
+        failures.push_back(buf + what);
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+/// УӦ
+class ResponseReader {
+public:
+
+    enum Result {
+        R_MORE, ///< Ҫ
+        R_DONE, ///< Ӧ
+        R_BAD, ///< 
+    };
+
+    void Reset(uint64_t salt, size_t expected) {
+        m_salt = salt;
+        m_expected = expected;
+        m_state = S_HEADER;
+        m_header.clear();
+        m_body = 0;
+        m_left = 0;
+        m_line.clear();
+        m_error.clear();
+    }
+
+    /// յֽ
+    size_t GetBodyReceived() const {
+        return m_body;
+    }
+
+    const string &GetError() const {
+        return m_error;
+    }
+
+    /// @param used ĵֽ
+    Result Feed(const char *data, size_t len, size_t &used) {
+        used = 0;
+
+        while (used < len) {
+            const char *p = data + used;
+            size_t n = len - used;
+
+            switch (m_state) {
+            case S_HEADER: {
+                m_header.push_back(*p);
+                used++;
+
+                size_t hl = m_header.size();
+                if (hl >= 4 && m_header.compare(hl - 4, 4, "\r\n\r\n") == 0) {
+                    if (!ParseHeader()) {
+                        return R_BAD;
+                    }
+
+                    if (m_state == S_DONE) {
+                        return R_DONE;
+                    }
+                }
+
+                break;
+            }
+
+            case S_BODY:
+            case S_CHUNK_DATA: {
+                size_t take = min(n, m_left);
+                if (!Verify(p, take)) {
+                    return R_BAD;
+                }
+
+                used += take;
+                m_left -= take;
+
+                if (m_left == 0) {
+                    if (m_state == S_BODY) {
+                        m_state = S_DONE;
+                        return R_DONE;
+                    }
+
+                    m_state = S_CHUNK_END;
+                }
+
+                break;
+            }
+
+            case S_CHUNK_SIZE:
+            case S_CHUNK_END:
+            case S_TRAILER: {
+                m_line.push_back(*p);
+                used++;
+
+                size_t ll = m_line.size();
+                if (ll < 2 || m_line.compare(ll - 2, 2, "\r\n") != 0) {
+                    break;
+                }
+
+                Result r = OnLine();
+                m_line.clear();
+
+                if (r != R_MORE) {
+                    return r;
+                }
+
+                break;
+            }
+
+            case S_DONE:
+                return R_DONE;
+            }
+        }
+
+        return m_state == S_DONE ? R_DONE : R_MORE;
+    }
+
+private:
+
+    bool ParseHeader() {
+        if (m_header.compare(0, 13, "HTTP/1.1 200 ") != 0) {
+            return Bad("Bad status line");
+        }
+
+        if (m_header.find("Transfer-Encoding: chunked\r\n") != string::npos) {
+            m_state = S_CHUNK_SIZE;
+            return true;
+        }
+
+        auto pos = m_header.find("Content-Length: ");
+        if (pos == string::npos) {
+            return Bad("No Content-Length");
+        }
+
+        m_left = (size_t) atoll(m_header.c_str() + pos + 16);
+        m_state = m_left > 0 ? S_BODY : S_DONE;
+
+        return m_left == m_expected || Bad("Wrong Content-Length");
+    }
+
+    Result OnLine() {
+        switch (m_state) {
+        case S_CHUNK_SIZE:
+            m_left = strtoul(m_line.c_str(), nullptr, 16);
+            m_state = m_left > 0 ? S_CHUNK_DATA : S_TRAILER;
+            return R_MORE;
+
+        case S_CHUNK_END:
+            if (m_line != "\r\n") {
+                Bad("Bad chunk end");
+                return R_BAD;
+            }
+
+            m_state = S_CHUNK_SIZE;
+            return R_MORE;
+
+        default: // S_TRAILER
+            if (m_line != "\r\n") {
+                return R_MORE; //  trailer ֶ
+            }
+
+            if (m_body != m_expected) {
+                Bad("Wrong chunked body length");
+                return R_BAD;
+            }
+
+            m_state = S_DONE;
+            return R_DONE;
+        }
+    }
+
+    bool Verify(const char *p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            if (p[i] != Pattern(m_salt, m_body + i)) {
+                return Bad("Corrupted body at offset " +
+                           to_string(m_body + i));
+            }
+        }
+
+        m_body += n;
+        return true;
+    }
+
+    bool Bad(const string &error) {
+        m_error = error;
+        return false;
+    }
+
+private:
+
+    enum State {
+        S_HEADER,
+        S_BODY,
+        S_CHUNK_SIZE,
+        S_CHUNK_DATA,
+        S_CHUNK_END,
+        S_TRAILER,
+        S_DONE,
+    };
+
+    uint64_t m_salt = 0;
+    size_t m_expected = 0;
+
+    State m_state = S_HEADER;
+    string m_header;
+    string m_line;
+    size_t m_body = 0;
+    size_t m_left = 0;
+
+    string m_error;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+/// ģԴվ
+///
+///  URL еĲӦ443 ˿ϵԭԡ
+class Server : public SimNet::Peer {
+public:
+
+    Server(bool echo, Stats &stats) : m_echo(echo), m_stats(stats) {}
+
+    virtual void OnData(SOCKET sd, const char *data, size_t len) override {
+        SimNet &net = SimNet::GetInstance();
+
+        // ѹرյյݣظ RST
+        if (m_closed) {
+            if (!m_reset) {
+                m_reset = true;
+                net.Abort(sd);
+            }
+
+            return;
+        }
+
+        if (m_echo) {
+            net.Send(sd, data, len);
+            return;
+        }
+
+        m_buf.append(data, len);
+
+        while (!m_busy && TryRequest(sd)) {}
+    }
+
+    virtual void OnClosed(SOCKET sd) override {
+        if (!m_closed) {
+            m_closed = true;
+            SimNet::GetInstance().Shutdown(sd);
+        }
+    }
+
+private:
+
+    // Ӧһ
+    bool TryRequest(SOCKET sd) {
+        auto end = m_buf.find("\r\n\r\n");
+        if (end == string::npos) {
+            return false;
+        }
+
+        size_t bodyOffset = end + 4;
+        size_t upload = Param("Content-Length: ");
+        if (m_buf.size() < bodyOffset + upload) {
+            return false;
+        }
+
+        // ӦѰѾ URL дΪ·
+        if (m_buf.compare(0, 5, "GET /") != 0 &&
+            m_buf.compare(0, 6, "POST /") != 0) {
+            Complain(0, "Bad request line: " +
+                        m_buf.substr(0, m_buf.find('\r')));
+        }
+
+        uint64_t id = Param("id=");
+        for (size_t i = 0; i < upload; i++) {
+            if (m_buf[bodyOffset + i] != Pattern(id * 3 + 1, i)) {
+                Complain(id, "Corrupted upload at offset " + to_string(i));
+                break;
+            }
+        }
+
+        size_t size = Param("size=");
+        bool chunked = Param("chunked=") != 0;
+        int64_t think = Param("think=") * MS;
+        bool close = Param("close=") != 0;
+        bool reset = Param("reset=") != 0;
+
+        m_buf.erase(0, bodyOffset + upload);
+        m_busy = true;
+
+        SimNet::GetInstance().Schedule(think, [=] {
+            Respond(sd, id, size, chunked, close, reset);
+        });
+
+        return true;
+    }
+
+    void Respond(SOCKET sd, uint64_t id, size_t size,
+                 bool chunked, bool close, bool reset) {
+        if (m_closed) {
+            return;
+        }
+
+        SimNet &net = SimNet::GetInstance();
+        string body = MakeBody(id, size);
+
+        string header = "HTTP/1.1 200 OK\r\nServer: sim\r\n";
+        header += close ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+
+        // ʱֻһ
+        if (reset) {
+            body.resize(body.size() / 2);
+        }
+
+        string out;
+        if (chunked) {
+            header += "Transfer-Encoding: chunked\r\n\r\n";
+            out = header;
+
+            mt19937_64 rng(id);
+            for (size_t pos = 0; pos < body.size(); ) {
+                size_t n = min(body.size() - pos, 1 + (size_t) (rng() % 8192));
+
+                char hex[16];
+                sprintf(hex, "%zx\r\n", n);
+
+                out += hex;
+                out.append(body, pos, n);
+                out += "\r\n";
+
+                pos += n;
+            }
+
+            if (!reset) {
+                out += "0\r\n\r\n";
+            }
+        }
+        else {
+            header += "Content-Length: " + to_string(size) + "\r\n\r\n";
+            out = header + body;
+        }
+
+        // ɴд
+        const size_t WRITE_SIZE = 16384;
+        for (size_t pos = 0; pos < out.size(); pos += WRITE_SIZE) {
+            size_t n = min(out.size() - pos, WRITE_SIZE);
+            net.Send(sd, out.data() + pos, n);
+        }
+
+        if (reset) {
+            m_closed = m_reset = true;
+            net.Abort(sd);
+        }
+        else if (close) {
+            m_closed = true;
+            net.Shutdown(sd);
+        }
+
+        m_busy = false;
+        while (!m_closed && !m_busy && TryRequest(sd)) {}
+    }
+
+    // ȡͷн @a name 
+    size_t Param(const char *name) const {
+        auto end = m_buf.find("\r\n\r\n");
+        auto pos = m_buf.find(name);
+        if (pos == string::npos || pos > end) {
+            return 0;
+        }
+
+        return (size_t) atoll(m_buf.c_str() + pos + strlen(name));
+    }
+
+    // ŵĸλӱ
+    void Complain(uint64_t id, const string &what) {
+        m_stats.failures.push_back("connection " + to_string(id / 16) +
+                                   ": server: " + what);
+    }
+
+private:
+
+    bool m_echo;
+    Stats &m_stats;
+
+    string m_buf;
+    bool m_busy = false;
+    bool m_closed = false;
+    bool m_reset = false;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+/// ģ籾УӦ
+class Browser : public SimNet::Peer {
+public:
+
+    Browser(const Scenario &sc, Stats &stats)
+        : m_sc(sc), m_stats(stats) {}
+
+    void Start() {
+        SimNet::GetInstance().Schedule(m_sc.start, [this] {
+            Begin();
+        });
+    }
+
+    virtual void OnData(SOCKET sd, const char *data, size_t len) override {
+        if (m_done) {
+            return;
+        }
+
+        m_lastActivity = SimNet::GetInstance().Now();
+
+        while (len > 0 && !m_done) {
+            size_t used = len;
+
+            if (m_stage == B_RESPONSE) {
+                OnResponseData(data, len, used);
+            }
+            else if (m_stage == B_CONFIRM) {
+                OnConfirmData(data, len, used);
+            }
+            else if (m_stage == B_ECHO) {
+                OnEchoData(data, len, used);
+            }
+            else {
+                Fail("Unexpected data");
+            }
+
+            data += used;
+            len -= used;
+        }
+    }
+
+    virtual void OnClosed(SOCKET) override {
+        if (m_done) {
+            return;
+        }
+
+        if (m_stage == B_CLOSING) {
+            Finish();
+        }
+        else if (m_sc.fault != Scenario::F_NONE) {
+            Expected();
+        }
+        else {
+            Fail("Connection closed unexpectedly");
+        }
+    }
+
+private:
+
+    enum Stage {
+        B_RESPONSE, ///< ȴӦ
+        B_CONFIRM, ///< ȴ
+        B_ECHO, ///< ȴ
+        B_CLOSING, ///< ѷ FINȴر
+    };
+
+    void Begin() {
+        SimNet &net = SimNet::GetInstance();
+        m_lastActivity = net.Now();
+
+        string req;
+        if (m_sc.tunnel) {
+            string host = HostName(m_sc, m_sc.exchanges[0].host) + ":443";
+            req = "CONNECT " + host + " HTTP/1.1\r\nHost: " + host + "\r\n\r\n";
+            m_stage = B_CONFIRM;
+        }
+        else {
+            req = BuildRequest();
+            m_stage = B_RESPONSE;
+        }
+
+        // һ𵽴
+        size_t first = 1 + net.Random()() % req.size();
+        m_sd = net.Accept(this, req.data(), first);
+        SendPieces(req.substr(first));
+
+        if (m_sc.fault == Scenario::F_GIVE_UP) {
+            net.Schedule(net.Random()() % (10 * MS), [this] {
+                if (!m_done) {
+                    SimNet::GetInstance().Abort(m_sd);
+                    Expected();
+                }
+            });
+        }
+
+        ArmIdleTimer(IDLE_TIMEOUT);
+    }
+
+    string BuildRequest() {
+        const Exchange &ex = m_sc.exchanges[m_exchange];
+        string host = HostName(m_sc, ex.host);
+        uint64_t id = (uint64_t) m_sc.index * 16 + m_exchange;
+
+        string req = ex.post ? "POST" : "GET";
+        req += " http://" + host + "/obj?id=" + to_string(id) +
+               "&size=" + to_string(ex.size) +
+               "&chunked=" + to_string(ex.chunked) +
+               "&think=" + to_string(ex.thinkMs) +
+               "&close=" + to_string(ex.close) +
+               "&reset=" + to_string(ex.serverReset) + " HTTP/1.1\r\n" +
+               "Host: " + host + "\r\n"
+               "Proxy-Connection: keep-alive\r\n"
+               "User-Agent: MyProxySimulation\r\n";
+
+        if (ex.post) {
+            req += "Content-Length: " + to_string(ex.upload) + "\r\n";
+        }
+
+        req += "\r\n" + MakeBody(id * 3 + 1, ex.upload);
+
+        m_reader.Reset(id, ex.size);
+        m_sentAt = SimNet::GetInstance().Now();
+
+        return req;
+    }
+
+    // ֳɼڷ
+    void SendPieces(const string &data) {
+        SimNet &net = SimNet::GetInstance();
+        int64_t delay = 0;
+
+        for (size_t pos = 0; pos < data.size(); ) {
+            size_t n = data.size() - pos;
+            if (n > 1 && net.Random()() % 2 == 0) {
+                n = 1 + net.Random()() % (n - 1);
+            }
+
+            string piece = data.substr(pos, n);
+            net.Schedule(delay, [this, piece] {
+                if (!m_done) {
+                    SimNet::GetInstance().Send(m_sd, piece.data(),
+                                               piece.size());
+                }
+            });
+
+            pos += n;
+            delay += net.Random()() % (2 * MS);
+        }
+    }
+
+    void OnResponseData(const char *data, size_t len, size_t &used) {
+        auto r = m_reader.Feed(data, len, used);
+
+        if (r == ResponseReader::R_BAD) {
+            Fail(m_reader.GetError());
+            return;
+        }
+
+        const Exchange &ex = m_sc.exchanges[m_exchange];
+
+        if (m_sc.fault == Scenario::F_BROWSER_RESET &&
+            m_exchange + 1 == m_sc.exchanges.size() &&
+            m_reader.GetBodyReceived() >= ex.size / 2) {
+            SimNet::GetInstance().Abort(m_sd);
+            Expected();
+            return;
+        }
+
+        if (r != ResponseReader::R_DONE) {
+            return;
+        }
+
+        // 籾;ʧܵӦ
+        if (ex.serverReset) {
+            Fail("Truncated response completed");
+            return;
+        }
+
+        if (m_sc.fault == Scenario::F_NONE) {
+            m_stats.latencies.push_back(SimNet::GetInstance().Now() - m_sentAt);
+        }
+
+        if (++m_exchange == m_sc.exchanges.size()) {
+            Close();
+            return;
+        }
+
+        // ֮ͣ٣Աرӵ FIN ȵ
+        SimNet &net = SimNet::GetInstance();
+        int64_t pause = 5 * MS + net.Random()() % (20 * MS);
+
+        net.Schedule(pause, [this] {
+            if (!m_done) {
+                m_lastActivity = SimNet::GetInstance().Now();
+                SendPieces(BuildRequest());
+            }
+        });
+    }
+
+    void OnConfirmData(const char *data, size_t len, size_t &used) {
+        static const string CONFIRM =
+            "HTTP/1.1 200 Connection Established\r\n\r\n";
+
+        used = min(len, CONFIRM.size() - m_confirm.size());
+        m_confirm.append(data, used);
+
+        if (CONFIRM.compare(0, m_confirm.size(), m_confirm) != 0) {
+            Fail("Bad tunnel confirmation");
+            return;
+        }
+
+        if (m_confirm.size() == CONFIRM.size()) {
+            m_stage = B_ECHO;
+            SendRound();
+        }
+    }
+
+    void SendRound() {
+        uint64_t salt = (uint64_t) m_sc.index * 16 + m_round;
+        size_t n = m_sc.rounds[m_round];
+
+        m_echoed = 0;
+        SendPieces(MakeBody(salt, n));
+    }
+
+    void OnEchoData(const char *data, size_t len, size_t &used) {
+        uint64_t salt = (uint64_t) m_sc.index * 16 + m_round;
+        size_t expected = m_sc.rounds[m_round];
+
+        used = min(len, expected - m_echoed);
+        for (size_t i = 0; i < used; i++) {
+            if (data[i] != Pattern(salt, m_echoed + i)) {
+                Fail("Corrupted echo at offset " + to_string(m_echoed + i));
+                return;
+            }
+        }
+
+        m_echoed += used;
+        if (m_echoed < expected) {
+            return;
+        }
+
+        if (++m_round == m_sc.rounds.size()) {
+            Close();
+        }
+        else {
+            SendRound();
+        }
+    }
+
+    // ɣرշͷ򲢵ȴر
+    void Close() {
+        m_stage = B_CLOSING;
+        SimNet::GetInstance().Shutdown(m_sd);
+    }
+
+    void ArmIdleTimer(int64_t delay) {
+        SimNet::GetInstance().Schedule(delay, [this] {
+            if (m_done) {
+                return;
+            }
+
+            SimNet &net = SimNet::GetInstance();
+            int64_t idle = net.Now() - m_lastActivity;
+
+            if (idle < IDLE_TIMEOUT) {
+                ArmIdleTimer(IDLE_TIMEOUT - idle);
+                return;
+            }
+
+            net.Abort(m_sd);
+
+            // ;ʱֻرշӣֻܵȴʱ
+            if (m_sc.fault != Scenario::F_NONE) {
+                Expected();
+            }
+            else if (m_stage == B_CLOSING) {
+                Fail("Proxy did not close the connection after browser FIN");
+            }
+            else {
+                Fail("Stalled");
+            }
+        });
+    }
+
+    // ǰѾ
+    void Finish() {
+        m_done = true;
+
+        if (m_sc.fault == Scenario::F_NONE) {
+            m_stats.ok++;
+        }
+        else {
+            m_stats.expected++;
+        }
+    }
+
+    void Expected() {
+        m_done = true;
+        m_stats.expected++;
+    }
+
+    void Fail(const string &what) {
+        char buf[64];
+        sprintf(buf, "request %d, stage %d: ", (int) m_exchange, (int) m_stage);
+
+        m_done = true;
+        m_stats.Fail(m_sc, buf + what);
+    }
+
+private:
+
+    const Scenario &m_sc;
+    Stats &m_stats;
+
+    SOCKET m_sd = INVALID_SOCKET;
+    Stage m_stage = B_RESPONSE;
+    bool m_done = false;
+
+    size_t m_exchange = 0;
+    ResponseReader m_reader;
+    int64_t m_sentAt = 0;
+    int64_t m_lastActivity = 0;
+
+    string m_confirm;
+    size_t m_round = 0;
+    size_t m_echoed = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// ַh<k>.sim -> 10.0.0.<k+1>down<k>.sim -> 10.0.1.<k+1>
+static bool Resolve(const string &host, uint32_t &ip) {
+    int k;
+    if (sscanf(host.c_str(), "h%d.sim", &k) == 1) {
+        ip = 0x0A000001 + k;
+        return true;
+    }
+
+    if (sscanf(host.c_str(), "down%d.sim", &k) == 1) {
+        ip = 0x0A000101 + k;
+        return true;
+    }
+
+    return false;
+}
+
+static double Percentile(const vector<int64_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t i = (size_t) (p * (sorted.size() - 1) + 0.5);
+    return (double) sorted[i] / MS;
+}
+
+// һ֣Ƿͨ
+static bool RunWave(int wave, Stats &stats) {
+    SimNet &net = SimNet::GetInstance();
+
+    vector<Scenario> scenarios;
+    for (int i = 0; i < gs_connections; i++) {
+        int index = wave * gs_connections + i;
+        if (gs_only < 0 || gs_only == index) {
+            scenarios.push_back(MakeScenario(index));
+        }
+    }
+
+    vector<unique_ptr<Server>> servers;
+    net.SetListener([&](SOCKET, uint32_t ip, u_short port) -> SimNet::Peer * {
+        if ((ip & 0xFFFFFF00) != 0x0A000000) {
+            return nullptr; // ɴ
+        }
+
+        servers.emplace_back(new Server(port == 443, stats));
+        return servers.back().get();
+    });
+
+    // ȫֵģֻ鱾ֵı仯
+    auto reqBefore = RequestPool::GetInstance().GetUsage();
+    auto txBefore = TxContextPool::GetInstance().GetUsage();
+    long long connectionsBefore = Request::GetConnectionCount();
+    size_t socketsBefore = net.GetOpenSocketCount();
+
+    vector<unique_ptr<Browser>> browsers;
+    for (auto &sc : scenarios) {
+        browsers.emplace_back(new Browser(sc, stats));
+        browsers.back()->Start();
+    }
+
+    net.Run(INT64_MAX);
+
+    // ԴǷȫ黹
+    auto reqUsage = RequestPool::GetInstance().GetUsage();
+    auto txUsage = TxContextPool::GetInstance().GetUsage();
+    bool ok = true;
+
+    auto check = [&](bool cond, const string &what) {
+        if (!cond) {
+            stats.failures.push_back(what);
+            ok = false;
+        }
+    };
+
+    check(reqUsage.used == reqBefore.used, "Leaked Request objects: " +
+          to_string(reqUsage.used - reqBefore.used));
+    check(txUsage.used == txBefore.used, "Leaked TxContext objects: " +
+          to_string(txUsage.used - txBefore.used));
+
+    long long connections = Request::GetConnectionCount();
+    check(connections == connectionsBefore, "Connection gauge changed by " +
+          to_string(connections - connectionsBefore));
+    size_t sockets = net.GetOpenSocketCount();
+    check(sockets == socketsBefore,
+          "Sockets left open: " + to_string(sockets - socketsBefore));
+
+    size_t limit = max<size_t>(Request::STATIC_POOL_SIZE,
+                               gs_connections + Request::DYNAMIC_POOL_SIZE);
+    check(reqUsage.capacity <= limit,
+          "RequestPool grew to " + to_string(reqUsage.capacity));
+
+    for (auto &v : net.GetViolations()) {
+        check(false, "Violation: " + v);
+    }
+
+    sort(stats.latencies.begin(), stats.latencies.end());
+    if (!stats.latencies.empty() && stats.latencies.back() > gs_maxLatency) {
+        check(false, "Slowest clean request took " +
+              to_string(stats.latencies.back() / MS) + " ms");
+    }
+
+    ok = ok && stats.failures.empty();
+
+    printf("wave %d: %d ok, %d expected failures, %d failures; "
+           "latency p50 %.1f p99 %.1f max %.1f ms; "
+           "Request capacity %u, TxContext capacity %u\n",
+           wave + 1, stats.ok, stats.expected, (int) stats.failures.size(),
+           Percentile(stats.latencies, 0.5),
+           Percentile(stats.latencies, 0.99),
+           Percentile(stats.latencies, 1.0),
+           (unsigned) reqUsage.capacity, (unsigned) txUsage.capacity);
+
+    // ͷŵ Request ˸ڣһֿ
+    net.Schedule(21 * SECOND, [] {});
+    net.Run(INT64_MAX);
+
+    net.SetListener(nullptr);
+    return ok;
+}
+
+static void Usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-s seed] [-n connections] [-w waves] "
+            "[-o index] [-L max_ms] [-v]\n", argv0);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-s" && hasValue) {
+            gs_seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "-n" && hasValue) {
+            gs_connections = atoi(argv[++i]);
+        }
+        else if (arg == "-w" && hasValue) {
+            gs_waves = atoi(argv[++i]);
+        }
+        else if (arg == "-o" && hasValue) {
+            gs_only = atoi(argv[++i]);
+        }
+        else if (arg == "-L" && hasValue) {
+            gs_maxLatency = atoll(argv[++i]) * MS;
+        }
+        else if (arg == "-v") {
+            gs_verbose = true;
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (gs_connections < 1 || gs_waves < 1) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    Logger::CONSOLE = gs_verbose;
+    if (!gs_verbose) {
+        Logger::LEVEL = Logger::OL_ERROR;
+    }
+
+    SimNet &net = SimNet::GetInstance();
+    net.Reset(gs_seed, SimNet::Config());
+    net.SetResolver(Resolve);
+
+    int64_t begin = Clock::Virtual();
+    bool ok = true;
+    vector<string> failures;
+
+    for (int wave = 0; wave < gs_waves; wave++) {
+        if (gs_only >= 0 && gs_only / gs_connections != wave) {
+            continue;
+        }
+
+        Stats stats;
+        if (!RunWave(wave, stats)) {
+            ok = false;
+
+            for (auto &f : stats.failures) {
+                failures.push_back("wave " + to_string(wave + 1) + ": " + f);
+            }
+        }
+    }
+
+    printf("simulated %.1f s\n", Clock::ToSeconds(Clock::Virtual() - begin));
+
+    if (!ok) {
+        const size_t MAX_SHOWN = 20;
+        for (size_t i = 0; i < failures.size() && i < MAX_SHOWN; i++) {
+            printf("FAIL %s\n", failures[i].c_str());
+        }
+
+        if (failures.size() > MAX_SHOWN) {
+            printf("... and %u more\n",
+                   (unsigned) (failures.size() - MAX_SHOWN));
+        }
+
+        printf("reproduce with: %s -s %llu -n %d -w %d -L %lld\n", argv[0],
+               (unsigned long long) gs_seed, gs_connections, gs_waves,
+               (long long) (gs_maxLatency / MS));
+    }
+    else {
+        printf("PASS\n");
+    }
+
+    Logger::Stop();
+    return ok ? 0 : 1;
+}
@@ -31,8 +31,11 @@ solution "MyProxy2"
         cppdialect "C++11"
         characterset "Unicode"
 
-        headers = { "../Async.hpp", "../Logger.hpp", "../ws-util.h", }
-        sources = { "../Async.cpp", "../Logger.cpp", "../ws-util.cpp", "AsyncTest/main.cpp", }
+        headers = { "../Async.hpp", "../DNSCache.hpp", "../DNSClient.hpp", "../DNSMessage.hpp",
+                    "../PerIoContext.hpp", "../MemoryPool.hpp", "../Logger.hpp", "../RingBuffer.hpp",
+                    "../Clock.hpp", "../ws-util.h", }
+        sources = { "../Async.cpp", "../DNSCache.cpp", "../DNSClient.cpp", "../DNSMessage.cpp",
+                    "../PerIoContext.cpp", "../Logger.cpp", "../ws-util.cpp", "AsyncTest/main.cpp", }
 
         files(headers)
         files(sources)
@@ -51,3 +54,256 @@ solution "MyProxy2"
         filter "configurations:Release"
             defines { "NDEBUG" }
             optimize "On"
+
+    project "DNSStub"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+
+        headers = { "../DNSMessage.hpp", }
+        sources = { "../DNSMessage.cpp", "DNSStub/main.cpp", }
+
+        files(headers)
+        files(sources)
+
+        vpaths {
+            ["Headers"] = headers,
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "WIN32_LEAN_AND_MEAN" }
+
+        filter "system:windows"
+            links { "ws2_32" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "LoggerBench"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+        characterset "Unicode"
+
+        headers = { "../Logger.hpp", "../RingBuffer.hpp", "../Clock.hpp", }
+        sources = { "../Logger.cpp", "LoggerBench/main.cpp", }
+
+        files(headers)
+        files(sources)
+
+        vpaths {
+            ["Headers"] = headers,
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "UNICODE", "_UNICODE", "WIN32_LEAN_AND_MEAN" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "AccessLogDecoder"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+
+        headers = { "../AccessLogFormat.hpp", }
+        sources = { "AccessLogDecoder/main.cpp", }
+
+        files(headers)
+        files(sources)
+
+        vpaths {
+            ["Headers"] = headers,
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "LoadGen"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+
+        sources = { "LoadGen/main.cpp", }
+
+        files(sources)
+
+        vpaths {
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "WIN32_LEAN_AND_MEAN", "_WIN32_WINNT=0x0600" }
+
+        filter "system:windows"
+            links { "ws2_32" }
+
+        filter "system:linux"
+            links { "pthread" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "OriginServer"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+
+        sources = { "OriginServer/main.cpp", }
+
+        files(sources)
+
+        vpaths {
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "WIN32_LEAN_AND_MEAN", "_WIN32_WINNT=0x0600" }
+
+        filter "system:windows"
+            links { "ws2_32" }
+
+        filter "system:linux"
+            links { "pthread" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "MicroBench"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+        characterset "Unicode"
+
+        --  main.cpp ֮дԴļ
+        files { "../*.h", "../*.hpp", "../*.cpp", "MicroBench/main.cpp", }
+        removefiles { "../main.cpp", }
+
+        vpaths {
+            ["Headers"] = { "../*.h", "../*.hpp", },
+            ["Sources"] = { "../*.cpp", "MicroBench/main.cpp", },
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "UNICODE", "_UNICODE", "WIN32_LEAN_AND_MEAN" }
+
+        links { "ws2_32" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "ImpairRelay"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+
+        sources = { "ImpairRelay/main.cpp", }
+
+        files(sources)
+
+        vpaths {
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "WIN32_LEAN_AND_MEAN", "_WIN32_WINNT=0x0600" }
+
+        filter "system:windows"
+            links { "ws2_32" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "Simulation"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+        characterset "Unicode"
+
+        -- Դļ SimNet ɶ˿ Winsock
+        files { "../*.h", "../*.hpp", "../*.cpp", "Simulation/main.cpp", }
+        removefiles { "../main.cpp", "../Proxy.cpp", "../AdminServer.cpp", }
+
+        vpaths {
+            ["Headers"] = { "../*.h", "../*.hpp", },
+            ["Sources"] = { "../*.cpp", "Simulation/main.cpp", },
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "UNICODE", "_UNICODE", "WIN32_LEAN_AND_MEAN",
+                  "MYPROXY_SIMULATION" }
+
+        links { "ws2_32" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
+
+    project "Replay"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++11"
+
+        headers = { "../CaptureFormat.hpp", }
+        sources = { "Replay/main.cpp", }
+
+        files(headers)
+        files(sources)
+
+        vpaths {
+            ["Headers"] = headers,
+            ["Sources"] = sources,
+        }
+
+        defines { "_CRT_SECURE_NO_WARNINGS", "WIN32_LEAN_AND_MEAN", "_WIN32_WINNT=0x0600" }
+
+        filter "system:windows"
+            links { "ws2_32" }
+
+        filter "system:linux"
+            links { "pthread" }
+
+        filter "configurations:Debug"
+            defines { "_DEBUG", "DEBUG" }
+            symbols "On"
+
+        filter "configurations:Release"
+            defines { "NDEBUG" }
+            optimize "On"
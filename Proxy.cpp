@@ -1,9 +1,18 @@
 
 #include "Proxy.hpp"
 #include "Request.hpp"
+#include "DNSClient.hpp"
+#include "AdminServer.hpp"
+#include "Metrics.hpp"
+#include "DispatchProfile.hpp"
+#include "TaskExecutor.hpp"
+#include "Topology.hpp"
+#include "Admission.hpp"
+#include "Clock.hpp"
 #include "Logger.hpp"
 
 #include <mswsock.h>
+#include <mstcpip.h> // for SIO_QUERY_RSS_PROCESSOR_INFO
 
 #include <sstream>
 using namespace std;
@@ -20,9 +29,14 @@ LPFN_CONNECTEX lpfnConnectEx;
 
 //////////////////////////////////////////////////////////////////////////
 
-static int GetThreadCount() {
-    return GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
-}
+static Metrics::Counter gs_accepted
+    ("myproxy_accepted_total", "Accepted browser connections");
+
+//////////////////////////////////////////////////////////////////////////
+
+int MyProxy::DRAIN_SECONDS = 30;
+
+//////////////////////////////////////////////////////////////////////////
 
 bool AssociateWithCompletionPort(SOCKET sd, HANDLE cp, ULONG_PTR key) {
     // Associate the accept socket with the completion port.
@@ -46,42 +60,84 @@ bool AssociateWithCompletionPort(SOCKET sd, HANDLE cp, ULONG_PTR key) {
 
 MyProxy::MyProxy()
     : m_listener(INVALID_SOCKET) {
-    m_numExitedThreads = 0;
+    // ڴذڸԵ NUMA ϣȷ
+    Topology::Init();
 
     // ǿƳʼڴ
     TxContextPool::GetInstance();
-    RequestPool::GetInstance();
+    for (int i = 0; i < Topology::GetGroupCount(); i++) {
+        RequestPool::GetInstance(i);
+    }
 }
 
 MyProxy::~MyProxy() {
-    if (m_cp && m_listener != INVALID_SOCKET) {
-        int count = GetThreadCount();
+    // Ӻ Drain() ѹرռ
+    if (m_cp) {
+        Admission::Stop();
+
+        // ʧܵĲѯ SCK_EXIT ֮ǰɹ̴߳
+        DNSClient::GetInstance().CancelAll();
 
-        for (int i = 0; i < count; i++) {
-            PostQueuedCompletionStatus(m_cp, 0, SCK_EXIT, nullptr);
+        for (auto &args : m_workerArgs) {
+            int group = Topology::GetWorker(args.index).group;
+            PostQueuedCompletionStatus(m_ports[group], 0, SCK_EXIT, nullptr);
         }
 
-        while (m_numExitedThreads < count) {
-            Sleep(100);
+        for (HANDLE h : m_threads) {
+            WaitForSingleObject(h, INFINITE);
+            CloseHandle(h);
         }
 
-        closesocket(m_listener);
-        m_listener = INVALID_SOCKET;
+        m_threads.clear();
+
+        DNSClient::GetInstance().Stop();
+        AdminServer::GetInstance().Stop();
+
+        if (m_listener != INVALID_SOCKET) {
+            closesocket(m_listener);
+            m_listener = INVALID_SOCKET;
+        }
+
+        for (size_t i = 1; i < m_ports.size(); i++) {
+            CloseHandle(m_ports[i]);
+        }
+
+        m_ports.clear();
 
         CloseHandle(m_cp);
         m_cp = nullptr;
     }
 }
 
-bool MyProxy::Start(const char *addr, u_short port) {
-    enum {
-        INIT_REQUEST_POOL_SIZE = 64,
-    };
+bool MyProxy::Start(const char *addr, u_short port, SOCKET listener) {
+    if (!SetUpListener(addr, port, listener) ||
+        !GetIocpFunctionPointers(m_listener)) {
+        return false;
+    }
+
+    // m_cp  0 ɶ˿ڣDNS ͻҳֻڸ鴦
 
-    return SetUpListener(addr, port) &&
-           GetIocpFunctionPointers(m_listener) &&
-           SpawnThreads() &&
-           SpawnAcceptors(INIT_REQUEST_POOL_SIZE);
+    // ʧʱ˻صϵͳ DNS 
+    if (DNSClient::ENABLED && !DNSClient::GetInstance().Start(m_cp)) {
+        Logger::LogError(__FUNC__ "DNS client unavailable, "
+                         "falling back to GetAddrInfoExW()");
+    }
+
+    // ҳ治Ǳ
+    if (AdminServer::ENABLED && !AdminServer::GetInstance().Start(m_cp)) {
+        Logger::LogError(__FUNC__ "Admin server unavailable");
+    }
+
+    if (!SpawnThreads()) {
+        return false;
+    }
+
+    // ػ󲹳䱻õ AcceptEx()
+    if (Admission::ENABLED) {
+        Admission::Start(m_ports, [this] { OnAdmissionTick(); });
+    }
+
+    return SpawnAcceptors(Admission::GetMaxAccepts());
 }
 
 /*static*/
@@ -146,7 +202,7 @@ bool MyProxy::GetIocpFunctionPointers(SOCKET sd) {
     return true;
 }
 
-bool MyProxy::SetUpListener(const char *addr, int port) {
+bool MyProxy::SetUpListener(const char *addr, int port, SOCKET listener) {
     ostringstream oss;
     
     m_cp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, 0);
@@ -158,6 +214,23 @@ bool MyProxy::SetUpListener(const char *addr, int port) {
         return false;
     }
 
+    // ֵ׽Ѿڼ
+    if (listener != INVALID_SOCKET) {
+        m_listener = listener;
+
+        if (!AssociateWithCompletionPort(m_listener, m_cp, 0)) {
+            closesocket(m_listener);
+            m_listener = INVALID_SOCKET;
+
+            CloseHandle(m_cp);
+            m_cp = nullptr;
+
+            return false;
+        }
+
+        return true;
+    }
+
     // The socket function creates a socket that supports overlapped I/O 
     // operations as the default behavior.
     m_listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -243,6 +316,19 @@ bool MyProxy::SpawnAcceptors(int num) {
 bool MyProxy::PostAccept(RxContext &context) {
     context.Reset();
 
+    // ֹͣӺٲ
+    if (!m_accepting) {
+        return true;
+    }
+
+    // ʱãں˵ĵȴ
+    if (m_numPendingAccepts >= Admission::GetAcceptTarget()) {
+        std::lock_guard<std::mutex> lock(m_parkedMutex);
+        m_parked.push_back(&context);
+
+        return true;
+    }
+
     // Create an accepting socket.
     SOCKET bsocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (bsocket == INVALID_SOCKET) {
@@ -252,9 +338,23 @@ bool MyProxy::PostAccept(RxContext &context) {
         return false;
     }
 
+    std::unique_lock<std::mutex> lock(m_acceptMutex);
+
+    // ֮ Drain() Ѿر˼
+    if (!m_accepting) {
+        lock.unlock();
+        closesocket(bsocket);
+
+        return true;
+    }
+
     context.sd = bsocket;
     context.action = PerIoContext::ACCEPT; // TODO:
 
+    // ȼ֪ͨ AcceptEx() ֮ǰͱ
+    m_numPendingAccepts++;
+    m_pendingAccepts.insert(&context);
+
     BOOL bRetVal = lpfnAcceptEx(m_listener,
                                 context.sd,
                                 context.buf,
@@ -265,11 +365,18 @@ bool MyProxy::PostAccept(RxContext &context) {
                                 &context.ol);
 
     if (bRetVal == TRUE) {
+        m_pendingAccepts.erase(&context);
+        lock.unlock();
+
         DoAccept(context);
     }
     else {
         int ec = WSAGetLastError();
         if (ec != ERROR_IO_PENDING) {
+            m_pendingAccepts.erase(&context);
+            m_numPendingAccepts--;
+            lock.unlock();
+
             auto fmt = __FUNC__ "AcceptEx() failed";
             Logger::LogError(WSAGetLastErrorMessage(fmt, ec));
 
@@ -284,9 +391,28 @@ bool MyProxy::PostAccept(RxContext &context) {
 }
 
 bool MyProxy::SpawnThreads() {
-    int count = GetThreadCount();
+    m_ports.push_back(m_cp);
+
+    for (int i = 1; i < Topology::GetGroupCount(); i++) {
+        HANDLE cp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, 0);
+        if (cp == nullptr) {
+            Logger::LogWindowsLastError
+                (__FUNC__ "CreateIoCompletionPort() failed");
+
+            return false;
+        }
+
+        m_ports.push_back(cp);
+    }
+
+    // ߳õָŲʧЧ
+    int count = Topology::GetWorkerCount();
     for (int i = 0; i < count; i++) {
-        HANDLE h = CreateThread(nullptr, 0, ProxyHandler, this, 0, nullptr);
+        m_workerArgs.push_back(WorkerArgs{this, i});
+    }
+
+    for (auto &args : m_workerArgs) {
+        HANDLE h = CreateThread(nullptr, 0, ProxyHandler, &args, 0, nullptr);
         if (h == nullptr) {
             ostringstream ss;
             ss << "CreateThread() failed --" << GetLastError();
@@ -294,6 +420,8 @@ bool MyProxy::SpawnThreads() {
 
             return false;
         }
+
+        m_threads.push_back(h);
     }
 
     return true;
@@ -303,16 +431,57 @@ bool MyProxy::SpawnThreads() {
 DWORD CALLBACK MyProxy::ProxyHandler(PVOID pv) {
     ostringstream oss;
 
-    MyProxy *This = (MyProxy *) pv;
+    WorkerArgs *args = (WorkerArgs *) pv;
+    MyProxy *This = args->proxy;
+
+    Topology::EnterWorker(args->index);
+    int group = Topology::GetWorker(args->index).group;
+    HANDLE cp = This->m_ports[group];
 
     DWORD transfered;
     ULONG_PTR key;
     PerIoContext *pic;
 
+    // DNS ͻҳ׽ֻ 0 ɶ˿ڣǵ
+    // Сֵ÷ɢ顣̲߳յǵ֪ͨ
+    // Ҳض DNS ѯǷʱ
+    bool ownsDNS = group == 0;
+
+    DNSClient &dnsClient = DNSClient::GetInstance();
+    AdminServer &adminServer = AdminServer::GetInstance();
+    DWORD timeout = (ownsDNS && dnsClient.IsRunning()) ?
+                    DNSClient::TICK_INTERVAL : INFINITE;
+
     while (true) {
-        if (!GetQueuedCompletionStatus(This->m_cp, &transfered, &key,
+        if (ownsDNS) {
+            dnsClient.Poll();
+        }
+
+        if (!GetQueuedCompletionStatus(cp, &transfered, &key,
                                       (LPWSAOVERLAPPED *) &pic,
-                                       INFINITE)) {
+                                       timeout)) {
+            // ûгκ֪ͨ
+            if (pic == nullptr) {
+                if (GetLastError() != WAIT_TIMEOUT) {
+                    oss << __FUNC__ "GetQueuedCompletionStatus() failed -- "
+                        << GetLastError();
+
+                    Logger::LogError(oss.str());
+                    oss.str(string());
+                }
+
+                continue;
+            }
+
+            if (key == SCK_DNS_CLIENT) {
+                dnsClient.OnCompletion(pic, 0, false);
+                continue;
+            }
+            else if (key == SCK_ADMIN) {
+                adminServer.OnCompletion(pic, 0, false);
+                continue;
+            }
+
             switch (GetLastError()) {
             // ʱֻ첽ӲӦ˳ʱ
             case ERROR_SEM_TIMEOUT:
@@ -352,23 +521,50 @@ DWORD CALLBACK MyProxy::ProxyHandler(PVOID pv) {
         }
 
         if (key == SCK_EXIT) {
-            This->m_numExitedThreads++;
             break;
         }
         else if (key == SCK_NAME_RESOLVE) {
+            DispatchProfile::Scope scope(DispatchProfile::OP_NAME_RESOLVE);
+
             auto context = (AsyncResolver::QueryContext *) pic;
             Request *req = (Request *) context->userData;
 
             req->OnIocpQueryCompleted(*context);
             continue;
         }
+        else if (key == SCK_DNS_CLIENT) {
+            dnsClient.OnCompletion(pic, transfered, true);
+            continue;
+        }
+        else if (key == SCK_ADMIN) {
+            adminServer.OnCompletion(pic, transfered, true);
+            continue;
+        }
+        else if (key == SCK_TASK) {
+            ((TaskExecutor::Task *) (LPOVERLAPPED) pic)->Complete();
+            continue;
+        }
+        else if (key == SCK_PROBE) {
+            Admission::OnProbe((Admission::Probe *) (LPOVERLAPPED) pic);
+            continue;
+        }
 
 HANDLERS:
+        DispatchProfile::Scope scope(DispatchProfile::OpOf(pic->action));
+        Topology::RecordCompletion();
+
         switch (pic->action) {
         case PerIoContext::ACCEPT: {
             RxContext *context = (RxContext *) pic;
             context->rx = transfered;
 
+            {
+                std::lock_guard<std::mutex> lock(This->m_acceptMutex);
+                This->m_pendingAccepts.erase(context);
+            }
+
+            This->m_numPendingAccepts--;
+
             if (transfered > 0) {
                 This->DoAccept(*context);
             }
@@ -424,37 +620,203 @@ HANDLERS:
         }
     }
 
-    Logger::LogInfo("Worker thread ended.");
+    LOG_INFO("Worker thread ended.");
     return 0;
 }
 
 void MyProxy::DoAccept(RxContext &context) {
-    Request *req = RequestPool::GetInstance().Allocate();
-    req->Init(m_cp, context);
+    // ʱ Requestظ 503 ر
+    if (Admission::ShouldReject()) {
+        UpdateAcceptContext(context.sd);
+
+        // Ӧδʱֱ
+        bool sent = Admission::Reject(context.sd);
+        ShutdownConnection(context.sd, sent);
+
+        PostAccept(context);
+        return;
+    }
+
+    int group = PlaceConnection(context.sd);
+    HANDLE cp = m_ports[group];
+
+    Request *req = RequestPool::GetInstance(group).Allocate();
 
     // Associate the accept socket with the completion port.
-    if (!AssociateWithCompletionPort(context.sd, m_cp, (ULONG_PTR) req)) {
-        RequestPool::GetInstance().DeAllocate(req);
+    if (!AssociateWithCompletionPort(context.sd, cp, (ULONG_PTR) req)) {
+        RequestPool::GetInstance(group).DeAllocate(req);
+
+        // ӣʧȥ acceptor
+        ShutdownConnection(context.sd);
+        PostAccept(context);
+
         return;
     }
 
-    sockaddr_in *local, *remote;
-    int i1, i2;
+    req->Init(cp, context, group);
+    gs_accepted.Inc();
+    Topology::RecordAccepted(group);
+
+    // ֻҪʱŽַ
+    Logger::LogLazy<Logger::OL_INFO>([&](std::ostream &os) {
+        sockaddr_in *local, *remote;
+        int i1, i2;
 
-    lpfnGetAcceptExSockAddrs((LPVOID) context.buf, 
-                              RxContext::DATA_CAPACITY,
-                              RxContext::ADDR_LEN,
-                              RxContext::ADDR_LEN,
-                             (LPSOCKADDR *) &local, &i1,
-                             (LPSOCKADDR *) &remote, &i2);
+        lpfnGetAcceptExSockAddrs((LPVOID) context.buf, 
+                                  RxContext::DATA_CAPACITY,
+                                  RxContext::ADDR_LEN,
+                                  RxContext::ADDR_LEN,
+                                 (LPSOCKADDR *) &local, &i1,
+                                 (LPSOCKADDR *) &remote, &i2);
 
-    ostringstream ss;
-    ss << "Accepted connection from " << inet_ntoa(remote->sin_addr)
-       << ":" << ntohs(remote->sin_port);
-    Logger::LogInfo(ss.str());
+        os << "Accepted connection from " << inet_ntoa(remote->sin_addr)
+           << ":" << ntohs(remote->sin_port);
+    });
 
     req->HandleBrowser();
 
     // ·첽 acceptor
     PostAccept(context);
 }
+
+int MyProxy::PlaceConnection(SOCKET sd) {
+    int numGroups = (int) m_ports.size();
+    if (numGroups == 1) {
+        return 0;
+    }
+
+    // ѴӵݰͶݵ NUMA 
+    if (Topology::RSS_PLACEMENT) {
+        UpdateAcceptContext(sd);
+
+        SOCKET_PROCESSOR_AFFINITY spa;
+        DWORD bytes = 0;
+
+        if (WSAIoctl(sd, SIO_QUERY_RSS_PROCESSOR_INFO, nullptr, 0,
+                     &spa, sizeof(spa), &bytes, nullptr, nullptr) == 0) {
+            int group = Topology::GetGroupOfNode(spa.NumaNodeId);
+            if (group >= 0) {
+                return group;
+            }
+        }
+    }
+
+    return (int) (m_nextGroup++ % numGroups);
+}
+
+void MyProxy::UpdateAcceptContext(SOCKET sd) {
+    std::lock_guard<std::mutex> lock(m_acceptMutex);
+
+    if (m_listener != INVALID_SOCKET) {
+        setsockopt(sd, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+                   (char *) &m_listener, sizeof(m_listener));
+    }
+}
+
+void MyProxy::CancelAcceptors(bool idle, DWORD silentSeconds) {
+    // ڼ乤߳޷ȡύЩ acceptorȡ
+    // ͬһ AcceptEx()ɵȡֻʧ
+    std::lock_guard<std::mutex> lock(m_acceptMutex);
+
+    if (m_listener == INVALID_SOCKET) {
+        return;
+    }
+
+    for (RxContext *context : m_pendingAccepts) {
+        // ӽʱΪ 0xFFFFFFFF
+        DWORD seconds = 0;
+        int len = sizeof(seconds);
+
+        if (getsockopt(context->sd, SOL_SOCKET, SO_CONNECT_TIME,
+                       (char *) &seconds, &len) != 0) {
+            seconds = 0xFFFFFFFF;
+        }
+
+        bool cancel = (seconds == 0xFFFFFFFF) ? idle :
+                      (silentSeconds > 0 && seconds >= silentSeconds);
+
+        if (cancel) {
+            CancelIoEx((HANDLE) m_listener, &context->ol);
+        }
+    }
+}
+
+bool MyProxy::Drain(int seconds, bool handedOver, HANDLE abortEvent) {
+    {
+        std::lock_guard<std::mutex> lock(m_acceptMutex);
+        m_accepting = false;
+
+        // ½̳м׽ֵĸرձ̵ľӰ
+        if (handedOver && m_listener != INVALID_SOCKET) {
+            closesocket(m_listener);
+            m_listener = INVALID_SOCKET;
+        }
+    }
+
+    int64_t deadline = Clock::Now() + seconds * Clock::Frequency();
+    long long connections = 0;
+
+    while (true) {
+        // ӽ AcceptEx() ȴ׸ݰճ
+        if (!handedOver) {
+            CancelAcceptors(true, 0);
+        }
+
+        connections = Request::GetConnectionCount();
+        if (m_numPendingAccepts == 0 && connections == 0) {
+            Logger::LogInfo(__FUNC__ "All connections drained");
+            return true;
+        }
+
+        if (Clock::Now() >= deadline) {
+            break;
+        }
+
+        if (abortEvent) {
+            if (WaitForSingleObject(abortEvent, 100) == WAIT_OBJECT_0) {
+                break;
+            }
+        }
+        else {
+            Sleep(100);
+        }
+    }
+
+    ostringstream oss;
+    oss << __FUNC__ "Gave up draining with " << connections
+        << " connection(s) and " << m_numPendingAccepts
+        << " pending accept(s) left";
+
+    Logger::LogError(oss.str());
+    return false;
+}
+
+void MyProxy::OnAdmissionTick() {
+    // ֻʣȼ AcceptEx()ȴ˵Ŀͻռס
+    if (Admission::GetAcceptTarget() < Admission::GetMaxAccepts()) {
+        CancelAcceptors(false, Admission::ACCEPT_TIMEOUT);
+    }
+
+    ResumeAcceptors();
+}
+
+void MyProxy::ResumeAcceptors() {
+    while (m_accepting &&
+           m_numPendingAccepts < Admission::GetAcceptTarget()) {
+        RxContext *context;
+
+        {
+            std::lock_guard<std::mutex> lock(m_parkedMutex);
+            if (m_parked.empty()) {
+                break;
+            }
+
+            context = m_parked.back();
+            m_parked.pop_back();
+        }
+
+        if (!PostAccept(*context)) {
+            break;
+        }
+    }
+}
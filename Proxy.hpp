@@ -5,6 +5,8 @@
 #include <vector>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_set>
 
 struct RxContext;
 class Request;
@@ -17,25 +19,67 @@ public:
     MyProxy();
 
     /// 
+    ///
+    /// й̣߳δɵ֮жϣҪƽ˳ʱȵ
+    /// #Drain()
     ~MyProxy();
 
+    /// ֹͣӺȴ;ӽʱ䣨룩
+    static int DRAIN_SECONDS;
+
     /// ʼ
-    bool Start(const char *addr, u_short port);
+    ///
+    /// @param listener Ӿɽֵ̽ļ׽֣ Upgrade
+    ///                 Ϊ INVALID_SOCKET ʱ @a addr:@a port ½
+    bool Start(const char *addr, u_short port,
+               SOCKET listener = INVALID_SOCKET);
+
+    /// ׽
+    SOCKET GetListener() const {
+        return m_listener;
+    }
+
+    /// ֹͣӣȴ;ӽ
+    ///
+    /// Ѿȴ׸ճ
+    ///
+    /// @param handedOver ׽Ƿѽ½̣ Upgrade
+    ///                   رձ̵ļϵͳϵ
+    ///                   AcceptEx()ȡӽ
+    /// @param abortEvent λʱأΪ
+    /// @return ǷӶ @a seconds ڽ
+    bool Drain(int seconds, bool handedOver, HANDLE abortEvent = nullptr);
 
 private:
 
     // ȡ IOCP  API ĺָ
     static bool GetIocpFunctionPointers(SOCKET sd);
 
-    // ʼ׽
-    bool SetUpListener(const char *addr, int port);
+    // ʼ׽֣@a listener Чʱֱʹ
+    bool SetUpListener(const char *addr, int port, SOCKET listener);
 
     // ύ @a num  AcceptEx() 첽
     bool SpawnAcceptors(int num);
 
     bool PostAccept(RxContext &context);
 
-    // ߳
+    // Լ׽ָѽܵ @a sd 
+    void UpdateAcceptContext(SOCKET sd);
+
+    // ȡ AcceptEx() 
+    //
+    // @param idle Ƿȡӽ
+    // @param silentSeconds ȡӽ󳬹ôδݵģ
+    //                      0 ʾȡ
+    void CancelAcceptors(bool idle, DWORD silentSeconds);
+
+    // Admission ÿβ
+    void OnAdmissionTick();
+
+    //  Admission Ŀ겹䱻õ AcceptEx() 
+    void ResumeAcceptors();
+
+    // ɶ˿빤߳
     bool SpawnThreads();
 
     // ߳ں
@@ -44,13 +88,41 @@ private:
     // һ
     void DoAccept(RxContext &context);
 
+    // Ϊ½ܵ @a sd ѡ߳
+    int PlaceConnection(SOCKET sd);
+
 private:
 
     HANDLE m_cp = nullptr;
     SOCKET m_listener;
 
+    // ߳ɶ˿ڣ 0 鼴 m_cp
+    std::vector<HANDLE> m_ports;
+    std::atomic_uint m_nextGroup{0}; // 
+
+    // ߳ںĲ
+    struct WorkerArgs {
+        MyProxy *proxy;
+        int index; //  Topology е
+    };
+
+    std::vector<WorkerArgs> m_workerArgs;
+
     typedef std::vector<std::shared_ptr<RxContext>> AcceptorVec;
 
     AcceptorVec m_acceptors;
-    std::atomic_int m_numExitedThreads; // ˳߳Ŀ
+    std::atomic_int m_numPendingAccepts{0}; // δɵ AcceptEx() Ŀ
+    std::atomic_bool m_accepting{true}; // Ƿ
+
+    //  m_pendingAccepts Ĺر
+    //
+    // ߳ȴӼȡ acceptor ŻĶ sdʱе
+    // acceptor  sd ЧǴ AcceptEx() ׽֡
+    std::mutex m_acceptMutex;
+    std::unordered_set<RxContext *> m_pendingAccepts; // ύ AcceptEx()
+
+    std::mutex m_parkedMutex;
+    std::vector<RxContext *> m_parked; // ضõ acceptor
+
+    std::vector<HANDLE> m_threads; // ߳
 };
@@ -1,14 +1,23 @@
 
 #include "Request.hpp"
 #include "DNSCache.hpp"
+#include "Clock.hpp"
+#include "Metrics.hpp"
+#include "TrafficTable.hpp"
+#include "AdminServer.hpp"
 
 #include <Ws2tcpip.h> // for getaddrinfo()
 #include <mswsock.h> // for LPFN_CONNECTEX
 
 #include <sstream>
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 
+#ifdef MYPROXY_SIMULATION
+#include "SimNet.hpp" // ڴ滻 Winsock 
+#endif
+
 #include "Debug.hpp"
 
 
@@ -24,12 +33,99 @@ string ToLower(const string &s) {
     return ret;
 }
 
+// ״̬ "HTTP/x.y NNN ..." н״̬
+//
+//  NUL βֻǰ @a len ֽڣʽʱ 0
+static uint16_t ParseStatusCode(const char *buf, size_t len) {
+    if (len < 12 || buf[8] != ' ') {
+        return 0;
+    }
+
+    uint16_t code = 0;
+    for (size_t i = 9; i < 12; i++) {
+        if (buf[i] < '0' || buf[i] > '9') {
+            return 0;
+        }
+
+        code = code * 10 + (buf[i] - '0');
+    }
+
+    if (len > 12 && buf[12] != ' ' && buf[12] != '\r') {
+        return 0;
+    }
+
+    return code >= 100 ? code : 0;
+}
+
 bool AssociateWithCompletionPort(SOCKET sd, HANDLE cp, ULONG_PTR key);
 extern LPFN_CONNECTEX lpfnConnectEx;
 
+// ¼켣¼¼ش RequestTrace:: ǰ׺
+//
+// δʱֻһοָжϡ
+#define REQ_TRACE(...) \
+    do { if (m_trace) m_trace->Add(RequestTrace::__VA_ARGS__); } while (0)
+
+// ǰ׺־Ϊʽ
+#define REQ_LOG_INFO(args) \
+    LogLazy<Logger::OL_INFO>([&](std::ostream &os_) { os_ << args; })
+
 //////////////////////////////////////////////////////////////////////////
 
-Request::Statistics Request::ms_stat;
+static Metrics::Gauge gs_connections
+    ("myproxy_browser_connections", "Open browser connections");
+static Metrics::Counter gs_requests
+    ("myproxy_requests_total", "HTTP requests and tunnels from browsers");
+
+static Metrics::Counter gs_dnsLookups
+    ("myproxy_dns_lookups_total", "Host name lookups");
+static Metrics::Counter gs_dnsCacheHits
+    ("myproxy_dns_cache_hits_total", "Lookups answered by the DNS cache");
+static Metrics::Counter gs_dnsFailures
+    ("myproxy_dns_failures_total", "Lookups that yielded no address");
+
+static Metrics::Counter gs_connectsOk
+    ("myproxy_server_connects_total{result=\"ok\"}",
+     "Connection attempts to servers");
+static Metrics::Counter gs_connectsFailed
+    ("myproxy_server_connects_total{result=\"failed\"}",
+     "Connection attempts to servers");
+static Metrics::Counter gs_reuses
+    ("myproxy_server_reuses_total", "Requests sent on a kept-alive "
+     "server connection");
+
+static Metrics::Counter gs_browserRx
+    ("myproxy_received_bytes_total{peer=\"browser\"}", "Bytes received");
+static Metrics::Counter gs_serverRx
+    ("myproxy_received_bytes_total{peer=\"server\"}", "Bytes received");
+static Metrics::Counter gs_txBytes
+    ("myproxy_sent_bytes_total", "Bytes sent to browsers and servers");
+static Metrics::Histogram gs_recvSize
+    ("myproxy_recv_size_bytes", "Payload size of completed receives");
+
+// ׶κʱ΢¼뵼
+static Metrics::Histogram gs_headerLatency
+    ("myproxy_header_seconds", "From accept to the first complete "
+     "request header", 1e-6);
+static Metrics::Histogram gs_dnsLatency
+    ("myproxy_dns_seconds", "Host name resolution, cache misses only", 1e-6);
+static Metrics::Histogram gs_connectLatency
+    ("myproxy_connect_seconds", "Successful connection attempts to "
+     "servers", 1e-6);
+static Metrics::Histogram gs_firstByteLatency
+    ("myproxy_first_byte_seconds", "From complete request header to the "
+     "first byte from the server", 1e-6);
+static Metrics::Histogram gs_requestLatency
+    ("myproxy_request_seconds", "From complete request header to the end "
+     "of the request", 1e-6);
+
+// ¼ʱ @a from  @a to ĺʱ
+static void RecordLatency(Metrics::Histogram &histogram,
+                          int64_t from, int64_t to) {
+    if (from != 0 && to >= from) {
+        histogram.Record((uint64_t) Clock::ToMicroseconds(to - from));
+    }
+}
 
 Request::Request()
     : m_vbuf(0),
@@ -40,13 +136,43 @@ Request::Request()
 
 Request::~Request() {
     Clear();
+    delete m_trace;
+    delete m_capture;
 }
 
-void Request::Init(HANDLE cp, const RxContext &acceptContext) {
+void Request::Init(HANDLE cp, const RxContext &acceptContext, int group) {
     m_cp = cp;
+    m_group = group;
     m_bcontext = acceptContext;
 
+    m_acceptTS = Clock::Now();
+    m_access.Reset();
+    m_accessBegun = false;
+
     m_delTS = 0;
+
+    if (RequestTrace::ENABLED && !m_trace) {
+        m_trace = new RequestTrace;
+    }
+
+    if (m_trace) {
+        m_trace->Clear();
+    }
+
+    if (Capture::IsRunning()) {
+        if (!m_capture) {
+            m_capture = new Capture::Entry;
+        }
+
+        m_capture->conn = Capture::NewConnection();
+        m_capture->request = 0;
+    }
+    else {
+        delete m_capture;
+        m_capture = nullptr;
+    }
+
+    gs_connections.Inc();
 }
 
 void Request::ShutdownBrowserSocket() {
@@ -117,13 +243,17 @@ void Request::Clear() {
 }
 
 void Request::DeleteThis() {
+    REQ_TRACE(E_DELETE, RequestTrace::P_NONE);
+    FinishAccess();
+    gs_connections.Dec();
+
     ShutdownBrowserSocket();
     ShutdownServerSocket();
 
     Clear();
 
     m_delTS = time(nullptr);
-    RequestPool::GetInstance().DeAllocate(this);
+    RequestPool::GetInstance(m_group).DeAllocate(this);
 }
 
 bool Request::IsRecyclable() const {
@@ -132,6 +262,8 @@ bool Request::IsRecyclable() const {
 }
 
 void Request::HandleBrowser() {
+    REQ_TRACE(E_HANDLE_BROWSER, RequestTrace::P_BROWSER, m_bcontext.rx);
+
     if (m_bcontext.rx > 0) {
         m_everRx = true;
         m_noAttachedData = false;
@@ -148,16 +280,24 @@ void Request::HandleBrowser() {
 
     if (!TryParsingHeaders()) {
         m_vbuf.pop_back();
+
+        // ͷвգѱʱ֪ͨ
+        if (!PostRecv(m_bcontext)) {
+            DeleteThis();
+        }
+
         return;
     }
 
     PrintRequest(Logger::OL_INFO);
+    BeginAccess();
 
     //-------------------------------------------
 
     if (strncmp(m_vbuf.data(), "CONNECT ", 8) == 0) {
         SplitHost(m_vbuf.data() + 8, 443);
         m_host.tunel = true;
+        m_access.flags |= AccessLogFormat::F_TUNNEL;
 
         ShutdownServerSocket();
     }
@@ -195,7 +335,6 @@ void Request::OnUploadDone() {
 
 bool Request::TryParsingHeaders() {
     if (!m_headers.Parse(m_vbuf.data(), true)) {
-        PostRecv(m_bcontext);
         return false;
     }
 
@@ -204,6 +343,11 @@ bool Request::TryParsingHeaders() {
 
     m_brx = m_vbuf.size() - 1;
 
+    // ϵĵһ
+    if (!m_accessBegun) {
+        RecordLatency(gs_headerLatency, m_acceptTS, Clock::Now());
+    }
+
     auto it(m_headers.m.find("Content-Length"));
     if (it != m_headers.m.end()) {
         m_btotal = m_headers.bodyOffset + atoi(it->second.c_str());
@@ -222,18 +366,21 @@ void Request::OnRecvCompleted(RxContext &context) {
         return;
     }
 
+    REQ_TRACE(E_RECV_COMPLETED, PeerOf(context.sd), context.rx);
+
     SetRxReqPostedMark(IsBrowserOrientedContext(context), false);
+    gs_recvSize.Record(context.rx);
 
     // һϿ
     if (context.rx == 0) {
         if (IsBrowserOrientedContext(context)) {
-            LogInfo("Browser disconnected");
+            REQ_LOG_INFO("Browser disconnected");
 
             // һرշ
             DeleteThis();
         }
         else {
-            LogInfo("Server disconnected");
+            REQ_LOG_INFO("Server disconnected");
 
             // 
             ShutdownServerSocket();
@@ -248,6 +395,9 @@ void Request::OnRecvCompleted(RxContext &context) {
             return;
         }
         else {
+            m_access.inBytes += context.rx;
+            gs_browserRx.Add(context.rx);
+
             if (m_host.tunel) {
                 PostSend(NewTxContext(m_scontext.sd, context));
             }
@@ -264,16 +414,46 @@ void Request::OnRecvCompleted(RxContext &context) {
         }
     }
     else if (context.sd == m_scontext.sd) {
+        m_access.outBytes += context.rx;
+        gs_serverRx.Add(context.rx);
+
         if (!m_firstResponseRecv) {
             m_firstResponseRecv = true;
+            m_access.firstByte = Clock::Now();
+            RecordLatency(gs_firstByteLatency,
+                          m_access.request, m_access.firstByte);
+
+            // Ӧͷͨλڵһֶ
+            if (m_capture && !m_host.tunel) {
+                const char *end = "\r\n\r\n";
+                const char *p = search(context.buf, context.buf + context.rx,
+                                       end, end + 4);
+
+                m_capture->responseHeader = (uint32_t) (p - context.buf) +
+                    (p != context.buf + context.rx ? 4 : 0);
+            }
 
             if (!m_host.tunel) {
-                if (strncmp(context.buf, "HTTP/", 5) == 0) {
-                    string resp(context.buf, strchr(context.buf, '\r'));
-                    LogInfo(__FUNC__ + resp);
+                // һֶοܻ 5 ֽ
+                size_t n = min<size_t>(context.rx, 5);
+
+                if (strncmp(context.buf, "HTTP/", n) == 0) {
+                    m_access.status = ParseStatusCode(context.buf, context.rx);
+
+                    // ջ NUL βֻѽյķΧڲ
+                    const char *buf = context.buf;
+                    size_t rx = context.rx;
+
+                    LogLazy<Logger::OL_INFO>([buf, rx](std::ostream &os) {
+                        auto cr = (const char *) memchr(buf, '\r', rx);
+
+                        os << __FUNC__;
+                        os.write(buf, cr ? cr - buf : rx);
+                    });
                 }
                 else {
                     LogError(__FUNC__ "Fatal: Incorrect response header");
+                    m_access.flags |= AccessLogFormat::F_BAD_RESPONSE;
                     
                     DeleteThis();
                     return;
@@ -291,10 +471,21 @@ void Request::OnRecvCompleted(RxContext &context) {
     }
 
     // ʼռΪǱ֪ʲôʱϿ
-    PostRecv(context);
+    if (!PostRecv(context) && context.IsOk() && m_bcontext.IsOk()) {
+        // ѱãϿ
+        if (IsBrowserOrientedContext(context)) {
+            DeleteThis();
+        }
+        else {
+            ShutdownServerSocket();
+        }
+    }
 }
 
 void Request::OnSendCompleted(TxContext *&context) {
+    REQ_TRACE(E_SEND_COMPLETED, PeerOf(context->sd), context->tx);
+    gs_txBytes.Add(context->tx);
+
     if (m_bcontext.IsOk() && context->tx != context->buffers->len) {
         ostringstream oss;
         oss << __FUNC__ "Byte count: " << context->buffers->len
@@ -308,14 +499,19 @@ void Request::OnSendCompleted(TxContext *&context) {
 }
 
 void Request::PrintRequest(Logger::OutputLevel level) const {
+    if (!Logger::IsEnabled(level)) {
+        return;
+    }
+
     auto p = min(strchr(m_vbuf.data(), '\r'), m_vbuf.data() + 100);
     string firstLine(m_vbuf.data(), p);
 
     Log(firstLine, level);
 }
 
-Request::Statistics Request::GetStatistics() {
-    return ms_stat;
+/*static*/
+long long Request::GetConnectionCount() {
+    return gs_connections.GetValue();
 }
 
 void Request::SplitHost(const string &decl, int defaultPort) {
@@ -337,16 +533,27 @@ bool Request::HandleServer() {
 
     if (m_scontext.IsOk()) {
         if (DoHandleServer()) {
-            LogInfo(__FUNC__ "Successfully reused socket");
+            m_access.flags |= AccessLogFormat::F_REUSED;
+            gs_reuses.Inc();
+
+            REQ_LOG_INFO(__FUNC__ "Successfully reused socket");
             return true;
         }
 
         ShutdownServerSocket();
     }
 
-    if (TryDNSCache()) {
+    bool failed = false;
+    if (TryDNSCache(failed)) {
         return true;
     }
+    else if (failed) {
+        m_access.flags |= AccessLogFormat::F_DNS_FAILED;
+        gs_dnsFailures.Inc();
+
+        LogError(__FUNC__ "Negative DNS cache hit");
+        return false;
+    }
     else {
         return PostDnsQuery();
     }
@@ -377,12 +584,19 @@ bool Request::DoHandleServer() {
     return true;
 }
 
-bool Request::TryDNSCache() {
+bool Request::TryDNSCache(bool &failed) {
     assert(!m_qcontext);
-    ms_stat.dnsQueries++;
+    gs_dnsLookups.Inc();
 
-    m_ai = DNSCache::Resolve(m_host.GetFullName());
+    m_access.dnsStart = Clock::Now();
+
+    m_ai = m_aiCached = DNSCache::Resolve(m_host.GetFullName(), &failed);
     if (m_ai) {
+        gs_dnsCacheHits.Inc();
+
+        m_access.dnsEnd = m_access.dnsStart;
+        m_access.flags |= AccessLogFormat::F_DNS_CACHE_HIT;
+
         PostConnect();
         return true;
     }
@@ -396,19 +610,27 @@ void Request::DelQueryContext() {
         m_qcontext = nullptr;
     }
     //  DNS 
-    else if (m_ai) {
-        DNSCache::DestroyAddrInfo(m_ai);
+    else if (m_aiCached) {
+        DNSCache::DestroyAddrInfo(m_aiCached);
     }
-    
-    m_ai = nullptr;
+
+    m_ai = m_aiCached = nullptr;
 }
 
 bool Request::PostDnsQuery() {
+    REQ_TRACE(E_POST_DNS_QUERY, RequestTrace::P_SERVER);
+
     AsyncResolver::Request req{m_host.name.c_str(), m_host.port, this};
     return m_resolver.PostResolve(req);
 }
 
 void Request::OnQueryCompleted(QueryContext *context) {
+    //  DNS ͻڹ߳УƵɶ˿
+    if (context->onWorker) {
+        OnIocpQueryCompleted(*context);
+        return;
+    }
+
     BOOL bResult = PostQueuedCompletionStatus
         (m_cp, 0, SCK_NAME_RESOLVE, &context->ol);
 
@@ -430,6 +652,23 @@ void Request::OnIocpQueryCompleted(QueryContext &context) {
     m_qcontext = &context;
     m_ai = m_qcontext->results;
 
+    REQ_TRACE(E_DNS_COMPLETED, RequestTrace::P_SERVER, context.error);
+
+    m_access.dnsEnd = Clock::Now();
+    RecordLatency(gs_dnsLatency, m_access.dnsStart, m_access.dnsEnd);
+
+    if (!m_ai) {
+        m_access.flags |= AccessLogFormat::F_DNS_FAILED;
+        gs_dnsFailures.Inc();
+    }
+
+    if (m_ai) {
+        DNSCache::Add(m_host.GetFullName(), *m_ai, context.ttl);
+    }
+    else if (DNSCache::IsNegativeCacheable(context.error)) {
+        DNSCache::AddNegative(m_host.GetFullName());
+    }
+
     PostConnect();
 }
 
@@ -468,8 +707,63 @@ bool Bind(SOCKET sd, const ADDRINFOEX &ai) {
     return true;
 }
 
+// ǷΪҳļ˵
+//
+// ҳûֻ֤ڱַȥ
+// κʹô˶ܷ 0.0.0.0 ʱֻʶػַ
+static bool IsAdminEndpoint(const sockaddr *addr) {
+#ifdef MYPROXY_SIMULATION
+    (void) addr;
+    return false; // ģ⹹ҳ
+#else
+    if (!AdminServer::ENABLED) {
+        return false;
+    }
+
+    u_long ip; // ֽ
+    u_short port;
+
+    if (addr->sa_family == AF_INET) {
+        auto sin = (const sockaddr_in *) addr;
+        ip = sin->sin_addr.s_addr;
+        port = sin->sin_port;
+    }
+    else if (addr->sa_family == AF_INET6) {
+        // ֻ IPv4 ӳַܵֻ IPv4 ģҳ
+        auto sin6 = (const sockaddr_in6 *) addr;
+        static const unsigned char prefix[12] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff,
+        };
+
+        if (memcmp(&sin6->sin6_addr, prefix, sizeof(prefix)) != 0) {
+            return false;
+        }
+
+        memcpy(&ip, (const char *) &sin6->sin6_addr + 12, sizeof(ip));
+        port = sin6->sin6_port;
+    }
+    else {
+        return false;
+    }
+
+    if (port != htons(AdminServer::PORT)) {
+        return false;
+    }
+
+    if ((ntohl(ip) >> 24) == 127) {
+        return true;
+    }
+
+    return ip == inet_addr(AdminServer::ADDRESS.c_str());
+#endif
+}
+
 void Request::PostConnect() {
     if (!m_ai) {
+        if (!(m_access.flags & AccessLogFormat::F_DNS_FAILED)) {
+            m_access.flags |= AccessLogFormat::F_CONNECT_FAILED;
+        }
+
         DelQueryContext();
         DeleteThis();
 
@@ -478,6 +772,15 @@ void Request::PostConnect() {
 
     const ADDRINFOEX &ai = *m_ai;
 
+    if (IsAdminEndpoint(ai.ai_addr)) {
+        LogError(__FUNC__ "Refused to connect to the admin server");
+
+        m_ai = m_ai->ai_next;
+        PostConnect();
+
+        return;
+    }
+
     SOCKET sd = socket(ai.ai_family, ai.ai_socktype, ai.ai_protocol);
     if (sd == INVALID_SOCKET) {
         LogError(WSAGetLastErrorMessage(__FUNC__ "socket() failed"));
@@ -497,12 +800,6 @@ void Request::PostConnect() {
     }
 
     m_ccontext.sd = sd;
-
-    // 籾Ի棬ͲҪ¼ӽȥ
-    if (!m_qcontext) {
-        DNSCache::Add(m_host.GetFullName(), *m_ai);
-    }
-    
     m_ai = m_ai->ai_next;
 
     //-------------------------------------------
@@ -515,6 +812,9 @@ void Request::PostConnect() {
         len = m_vbuf.size() - 1;
     }
 
+    m_connectTS = Clock::Now();
+    REQ_TRACE(E_POST_CONNECT, RequestTrace::P_SERVER);
+
     BOOL bResult = lpfnConnectEx(m_ccontext.sd,
                                  ai.ai_addr, 
                                  ai.ai_addrlen,
@@ -538,8 +838,11 @@ void Request::PostConnect() {
 
 void Request::OnConnectCompleted() {
     assert(m_ccontext.IsOk());
+    REQ_TRACE(E_CONNECT_COMPLETED, RequestTrace::P_SERVER,
+              m_ccontext.connected);
 
     if (!m_ccontext.connected) {
+        gs_connectsFailed.Inc();
         DNSCache::Remove(m_host.GetFullName());
 
         closesocket(m_ccontext.sd);
@@ -559,7 +862,11 @@ void Request::OnConnectCompleted() {
     m_scontext.sd = m_ccontext.sd;
     m_ccontext.Reset();
 
-    LogInfo("Connected to server");
+    m_access.connect = Clock::Now();
+    RecordLatency(gs_connectLatency, m_connectTS, m_access.connect);
+    gs_connectsOk.Inc();
+
+    REQ_LOG_INFO("Connected to server");
 
     // ȡӦ
     if (!PostRecv(m_scontext)) {
@@ -689,6 +996,7 @@ bool Request::PostRecv(RxContext &context) {
     assert(context.sd != m_scontext.sd || !m_srxPosted);
 
     context.PrepareForNextRecv();
+    REQ_TRACE(E_POST_RECV, PeerOf(context.sd));
 
     // áύ־λ
     // ̷֪ͨ͵ģ־λûбʱã
@@ -730,6 +1038,8 @@ bool Request::PostSend(TxContext *context) {
         return false;
     }
 
+    REQ_TRACE(E_POST_SEND, PeerOf(context->sd), context->buffers->len);
+
     int iResult = WSASend(context->sd,
                           context->buffers,
                           context->nb,
@@ -750,9 +1060,93 @@ bool Request::PostSend(TxContext *context) {
     auto prefix = __FUNC__ "WSASend() failed";
     LogError(WSAGetLastErrorMessage(prefix, ec));
 
+    // ֪ͨ
+    DelTxContext(context);
+
     return false;
 }
 
+void Request::BeginAccess() {
+    FinishAccess();
+
+    uint32_t flags = m_accessBegun ? AccessLogFormat::F_KEEP_ALIVE : 0;
+
+    m_access.Reset();
+    m_access.accept = m_acceptTS;
+    m_access.request = Clock::Now();
+    m_access.flags = flags;
+
+    // ͷԼ֮Ĳ
+    m_access.inBytes = m_vbuf.size() - 1;
+
+    m_accessBegun = true;
+    gs_requests.Inc();
+
+    if (m_capture) {
+        string firstLine(m_vbuf.data(), strcspn(m_vbuf.data(), "\r"));
+        Capture::Describe(firstLine, m_headers.m, *m_capture);
+
+        m_capture->accept = m_acceptTS;
+        m_capture->request = m_access.request;
+        m_capture->requestHeader = (uint32_t) m_headers.bodyOffset;
+        m_capture->responseHeader = 0;
+    }
+}
+
+void Request::FinishAccess() {
+    if (m_access.request == 0) {
+        return;
+    }
+
+    m_access.close = Clock::Now();
+    m_access.port = m_host.port;
+
+    RecordLatency(gs_requestLatency, m_access.request, m_access.close);
+
+    const uint32_t failures = AccessLogFormat::F_DNS_FAILED |
+                              AccessLogFormat::F_CONNECT_FAILED |
+                              AccessLogFormat::F_BAD_RESPONSE;
+
+    bool failed = (m_access.flags & failures) || m_access.status >= 500;
+
+    if (!m_host.name.empty()) {
+        TrafficTable::Record(m_host.name,
+                             m_access.inBytes + m_access.outBytes, failed);
+    }
+
+    if (m_trace) {
+        double elapsed = Clock::ToSeconds(m_access.close - m_access.request);
+
+        if (failed) {
+            m_trace->Dump(m_host.GetFullName(), "failed");
+        }
+        else if (elapsed >= RequestTrace::SLOW_THRESHOLD) {
+            m_trace->Dump(m_host.GetFullName(), "slow");
+        }
+
+        m_trace->Clear();
+    }
+
+    AccessLog::Submit(m_access, m_host.name);
+    m_access.request = 0;
+
+    if (m_capture && m_capture->request != 0) {
+        m_capture->firstByte = m_access.firstByte;
+        m_capture->close = m_access.close;
+        m_capture->inBytes = m_access.inBytes;
+        m_capture->outBytes = m_access.outBytes;
+        m_capture->port = m_access.port;
+        m_capture->status = m_access.status;
+
+        if (m_access.flags & AccessLogFormat::F_TUNNEL) {
+            m_capture->flags |= CaptureFormat::F_TUNNEL;
+        }
+
+        Capture::Submit(*m_capture);
+        m_capture->request = 0;
+    }
+}
+
 void Request::LogInfo(const string &msg) const {
     Log(msg, Logger::OL_INFO);
 }
@@ -762,19 +1156,32 @@ void Request::LogError(const string &msg) const {
 }
 
 void Request::Log(const string &msg, Logger::OutputLevel level) const {
-    if (level >= Logger::LEVEL) {
+    if (Logger::IsEnabled(level)) {
         ostringstream oss;
-        oss << "[0x" << hex << this << "] " << dec;
-
-        if (m_host.port > 0) {
-            oss << m_host.name << ':' << m_host.port << '\n';
-        }
+        WritePrefix(oss);
 
         oss << msg;
         Logger::Log(oss.str(), level);
     }
 }
 
+RequestTrace::Peer Request::PeerOf(SOCKET sd) const {
+    if (sd == m_bcontext.sd) {
+        return RequestTrace::P_BROWSER;
+    }
+
+    return sd == m_scontext.sd ? RequestTrace::P_SERVER
+                               : RequestTrace::P_NONE;
+}
+
+void Request::WritePrefix(std::ostream &os) const {
+    os << "[0x" << hex << this << "] " << dec;
+
+    if (m_host.port > 0) {
+        os << m_host.name << ':' << m_host.port << '\n';
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 bool Request::Headers::Parse(const char *buf, bool browser) {
@@ -869,7 +1276,7 @@ string Request::Host::GetFullName() const {
 
 //////////////////////////////////////////////////////////////////////////
 
-RequestPool &RequestPool::GetInstance() {
-    static RequestPool s_pool;
-    return s_pool;
+RequestPool &RequestPool::GetInstance(int group) {
+    static PerGroup<RequestPool> s_pools;
+    return s_pools.Get(group);
 }
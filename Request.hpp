@@ -4,7 +4,11 @@
 #include "Logger.hpp"
 #include "PerIoContext.hpp"
 #include "Async.hpp"
+#include "AccessLog.hpp"
+#include "Capture.hpp"
+#include "RequestTrace.hpp"
 #include "MemoryPool.hpp"
+#include "Topology.hpp"
 #include "ws-util.h"
 
 #include <ctime>
@@ -37,7 +41,9 @@ public:
     ~Request();
 
     /// ʼ
-    void Init(HANDLE cp, const RxContext &acceptContext);
+    ///
+    /// @param group ӵĹ߳飬ȡԸڴ
+    void Init(HANDLE cp, const RxContext &acceptContext, int group = 0);
 
     /// 
     void HandleBrowser();
@@ -62,29 +68,19 @@ public:
     /// ӡ HTTP ͷĵһУ GETPOST Ϣ
     void PrintRequest(Logger::OutputLevel level) const;
 
-    /// ͳϢ
-    struct Statistics {
-        /// ܵ
-        atomic_int requests;
-
-        /// 롢ֽ
-        atomic_llong inBytes, outBytes;
-
-        /// DNS ѯ
-        atomic_int dnsQueries;
-
-        /// DNS 
-        atomic_int dnsCacheHit;
-    };
-
-    /// ȡͳϢ
-    static Statistics GetStatistics();
+    /// ȡǰ򿪵Ŀ
+    static long long GetConnectionCount();
 
 public:
 
     /// ǰǷ
     bool IsRecyclable() const;
 
+private:
+
+    // ΢׼ԣPremake/MicroBenchֱӵͷд
+    friend class RequestBench;
+
 private:
 
     // öΪࡱ״̬
@@ -118,7 +114,9 @@ private:
     bool ShutdownServerSocket();
 
     // ʹ DNS  IP ַӵ
-    bool TryDNSCache();
+    //
+    // @param failed з񶨻棨ʧܣʱΪ true
+    bool TryDNSCache(bool &failed);
 
     // DNS 
     virtual void OnQueryCompleted(QueryContext *context) override;
@@ -166,9 +164,31 @@ private:
 
     void Log(const string &msg, Logger::OutputLevel level) const;
 
+    // ־@a fmt ֻڼʱű
+    template <Logger::OutputLevel L, typename Fmt>
+    void LogLazy(Fmt &&fmt) const {
+        Logger::LogLazy<L>([&](std::ostream &os) {
+            WritePrefix(os);
+            fmt(os);
+        });
+    }
+
+    // ־ǰ׺ַĿ
+    void WritePrefix(std::ostream &os) const;
+
+    // ׽ @a sd ڹ켣жӦһ
+    RequestTrace::Peer PeerOf(SOCKET sd) const;
+
+    // ʼ¼һµ HTTP 󣬲ύһķʼ¼
+    void BeginAccess();
+
+    // ύǰķʼ¼
+    void FinishAccess();
+
 private:
 
     HANDLE m_cp = nullptr;
+    int m_group = 0; // Ĺ߳
 
     // İ HTTP ͷһ
     // ֻܲ HTTP ͷϢ
@@ -199,6 +219,7 @@ private:
     AsyncResolver m_resolver;
     QueryContext *m_qcontext = nullptr;
     ADDRINFOEX *m_ai = nullptr; // ǰԵ addrinfo ṹ
+    ADDRINFOEX *m_aiCached = nullptr; //  DNS 渴Ƶĵַб
     ConnectContext m_ccontext;
 
     // HTTP ͷ
@@ -245,8 +266,17 @@ private:
     bool m_brxPosted = false; // ǰǷĽ
     bool m_srxPosted = false; // ǰǷĽ
 
-    // ͳϢ
-    static Statistics ms_stat;
+    // ǰķʼ¼
+    AccessLog::Entry m_access;
+    int64_t m_acceptTS = 0; // ӵʱ
+    int64_t m_connectTS = 0; // һηӵʱ
+
+    // ¼켣δʱΪ
+    RequestTrace *m_trace = nullptr;
+
+    // δڲʱΪ
+    Capture::Entry *m_capture = nullptr;
+    bool m_accessBegun = false; // Ƿʼ
 
 private:
 
@@ -266,10 +296,16 @@ private:
 class RequestPool : public MemoryPool<Request, mutex> {
 public:
 
-    /// ȡ
-    static RequestPool &GetInstance();
+    /// ȡ 0 ڴ
+    static RequestPool &GetInstance() {
+        return GetInstance(0);
+    }
+
+    /// ȡ @a group 鹤̵߳ڴ
+    static RequestPool &GetInstance(int group);
 
 private:
 
+    friend class PerGroup<RequestPool>;
     RequestPool() {}
 };
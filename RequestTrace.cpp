@@ -0,0 +1,206 @@
+#include "RequestTrace.hpp"
+#include "Logger.hpp"
+#include "ws-util.h"
+
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+bool RequestTrace::ENABLED = false;
+std::string RequestTrace::PATH = "trace.json";
+double RequestTrace::SLOW_THRESHOLD = 1.0;
+int RequestTrace::MAX_DUMPS_PER_SECOND = 20;
+
+namespace {
+
+const char *EVENT_NAMES[] = {
+    "handle_browser", "post_dns_query", "dns_completed",
+    "post_connect", "connect_completed",
+    "post_recv", "recv_completed",
+    "post_send", "send_completed",
+    "delete",
+};
+
+static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) ==
+              RequestTrace::NUM_EVENTS, "EVENT_NAMES out of sync");
+
+const char *PEER_NAMES[] = { "", "browser", "server" };
+
+std::mutex gs_fileMutex;
+FILE *gs_file;
+
+std::atomic<uint64_t> gs_nextId(1);
+
+// ٣ǰ뱾ѵĿ
+std::atomic<time_t> gs_second(0);
+std::atomic<int> gs_numDumps(0);
+
+// ת JSON ַеַ
+std::string Escape(const std::string &s) {
+    std::string ret;
+
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            ret.push_back('\\');
+            ret.push_back(c);
+        }
+        else if ((unsigned char) c >= 0x20) {
+            ret.push_back(c);
+        }
+    }
+
+    return ret;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+bool RequestTrace::Dump(const std::string &host, const char *reason) const {
+    time_t curr = time(nullptr);
+    time_t second = gs_second.load(std::memory_order_relaxed);
+
+    if (second != curr &&
+        gs_second.compare_exchange_strong(second, curr)) {
+        gs_numDumps = 0;
+    }
+
+    if (gs_numDumps++ >= MAX_DUMPS_PER_SECOND) {
+        return false;
+    }
+
+    std::string out;
+    Format(gs_nextId++, host, reason, out);
+
+    std::lock_guard<std::mutex> lock(gs_fileMutex);
+
+    if (!gs_file) {
+        gs_file = fopen(PATH.c_str(), "ab");
+        if (!gs_file) {
+            Logger::LogError(__FUNC__ "Cannot open the trace file " + PATH);
+            return false;
+        }
+
+        // JSON ʽβ ']' ʡԣ׷дʼЧ
+        fseek(gs_file, 0, SEEK_END);
+        if (ftell(gs_file) == 0) {
+            fputs("[\n", gs_file);
+        }
+    }
+
+    fwrite(out.data(), 1, out.size(), gs_file);
+    fflush(gs_file);
+
+    return true;
+}
+
+/*static*/
+void RequestTrace::Close() {
+    std::lock_guard<std::mutex> lock(gs_fileMutex);
+
+    if (gs_file) {
+        fclose(gs_file);
+        gs_file = nullptr;
+    }
+}
+
+// ÿռһ tidڲ鿴жռһСÿ¼
+//  DNS ѯĽյȴϳΪ䡣
+void RequestTrace::Format(uint64_t id, const std::string &host,
+                          const char *reason, std::string &out) const {
+    uint32_t total = m_count.load(std::memory_order_relaxed);
+    uint32_t count = std::min<uint32_t>(total, CAPACITY);
+
+    // Ƚضת壬תм䣻ת 510 ֽ
+    char buf[768];
+    snprintf(buf, sizeof(buf),
+             "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+             "\"tid\":%llu,\"args\":{\"name\":\"#%llu %s (%s)\","
+             "\"dropped\":%u}},\n",
+             (unsigned long long) id, (unsigned long long) id,
+             Escape(host.substr(0, 255)).c_str(), reason, total - count);
+    out += buf;
+
+    if (count == 0) {
+        return;
+    }
+
+    // 㣬 Peer 
+    int64_t dnsBegin = 0, connectBegin = 0;
+    int64_t recvBegin[3] = { 0, 0, 0 };
+
+    auto span = [&](const char *name, const char *peer,
+                    int64_t begin, int64_t end) {
+        snprintf(buf, sizeof(buf),
+                 "{\"name\":\"%s%s%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,"
+                 "\"ts\":%lld,\"dur\":%lld},\n",
+                 name, *peer ? " " : "", peer, (unsigned long long) id,
+                 (long long) Clock::ToUnixMicroseconds(begin),
+                 (long long) Clock::ToMicroseconds(end - begin));
+        out += buf;
+    };
+
+    const Entry &first = m_entries[(total - count) & (CAPACITY - 1)];
+    const Entry &last = m_entries[(total - 1) & (CAPACITY - 1)];
+    span("request", "", first.ts, last.ts);
+
+    for (uint32_t i = total - count; i != total; i++) {
+        const Entry &entry = m_entries[i & (CAPACITY - 1)];
+        const char *peer = PEER_NAMES[entry.peer];
+
+        snprintf(buf, sizeof(buf),
+                 "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+                 "\"tid\":%llu,\"ts\":%lld,"
+                 "\"args\":{\"peer\":\"%s\",\"arg\":%u}},\n",
+                 EVENT_NAMES[entry.event], (unsigned long long) id,
+                 (long long) Clock::ToUnixMicroseconds(entry.ts),
+                 peer, entry.arg);
+        out += buf;
+
+        switch (entry.event) {
+        case E_POST_DNS_QUERY:
+            dnsBegin = entry.ts;
+            break;
+
+        case E_DNS_COMPLETED:
+            if (dnsBegin != 0) {
+                span("dns", "", dnsBegin, entry.ts);
+                dnsBegin = 0;
+            }
+
+            break;
+
+        case E_POST_CONNECT:
+            connectBegin = entry.ts;
+            break;
+
+        case E_CONNECT_COMPLETED:
+            if (connectBegin != 0) {
+                span("connect", "", connectBegin, entry.ts);
+                connectBegin = 0;
+            }
+
+            break;
+
+        case E_POST_RECV:
+            recvBegin[entry.peer] = entry.ts;
+            break;
+
+        case E_RECV_COMPLETED:
+            if (recvBegin[entry.peer] != 0) {
+                span("recv", peer, recvBegin[entry.peer], entry.ts);
+                recvBegin[entry.peer] = 0;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+}
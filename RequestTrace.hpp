@@ -0,0 +1,108 @@
+#pragma once
+#include "Clock.hpp"
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+/// ¼켣
+///
+/// Ļμ¼ÿΪʱ̡¼ֻ
+/// #CAPACITY ʧʱ Chrome trace event ʽ
+/// ׷ӵ #PATHֱ chrome://tracing  Perfetto 򿪡
+///
+/// δʱ Request 켣ÿֻһοָжϡ
+class RequestTrace {
+public:
+
+    /// Ƿ
+    static bool ENABLED;
+
+    /// 켣ļ·
+    static std::string PATH;
+
+    /// ʱڴֵ룩󱻵
+    static double SLOW_THRESHOLD;
+
+    /// ÿർʱдļ
+    static int MAX_DUMPS_PER_SECOND;
+
+    enum {
+        /// ¼Ŀ 2 
+        CAPACITY = 128,
+    };
+
+    /// ¼
+    enum Event : uint8_t {
+        E_HANDLE_BROWSER, ///< ݣΪֽ
+        E_POST_DNS_QUERY, ///< ύ DNS ѯ
+        E_DNS_COMPLETED, ///< DNS ѯɣΪ
+        E_POST_CONNECT, ///< 
+        E_CONNECT_COMPLETED, ///< ɣΪǷɹ
+        E_POST_RECV, ///< ύ
+        E_RECV_COMPLETED, ///< ɣΪֽ
+        E_POST_SEND, ///< ύ󣬲Ϊֽ
+        E_SEND_COMPLETED, ///< ɣΪֽ
+        E_DELETE, ///< 󱻻
+
+        NUM_EVENTS
+    };
+
+    /// ¼漰һ
+    enum Peer : uint8_t {
+        P_NONE,
+        P_BROWSER,
+        P_SERVER,
+    };
+
+    /// 캯
+    RequestTrace() : m_count(0) {}
+
+    /// ¼һ¼
+    ///
+    /// ͬһ¼ԲͬḶ́߳ԭӼӷռλ
+    void Add(Event event, Peer peer, uint32_t arg = 0) {
+        uint32_t index = m_count.fetch_add(1, std::memory_order_relaxed);
+
+        Entry &entry = m_entries[index & (CAPACITY - 1)];
+        entry.ts = Clock::Now();
+        entry.arg = arg;
+        entry.event = event;
+        entry.peer = peer;
+    }
+
+    /// 
+    void Clear() {
+        m_count.store(0, std::memory_order_relaxed);
+    }
+
+    /// ׷ӵ켣ļ
+    ///
+    ///  #MAX_DUMPS_PER_SECOND ƣʱֱӷ false
+    ///
+    /// @param host Ŀ꣬켣
+    /// @param reason ԭ "slow""failed"
+    bool Dump(const std::string &host, const char *reason) const;
+
+    /// дݲرչ켣ļ
+    static void Close();
+
+private:
+
+    // һ¼
+    struct Entry {
+        int64_t ts; // Clock::Now()
+        uint32_t arg;
+        Event event;
+        Peer peer;
+    };
+
+    // ¼ʽΪ JSON
+    void Format(uint64_t id, const std::string &host, const char *reason,
+                std::string &out) const;
+
+private:
+
+    Entry m_entries[CAPACITY];
+    std::atomic<uint32_t> m_count; // ¼¼
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// ߵߵλ
+///
+/// ű䳤¼ÿ¼ǰ 4 ֽڵĳȡ߸
+/// ֻдһλüκʱ #TryWrite()
+/// ʧܣɵ߾ԣߡ
+class RingBuffer {
+public:
+
+    /// 캯
+    ///
+    /// @param capacity ֽڣȡΪ 2 
+    explicit RingBuffer(size_t capacity) {
+        m_capacity = 64;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+
+        m_mask = m_capacity - 1;
+        m_buf = new char[m_capacity];
+    }
+
+    /// 
+    ~RingBuffer() {
+        delete [] m_buf;
+    }
+
+    // ֹ
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    /// ֽڣ
+    size_t GetCapacity() const {
+        return m_capacity;
+    }
+
+    /// дһƴӶɵļ¼̣߳
+    ///
+    /// @return ռ䲻ʱ falseֲ
+    bool TryWrite(const void *a, size_t alen,
+                  const void *b = nullptr, size_t blen = 0) {
+        uint32_t len = (uint32_t) (alen + blen);
+        size_t need = sizeof(len) + len;
+
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (m_capacity - (head - m_cachedTail) < need) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+
+            if (m_capacity - (head - m_cachedTail) < need) {
+                return false;
+            }
+        }
+
+        Copy(head, &len, sizeof(len));
+        Copy(head + sizeof(len), a, alen);
+
+        if (blen > 0) {
+            Copy(head + sizeof(len) + alen, b, blen);
+        }
+
+        m_head.store(head + need, std::memory_order_release);
+        return true;
+    }
+
+    /// һ¼̣߳
+    ///
+    /// @return Ϊʱ false
+    bool Read(std::vector<char> &out) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail == m_cachedHead) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+
+            if (tail == m_cachedHead) {
+                return false;
+            }
+        }
+
+        uint32_t len;
+        Paste(tail, &len, sizeof(len));
+
+        out.resize(len);
+        if (len > 0) {
+            Paste(tail + sizeof(len), out.data(), len);
+        }
+
+        m_tail.store(tail + sizeof(len) + len, std::memory_order_release);
+        return true;
+    }
+
+    /// ǷΪգκ߳̾ɵãο
+    bool IsEmpty() const {
+        return m_head.load(std::memory_order_acquire) ==
+               m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+
+    // дλ @a pos Ҫʱ۷ͷ
+    void Copy(size_t pos, const void *src, size_t len) {
+        size_t offset = pos & m_mask;
+        size_t first = m_capacity - offset;
+
+        if (len <= first) {
+            memcpy(m_buf + offset, src, len);
+        }
+        else {
+            memcpy(m_buf + offset, src, first);
+            memcpy(m_buf, (const char *) src + first, len - first);
+        }
+    }
+
+    // λ @a pos 
+    void Paste(size_t pos, void *dst, size_t len) const {
+        size_t offset = pos & m_mask;
+        size_t first = m_capacity - offset;
+
+        if (len <= first) {
+            memcpy(dst, m_buf + offset, len);
+        }
+        else {
+            memcpy(dst, m_buf + offset, first);
+            memcpy((char *) dst + first, m_buf, len - first);
+        }
+    }
+
+private:
+
+    enum { CACHE_LINE = 64 };
+
+    char *m_buf;
+    size_t m_capacity;
+    size_t m_mask;
+
+    // ߶ռĻ
+    alignas(CACHE_LINE) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail = 0; // λõıظٿ˷
+
+    // ߶ռĻ
+    alignas(CACHE_LINE) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead = 0;
+};
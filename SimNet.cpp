@@ -0,0 +1,667 @@
+#ifdef MYPROXY_SIMULATION
+
+#define SIMNET_IMPL
+#include "SimNet.hpp"
+#include "Request.hpp"
+#include "PerIoContext.hpp"
+#include "DNSCache.hpp"
+#include "Clock.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+using namespace std;
+
+#include "Debug.hpp"
+
+
+//////////////////////////////////////////////////////////////////////////
+
+// ģ⹹ Proxy.cppɴ˴ṩ Request 
+
+bool AssociateWithCompletionPort(SOCKET sd, HANDLE cp, ULONG_PTR key) {
+    SimNet::GetInstance().Associate(sd, key);
+    return true;
+}
+
+LPFN_CONNECTEX lpfnConnectEx = SimNet::ConnectEx;
+
+//////////////////////////////////////////////////////////////////////////
+
+// ʱӵ㣬롰δ¼ 0 
+static const int64_t CLOCK_ORIGIN = 1000000000;
+
+// time() 
+static const time_t UNIX_ORIGIN = 1500000000;
+
+// ׽־㣬ʵֿ
+static const SOCKET FIRST_SOCKET = 0x10000;
+
+/*static*/
+SimNet &SimNet::GetInstance() {
+    static SimNet s_instance;
+    return s_instance;
+}
+
+void SimNet::Reset(uint64_t seed, const Config &config) {
+    m_config = config;
+    m_random.seed(seed);
+
+    m_events = decltype(m_events)();
+    m_seq = 0;
+
+    m_sockets.clear();
+    m_nextSocket = FIRST_SOCKET;
+    m_lastError = 0;
+
+    m_violations.clear();
+
+    Clock::Virtual() = CLOCK_ORIGIN;
+}
+
+int64_t SimNet::Now() const {
+    return Clock::Virtual();
+}
+
+void SimNet::Schedule(int64_t delay, const function<void()> &fn) {
+    assert(delay >= 0);
+    m_events.push(Event{Now() + delay, m_seq++, fn});
+}
+
+uint64_t SimNet::Run(int64_t until) {
+    uint64_t count = 0;
+
+    while (!m_events.empty() && m_events.top().when <= until) {
+        Event e = m_events.top();
+        m_events.pop();
+
+        Clock::Virtual() = e.when;
+        e.fn();
+
+        count++;
+    }
+
+    return count;
+}
+
+int64_t SimNet::Uniform(int64_t n) {
+    assert(n > 0);
+    return (int64_t) (m_random() % (uint64_t) n);
+}
+
+SimNet::FakeSocket *SimNet::Find(SOCKET sd) {
+    auto it = m_sockets.find(sd);
+    return it != m_sockets.end() ? &it->second : nullptr;
+}
+
+SOCKET SimNet::NewSocket() {
+    SOCKET sd = m_nextSocket++;
+
+    FakeSocket &s = m_sockets[sd];
+    s.latency = m_config.minLatency +
+                Uniform(m_config.maxLatency - m_config.minLatency + 1);
+
+    return sd;
+}
+
+size_t SimNet::GetOpenSocketCount() const {
+    size_t count = 0;
+    for (auto &kv : m_sockets) {
+        count += kv.second.closed ? 0 : 1;
+    }
+
+    return count;
+}
+
+void SimNet::Violate(const string &what) {
+    ostringstream oss;
+    oss << "[" << Clock::ToMicroseconds(Now() - CLOCK_ORIGIN) << "us] "
+        << what;
+
+    m_violations.push_back(oss.str());
+}
+
+void SimNet::Associate(SOCKET sd, ULONG_PTR key) {
+    FakeSocket *s = Find(sd);
+    if (!s) {
+        Violate("Associating an unknown socket");
+        return;
+    }
+
+    s->key = key;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Զ
+
+SOCKET SimNet::Accept(Peer *browser, const char *data, size_t len) {
+    assert(len > 0);
+
+    SOCKET sd = NewSocket();
+    FakeSocket &s = m_sockets[sd];
+    s.peer = browser;
+    s.connected = true;
+
+    // AcceptEx() ֻܴػװµĲ֣Ժճ
+    size_t first = min(len, (size_t) RxContext::DATA_CAPACITY);
+    s.inbound.assign(data + first, data + len);
+
+    RxContext context(sd);
+    memcpy(context.buf, data, first);
+    context.rx = (DWORD) first;
+
+    Request *req = RequestPool::GetInstance().Allocate();
+    Associate(sd, (ULONG_PTR) req);
+
+    req->Init(nullptr, context);
+    req->HandleBrowser();
+
+    return sd;
+}
+
+void SimNet::Send(SOCKET sd, const char *data, size_t len) {
+    FakeSocket *s = Find(sd);
+    if (!s) {
+        return;
+    }
+
+    string bytes(data, len);
+    Schedule(s->latency, [this, sd, bytes] {
+        FakeSocket *s = Find(sd);
+
+        // ѹرյ׽ֱӶյ
+        if (s && !s->closed) {
+            s->inbound += bytes;
+            TryCompleteRecv(sd);
+        }
+    });
+}
+
+void SimNet::Shutdown(SOCKET sd) {
+    FakeSocket *s = Find(sd);
+    if (!s) {
+        return;
+    }
+
+    Schedule(s->latency, [this, sd] {
+        FakeSocket *s = Find(sd);
+        if (s) {
+            s->peerFin = true;
+            TryCompleteRecv(sd);
+            Collect(sd);
+        }
+    });
+}
+
+void SimNet::Abort(SOCKET sd) {
+    FakeSocket *s = Find(sd);
+    if (!s) {
+        return;
+    }
+
+    Schedule(s->latency, [this, sd] {
+        FakeSocket *s = Find(sd);
+        if (s) {
+            s->peerReset = true;
+            s->inbound.clear();
+
+            TryCompleteRecv(sd);
+            Collect(sd);
+        }
+    });
+}
+
+void SimNet::NotifyPeerClosed(SOCKET sd, FakeSocket &s) {
+    if (s.peer && !s.peerReset) {
+        Peer *peer = s.peer;
+        Schedule(s.latency, [peer, sd] {
+            peer->OnClosed(sd);
+        });
+    }
+}
+
+void SimNet::Collect(SOCKET sd) {
+    FakeSocket *s = Find(sd);
+    if (s && s->closed && (s->peerFin || s->peerReset || !s->peer) &&
+        !s->recv && !s->connect) {
+        m_sockets.erase(sd);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ֪ͨ
+
+void SimNet::TryCompleteRecv(SOCKET sd) {
+    FakeSocket *s = Find(sd);
+    if (!s || !s->recv) {
+        return;
+    }
+
+    PerIoContext *pic = s->recv;
+    int64_t jitter = Uniform(m_config.maxJitter + 1);
+
+    if (s->peerReset) {
+        s->recv = nullptr;
+        Complete(s->key, pic, 0, ERROR_NETNAME_DELETED, jitter);
+    }
+    else if (!s->inbound.empty()) {
+        size_t n = min(s->inbound.size(), (size_t) s->recvBuf.len);
+
+        // ģ TCP ֶΣֻȡһ
+        if (n > 1 && (double) Uniform(1000) / 1000 < m_config.splitRate) {
+            n = 1 + (size_t) Uniform((int64_t) n - 1);
+        }
+
+        memcpy(s->recvBuf.buf, s->inbound.data(), n);
+        s->inbound.erase(0, n);
+
+        s->recv = nullptr;
+        Complete(s->key, pic, (DWORD) n, 0, jitter);
+    }
+    else if (s->peerFin) {
+        s->recv = nullptr;
+        Complete(s->key, pic, 0, 0, jitter);
+    }
+}
+
+void SimNet::AbortPending(SOCKET sd, FakeSocket &s) {
+    int64_t jitter = Uniform(m_config.maxJitter + 1);
+
+    if (s.recv) {
+        Complete(s.key, s.recv, 0, ERROR_OPERATION_ABORTED, jitter);
+        s.recv = nullptr;
+    }
+
+    if (s.connect) {
+        Complete(s.key, s.connect, 0, ERROR_OPERATION_ABORTED, jitter);
+        s.connect = nullptr;
+    }
+}
+
+void SimNet::Complete(ULONG_PTR key, PerIoContext *pic,
+                      DWORD transfered, DWORD error, int64_t delay) {
+    Schedule(delay, [=] {
+        Dispatch(key, pic, transfered, error);
+    });
+}
+
+void SimNet::Dispatch(ULONG_PTR key, PerIoContext *pic,
+                      DWORD transfered, DWORD error) {
+    switch (error) {
+    case 0:
+        break;
+
+    case ERROR_SEM_TIMEOUT:
+        if (pic->action != PerIoContext::CONNECT) {
+            Violate("What timed out?");
+            return;
+        }
+
+        transfered = (DWORD) -1;
+        break;
+
+    case ERROR_OPERATION_ABORTED:
+    case ERROR_INVALID_NETNAME:
+    case ERROR_NETNAME_DELETED:
+        transfered = 0;
+        break;
+
+    default: {
+        ostringstream oss;
+        oss << "Unexpected completion error " << error;
+        Violate(oss.str());
+
+        return;
+    }
+    }
+
+    Request *req = (Request *) key;
+
+    switch (pic->action) {
+    case PerIoContext::CONNECT: {
+        ConnectContext *context = (ConnectContext *) pic;
+
+        if (transfered == (DWORD) -1) {
+            context->tx = 0;
+            context->connected = false;
+        }
+        else {
+            context->tx = transfered;
+            context->connected = true;
+        }
+
+        req->OnConnectCompleted();
+        break;
+    }
+
+    case PerIoContext::RECV: {
+        RxContext *context = (RxContext *) pic;
+        context->rx = transfered;
+
+        req->OnRecvCompleted(*context);
+        break;
+    }
+
+    case PerIoContext::SEND: {
+        TxContext *context = (TxContext *) pic;
+        context->tx = transfered;
+
+        req->OnSendCompleted(context);
+        break;
+    }
+
+    default:
+        Violate("Unexpected completion action");
+        break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 滻 Winsock ĺ
+
+/*static*/
+SOCKET SimNet::Socket(int af, int type, int protocol) {
+    return GetInstance().NewSocket();
+}
+
+/*static*/
+int SimNet::Bind(SOCKET sd, const sockaddr *addr, int len) {
+    SimNet &net = GetInstance();
+
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.m_lastError = WSAENOTSOCK;
+        return SOCKET_ERROR;
+    }
+
+    s->bound = true;
+    return 0;
+}
+
+/*static*/
+int SimNet::WsaRecv(SOCKET sd, LPWSABUF bufs, DWORD nb, LPDWORD rx,
+                    LPDWORD flags, LPWSAOVERLAPPED ol,
+                    LPWSAOVERLAPPED_COMPLETION_ROUTINE cr) {
+    SimNet &net = GetInstance();
+
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.m_lastError = WSAENOTSOCK;
+        return SOCKET_ERROR;
+    }
+
+    if (s->recv) {
+        net.Violate("Overlapping WSARecv() on one socket");
+        net.m_lastError = WSAEINVAL;
+        return SOCKET_ERROR;
+    }
+
+    if (!s->connected) {
+        net.m_lastError = WSAENOTCONN;
+        return SOCKET_ERROR;
+    }
+
+    // յ RST ׽ʧܣ֪ͨ
+    if (s->peerReset) {
+        net.m_lastError = WSAECONNRESET;
+        return SOCKET_ERROR;
+    }
+
+    assert(nb == 1);
+    s->recv = (PerIoContext *) ol;
+    s->recvBuf = bufs[0];
+
+    net.TryCompleteRecv(sd);
+
+    net.m_lastError = WSA_IO_PENDING;
+    return SOCKET_ERROR;
+}
+
+/*static*/
+int SimNet::WsaSend(SOCKET sd, LPWSABUF bufs, DWORD nb, LPDWORD tx,
+                    DWORD flags, LPWSAOVERLAPPED ol,
+                    LPWSAOVERLAPPED_COMPLETION_ROUTINE cr) {
+    SimNet &net = GetInstance();
+
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.m_lastError = WSAENOTSOCK;
+        return SOCKET_ERROR;
+    }
+
+    if (s->shutdown) {
+        net.m_lastError = WSAESHUTDOWN;
+        return SOCKET_ERROR;
+    }
+
+    if (s->peerReset) {
+        net.m_lastError = WSAECONNRESET;
+        return SOCKET_ERROR;
+    }
+
+    if (!s->connected) {
+        net.m_lastError = WSAENOTCONN;
+        return SOCKET_ERROR;
+    }
+
+    string bytes;
+    for (DWORD i = 0; i < nb; i++) {
+        bytes.append(bufs[i].buf, bufs[i].len);
+    }
+
+    // ѷܻᵽԶڴ֮ǰ
+    Peer *peer = s->peer;
+    net.Schedule(s->latency, [&net, sd, peer, bytes] {
+        FakeSocket *s = net.Find(sd);
+        if (!s || !s->peerReset) {
+            peer->OnData(sd, bytes.data(), bytes.size());
+        }
+    });
+
+    int64_t jitter = net.Uniform(net.m_config.maxJitter + 1);
+    net.Complete(s->key, (PerIoContext *) ol, (DWORD) bytes.size(), 0,
+                 jitter);
+
+    // ʵ WSASend() һ֪ͨ
+    if (net.Uniform(2) == 0) {
+        return 0;
+    }
+
+    net.m_lastError = WSA_IO_PENDING;
+    return SOCKET_ERROR;
+}
+
+/*static*/
+BOOL PASCAL SimNet::ConnectEx(SOCKET sd, const sockaddr *addr, int len,
+                              PVOID buf, DWORD bufLen, LPDWORD tx,
+                              LPOVERLAPPED ol) {
+    SimNet &net = GetInstance();
+
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.m_lastError = WSAENOTSOCK;
+        return FALSE;
+    }
+
+    if (!s->bound) {
+        net.Violate("ConnectEx() on an unbound socket");
+        net.m_lastError = WSAEINVAL;
+        return FALSE;
+    }
+
+    if (s->connect || s->connected) {
+        net.Violate("ConnectEx() on a connected socket");
+        net.m_lastError = WSAEISCONN;
+        return FALSE;
+    }
+
+    auto sin = (const sockaddr_in *) addr;
+    uint32_t ip = ntohl(sin->sin_addr.s_addr);
+    u_short port = ntohs(sin->sin_port);
+
+    PerIoContext *pic = (PerIoContext *) ol;
+    s->connect = pic;
+
+    Peer *peer = net.m_listener ? net.m_listener(sd, ip, port) : nullptr;
+    string bytes((const char *) buf, bufLen);
+
+    // Ӳϣȴʱ
+    if (!peer) {
+        net.Schedule(net.m_config.connectTimeout, [&net, sd, pic] {
+            FakeSocket *s = net.Find(sd);
+            if (s && s->connect == pic) {
+                s->connect = nullptr;
+                net.Complete(s->key, pic, 0, ERROR_SEM_TIMEOUT);
+            }
+        });
+    }
+    // ֮ͬһ
+    else {
+        net.Schedule(s->latency * 2, [&net, sd, pic, peer, bytes] {
+            FakeSocket *s = net.Find(sd);
+            if (!s || s->connect != pic) {
+                return; // ѱȡ
+            }
+
+            s->connect = nullptr;
+            s->connected = true;
+            s->peer = peer;
+
+            if (!bytes.empty()) {
+                net.Schedule(s->latency, [sd, peer, bytes] {
+                    peer->OnData(sd, bytes.data(), bytes.size());
+                });
+            }
+
+            net.Complete(s->key, pic, (DWORD) bytes.size(), 0);
+        });
+    }
+
+    net.m_lastError = WSA_IO_PENDING;
+    return FALSE;
+}
+
+/*static*/
+int SimNet::CloseSocket(SOCKET sd) {
+    SimNet &net = GetInstance();
+
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.Violate("closesocket() on an invalid socket");
+        net.m_lastError = WSAENOTSOCK;
+        return SOCKET_ERROR;
+    }
+
+    s->closed = true;
+    net.AbortPending(sd, *s);
+
+    if (!s->shutdown) {
+        net.NotifyPeerClosed(sd, *s);
+    }
+
+    net.Collect(sd);
+    return 0;
+}
+
+/*static*/
+int SimNet::ShutdownSocket(SOCKET sd, int how) {
+    SimNet &net = GetInstance();
+
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.m_lastError = WSAENOTSOCK;
+        return SOCKET_ERROR;
+    }
+
+    if (!s->connected) {
+        net.m_lastError = WSAENOTCONN;
+        return SOCKET_ERROR;
+    }
+
+    if (how != SD_RECEIVE && !s->shutdown) {
+        s->shutdown = true;
+        net.NotifyPeerClosed(sd, *s);
+    }
+
+    return 0;
+}
+
+/*static*/
+BOOL SimNet::CancelIo(HANDLE h, LPOVERLAPPED ol) {
+    SimNet &net = GetInstance();
+
+    SOCKET sd = (SOCKET) h;
+    FakeSocket *s = net.Find(sd);
+    if (!s || s->closed) {
+        net.m_lastError = ERROR_INVALID_HANDLE;
+        return FALSE;
+    }
+
+    if (!s->recv && !s->connect) {
+        net.m_lastError = ERROR_NOT_FOUND;
+        return FALSE;
+    }
+
+    net.AbortPending(sd, *s);
+    return TRUE;
+}
+
+/*static*/
+int SimNet::LastError() {
+    return GetInstance().m_lastError;
+}
+
+/*static*/
+time_t SimNet::Time(time_t *t) {
+    time_t now = UNIX_ORIGIN + (time_t) ((Clock::Virtual() - CLOCK_ORIGIN) /
+                                         1000000000);
+    if (t) {
+        *t = now;
+    }
+
+    return now;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void SimNet::Resolve(AsyncResolver::QueryContext *context) {
+    // ֻ ASCII ַ
+    string host;
+    for (const wchar_t *p = context->host; *p; p++) {
+        host.push_back((char) *p);
+    }
+
+    Schedule(m_config.dnsLatency, [this, context, host] {
+        uint32_t ip = 0;
+
+        if (m_resolver && m_resolver(host, ip)) {
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(context->port);
+            addr.sin_addr.s_addr = htonl(ip);
+
+            DNSCache::AI ai;
+            memset(&ai, 0, sizeof(ai));
+            ai.ai_family = AF_INET;
+            ai.ai_socktype = SOCK_STREAM;
+            ai.ai_protocol = IPPROTO_TCP;
+            ai.ai_addrlen = sizeof(addr);
+            ai.ai_addr = (sockaddr *) &addr;
+
+            context->results = DNSCache::CopyAddrInfo(&ai);
+            context->copied = true;
+            context->error = ERROR_SUCCESS;
+            context->ttl = m_config.dnsTTL;
+        }
+        else {
+            context->results = nullptr;
+            context->error = WSAHOST_NOT_FOUND;
+        }
+
+        context->onWorker = true;
+        AsyncResolver::Complete(context);
+    });
+}
+
+#endif // MYPROXY_SIMULATION
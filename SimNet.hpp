@@ -0,0 +1,260 @@
+#pragma once
+#ifdef MYPROXY_SIMULATION
+
+#include "ws-util.h"
+#include "Async.hpp"
+
+#include <MSWSock.h>
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+struct PerIoContext;
+
+/// ȷģʹõڴ
+///
+/// ڶ MYPROXY_SIMULATION ĹСRequest õ Winsock
+/// ñļĩβĺ滻Ϊڴ׽ֵĲ֪ͨʱ
+/// ¼У #Run() ڵ߳ηַַ߼
+/// MyProxy::ProxyHandler() һ¡
+///
+/// ·ӳ١շֶΡ֪ͨȺȡͬһӣ
+/// ͬһӵȫͬģ̵߳Ĳ
+class SimNet {
+public:
+
+    /// ģԶˣ
+    class Peer {
+    public:
+
+        virtual ~Peer() {}
+
+        /// յ
+        virtual void OnData(SOCKET sd, const char *data, size_t len) = 0;
+
+        /// رӣ FIN  closesocket()
+        virtual void OnClosed(SOCKET sd) = 0;
+    };
+
+    ///  false ʾ
+    typedef std::function<bool(const std::string &host, uint32_t &ip)>
+        Resolver;
+
+    /// ܴӵĺ nullptr ʾӳʱ
+    typedef std::function<Peer *(SOCKET sd, uint32_t ip, u_short port)>
+        Listener;
+
+    /// ʱ䵥λΪ룩
+    struct Config {
+        int64_t minLatency = 100000; ///< ӳޣÿӹ̶
+        int64_t maxLatency = 5000000; ///< ӳ
+        int64_t maxJitter = 50000; ///< ֪ͨƳ
+        double splitRate = 0.3; ///< һνֻȡ߲ݵĸ
+        int64_t dnsLatency = 2000000; ///< DNS ʱ
+        int64_t connectTimeout = 3000000000; ///< ӳʱ
+        unsigned long dnsTTL = 60; ///<  TTL룩
+    };
+
+    /// ȡ
+    static SimNet &GetInstance();
+
+    ///  @a seed ¿ʼ
+    ///
+    /// ʱӻص㣬׽δ¼
+    void Reset(uint64_t seed, const Config &config);
+
+    /// 
+    void SetResolver(const Resolver &resolver) {
+        m_resolver = resolver;
+    }
+
+    /// ýܴӵĺ
+    void SetListener(const Listener &listener) {
+        m_listener = listener;
+    }
+
+    /// 
+    std::mt19937_64 &Random() {
+        return m_random;
+    }
+
+    /// ǰʱ̣룩
+    int64_t Now() const;
+
+    ///  @a delay ִ @a fn
+    void Schedule(int64_t delay, const std::function<void()> &fn);
+
+    /// ִ¼ֱΪջʱ̳ @a until
+    ///
+    /// @return ִй¼Ŀ
+    uint64_t Run(int64_t until);
+
+    /// Ƿδִе¼
+    bool HasEvents() const {
+        return !m_events.empty();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // ģԶ˵
+
+    /// @a data Ϊ AcceptEx() յ
+    ///
+    ///  MyProxy::DoAccept() һ Request ʼ
+    SOCKET Accept(Peer *browser, const char *data, size_t len);
+
+    /// Զ
+    void Send(SOCKET sd, const char *data, size_t len);
+
+    /// Զ˹رշͷ
+    void Shutdown(SOCKET sd);
+
+    /// Զ
+    void Abort(SOCKET sd);
+
+    /// ΥӿԼĴͬһ׽ͬʱ
+    const std::vector<std::string> &GetViolations() const {
+        return m_violations;
+    }
+
+    /// δرյ׽Ŀ
+    size_t GetOpenSocketCount() const;
+
+    //////////////////////////////////////////////////////////////////////
+    // 滻 Winsock ĺ뷵ֵͬȥǰ׺ԭ
+
+    static SOCKET Socket(int af, int type, int protocol);
+    static int Bind(SOCKET sd, const sockaddr *addr, int len);
+    static int WsaRecv(SOCKET sd, LPWSABUF bufs, DWORD nb, LPDWORD rx,
+                       LPDWORD flags, LPWSAOVERLAPPED ol,
+                       LPWSAOVERLAPPED_COMPLETION_ROUTINE cr);
+    static int WsaSend(SOCKET sd, LPWSABUF bufs, DWORD nb, LPDWORD tx,
+                       DWORD flags, LPWSAOVERLAPPED ol,
+                       LPWSAOVERLAPPED_COMPLETION_ROUTINE cr);
+    static BOOL PASCAL ConnectEx(SOCKET sd, const sockaddr *addr, int len,
+                                 PVOID buf, DWORD bufLen, LPDWORD tx,
+                                 LPOVERLAPPED ol);
+    static int CloseSocket(SOCKET sd);
+    static int ShutdownSocket(SOCKET sd, int how);
+    static BOOL CancelIo(HANDLE h, LPOVERLAPPED ol);
+    static int LastError();
+    static time_t Time(time_t *t);
+
+    /// ύ DNS ѯ AsyncResolver::PostResolve() 
+    void Resolve(AsyncResolver::QueryContext *context);
+
+    /// ׽ֹɶ˿ڡ
+    void Associate(SOCKET sd, ULONG_PTR key);
+
+private:
+
+    SimNet() {}
+
+    // ڴе׽
+    struct FakeSocket {
+        ULONG_PTR key = 0;
+        Peer *peer = nullptr;
+        int64_t latency = 0; // ӳ
+
+        std::string inbound; // ѵδȡ
+        bool peerFin = false; // Զ˵ FIN ѵ
+        bool peerReset = false; // Զ˵ RST ѵ
+        bool bound = false;
+        bool connected = false;
+        bool shutdown = false; // ѹرշͷ
+        bool closed = false; // ѵ closesocket()
+
+        WSABUF recvBuf;
+        PerIoContext *recv = nullptr; // δĽ
+        PerIoContext *connect = nullptr; // δ
+    };
+
+    typedef std::map<SOCKET, FakeSocket> SocketMap;
+
+    // ¼
+    struct Event {
+        int64_t when;
+        uint64_t seq;
+        std::function<void()> fn;
+
+        bool operator>(const Event &other) const {
+            return when != other.when ? when > other.when : seq > other.seq;
+        }
+    };
+
+    FakeSocket *Find(SOCKET sd);
+    SOCKET NewSocket();
+
+    // [0, n) ϵľȷֲ
+    int64_t Uniform(int64_t n);
+
+    // δĽ
+    void TryCompleteRecv(SOCKET sd);
+
+    // ׽ϵδ ERROR_OPERATION_ABORTED 
+    void AbortPending(SOCKET sd, FakeSocket &s);
+
+    // ֪ͨԶ˴ѹر
+    void NotifyPeerClosed(SOCKET sd, FakeSocket &s);
+
+    // ɶ˿֪ͨƳٺ #Dispatch() 
+    void Complete(ULONG_PTR key, PerIoContext *pic,
+                  DWORD transfered, DWORD error, int64_t delay = 0);
+
+    //  MyProxy::ProxyHandler() ͬķַ߼
+    void Dispatch(ULONG_PTR key, PerIoContext *pic,
+                  DWORD transfered, DWORD error);
+
+    // ѽ׽ֲҪ
+    void Collect(SOCKET sd);
+
+    void Violate(const std::string &what);
+
+private:
+
+    Config m_config;
+    std::mt19937_64 m_random;
+
+    std::priority_queue<Event, std::vector<Event>,
+                        std::greater<Event>> m_events;
+    uint64_t m_seq = 0;
+
+    SocketMap m_sockets;
+    SOCKET m_nextSocket = 0;
+
+    int m_lastError = 0;
+
+    Resolver m_resolver;
+    Listener m_listener;
+
+    std::vector<std::string> m_violations;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//  Winsock 滻Ϊ SimNet ʵ
+//
+// ϵͳͷļ֮ļ
+
+#ifndef SIMNET_IMPL
+
+#undef SOCKET_bind
+#define SOCKET_bind SimNet::Bind
+
+#define socket(af, type, protocol) SimNet::Socket(af, type, protocol)
+#define WSARecv SimNet::WsaRecv
+#define WSASend SimNet::WsaSend
+#define closesocket(sd) SimNet::CloseSocket(sd)
+#define shutdown(sd, how) SimNet::ShutdownSocket(sd, how)
+#define CancelIoEx(h, ol) SimNet::CancelIo(h, ol)
+#define WSAGetLastError() SimNet::LastError()
+#define GetLastError() SimNet::LastError()
+#define time(t) SimNet::Time(t)
+
+#endif // !SIMNET_IMPL
+
+#endif // MYPROXY_SIMULATION
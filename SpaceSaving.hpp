@@ -0,0 +1,140 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+/// Space-Saving Ƶheavy hittersͳ
+///
+///  @a capacity ڴռù̶ʱ³ֵļ
+/// Сļ̳ΪϽ磬κʵ
+///  / capacity ļһڱУҹֵƫ󲻳 #Entry::error
+///
+/// СļСάΪ O(log capacity)̰߳ȫġ
+///
+/// @param Payload ĸݣʱ³ʼ
+template <class Payload>
+class SpaceSaving {
+public:
+
+    /// һٵļ
+    struct Entry {
+        std::string key;
+        uint64_t count; ///< Ƶļƫ
+        uint64_t error; ///< ƫϽ
+        Payload payload; ///< ԼۼƵĸ
+    };
+
+    /// 캯
+    explicit SpaceSaving(size_t capacity) : m_capacity(capacity) {
+        m_heap.reserve(capacity);
+        m_index.reserve(capacity * 2);
+    }
+
+    /// Ϊ @a key ۼ @a weight
+    ///
+    /// @return üĸݣ߸
+    Payload &Add(const std::string &key, uint64_t weight) {
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            size_t pos = it->second;
+            m_heap[pos].count += weight;
+
+            return m_heap[SiftDown(pos)].payload;
+        }
+
+        if (m_heap.size() < m_capacity) {
+            m_heap.push_back(Entry{key, weight, 0, Payload()});
+            m_index.emplace(key, m_heap.size() - 1);
+
+            return m_heap[SiftUp(m_heap.size() - 1)].payload;
+        }
+
+        // Сļ
+        Entry &min = m_heap.front();
+        m_index.erase(min.key);
+
+        min.key = key;
+        min.error = min.count;
+        min.count += weight;
+        min.payload = Payload();
+
+        m_index.emplace(key, 0);
+        return m_heap[SiftDown(0)].payload;
+    }
+
+    /// бٵļ
+    const std::vector<Entry> &GetEntries() const {
+        return m_heap;
+    }
+
+    /// ʱСΪ 0
+    ///
+    /// ڱеļʵֵ
+    uint64_t GetMinCount() const {
+        return m_heap.size() < m_capacity ? 0 : m_heap.front().count;
+    }
+
+    /// 
+    void Clear() {
+        m_heap.clear();
+        m_index.clear();
+    }
+
+private:
+
+    // еλò
+    void Swap(size_t a, size_t b) {
+        std::swap(m_heap[a], m_heap[b]);
+        m_index[m_heap[a].key] = a;
+        m_index[m_heap[b].key] = b;
+    }
+
+    // Ԫصλ
+    size_t SiftUp(size_t pos) {
+        while (pos > 0) {
+            size_t parent = (pos - 1) / 2;
+            if (m_heap[parent].count <= m_heap[pos].count) {
+                break;
+            }
+
+            Swap(parent, pos);
+            pos = parent;
+        }
+
+        return pos;
+    }
+
+    // Ԫصλ
+    size_t SiftDown(size_t pos) {
+        while (true) {
+            size_t smallest = pos;
+            size_t left = pos * 2 + 1, right = left + 1;
+
+            if (left < m_heap.size() &&
+                m_heap[left].count < m_heap[smallest].count) {
+                smallest = left;
+            }
+
+            if (right < m_heap.size() &&
+                m_heap[right].count < m_heap[smallest].count) {
+                smallest = right;
+            }
+
+            if (smallest == pos) {
+                return pos;
+            }
+
+            Swap(pos, smallest);
+            pos = smallest;
+        }
+    }
+
+private:
+
+    size_t m_capacity;
+
+    std::vector<Entry> m_heap; //  count ΪС
+    std::unordered_map<std::string, size_t> m_index; // ڶеλ
+};
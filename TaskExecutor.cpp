@@ -0,0 +1,245 @@
+#include "TaskExecutor.hpp"
+#include "PerIoContext.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+int TaskExecutor::NUM_THREADS = 0;
+size_t TaskExecutor::DEQUE_CAPACITY = 4096;
+
+namespace {
+
+// ǰִִ̣߳߳߳Ϊ
+thread_local void *tls_worker = nullptr;
+
+// ȴ֮ǰĴ
+const int SPIN_COUNT = 64;
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+TaskExecutor &TaskExecutor::GetInstance() {
+    static TaskExecutor s_executor;
+    return s_executor;
+}
+
+bool TaskExecutor::Start() {
+    if (m_running) {
+        return true;
+    }
+
+    int n = NUM_THREADS;
+    if (n <= 0) {
+        n = std::max<int>(GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS) / 4,
+                          1);
+    }
+
+    m_stopping = false;
+
+    for (int i = 0; i < n; i++) {
+        m_workers.push_back(new Worker(DEQUE_CAPACITY));
+    }
+
+    m_running = true;
+
+    for (int i = 0; i < n; i++) {
+        Worker *worker = m_workers[i];
+        worker->thread = std::thread(&TaskExecutor::Run, this, worker,
+                                     (unsigned) i);
+    }
+
+    return true;
+}
+
+void TaskExecutor::Stop() {
+    if (!m_running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_cv.notify_all();
+
+    for (auto worker : m_workers) {
+        worker->thread.join();
+    }
+
+    // ˺ύ͵ִУֹͣǰһ̲Žעе
+    std::deque<Task *> left;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        left.swap(m_injected);
+    }
+
+    for (auto task : left) {
+        m_pending--;
+        Execute(task);
+    }
+
+    for (auto worker : m_workers) {
+        delete worker;
+    }
+
+    m_workers.clear();
+}
+
+void TaskExecutor::Submit(Task *task) {
+    Worker *self = (Worker *) tls_worker;
+
+    if (self && m_running) {
+        m_pending++;
+
+        if (!self->deque.Push(task)) {
+            m_pending--;
+            m_numInlined++;
+
+            Execute(task);
+            return;
+        }
+    }
+    else {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (!m_running) {
+            lock.unlock();
+            m_numInlined++;
+
+            Execute(task);
+            return;
+        }
+
+        m_injected.push_back(task);
+        m_pending++;
+        m_numInjected++;
+    }
+
+    if (m_numSleeping > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cv.notify_one();
+    }
+}
+
+TaskExecutor::Stats TaskExecutor::GetStats() const {
+    Stats stats;
+    stats.injected = m_numInjected;
+    stats.inlined = m_numInlined;
+    stats.queued = (size_t) std::max<long long>(m_pending, 0);
+    stats.numThreads = (int) m_workers.size();
+
+    for (auto worker : m_workers) {
+        stats.executed += worker->executed;
+        stats.stolen += worker->stolen;
+    }
+
+    return stats;
+}
+
+void TaskExecutor::Run(Worker *self, unsigned index) {
+    tls_worker = self;
+    unsigned seed = index + 1;
+
+    while (true) {
+        Task *task = Find(self, index, seed);
+        if (task) {
+            Execute(task);
+            self->executed++;
+
+            continue;
+        }
+
+        if (Wait()) {
+            break;
+        }
+    }
+
+    tls_worker = nullptr;
+}
+
+TaskExecutor::Task *TaskExecutor::Find(Worker *self, unsigned index,
+                                       unsigned &seed) {
+    Task *task = self->deque.Pop();
+    if (task) {
+        m_pending--;
+        return task;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_injected.empty()) {
+            task = m_injected.front();
+            m_injected.pop_front();
+            m_pending--;
+
+            return task;
+        }
+    }
+
+    // λÿʼȡп̼߳ͬһ
+    size_t n = m_workers.size();
+    seed = seed * 1103515245 + 12345;
+
+    for (size_t i = 0, start = (seed >> 16) % n; i < n; i++) {
+        size_t victim = (start + i) % n;
+        if (victim == index) {
+            continue;
+        }
+
+        task = m_workers[victim]->deque.Steal();
+        if (task) {
+            m_pending--;
+            self->stolen++;
+
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+/*static*/
+void TaskExecutor::Execute(Task *task) {
+    task->Run();
+
+    if (task->cp) {
+        if (PostQueuedCompletionStatus(task->cp, 0, SCK_TASK,
+                                       (LPOVERLAPPED) task)) {
+            return;
+        }
+
+        Logger::LogWindowsLastError
+            (__FUNC__ "PostQueuedCompletionStatus() failed");
+    }
+
+    task->Complete();
+}
+
+bool TaskExecutor::Wait() {
+    for (int i = 0; i < SPIN_COUNT; i++) {
+        if (m_pending > 0) {
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_numSleeping++;
+    m_cv.wait(lock, [this] {
+        return m_pending > 0 || m_stopping;
+    });
+    m_numSleeping--;
+
+    return m_stopping && m_pending == 0;
+}
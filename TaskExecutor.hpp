@@ -0,0 +1,129 @@
+#pragma once
+#include "WorkStealingDeque.hpp"
+
+#include <Windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// ִܼ
+///
+/// ѹ䡢־֮ĹӦ ProxyHandler ߳
+/// ͵ִУƳӵִ֪ͨԼһ̣߳
+/// ÿ߳ӵһ Chase-Lev ˫˶Уύѹ뱾
+/// ̵߳ĶУе̴̵߳߳ĶȡI/O ߳ύ
+/// 빫עС
+///
+/// ִϺָɶ˿ڣ SCK_TASK ΪͶݻɶ˿ڣ
+/// ĳ I/O ̵߳ Task::Complete()֪ͨһ
+/// ֱִ߳ϵá
+///
+/// ִδʱ͵ִС
+class TaskExecutor {
+public:
+
+    /// ߳0 ʾ߼Ŀķ֮һ 1 
+    static int NUM_THREADS;
+
+    /// ÿ̵߳˫˶ʱ͵ִ
+    static size_t DEQUE_CAPACITY;
+
+    /// 
+    class Task {
+    public:
+
+        virtual ~Task() {}
+
+        /// ִִ߳
+        virtual void Run() = 0;
+
+        /// ִϺãͷĬ delete this
+        ///
+        /// ָ #cp ʱ I/O ߳ϵá
+        virtual void Complete() {
+            delete this;
+        }
+
+        /// ִϺͶݵɶ˿ڣΪʱͶ
+        HANDLE cp = nullptr;
+    };
+
+    /// ͳ
+    struct Stats {
+        unsigned long long executed = 0; ///< ִе
+        unsigned long long stolen = 0; ///< д߳ȡ
+        unsigned long long injected = 0; ///< עύ
+        unsigned long long inlined = 0; ///< δл͵ִе
+        size_t queued = 0; ///< δʼִе
+        int numThreads = 0;
+    };
+
+    /// ȡ
+    static TaskExecutor &GetInstance();
+
+    /// ִ߳
+    bool Start();
+
+    /// ִύִ߳
+    void Stop();
+
+    /// Ƿ
+    bool IsRunning() const {
+        return m_running;
+    }
+
+    /// ύһ񣬿̵߳
+    void Submit(Task *task);
+
+    /// ȡͳ
+    Stats GetStats() const;
+
+private:
+
+    TaskExecutor() {}
+
+    // һִ߳
+    struct Worker {
+        explicit Worker(size_t capacity) : deque(capacity) {}
+
+        WorkStealingDeque<Task> deque;
+        std::thread thread;
+
+        std::atomic<unsigned long long> executed{0};
+        std::atomic<unsigned long long> stolen{0};
+    };
+
+    // ߳
+    void Run(Worker *self, unsigned index);
+
+    // һ񣺱̵߳ĶСעУٴ߳ȡ
+    Task *Find(Worker *self, unsigned index, unsigned &seed);
+
+    // ִ񲢽
+    static void Execute(Task *task);
+
+    // ȴ@return ǷӦ˳
+    bool Wait();
+
+private:
+
+    std::vector<Worker *> m_workers;
+    std::atomic_bool m_running{false};
+    std::atomic_bool m_stopping{false};
+
+    std::mutex m_mutex; // ע˯
+    std::condition_variable m_cv;
+    std::deque<Task *> m_injected;
+
+    // ύδȡߵ˯ߵ߳
+    // ˳һµĶдԣⶪʧ
+    std::atomic<long long> m_pending{0};
+    std::atomic_int m_numSleeping{0};
+
+    std::atomic<unsigned long long> m_numInjected{0};
+    std::atomic<unsigned long long> m_numInlined{0};
+};
@@ -0,0 +1,291 @@
+#include "Topology.hpp"
+#include "Metrics.hpp"
+#include "Logger.hpp"
+#include "ws-util.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+using namespace std;
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+int Topology::NUM_WORKERS = 0;
+bool Topology::PER_NODE_GROUPS = false;
+bool Topology::PIN_WORKERS = false;
+bool Topology::RSS_PLACEMENT = false;
+
+namespace {
+
+// һͳ
+struct GroupCounters {
+    unique_ptr<Metrics::Counter> accepted;
+    unique_ptr<Metrics::Counter> completions;
+};
+
+// δ Init() ʱֻһ޽
+vector<Topology::Group> gs_groups(1);
+vector<Topology::Worker> gs_workers;
+vector<GroupCounters> gs_counters;
+
+// ǰ߳飬ǹ߳Ϊ -1
+thread_local int tls_group = -1;
+
+//  @a affinity е߼ @a cpus
+void AddProcessors(const GROUP_AFFINITY &affinity,
+                   vector<PROCESSOR_NUMBER> &cpus) {
+    for (int i = 0; i < (int) sizeof(KAFFINITY) * 8; i++) {
+        if (affinity.Mask & ((KAFFINITY) 1 << i)) {
+            PROCESSOR_NUMBER cpu = {};
+            cpu.Group = affinity.Group;
+            cpu.Number = (BYTE) i;
+
+            cpus.push_back(cpu);
+        }
+    }
+}
+
+// гд NUMA 㣬ʧʱؿ
+vector<Topology::Group> ListNodes() {
+    vector<Topology::Group> nodes;
+
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest)) {
+        Logger::LogWindowsLastError
+            (__FUNC__ "GetNumaHighestNodeNumber() failed");
+        return nodes;
+    }
+
+    for (ULONG n = 0; n <= highest; n++) {
+        GROUP_AFFINITY affinity = {};
+        if (!GetNumaNodeProcessorMaskEx((USHORT) n, &affinity) ||
+            affinity.Mask == 0) {
+            continue;
+        }
+
+        Topology::Group node;
+        node.node = (int) n;
+        node.affinity = affinity;
+        AddProcessors(affinity, node.cpus);
+
+        nodes.push_back(node);
+    }
+
+    return nodes;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+void Topology::Init() {
+    vector<Group> nodes = ListNodes();
+    if (nodes.size() > MAX_GROUPS) {
+        nodes.resize(MAX_GROUPS);
+    }
+
+    vector<Group> groups;
+
+    if (PER_NODE_GROUPS && nodes.size() > 1) {
+        groups = nodes;
+    }
+    else {
+        // 飬׺ԣֻһʱԼ½ţ
+        // ڴڸý
+        Group all;
+
+        for (auto &node : nodes) {
+            all.cpus.insert(all.cpus.end(), node.cpus.begin(),
+                            node.cpus.end());
+        }
+
+        if (nodes.size() == 1) {
+            all.node = nodes[0].node;
+        }
+
+        groups.push_back(all);
+    }
+
+    // ̰߳Ŀıָ飬ÿһ
+    int numCpus = 0;
+    for (auto &group : groups) {
+        numCpus += (int) group.cpus.size();
+    }
+
+    int n = NUM_WORKERS;
+    if (n <= 0) {
+        n = (int) GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
+    }
+
+    n = max(n, (int) groups.size());
+
+    int assigned = 0;
+    for (auto &group : groups) {
+        group.numWorkers = numCpus > 0 ?
+            (int) (n * (long long) group.cpus.size() / numCpus) : 0;
+        group.numWorkers = max(group.numWorkers, 1);
+        assigned += group.numWorkers;
+    }
+
+    for (int i = 0; assigned < n; i = (i + 1) % (int) groups.size()) {
+        groups[i].numWorkers++;
+        assigned++;
+    }
+
+    vector<Worker> workers;
+    for (int g = 0; g < (int) groups.size(); g++) {
+        Group &group = groups[g];
+        group.firstWorker = (int) workers.size();
+
+        for (int i = 0; i < group.numWorkers; i++) {
+            Worker worker;
+            worker.group = g;
+
+            if (PIN_WORKERS && !group.cpus.empty()) {
+                worker.pinned = true;
+                worker.cpu = group.cpus[i % group.cpus.size()];
+            }
+
+            workers.push_back(worker);
+        }
+    }
+
+    gs_groups.swap(groups);
+    gs_workers.swap(workers);
+
+    // ڹ߳ǰע
+    gs_counters.clear();
+    gs_counters.resize(gs_groups.size());
+
+    for (int g = 0; g < (int) gs_groups.size(); g++) {
+        ostringstream labels;
+        labels << "{group=\"" << g << "\",node=\"" << gs_groups[g].node
+               << "\"}";
+
+        gs_counters[g].accepted.reset(new Metrics::Counter
+            (("myproxy_group_accepted_total" + labels.str()).c_str(),
+             "Browser connections handed to a worker group"));
+        gs_counters[g].completions.reset(new Metrics::Counter
+            (("myproxy_group_completions_total" + labels.str()).c_str(),
+             "Completions dispatched by a worker group"));
+    }
+}
+
+/*static*/
+int Topology::GetGroupCount() {
+    return (int) gs_groups.size();
+}
+
+/*static*/
+const Topology::Group &Topology::GetGroup(int index) {
+    return gs_groups[index];
+}
+
+/*static*/
+int Topology::GetWorkerCount() {
+    return (int) gs_workers.size();
+}
+
+/*static*/
+const Topology::Worker &Topology::GetWorker(int index) {
+    return gs_workers[index];
+}
+
+/*static*/
+int Topology::GetGroupOfNode(int node) {
+    for (int g = 0; g < (int) gs_groups.size(); g++) {
+        if (gs_groups[g].node == node) {
+            return g;
+        }
+    }
+
+    return -1;
+}
+
+/*static*/
+void Topology::EnterWorker(int index) {
+    const Worker &worker = gs_workers[index];
+    const Group &group = gs_groups[worker.group];
+
+    tls_group = worker.group;
+
+    if (worker.pinned) {
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = worker.cpu.Group;
+        affinity.Mask = (KAFFINITY) 1 << worker.cpu.Number;
+
+        if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+            Logger::LogWindowsLastError
+                (__FUNC__ "SetThreadGroupAffinity() failed");
+        }
+
+        PROCESSOR_NUMBER cpu = worker.cpu;
+        SetThreadIdealProcessorEx(GetCurrentThread(), &cpu, nullptr);
+    }
+    else if (group.affinity.Mask != 0) {
+        if (!SetThreadGroupAffinity(GetCurrentThread(), &group.affinity,
+                                    nullptr)) {
+            Logger::LogWindowsLastError
+                (__FUNC__ "SetThreadGroupAffinity() failed");
+        }
+    }
+}
+
+/*static*/
+int Topology::GetCurrentGroup() {
+    return tls_group >= 0 ? tls_group : 0;
+}
+
+/*static*/
+void Topology::RecordAccepted(int group) {
+    if (group < (int) gs_counters.size()) {
+        gs_counters[group].accepted->Inc();
+    }
+}
+
+/*static*/
+void Topology::RecordCompletion() {
+    if (tls_group >= 0 && tls_group < (int) gs_counters.size()) {
+        gs_counters[tls_group].completions->Inc();
+    }
+}
+
+/*static*/
+void Topology::Render(string &out) {
+    ostringstream oss;
+    oss << "# per_node_groups " << (PER_NODE_GROUPS ? "on" : "off")
+        << ", pin_workers " << (PIN_WORKERS ? "on" : "off")
+        << ", rss_placement " << (RSS_PLACEMENT ? "on" : "off") << '\n';
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%-6s %5s %6s %8s %12s %14s  %s\n",
+             "group", "node", "cpus", "workers", "accepted", "completions",
+             "processors");
+    oss << buf;
+
+    for (int g = 0; g < (int) gs_groups.size(); g++) {
+        const Group &group = gs_groups[g];
+
+        unsigned long long accepted = 0, completions = 0;
+        if (g < (int) gs_counters.size()) {
+            accepted = gs_counters[g].accepted->GetValue();
+            completions = gs_counters[g].completions->GetValue();
+        }
+
+        ostringstream cpus;
+        for (auto &cpu : group.cpus) {
+            cpus << (cpus.tellp() > 0 ? " " : "") << cpu.Group << ':'
+                 << (int) cpu.Number;
+        }
+
+        snprintf(buf, sizeof(buf), "%-6d %5d %6u %8d %12llu %14llu  ",
+                 g, group.node, (unsigned) group.cpus.size(),
+                 group.numWorkers, accepted, completions);
+        oss << buf << cpus.str() << '\n';
+    }
+
+    out += oss.str();
+}
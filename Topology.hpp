@@ -0,0 +1,155 @@
+#pragma once
+#include <Windows.h>
+
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+/// ̵߳Ĵ
+///
+/// Ĭй̹߳һɶ˿ڣκΰ󶨣ӵ
+/// ֪ͨ⴦ϵ̴߳ڶ·ζ
+/// ͬһӵ NUMA ֮ذˡ
+///
+///  #PER_NODE_GROUPS ÿ NUMA һ߳飺ڵ
+/// ֻ߳ڱĴУñɶ˿ڣӱܺ
+/// ĳһ飬˺ȫ֪ͨڸ鴦 Request ڴ
+/// ڱڴϣ PerGroupDNS ͻҳ
+/// Сǵ׽ֻ 0 ɶ˿ڡ
+///
+/// ġ顱ָ߳飬 Windows Ĵ飨processor group
+/// ޹ء
+class Topology {
+public:
+
+    /// ߳0 ʾ߼Ŀ
+    static int NUM_WORKERS;
+
+    /// Ƿÿ NUMA һ߳
+    static bool PER_NODE_GROUPS;
+
+    /// Ƿÿ̶̹߳һ߼
+    static bool PIN_WORKERS;
+
+    /// Ƿ RSS ӽݰĽڵ
+    ///
+    /// ڸ䡣ֻжʱ塣
+    static bool RSS_PLACEMENT;
+
+    enum {
+        MAX_GROUPS = 64, ///< ߳Ŀ
+    };
+
+    /// ߳
+    struct Group {
+        int node = -1; ///< NUMA 㣬-1 ʾ
+        GROUP_AFFINITY affinity = {}; ///< ̵߳׺ԣMask Ϊ 0 ʾ
+        std::vector<PROCESSOR_NUMBER> cpus; ///< ڵ߼
+        int firstWorker = 0; ///< һ̵߳
+        int numWorkers = 0; ///< ߳Ŀ
+    };
+
+    /// ߳
+    struct Worker {
+        int group = 0; ///< 
+        bool pinned = false; ///< Ƿ̶ #cpu
+        PROCESSOR_NUMBER cpu = {}; ///< ̶߼
+    };
+
+    /// ̽⴦ˣֹ߳
+    ///
+    /// ڴ֮߳ǰãʧʱ˻ص󶨵顣
+    static void Init();
+
+    /// ߳Ŀ
+    static int GetGroupCount();
+
+    ///  @a index ߳
+    static const Group &GetGroup(int index);
+
+    /// ߳
+    static int GetWorkerCount();
+
+    ///  @a index ߳
+    static const Worker &GetWorker(int index);
+
+    /// NUMA  @a node ڵ飬ûʱ -1
+    static int GetGroupOfNode(int node);
+
+    /// ڵ @a index ̵߳Ŀͷã׺ԣ
+    static void EnterWorker(int index);
+
+    /// ǰ߳飬ǹ̷߳ 0
+    static int GetCurrentGroup();
+
+    /// ¼ @a group һ
+    static void RecordAccepted(int group);
+
+    /// ¼ǰ̴߳һ֪ͨ
+    static void RecordCompletion();
+
+    /// ıĴ߳
+    static void Render(std::string &out);
+};
+
+/// ÿ߳һĶ
+///
+/// ڵһηʱ죬ڴ VirtualAllocExNuma() Ӹ NUMA
+/// 䣻޽ʹͨ new@a T Ĺ캯Ϊ˽У
+///  PerGroup<T> ΪԪ
+template <class T>
+class PerGroup {
+public:
+
+    PerGroup() {
+        for (auto &item : m_items) {
+            item = nullptr;
+        }
+    }
+
+    ~PerGroup() {
+        for (int i = 0; i < Topology::MAX_GROUPS; i++) {
+            T *item = m_items[i];
+            if (!item) {
+                continue;
+            }
+
+            if (m_numa[i]) {
+                item->~T();
+                VirtualFree(item, 0, MEM_RELEASE);
+            }
+            else {
+                delete item;
+            }
+        }
+    }
+
+    ///  @a group Ķ
+    T &Get(int group) {
+        std::call_once(m_once[group], [this, group] {
+            int node = Topology::GetGroup(group).node;
+
+            void *mem = nullptr;
+            if (node >= 0) {
+                mem = VirtualAllocExNuma(GetCurrentProcess(), nullptr,
+                                         sizeof(T), MEM_RESERVE | MEM_COMMIT,
+                                         PAGE_READWRITE, (DWORD) node);
+            }
+
+            m_numa[group] = mem != nullptr;
+            m_items[group] = mem ? new (mem) T : new T;
+        });
+
+        return *m_items[group];
+    }
+
+private:
+
+    PerGroup(const PerGroup &) = delete;
+    PerGroup &operator=(const PerGroup &) = delete;
+
+    T *m_items[Topology::MAX_GROUPS];
+    bool m_numa[Topology::MAX_GROUPS] = {};
+    std::once_flag m_once[Topology::MAX_GROUPS];
+};
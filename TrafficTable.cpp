@@ -0,0 +1,202 @@
+#include "TrafficTable.hpp"
+#include "SpaceSaving.hpp"
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+size_t TrafficTable::CAPACITY = 256;
+
+namespace {
+
+// ĸ
+struct Traffic {
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+};
+
+typedef SpaceSaving<Traffic> Sketch;
+
+// һ̵߳ͳƱ
+//
+// ֻڶȡʱŻá
+struct ThreadTable {
+    ThreadTable()
+        : byRequests(TrafficTable::CAPACITY),
+          byBytes(TrafficTable::CAPACITY) {}
+
+    std::mutex mutex;
+    Sketch byRequests;
+    Sketch byBytes;
+};
+
+// ̵߳ͳƱ
+//
+// ߳˳ͳƱȻ̵߳Ŀǹ̶ġ
+class Registry {
+public:
+
+    static Registry &GetInstance() {
+        static Registry s_registry;
+        return s_registry;
+    }
+
+    ThreadTable *Register() {
+        ThreadTable *table = new ThreadTable;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tables.push_back(table);
+
+        return table;
+    }
+
+    std::vector<ThreadTable *> GetTables() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tables;
+    }
+
+private:
+
+    Registry() {}
+
+    ~Registry() {
+        for (auto table : m_tables) {
+            delete table;
+        }
+    }
+
+private:
+
+    std::mutex m_mutex;
+    std::vector<ThreadTable *> m_tables;
+};
+
+thread_local ThreadTable *tls_table;
+
+// ϲеһ
+struct MergedRow {
+    TrafficTable::Row row;
+    uint64_t presentMin = 0; // ĸС֮
+};
+
+// ϲ߳ͬһݵͳƱ
+//
+// ĳĳıʱڸ̵߳ʵñ
+// СϽ硣
+void Merge(TrafficTable::Order order,
+           std::unordered_map<std::string, MergedRow> &merged) {
+    uint64_t totalMin = 0;
+
+    for (auto table : Registry::GetInstance().GetTables()) {
+        std::lock_guard<std::mutex> lock(table->mutex);
+
+        const Sketch &sketch = order == TrafficTable::BY_REQUESTS
+                                   ? table->byRequests : table->byBytes;
+
+        uint64_t min = sketch.GetMinCount();
+        totalMin += min;
+
+        for (auto &entry : sketch.GetEntries()) {
+            MergedRow &m = merged[entry.key];
+            TrafficTable::Row &row = m.row;
+
+            if (row.host.empty()) {
+                row.host = entry.key;
+                row.requests = row.bytes = row.errors = row.error = 0;
+            }
+
+            if (order == TrafficTable::BY_REQUESTS) {
+                row.requests += entry.count;
+                row.bytes += entry.payload.bytes;
+            }
+            else {
+                row.requests += entry.payload.requests;
+                row.bytes += entry.count;
+            }
+
+            row.errors += entry.payload.errors;
+            row.error += entry.error;
+            m.presentMin += min;
+        }
+    }
+
+    for (auto &item : merged) {
+        item.second.row.error += totalMin - item.second.presentMin;
+    }
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+void TrafficTable::Record(const std::string &host, uint64_t bytes,
+                          bool failed) {
+    ThreadTable *table = tls_table;
+    if (!table) {
+        table = tls_table = Registry::GetInstance().Register();
+    }
+
+    std::lock_guard<std::mutex> lock(table->mutex);
+
+    Traffic &t1 = table->byRequests.Add(host, 1);
+    t1.requests++;
+    t1.bytes += bytes;
+    t1.errors += failed ? 1 : 0;
+
+    Traffic &t2 = table->byBytes.Add(host, bytes);
+    t2.requests++;
+    t2.bytes += bytes;
+    t2.errors += failed ? 1 : 0;
+}
+
+/*static*/
+std::vector<TrafficTable::Row> TrafficTable::GetTop(Order order, size_t n) {
+    std::unordered_map<std::string, MergedRow> merged;
+    Merge(order, merged);
+
+    std::vector<Row> rows;
+    rows.reserve(merged.size());
+
+    for (auto &item : merged) {
+        rows.push_back(std::move(item.second.row));
+    }
+
+    auto key = [order](const Row &row) {
+        return order == BY_REQUESTS ? row.requests : row.bytes;
+    };
+
+    n = std::min(n, rows.size());
+    std::partial_sort(rows.begin(), rows.begin() + n, rows.end(),
+                      [&key](const Row &a, const Row &b) {
+        return key(a) > key(b);
+    });
+
+    rows.resize(n);
+    return rows;
+}
+
+/*static*/
+void TrafficTable::Render(Order order, size_t n, std::string &out) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%-40s %12s %16s %10s %12s\n",
+             "host", "requests", "bytes", "errors", "error_bound");
+    out += buf;
+
+    for (auto &row : GetTop(order, n)) {
+        snprintf(buf, sizeof(buf), "%-40.255s %12llu %16llu %10llu %12llu\n",
+                 row.host.c_str(),
+                 (unsigned long long) row.requests,
+                 (unsigned long long) row.bytes,
+                 (unsigned long long) row.errors,
+                 (unsigned long long) row.error);
+        out += buf;
+    }
+}
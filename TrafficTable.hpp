@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// ĿͳƵ
+///
+/// ֻSpace-Saving 㷨
+/// ڴռù̶ÿ̼߳¼ԼͳƱУȡʱźϲ
+/// ȡת
+class TrafficTable {
+public:
+
+    /// ÿ̡߳ÿٵĿ
+    static size_t CAPACITY;
+
+    /// 
+    enum Order {
+        BY_REQUESTS, ///< 
+        BY_BYTES, ///< ֽ֮
+    };
+
+    /// һͳ
+    struct Row {
+        std::string host;
+
+        uint64_t requests; ///< 
+        uint64_t bytes; ///< ֽ
+        uint64_t errors; ///< ʧܵ
+
+        /// ݵֵƫϽ
+        ///
+        /// ͳƱʱֻ½֮ݡ
+        uint64_t error;
+    };
+
+    /// ¼һѽ
+    ///
+    /// @param failed ʧܻӦ 5xx
+    static void Record(const std::string &host, uint64_t bytes, bool failed);
+
+    /// ȡǰ @a n λ
+    static std::vector<Row> GetTop(Order order, size_t n);
+
+    /// ǰ @a n λΪı
+    static void Render(Order order, size_t n, std::string &out);
+};
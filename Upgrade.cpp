@@ -0,0 +1,302 @@
+#include "Upgrade.hpp"
+#include "DNSCache.hpp"
+#include "Logger.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <sstream>
+#include <thread>
+using namespace std;
+
+#include "Debug.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+
+bool Upgrade::ENABLED = false;
+string Upgrade::PIPE_NAME = "\\\\.\\pipe\\MyProxy2-upgrade";
+int Upgrade::TAKEOVER_TIMEOUT = 10;
+
+namespace {
+
+// ɽ
+SOCKET gs_listener = INVALID_SOCKET;
+function<void()> gs_onHandedOver;
+thread gs_thread;
+atomic_bool gs_handedOver(false);
+
+// Stop() ʱλȡܵڵȴĲ
+HANDLE gs_stopEvent = nullptr;
+
+// ܵص¼
+HANDLE gs_ioEvent = nullptr;
+
+// ½ɽ֮Ĺܵ
+HANDLE gs_client = INVALID_HANDLE_VALUE;
+
+// ȴܵ @a pipe ϵص
+//
+// @param ok ĺķֵ
+// @param n ֽ
+// @return gs_stopEvent λʱȡ false
+bool Complete(HANDLE pipe, OVERLAPPED &ol, BOOL ok, DWORD &n) {
+    if (!ok && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+
+    HANDLE events[] = { ol.hEvent, gs_stopEvent };
+    if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+        // ȡ֮ ol 
+        CancelIoEx(pipe, &ol);
+        GetOverlappedResult(pipe, &ol, &n, TRUE);
+
+        return false;
+    }
+
+    return GetOverlappedResult(pipe, &ol, &n, FALSE) != FALSE;
+}
+
+//  @a len ֽ
+//
+// ɽ̵Ĺܵصʽ򿪣ṩ @a ol½̵Ϊͬʽ
+bool ReadFull(HANDLE pipe, void *buf, DWORD len, OVERLAPPED *ol = nullptr) {
+    char *p = (char *) buf;
+
+    while (len > 0) {
+        DWORD n = 0;
+        BOOL ok = ReadFile(pipe, p, len, ol ? nullptr : &n, ol);
+
+        if (ol) {
+            ok = Complete(pipe, *ol, ok, n);
+        }
+
+        if (!ok || n == 0) {
+            return false;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+// д @a len ֽڣ@a ol ͬ ReadFull()
+bool WriteFull(HANDLE pipe, const void *buf, DWORD len,
+               OVERLAPPED *ol = nullptr) {
+    const char *p = (const char *) buf;
+
+    while (len > 0) {
+        DWORD n = 0;
+        BOOL ok = WriteFile(pipe, p, len, ol ? nullptr : &n, ol);
+
+        if (ol) {
+            ok = Complete(pipe, *ol, ok, n);
+        }
+
+        if (!ok || n == 0) {
+            return false;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+// һӵ½̽ӣ@return ½ǷȷϽ
+bool HandOver(HANDLE pipe, OVERLAPPED &ol) {
+    DWORD pid = 0;
+    if (!ReadFull(pipe, &pid, sizeof(pid), &ol)) {
+        return false;
+    }
+
+    // ½յ׽ֺͻؿ
+    DNSCache::SaveSnapshot();
+
+    WSAPROTOCOL_INFOW info;
+    if (WSADuplicateSocketW(gs_listener, pid, &info) != 0) {
+        auto fmt = __FUNC__ "WSADuplicateSocketW() failed";
+        Logger::LogError(WSAGetLastErrorMessage(fmt));
+
+        return false;
+    }
+
+    if (!WriteFull(pipe, &info, sizeof(info), &ol)) {
+        return false;
+    }
+
+    // ½̿ʼ֮ǰʧ˳ʱܵϿȡʧ
+    char ack = 0;
+    return ReadFull(pipe, &ack, sizeof(ack), &ol) && ack == 1;
+}
+
+bool IsStopping() {
+    return WaitForSingleObject(gs_stopEvent, 0) == WAIT_OBJECT_0;
+}
+
+// ɽ̵Ĺܵ߳
+void Serve() {
+    OVERLAPPED ol;
+    memset(&ol, 0, sizeof(ol));
+    ol.hEvent = gs_ioEvent;
+
+    while (!IsStopping()) {
+        DWORD mode = PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+                     PIPE_REJECT_REMOTE_CLIENTS;
+
+        // ͬܵѴʱʧܣΪ˵Ĺܵһʵ
+        DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED |
+                         FILE_FLAG_FIRST_PIPE_INSTANCE;
+
+        HANDLE pipe = CreateNamedPipeA(Upgrade::PIPE_NAME.c_str(),
+                                       openMode, mode,
+                                       1, 4096, 4096, 0, nullptr);
+
+        // һܻ̿ûйرչܵ
+        if (pipe == INVALID_HANDLE_VALUE) {
+            Logger::LogWindowsLastError(__FUNC__ "CreateNamedPipeA() failed");
+            WaitForSingleObject(gs_stopEvent, 1000);
+
+            continue;
+        }
+
+        // صʽǷ FALSE
+        DWORD n = 0;
+        bool connected = ConnectNamedPipe(pipe, &ol) ||
+                         GetLastError() == ERROR_PIPE_CONNECTED ||
+                         Complete(pipe, ol, FALSE, n);
+
+        bool handedOver = connected && HandOver(pipe, ol);
+
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+
+        if (handedOver) {
+            Logger::LogInfo(__FUNC__ "Listener handed over to a new process");
+
+            gs_handedOver = true;
+            gs_onHandedOver();
+
+            break;
+        }
+
+        if (connected && !IsStopping()) {
+            Logger::LogError(__FUNC__ "Takeover by a new process failed");
+        }
+    }
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+/*static*/
+bool Upgrade::Start(SOCKET listener, function<void()> onHandedOver) {
+    if (gs_thread.joinable()) {
+        return true;
+    }
+
+    gs_stopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    gs_ioEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+    if (!gs_stopEvent || !gs_ioEvent) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateEventA() failed");
+
+        if (gs_stopEvent) {
+            CloseHandle(gs_stopEvent);
+            gs_stopEvent = nullptr;
+        }
+
+        if (gs_ioEvent) {
+            CloseHandle(gs_ioEvent);
+            gs_ioEvent = nullptr;
+        }
+
+        return false;
+    }
+
+    gs_listener = listener;
+    gs_onHandedOver = onHandedOver;
+    gs_handedOver = false;
+
+    gs_thread = thread(Serve);
+    return true;
+}
+
+/*static*/
+void Upgrade::Stop() {
+    if (!gs_thread.joinable()) {
+        return;
+    }
+
+    // ֻ߳ԼĹܵϵȴӹܵ
+    SetEvent(gs_stopEvent);
+    gs_thread.join();
+
+    CloseHandle(gs_stopEvent);
+    gs_stopEvent = nullptr;
+
+    CloseHandle(gs_ioEvent);
+    gs_ioEvent = nullptr;
+}
+
+/*static*/
+bool Upgrade::IsHandedOver() {
+    return gs_handedOver;
+}
+
+/*static*/
+SOCKET Upgrade::TakeOver() {
+    if (!WaitNamedPipeA(PIPE_NAME.c_str(), TAKEOVER_TIMEOUT * 1000)) {
+        Logger::LogWindowsLastError(__FUNC__ "WaitNamedPipeA() failed");
+        return INVALID_SOCKET;
+    }
+
+    HANDLE pipe = CreateFileA(PIPE_NAME.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        Logger::LogWindowsLastError(__FUNC__ "CreateFileA() failed");
+        return INVALID_SOCKET;
+    }
+
+    DWORD pid = GetCurrentProcessId();
+    WSAPROTOCOL_INFOW info;
+
+    if (!WriteFull(pipe, &pid, sizeof(pid)) ||
+        !ReadFull(pipe, &info, sizeof(info))) {
+        Logger::LogError(__FUNC__ "The old process closed the pipe");
+        CloseHandle(pipe);
+
+        return INVALID_SOCKET;
+    }
+
+    SOCKET sd = WSASocketW(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+                           FROM_PROTOCOL_INFO, &info, 0,
+                           WSA_FLAG_OVERLAPPED);
+    if (sd == INVALID_SOCKET) {
+        Logger::LogError(WSAGetLastErrorMessage(__FUNC__ "WSASocketW() failed"));
+        CloseHandle(pipe);
+
+        return INVALID_SOCKET;
+    }
+
+    // ȷ֮ǰӣɽ̾ݴж½Ƿ񻹻
+    gs_client = pipe;
+    return sd;
+}
+
+/*static*/
+void Upgrade::Confirm() {
+    if (gs_client == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    char ack = 1;
+    if (!WriteFull(gs_client, &ack, sizeof(ack))) {
+        Logger::LogError(__FUNC__ "Failed to confirm the takeover");
+    }
+
+    CloseHandle(gs_client);
+    gs_client = INVALID_HANDLE_VALUE;
+}
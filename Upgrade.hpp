@@ -0,0 +1,48 @@
+#pragma once
+#include "ws-util.h"
+
+#include <functional>
+#include <string>
+
+/// жϷ
+///
+/// еḶ̌ɽ̣ܵ #PIPE_NAME ϵȴ½̡
+///  --takeover ½ӹܵԼĽ̺ţɽȱ
+/// DNS գ WSADuplicateSocketW() Ѽ׽ָƸ½̡
+/// ½ͬһ׽ϿʼӺظȷϣɽ漴ֹͣ
+/// ӣ;Ӻ˳ MyProxy::Drain()
+///
+/// ׽ʼнڽӣڼ䲻ӱܾ
+/// ½ȷǰʧ˳ʱɽճ񣬵ȴһ
+class Upgrade {
+public:
+
+    /// Ƿڹܵϵȴ½
+    static bool ENABLED;
+
+    /// ܵ
+    static std::string PIPE_NAME;
+
+    /// ½̵ȴɽӦʱ䣨룩
+    static int TAKEOVER_TIMEOUT;
+
+    /// ɽ̣ʼڹܵϵȴ½
+    ///
+    /// @param listener Ҫļ׽
+    /// @param onHandedOver ½ȷϽֺں̨߳ϵ
+    static bool Start(SOCKET listener, std::function<void()> onHandedOver);
+
+    /// ɽֹ̣ͣȴ
+    static void Stop();
+
+    /// ɽ̣׽Ƿѽ½
+    static bool IsHandedOver();
+
+    /// ½̣Ӿɽּ̽׽
+    ///
+    /// @return ʧʱ INVALID_SOCKET
+    static SOCKET TakeOver();
+
+    /// ½̣ڽֵ׽Ͽʼӣ֪ͨɽ˳
+    static void Confirm();
+};
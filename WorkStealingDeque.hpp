@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// Chase-Lev ȡ˫˶
+///
+/// ߳ڵײѹ롢ȳȣ̴߳Ӷ
+/// ȡȽȳ߽硢ͨϴ񣩡ߵĲֻڶ
+/// ʣһʱҪһ CASȡ֮ CAS 
+///
+/// ʵֲ L ˵ C11 ڴģͰ汾PPoPP 2013̶
+/// ʱ #Push() ʧܣɵ߾͵ִУӶȥʱ
+/// ⡣ָֻ롣
+template <class T>
+class WorkStealingDeque {
+public:
+
+    /// 캯
+    ///
+    /// @param capacity ȡΪ 2 
+    explicit WorkStealingDeque(size_t capacity) {
+        m_capacity = 16;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+
+        m_mask = m_capacity - 1;
+        m_items.reset(new std::atomic<T *>[m_capacity]);
+    }
+
+    // ֹ
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    /// ڵײѹ루̣߳
+    ///
+    /// @return ʱ false
+    bool Push(T *item) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+
+        if (b - t >= (int64_t) m_capacity) {
+            return false;
+        }
+
+        m_items[b & m_mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    /// ӵײ̣߳
+    ///
+    /// @return Ϊʱ nullptr
+    T *Pop() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // ѿ
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T *item = m_items[b & m_mask].load(std::memory_order_relaxed);
+
+        // һȡ߾
+        if (t == b) {
+            if (!m_top.compare_exchange_strong(t, t + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return item;
+    }
+
+    /// Ӷȡ̣߳
+    ///
+    /// @return Ϊջ߳̾ʧʱ nullptr
+    T *Steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        T *item = m_items[t & m_mask].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+            return nullptr;
+        }
+
+        return item;
+    }
+
+    /// µĳȣͳ
+    size_t GetSize() const {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        return b > t ? (size_t) (b - t) : 0;
+    }
+
+private:
+
+    enum { CACHE_LINE = 64 };
+
+    std::unique_ptr<std::atomic<T *>[]> m_items;
+    size_t m_capacity;
+    size_t m_mask;
+
+    // ȡ߾Ļ
+    alignas(CACHE_LINE) std::atomic<int64_t> m_top{0};
+
+    // ߶ռĻ
+    alignas(CACHE_LINE) std::atomic<int64_t> m_bottom{0};
+};
@@ -10,10 +10,18 @@
 
 #include "Proxy.hpp"
 #include "Logger.hpp"
+#include "DNSClient.hpp"
+#include "DNSCache.hpp"
+#include "AccessLog.hpp"
+#include "Capture.hpp"
+#include "TaskExecutor.hpp"
+#include "RequestTrace.hpp"
+#include "Upgrade.hpp"
 
 #pragma comment(lib, "ws2_32.lib")
 
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 using namespace std;
 
@@ -34,13 +42,29 @@ const static int kDefaultServerPort = 1990;
 static MyProxy *gs_proxy;
 
 // 
-static bool gs_runing = true;
+static volatile bool gs_runing = true;
+
+// ˳ʱλѭ
+static HANDLE gs_stopEvent;
+
+// ٴ˳ʱλٵȴ;
+//
+// ̨һ߳ϣܴ gs_proxy
+static HANDLE gs_abortEvent;
 
 
 BOOL WINAPI ConsoleHandler(DWORD event) {
     switch (event) {
     case CTRL_C_EVENT:
-        gs_runing = false;
+        // һƽ˳ڶβٵȴ;
+        if (gs_runing) {
+            gs_runing = false;
+            SetEvent(gs_stopEvent);
+        }
+        else {
+            SetEvent(gs_abortEvent);
+        }
+
         return TRUE;
 
     default:
@@ -61,6 +85,13 @@ int main(int argc, char *argv[]) {
     assert(!errno);
 #endif
 
+    //  --takeover βʱеľɽּ̽׽
+    bool takeover = false;
+    if (argc >= 2 && strcmp(argv[argc - 1], "--takeover") == 0) {
+        takeover = true;
+        argc--;
+    }
+
     const char *pcHost = "127.0.0.1";
     int nPort = kDefaultServerPort;
 
@@ -73,8 +104,14 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    //  DNS бԶŷָ 8.8.8.8,1.1.1.1:53
+    const char *pcDnsServers = nullptr;
+    if (argc >= 4) {
+        pcDnsServers = argv[3];
+    }
+
     // Do a little sanity checking because we're anal.
-    int nNumArgsIgnored = (argc - 3);
+    int nNumArgsIgnored = (argc - 4);
     if (nNumArgsIgnored > 0) {
         cerr << nNumArgsIgnored << " extra argument" <<
                (nNumArgsIgnored == 1 ? "" : "s") << " ignored.  FYI.\n";
@@ -89,6 +126,9 @@ int main(int argc, char *argv[]) {
         return 255;
     }
 
+    gs_stopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    gs_abortEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
     if (SetConsoleCtrlHandler(ConsoleHandler, TRUE)) {
         printf("\nThe Control Handler is installed.\n");
         printf("\n -- Now try pressing Ctrl+C or Ctrl+Break, or");
@@ -102,24 +142,114 @@ int main(int argc, char *argv[]) {
     Logger::CONSOLE = false;
     Logger::LEVEL = Logger::OL_INFO;
 
+    // ָηʾõ DNS ͻ
+    if (pcDnsServers) {
+        DNSClient::ENABLED = true;
+
+        string servers(pcDnsServers);
+        size_t begin = 0;
+
+        while (begin <= servers.length()) {
+            size_t end = servers.find(',', begin);
+            if (end == string::npos) {
+                end = servers.length();
+            }
+
+            if (end > begin) {
+                DNSClient::GetInstance().AddServer
+                    (servers.substr(begin, end - begin).c_str());
+            }
+
+            begin = end + 1;
+        }
+    }
+
+    // ɽ̽׽֮ǰᱣ DNS 
+    SOCKET listener = INVALID_SOCKET;
+    if (takeover) {
+        listener = Upgrade::TakeOver();
+        if (listener == INVALID_SOCKET) {
+            cerr << "Failed to take over the listener from "
+                 << Upgrade::PIPE_NAME << ".\n";
+
+            return 63;
+        }
+    }
+
+    // 󾡿ָ DNS 棬Ҫ½
+    size_t numLoaded = DNSCache::LoadSnapshot();
+    if (numLoaded > 0) {
+        printf("\nLoaded %u DNS cache entries.\n", (unsigned) numLoaded);
+    }
+
+    TaskExecutor::GetInstance().Start();
+
+    if (AccessLog::ENABLED && !AccessLog::Start()) {
+        cerr << "Failed to open the access log " << AccessLog::PATH << ".\n";
+    }
+
+    if (Capture::ENABLED && !Capture::Start()) {
+        cerr << "Failed to open the capture file " << Capture::PATH << ".\n";
+    }
+
     gs_proxy = new MyProxy;
-    if (!gs_proxy->Start(pcHost, nPort)) {
+    if (!gs_proxy->Start(pcHost, nPort, listener)) {
         delete gs_proxy;
         return 127;
     }
 
-    gs_runing = true;
+    // ڽֵ׽Ͻӣɽ̿˳
+    if (takeover) {
+        Upgrade::Confirm();
+    }
+
+    if (Upgrade::ENABLED) {
+        Upgrade::Start(gs_proxy->GetListener(), [] {
+            gs_runing = false;
+            SetEvent(gs_stopEvent);
+        });
+    }
+
+    time_t lastSnapshot = time(nullptr);
 
-    // һֱ˯
+    // һֱ˯ߣڱ DNS 
     while (gs_runing) {
-        Sleep(1000);
+        WaitForSingleObject(gs_stopEvent, 1000);
+
+        time_t curr = time(nullptr);
+        if (difftime(curr, lastSnapshot) >= DNSCache::SNAPSHOT_INTERVAL) {
+            DNSCache::SaveSnapshot();
+            lastSnapshot = curr;
+        }
     }
 
+    Upgrade::Stop();
+
+    // ٽӣȴ;ӽ
+    printf("\nDraining connections...\n");
+    gs_proxy->Drain(MyProxy::DRAIN_SECONDS, Upgrade::IsHandedOver(),
+                    gs_abortEvent);
+
     delete gs_proxy;
+    gs_proxy = nullptr;
+
+    DNSCache::SaveSnapshot();
+
+    // ִʣпддĲ
+    TaskExecutor::GetInstance().Stop();
+
+    AccessLog::Stop();
+    Capture::Stop();
+    RequestTrace::Close();
+    Logger::Stop();
     printf("\nProxy server stopped.\n");
 
     // Shut Winsock back down and take off.
     WSACleanup();
 
+    SetConsoleCtrlHandler(ConsoleHandler, FALSE);
+    CloseHandle(gs_stopEvent);
+    CloseHandle(gs_abortEvent);
+
     return 0;
 }
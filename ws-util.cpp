@@ -14,6 +14,10 @@
 #include <cassert>
 using namespace std;
 
+#ifdef MYPROXY_SIMULATION
+#include "SimNet.hpp" // ڴ滻 Winsock 
+#endif
+
 #include "Debug.hpp"
 
 